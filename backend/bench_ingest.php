@@ -0,0 +1,87 @@
+<?php
+// Benchmark JSON x binário do ingest (lado backend).
+// Lê os corpos gravados por firmware/tools/uplink_body_bench (-o <dir>) e mede,
+// com o mesmo código de ingest_sensorpacket.php (ingest_decode.php):
+// - decodificação de cada formato, em µs por requisição e por pacote
+// - com --db: INSERT do lote numa tabela temporária (LIKE leituras_v2)
+// Também confere que os dois formatos produzem os mesmos valores.
+//
+// Uso (somente CLI):
+//   php bench_ingest.php <dir> [reps] [--db]
+require_once __DIR__ . '/ingest_decode.php';
+
+if (PHP_SAPI !== 'cli') {
+    http_response_code(404);
+    exit;
+}
+
+$args = array_values(array_filter(array_slice($argv, 1), fn($a) => $a !== '--db'));
+$useDb = in_array('--db', $argv, true);
+$dir = $args[0] ?? null;
+$reps = (int)($args[1] ?? 2000);
+if ($dir === null || $reps <= 0) {
+    fwrite(STDERR, "uso: php bench_ingest.php <dir> [reps] [--db]\n");
+    exit(2);
+}
+
+$mysqli = null;
+if ($useDb) {
+    require_once __DIR__ . '/config.php';
+    $mysqli = db_connect();
+    $mysqli->query('CREATE TEMPORARY TABLE leituras_v2_bench LIKE leituras_v2');
+}
+
+// Tempo médio de uma chamada, em µs
+function bench_us(callable $fn, int $reps): float {
+    $t0 = hrtime(true);
+    for ($i = 0; $i < $reps; $i++) {
+        $fn();
+    }
+    return (hrtime(true) - $t0) / 1e3 / $reps;
+}
+
+$failures = 0;
+printf("%5s  %9s %9s  %12s %12s %7s", 'batch', 'json B', 'bin B', 'json µs/pk', 'bin µs/pk', 'speed');
+if ($useDb) {
+    printf("  %12s", 'insert µs/pk');
+}
+echo "\n";
+
+foreach ([1, 8, 16, 32] as $n) {
+    $json = @file_get_contents("{$dir}/json_{$n}.json");
+    $bin = @file_get_contents("{$dir}/bin_{$n}.bin");
+    if ($json === false || $bin === false) {
+        fwrite(STDERR, "faltam {$dir}/json_{$n}.json ou bin_{$n}.bin (rode uplink_body_bench -o {$dir})\n");
+        exit(2);
+    }
+
+    try {
+        [$vj, $cj, $rj] = ingest_decode($json, 'application/json');
+        [$vb, $cb, $rb] = ingest_decode($bin, 'application/octet-stream');
+    } catch (IngestError $e) {
+        echo "FAIL batch {$n}: {$e->getMessage()}\n";
+        $failures++;
+        continue;
+    }
+    // Comparação frouxa: a taxa vem float do JSON (-2.0) e int do binário (-20 / 10)
+    if ($cj !== $n || $cb !== $n || $rj + $rb !== 0 || $vj != $vb) {
+        echo "FAIL batch {$n}: JSON e binário decodificam diferente\n";
+        $failures++;
+    }
+
+    $tj = bench_us(fn() => ingest_decode($json, 'application/json'), $reps) / $n;
+    $tb = bench_us(fn() => ingest_decode($bin, 'application/octet-stream'), $reps) / $n;
+    printf("%5d  %9d %9d  %12.2f %12.2f %6.1fx", $n, strlen($json), strlen($bin), $tj, $tb, $tj / $tb);
+
+    if ($useDb) {
+        $ti = bench_us(fn() => ingest_insert($mysqli, $vb, $cb, 'leituras_v2_bench'), max(1, intdiv($reps, 10))) / $n;
+        printf("  %12.2f", $ti);
+    }
+    echo "\n";
+}
+
+if ($failures > 0) {
+    echo "\nFAIL: {$failures} checks\n";
+    exit(1);
+}
+echo "\nok\n";
@@ -0,0 +1,172 @@
+<?php
+// Decodificação e INSERT dos lotes do gateway, usados por ingest_sensorpacket.php
+// e por bench_ingest.php (mesmo código no endpoint e no benchmark).
+// Formatos:
+// - JSON: objeto único ou array em lote
+// - binário (HTTP_UPLINK_BINARY no gateway):
+//     [magic 0xAB][versão 1][flags][count] + count × ([len][SensorPacketV1/V2 packed, little-endian])
+// Os dois decodificadores devolvem a mesma lista plana de valores, na ordem de INGEST_FIELDS.
+
+// Limite de registros por requisição (gateway envia no máximo HTTP_BATCH_MAX)
+const INGEST_MAX_BATCH = 64;
+
+const UPLINK_BIN_MAGIC = 0xAB;
+const UPLINK_BIN_VERSION = 1;
+const SENSOR_PACKET_V1_SIZE = 30;
+const SENSOR_PACKET_V2_SIZE = 32;   // V1 + int16 rate_cmpm_x10
+const SENSOR_RATE_UNKNOWN = -32768;
+
+// Layout de SensorPacketV1 (common/telemetry_packet.h) para unpack()
+const SENSOR_PACKET_V1_UNPACK = 'Cversion/Cnode_id/a6mac/Vseq/vdistance_cm/vlevel_cm/Cpercentual/Vvolume_l/vvin_mv/Cflags/Calert_type/crssi/Vts_ms';
+
+// Colunas de leituras_v2 e filtro de cada campo JSON
+const INGEST_FIELDS = [
+    'version' => FILTER_VALIDATE_INT,
+    'node_id' => FILTER_VALIDATE_INT,
+    'mac' => FILTER_UNSAFE_RAW,
+    'seq' => FILTER_VALIDATE_INT,
+    'distance_cm' => FILTER_VALIDATE_INT,
+    'level_cm' => FILTER_VALIDATE_INT,
+    'percentual' => FILTER_VALIDATE_INT,
+    'volume_l' => FILTER_VALIDATE_INT,
+    'vin_mv' => FILTER_VALIDATE_INT,
+    'rssi' => FILTER_VALIDATE_INT,
+    'ts_ms' => FILTER_VALIDATE_INT,
+    'rate_cm_min' => FILTER_VALIDATE_FLOAT,   // null: nó sem taxa
+];
+
+// Lote inválido; o código é o status HTTP da resposta
+class IngestError extends Exception {}
+
+function int16_from_u16(int $v): int {
+    return $v >= 0x8000 ? $v - 0x10000 : $v;
+}
+
+// Lote binário -> [valores, linhas, rejeitados]
+function ingest_decode_binary(string $raw): array {
+    if (strlen($raw) < 4) {
+        throw new IngestError('Invalid binary batch', 400);
+    }
+    $hdr = unpack('Cmagic/Cversion/Cflags/Ccount', $raw);
+    if ($hdr['magic'] !== UPLINK_BIN_MAGIC || $hdr['version'] !== UPLINK_BIN_VERSION) {
+        throw new IngestError('Invalid binary batch', 400);
+    }
+    if ($hdr['count'] > INGEST_MAX_BATCH) {
+        throw new IngestError('Batch too large', 413);
+    }
+
+    // Campos já tipados, sem json_decode/filter_var
+    $values = [];
+    $count = 0;
+    $rejected = 0;
+    $off = 4;
+    $total = strlen($raw);
+    for ($i = 0; $i < $hdr['count']; $i++) {
+        if ($off >= $total) {
+            throw new IngestError('Invalid binary batch', 400);
+        }
+        $len = ord($raw[$off]);
+        $off++;
+        if ($off + $len > $total) {
+            throw new IngestError('Invalid binary batch', 400);
+        }
+        // Registros maiores (versões futuras) são lidos pelo prefixo V1
+        if ($len < SENSOR_PACKET_V1_SIZE) {
+            $rejected++;
+            $off += $len;
+            continue;
+        }
+        $p = unpack(SENSOR_PACKET_V1_UNPACK, $raw, $off);
+        // V2: taxa de nível em 0.1 cm/min (+ = enchendo)
+        $rate = null;
+        if ($len >= SENSOR_PACKET_V2_SIZE) {
+            $r = int16_from_u16(unpack('v', $raw, $off + SENSOR_PACKET_V1_SIZE)[1]);
+            $rate = $r === SENSOR_RATE_UNKNOWN ? null : $r / 10;
+        }
+        $off += $len;
+
+        array_push($values,
+            $p['version'],
+            $p['node_id'],
+            strtoupper(implode(':', str_split(bin2hex($p['mac']), 2))),
+            $p['seq'],
+            int16_from_u16($p['distance_cm']),
+            int16_from_u16($p['level_cm']),
+            $p['percentual'],
+            $p['volume_l'],
+            int16_from_u16($p['vin_mv']),
+            $p['rssi'],
+            $p['ts_ms'],
+            $rate);
+        $count++;
+    }
+    return [$values, $count, $rejected];
+}
+
+// Lote JSON -> [valores, linhas, rejeitados]. Registro inválido é descartado,
+// o restante do lote segue.
+function ingest_decode_json(string $raw): array {
+    $data = json_decode($raw, true);
+    if (!$data || !is_array($data)) {
+        throw new IngestError('Invalid JSON', 400);
+    }
+
+    // Lote = array JSON de objetos; pacote único = objeto
+    $rows = isset($data[0]) ? $data : [$data];
+    if (count($rows) > INGEST_MAX_BATCH) {
+        throw new IngestError('Batch too large', 413);
+    }
+
+    $values = [];
+    $count = 0;
+    $rejected = 0;
+    foreach ($rows as $row) {
+        if (!is_array($row)) {
+            $rejected++;
+            continue;
+        }
+
+        $clean = [];
+        foreach (INGEST_FIELDS as $key => $filter) {
+            if (!array_key_exists($key, $row) || $row[$key] === null) {
+                $clean[$key] = null;
+                continue;
+            }
+            $clean[$key] = filter_var($row[$key], $filter);
+        }
+
+        // Validação mínima
+        if ($clean['version'] === false || $clean['node_id'] === false || $clean['seq'] === false) {
+            $rejected++;
+            continue;
+        }
+
+        if ($clean['rate_cm_min'] === false) {
+            $clean['rate_cm_min'] = null;
+        }
+
+        foreach ($clean as $v) {
+            $values[] = $v;
+        }
+        $count++;
+    }
+    return [$values, $count, $rejected];
+}
+
+// Decodificador escolhido pelo Content-Type
+function ingest_decode(string $raw, string $contentType): array {
+    return $contentType === 'application/octet-stream' ? ingest_decode_binary($raw) : ingest_decode_json($raw);
+}
+
+// Um único INSERT multi-linha para o lote inteiro
+function ingest_insert(mysqli $mysqli, array $values, int $count, string $table = 'leituras_v2'): void {
+    $placeholders = implode(', ', array_fill(0, $count, '(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)'));
+    $stmt = $mysqli->prepare("INSERT INTO {$table} (version, node_id, mac, seq, distance_cm, level_cm, percentual, volume_l, vin_mv, rssi, ts_ms, rate_cm_min) VALUES " . $placeholders);
+    if (!$stmt) {
+        throw new IngestError('Prepare failed', 500);
+    }
+    $stmt->bind_param(str_repeat('iisiiiiiiiid', $count), ...$values);
+    if (!$stmt->execute()) {
+        throw new IngestError('Insert failed', 500);
+    }
+}
@@ -1,6 +1,10 @@
 <?php
-// Recebe JSON de SensorPacketV1 e insere em leituras_v2
+// Recebe SensorPacketV1/V2 do gateway e insere em leituras_v2.
+// Formatos (escolhidos pelo Content-Type, ver ingest_decode.php):
+// - application/json: objeto único ou array em lote
+// - application/octet-stream: lote binário do gateway (HTTP_UPLINK_BINARY)
 require_once __DIR__ . '/config.php';
+require_once __DIR__ . '/ingest_decode.php';
 
 if ($_SERVER['REQUEST_METHOD'] !== 'POST') {
     http_response_code(405);
@@ -9,65 +13,18 @@ if ($_SERVER['REQUEST_METHOD'] !== 'POST') {
 }
 
 $raw = file_get_contents('php://input');
-$data = json_decode($raw, true);
-if (!$data) {
-    http_response_code(400);
-    exit('Invalid JSON');
-}
-
-$fields = [
-    'version' => FILTER_VALIDATE_INT,
-    'node_id' => FILTER_VALIDATE_INT,
-    'mac' => FILTER_UNSAFE_RAW,
-    'seq' => FILTER_VALIDATE_INT,
-    'distance_cm' => FILTER_VALIDATE_INT,
-    'level_cm' => FILTER_VALIDATE_INT,
-    'percentual' => FILTER_VALIDATE_INT,
-    'volume_l' => FILTER_VALIDATE_INT,
-    'vin_mv' => FILTER_VALIDATE_INT,
-    'rssi' => FILTER_VALIDATE_INT,
-    'ts_ms' => FILTER_VALIDATE_INT,
-];
+$contentType = strtolower(trim(explode(';', $_SERVER['CONTENT_TYPE'] ?? '')[0]));
 
-$clean = [];
-foreach ($fields as $key => $filter) {
-    if (!array_key_exists($key, $data)) {
-        $clean[$key] = null;
-        continue;
+try {
+    [$values, $count, $rejected] = ingest_decode($raw, $contentType);
+    if ($count === 0) {
+        http_response_code(400);
+        exit('Missing required numeric fields');
     }
-    $clean[$key] = filter_var($data[$key], $filter);
-}
-
-// Validação mínima
-if ($clean['version'] === false || $clean['node_id'] === false || $clean['seq'] === false) {
-    http_response_code(400);
-    exit('Missing required numeric fields');
-}
-
-$mysqli = db_connect();
-$stmt = $mysqli->prepare('INSERT INTO leituras_v2 (version, node_id, mac, seq, distance_cm, level_cm, percentual, volume_l, vin_mv, rssi, ts_ms) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)');
-if (!$stmt) {
-    http_response_code(500);
-    exit('Prepare failed');
-}
-$stmt->bind_param(
-    'iisiiiiiiii',
-    $clean['version'],
-    $clean['node_id'],
-    $clean['mac'],
-    $clean['seq'],
-    $clean['distance_cm'],
-    $clean['level_cm'],
-    $clean['percentual'],
-    $clean['volume_l'],
-    $clean['vin_mv'],
-    $clean['rssi'],
-    $clean['ts_ms']
-);
-
-if (!$stmt->execute()) {
-    http_response_code(500);
-    exit('Insert failed');
+    ingest_insert(db_connect(), $values, $count);
+} catch (IngestError $e) {
+    http_response_code($e->getCode());
+    exit($e->getMessage());
 }
 
-echo 'ok';
+echo $rejected > 0 ? "ok {$count} ({$rejected} rejected)" : 'ok';
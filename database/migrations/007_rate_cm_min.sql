@@ -0,0 +1,10 @@
+-- Migração 007: Taxa de nível filtrada (SensorPacketV2)
+-- Data: 2026-10-17
+
+USE sensores_db;
+
+-- cm/min, + = enchendo; NULL quando o nó não envia taxa (V1, lote, sem filtro)
+ALTER TABLE leituras_v2
+    ADD COLUMN rate_cm_min DECIMAL(6,1) NULL AFTER ts_ms;
+
+SELECT 'Coluna rate_cm_min adicionada!' as status;
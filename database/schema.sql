@@ -12,7 +12,8 @@ CREATE TABLE IF NOT EXISTS leituras_v2 (
     volume_l INT,
     vin_mv INT,
     rssi TINYINT,
-    ts_ms BIGINT
+    ts_ms BIGINT,
+    rate_cm_min DECIMAL(6,1) NULL
 );
 
 CREATE INDEX idx_leituras_v2_node_ts ON leituras_v2 (node_id, created_at);
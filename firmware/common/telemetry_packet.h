@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 // Binary packet v1 for ESP-NOW transport between nodes and gateway.
 // Packed to avoid padding differences across compilers.
@@ -22,14 +24,55 @@ typedef struct __attribute__((packed)) {
 
     // Fields set/overwritten by the gateway upon reception
     int8_t   rssi;           // RSSI if available, else 0
-    uint32_t ts_ms;          // gateway timestamp in ms
+    uint32_t ts_ms;          // node: age of the reading in ms (0 = just measured);
+                             // gateway: replaced by the reception timestamp minus that age
 } SensorPacketV1;
 
 #define SENSOR_PACKET_VERSION 1
 
+// Binary packet v2: the v1 fields (same layout and offsets, version = 2)
+// followed by the level rate from the node's 2-state Kalman filter. v1 is a
+// prefix of v2, so readers of v1 records can take the first 30 bytes.
+typedef struct __attribute__((packed)) {
+    uint8_t  version;        // = 2
+    uint8_t  node_id;
+    uint8_t  mac[6];
+    uint32_t seq;
+
+    int16_t  distance_cm;
+    int16_t  level_cm;
+    uint8_t  percentual;
+    uint32_t volume_l;
+    int16_t  vin_mv;
+
+    uint8_t  flags;
+    uint8_t  alert_type;
+
+    int8_t   rssi;           // set by the gateway
+    uint32_t ts_ms;          // age of the reading (node) / timestamp (gateway), see v1
+
+    int16_t  rate_cmpm_x10;  // filtered level rate in 0.1 cm/min (+ = filling),
+                             // SENSOR_RATE_UNKNOWN when the node has none
+} SensorPacketV2;
+
+#define SENSOR_PACKET_V2_VERSION 2
+#define SENSOR_RATE_UNKNOWN      INT16_MIN
+
+// A frame may carry several SensorPacketV2 (or V1) back to back, oldest
+// first, e.g. readings a node stored while no gateway answered. The gateway
+// ACKs the last one. 7 x 32 B (8 x 30 B for v1) fits the 250-byte ESP-NOW
+// payload.
+#define SENSOR_PACKET_MAX_PER_FRAME    7
+#define SENSOR_PACKET_V1_MAX_PER_FRAME 8
+
 // Packet flags
 #define FLAG_IS_ALERT  0x01  // Bit 0: Anomaly alert triggered
 
+// Flags set by the gateway when it normalizes other formats into SensorPacketV1
+#define FLAG_DISTANCE_ONLY  0x02  // Bit 1: only distance_cm is valid (level/percentual/volume computed server-side)
+#define FLAG_LOW_BATTERY    0x04  // Bit 2: node reported low battery
+#define FLAG_SENSOR_ERROR   0x08  // Bit 3: node reported a failed/timed-out reading
+
 // Alert types
 #define ALERT_NONE         0
 #define ALERT_RAPID_DROP   1  // Leak detected (rapid water level drop)
@@ -44,7 +87,7 @@ typedef struct __attribute__((packed)) {
     uint32_t ack_seq;        // Sequence number being acknowledged
     int8_t   rssi;           // RSSI measured by gateway
     uint8_t  status;         // 0=OK, 1=parsed but not sent, 2=error
-    uint8_t  gateway_id;     // Which gateway sent this ACK (0-2)
+    uint8_t  gateway_id;     // Which gateway sent this ACK (GATEWAY_ID on the gateway)
     uint8_t  reserved;       // Future use
 } AckPacket;
 
@@ -54,6 +97,23 @@ typedef struct __attribute__((packed)) {
 #define ACK_STATUS_QUEUED 1
 #define ACK_STATUS_ERROR 2
 
+// Beacon broadcast by every gateway every GATEWAY_BEACON_INTERVAL_MS. Nodes
+// learn gateways from it (the gateway MAC is the frame's source address) and
+// rank them by the RSSI they hear, so a new gateway needs no node reflash.
+typedef struct __attribute__((packed)) {
+    uint8_t  magic;          // 0xBE
+    uint8_t  version;        // = 1
+    uint8_t  gateway_id;     // same ID as in its ACKs
+    uint8_t  flags;          // GATEWAY_BEACON_FLAG_*
+    uint8_t  load_pct;       // uplink queue fill, 0..100
+    uint8_t  reserved;
+    uint16_t beacon_seq;     // +1 per beacon
+} GatewayBeacon;
+
+#define GATEWAY_BEACON_MAGIC          0xBE
+#define GATEWAY_BEACON_VERSION        1
+#define GATEWAY_BEACON_FLAG_UPLINK_OK 0x01  // backend reachable (readings go out now, not to the gateway backlog)
+
 // ============================================================================
 // AGUADA ULTRASONIC 01 - Ultra-minimal telemetry packet
 // ============================================================================
@@ -62,7 +122,7 @@ typedef struct __attribute__((packed)) {
 // - Server maintains node configuration table (MAC, offsets, tank geometry)
 // - Server performs all calculations (level, percentage, volume)
 // - Gateway adds: RSSI + timestamp (6 bytes metadata)
-// - Total: 13 bytes (vs 28 bytes in SensorPacketV1)
+// - Total: 13 bytes (vs 30 bytes in SensorPacketV1)
 // - 54% size reduction, ideal for high-frequency sampling or battery operation
 
 typedef struct __attribute__((packed)) {
@@ -127,6 +187,48 @@ typedef struct {
 //     return (uint32_t)(((int64_t)level_cm * (int64_t)cfg->vol_max_l) / (int64_t)cfg->level_max_cm);
 // }
 
+// ============================================================================
+// SENSOR BATCH - several distance samples in one ESP-NOW frame
+// ============================================================================
+// A node that samples faster than it transmits buffers its samples and sends
+// them together: fixed header + distance of sample 0 + one delta per further
+// sample (oldest first).
+//   sample i: seq            = base_seq + i
+//             age at send    = base_age_ms - i * interval_ms
+//             distance_cm    = previous + int8 delta; a delta byte equal to
+//                              SENSOR_BATCH_DELTA_ESCAPE is followed by the
+//                              absolute int16 value (little-endian)
+// flags/alert_type: OR of the samples' flags and the last alert; the gateway
+// puts them on the newest record. vin_mv is read at send time (all samples).
+// With level_max_cm > 0 the gateway fills level/percentual/volume from the
+// tank model (same math as level_calculator); otherwise distance only.
+// The gateway ACKs the frame with the seq of the newest sample.
+
+typedef struct __attribute__((packed)) {
+    uint8_t  magic;             // 0xB1
+    uint8_t  version;           // = 1
+    uint8_t  node_id;
+    uint8_t  count;             // samples in the frame (1..SENSOR_BATCH_MAX_SAMPLES)
+    uint32_t base_seq;          // seq of sample 0 (oldest)
+    uint32_t base_age_ms;       // age of sample 0 when the frame was sent
+    uint32_t interval_ms;       // time between samples
+    int16_t  vin_mv;
+    uint8_t  flags;
+    uint8_t  alert_type;
+    int16_t  level_max_cm;      // tank model (0 = distance only)
+    int16_t  sensor_offset_cm;
+    uint32_t vol_max_l;
+    int16_t  distance_cm;       // sample 0
+    // followed by the deltas of samples 1..count-1
+} SensorBatchHeader;            // 30 bytes
+
+#define SENSOR_BATCH_MAGIC        0xB1
+#define SENSOR_BATCH_VERSION      1
+#define SENSOR_BATCH_MAX_SAMPLES  32
+#define SENSOR_BATCH_DELTA_ESCAPE (-128)
+// Worst case: every delta escaped (3 bytes) -> 123 bytes, below the 250-byte ESP-NOW limit
+#define SENSOR_BATCH_MAX_FRAME    (sizeof(SensorBatchHeader) + (SENSOR_BATCH_MAX_SAMPLES - 1) * 3)
+
 // ============================================================================
 // GENERIC DATA PACKET - Variable length key-value pairs
 // ============================================================================
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "common/telemetry_packet.h"
+
+namespace ack_wait {
+
+// ============================================================================
+// ACK ROUND-TRIP HISTOGRAM
+// ============================================================================
+// Fixed buckets (ms): <5 <10 <20 <50 <100 <200 <500 >=500. Timeouts are
+// counted separately. Plain aggregate: can live in RTC memory.
+// Serial log only, not in the telemetry: SensorPacketV2 is the record the
+// gateway normalizes every format into, stores in its flash backlog and
+// posts to the backend table, and it has no spare bytes. Carrying p50/max/
+// timeouts would take a new packet version through node, gateway decoder,
+// backlog, uplink encoders and schema for a link-debugging figure; the
+// per-gateway RTT that matters for routing is already in gateway_table.
+
+constexpr int RTT_BUCKETS = 8;
+constexpr uint32_t RTT_BOUNDS_MS[RTT_BUCKETS - 1] = {5, 10, 20, 50, 100, 200, 500};
+
+struct RttHistogram {
+    uint32_t buckets[RTT_BUCKETS];
+    uint32_t count;
+    uint32_t timeouts;
+    uint32_t max_us;
+    uint64_t sum_us;
+
+    void record(int64_t rtt_us) {
+        uint32_t us = rtt_us < 0 ? 0 : (uint32_t)rtt_us;
+        int i = 0;
+        while (i < RTT_BUCKETS - 1 && us >= RTT_BOUNDS_MS[i] * 1000) {
+            i++;
+        }
+        buckets[i]++;
+        count++;
+        sum_us += us;
+        if (us > max_us) {
+            max_us = us;
+        }
+    }
+
+    void record_timeout() { timeouts++; }
+
+    // One line with the node's other TX stats
+    void log(const char *tag) const {
+        uint32_t avg_us = count ? (uint32_t)(sum_us / count) : 0;
+        ESP_LOGI(tag, "📊 ACK RTT: n=%" PRIu32 " avg=%" PRIu32 ".%" PRIu32 "ms max=%" PRIu32 ".%" PRIu32 "ms timeouts=%" PRIu32
+                      " | <5:%" PRIu32 " <10:%" PRIu32 " <20:%" PRIu32 " <50:%" PRIu32 " <100:%" PRIu32 " <200:%" PRIu32 " <500:%" PRIu32 " >=500:%" PRIu32,
+                 count, avg_us / 1000, (avg_us % 1000) / 100, max_us / 1000, (max_us % 1000) / 100, timeouts,
+                 buckets[0], buckets[1], buckets[2], buckets[3], buckets[4], buckets[5], buckets[6], buckets[7]);
+    }
+};
+
+// ============================================================================
+// ACK WAITER (task notification instead of polling a flag)
+// ============================================================================
+// The sending task arm()s the (node_id, seq) it expects and the gateway it
+// sends to, sends, and blocks in wait(). espnow_recv_cb hands every ACK to
+// deliver() with its source MAC: a matching one is copied under the lock and
+// the sender is notified with the seq as the notification value, so the
+// flag/seq pair can no longer be seen half-updated and the sender wakes as
+// soon as the ACK arrives (no 10 ms polling).
+// Late ACKs for an earlier seq are ignored, and so are late ACKs for the same
+// seq from the previous gateway of a failover (its RTT and the ACK itself
+// would otherwise be credited to the gateway tried now).
+
+class AckWaiter {
+public:
+    // Sending task, right before esp_now_send()
+    void arm(uint8_t node_id, uint32_t seq, const uint8_t gateway_mac[6]) {
+        TaskHandle_t self = xTaskGetCurrentTaskHandle();
+        portENTER_CRITICAL(&lock_);
+        task_ = self;
+        node_id_ = node_id;
+        seq_ = seq;
+        memcpy(gateway_mac_, gateway_mac, 6);
+        armed_ = true;
+        acked_ = false;
+        sent_us_ = esp_timer_get_time();
+        portEXIT_CRITICAL(&lock_);
+        xTaskNotifyStateClear(nullptr);   // drop a notification left by an earlier ACK
+    }
+
+    // espnow_recv_cb (Wi-Fi task), src_addr from recv_info. Returns true if
+    // the ACK matched the armed send.
+    bool deliver(const uint8_t src_addr[6], const AckPacket &ack) {
+        int64_t now = esp_timer_get_time();
+        portENTER_CRITICAL(&lock_);
+        bool match = armed_ && ack.ack_seq == seq_ && ack.node_id == node_id_ &&
+                     memcmp(src_addr, gateway_mac_, 6) == 0;
+        TaskHandle_t task = task_;
+        if (match) {
+            ack_ = ack;
+            rtt_us_ = now - sent_us_;
+            armed_ = false;
+            acked_ = true;
+        }
+        portEXIT_CRITICAL(&lock_);
+        if (match) {
+            xTaskNotify(task, ack.ack_seq, eSetValueWithOverwrite);
+        }
+        return match;
+    }
+
+    // Block until the armed ACK arrives or timeout_ms passes. Records the RTT
+    // (or the timeout) in hist; copies the ACK to *out on success.
+    bool wait(uint32_t timeout_ms, RttHistogram &hist, AckPacket *out = nullptr) {
+        TickType_t start = xTaskGetTickCount();
+        TickType_t budget = pdMS_TO_TICKS(timeout_ms);
+        for (;;) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            uint32_t value = 0;
+            if (elapsed >= budget ||
+                xTaskNotifyWait(0, UINT32_MAX, &value, budget - elapsed) != pdTRUE) {
+                break;
+            }
+            portENTER_CRITICAL(&lock_);
+            bool ok = acked_ && value == seq_;
+            AckPacket ack = ack_;
+            int64_t rtt = rtt_us_;
+            portEXIT_CRITICAL(&lock_);
+            if (ok) {
+                hist.record(rtt);
+                if (out) {
+                    *out = ack;
+                }
+                return true;
+            }
+        }
+
+        portENTER_CRITICAL(&lock_);
+        armed_ = false;
+        bool late = acked_;   // arrived between the timeout and here
+        AckPacket ack = ack_;
+        int64_t rtt = rtt_us_;
+        portEXIT_CRITICAL(&lock_);
+        if (late) {
+            hist.record(rtt);
+            if (out) {
+                *out = ack;
+            }
+            return true;
+        }
+        hist.record_timeout();
+        return false;
+    }
+
+    // Round trip of the last matched ACK (us)
+    int64_t last_rtt_us() const { return rtt_us_; }
+
+private:
+    portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+    TaskHandle_t task_ = nullptr;
+    uint8_t node_id_ = 0;
+    uint32_t seq_ = 0;
+    uint8_t gateway_mac_[6] = {};
+    bool armed_ = false;
+    bool acked_ = false;
+    int64_t sent_us_ = 0;
+    int64_t rtt_us_ = 0;
+    AckPacket ack_ = {};
+};
+
+} // namespace ack_wait
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "decimator.h"
+
+namespace adc_oversample {
+
+// ============================================================================
+// CONTINUOUS-MODE ADC OVERSAMPLER (adc_continuous DMA, one ADC1 channel)
+// ============================================================================
+// The ADC converts one channel continuously at sample_hz into DMA frames; the
+// driver's conv-done ISR wakes a small task that drains the frames through a
+// CicDecimator and WindowStats (decimator.h). read() only copies the window
+// under a spinlock and converts it to mV: it never waits for the ADC.
+//
+// adc_continuous takes the whole ADC1 unit: adc_oneshot cannot be used on
+// ADC1 while this runs (on the ESP32-C3 ADC2 is not usable with Wi-Fi).
+
+struct Config {
+    adc_channel_t channel;
+    uint32_t sample_hz = 1000;             // SOC_ADC_SAMPLE_FREQ_THRES_LOW (611 Hz on the C3) or more
+    adc_atten_t atten = ADC_ATTEN_DB_12;
+    uint32_t frame_bytes = 256;            // DMA frame: 64 conversions, one task wake-up
+    UBaseType_t task_priority = 2;
+};
+
+// One window, in mV at the ADC pin
+struct Reading {
+    int avg_mv;
+    int min_mv;
+    int max_mv;
+    uint32_t count;   // decimated values in the window (0: none new since the last read)
+    bool valid;       // false until the first decimated value
+};
+
+template <uint32_t R, int ORDER = 2>
+class AdcOversampler {
+public:
+    using Decimator = CicDecimator<R, ORDER, 12>;
+
+    // On failure everything start() created is released again (the task,
+    // the driver handle, the calibration scheme) and read() stays invalid.
+    esp_err_t start(const Config &cfg) {
+        esp_err_t err = init(cfg);
+        if (err != ESP_OK) {
+            release();
+        }
+        return err;
+    }
+
+    bool calibrated() const { return cali_ != nullptr; }
+
+    // Window since the last read(), in mV at the pin. Non-blocking.
+    Reading read() {
+        portENTER_CRITICAL(&lock_);
+        Window w = stats_.take();
+        portEXIT_CRITICAL(&lock_);
+        return Reading{to_mv(w.avg), to_mv(w.min), to_mv(w.max), w.count, w.valid};
+    }
+
+private:
+    esp_err_t init(const Config &cfg) {
+        cfg_ = cfg;
+        adc_continuous_handle_cfg_t handle_cfg = {};
+        handle_cfg.max_store_buf_size = cfg.frame_bytes * 4;
+        handle_cfg.conv_frame_size = cfg.frame_bytes;
+        esp_err_t err = adc_continuous_new_handle(&handle_cfg, &handle_);
+        if (err != ESP_OK) return err;
+
+        adc_digi_pattern_config_t pattern = {};
+        pattern.atten = cfg.atten;
+        pattern.channel = cfg.channel;
+        pattern.unit = ADC_UNIT_1;
+        pattern.bit_width = ADC_BITWIDTH_12;
+        adc_continuous_config_t dig_cfg = {};
+        dig_cfg.pattern_num = 1;
+        dig_cfg.adc_pattern = &pattern;
+        dig_cfg.sample_freq_hz = cfg.sample_hz;
+        dig_cfg.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+        dig_cfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+        err = adc_continuous_config(handle_, &dig_cfg);
+        if (err != ESP_OK) return err;
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+        adc_cali_curve_fitting_config_t cali_cfg = {
+            .unit_id = ADC_UNIT_1,
+            .chan = cfg.channel,
+            .atten = cfg.atten,
+            .bitwidth = ADC_BITWIDTH_12,
+        };
+        if (adc_cali_create_scheme_curve_fitting(&cali_cfg, &cali_) != ESP_OK) {
+            cali_ = nullptr;
+        }
+#endif
+
+        adc_continuous_evt_cbs_t cbs = {};
+        cbs.on_conv_done = &AdcOversampler::conv_done_isr;
+        err = adc_continuous_register_event_callbacks(handle_, &cbs, this);
+        if (err != ESP_OK) return err;
+
+        // Last: the ISR notifies this task, and nothing can fail after it but the start itself
+        if (xTaskCreate(&AdcOversampler::task_fn, "adc_os", 3072, this, cfg.task_priority, &task_) != pdPASS) {
+            task_ = nullptr;
+            return ESP_ERR_NO_MEM;
+        }
+        return adc_continuous_start(handle_);
+    }
+
+    // Undo a partial init(). The ADC is not running, so the task is parked in
+    // ulTaskNotifyTake() and the driver can be deinitialized.
+    void release() {
+        if (task_) {
+            vTaskDelete(task_);
+            task_ = nullptr;
+        }
+        if (handle_) {
+            adc_continuous_deinit(handle_);
+            handle_ = nullptr;
+        }
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+        if (cali_) {
+            adc_cali_delete_scheme_curve_fitting(cali_);
+            cali_ = nullptr;
+        }
+#endif
+    }
+
+    static bool IRAM_ATTR conv_done_isr(adc_continuous_handle_t, const adc_continuous_evt_data_t *, void *arg) {
+        AdcOversampler *self = static_cast<AdcOversampler *>(arg);
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(self->task_, &woken);
+        return woken == pdTRUE;
+    }
+
+    static void task_fn(void *arg) {
+        static_cast<AdcOversampler *>(arg)->run();
+    }
+
+    void run() {
+        uint8_t buf[256];
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            uint32_t got = 0;
+            while (adc_continuous_read(handle_, buf, sizeof(buf), &got, 0) == ESP_OK) {
+                for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got; i += SOC_ADC_DIGI_RESULT_BYTES) {
+                    const adc_digi_output_data_t *d = reinterpret_cast<const adc_digi_output_data_t *>(&buf[i]);
+                    if (d->type2.unit != 0 || d->type2.channel != (uint32_t)cfg_.channel) {
+                        continue;   // not ours, or a DMA result flagged invalid
+                    }
+                    uint32_t out;
+                    if (decimator_.push(d->type2.data, &out)) {
+                        portENTER_CRITICAL(&lock_);
+                        stats_.add(out);
+                        portEXIT_CRITICAL(&lock_);
+                    }
+                }
+            }
+        }
+    }
+
+    int to_mv(uint32_t raw) const {
+        int mv = 0;
+        if (!cali_ || adc_cali_raw_to_voltage(cali_, (int)raw, &mv) != ESP_OK) {
+            mv = (int)(raw * 3300 / 4095);   // uncalibrated, approximate
+        }
+        return mv;
+    }
+
+    Config cfg_ = {};
+    adc_continuous_handle_t handle_ = nullptr;
+    adc_cali_handle_t cali_ = nullptr;
+    TaskHandle_t task_ = nullptr;
+    Decimator decimator_;                  // touched only by the task
+    WindowStats stats_;                    // shared with read(), under lock_
+    portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+} // namespace adc_oversample
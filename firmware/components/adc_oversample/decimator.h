@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace adc_oversample {
+
+// ============================================================================
+// CIC DECIMATOR + WINDOW STATISTICS (no hardware access)
+// ============================================================================
+// The ADC runs continuously (DMA) at sample_hz; every sample goes through a
+// CIC (cascaded integrator-comb) decimator: ORDER integrators at the input
+// rate, ORDER combs at the output rate, one output per R inputs. ORDER = 1 is
+// a plain boxcar average of R samples; ORDER = 2 is two boxcars in series
+// (triangle weights over 2R - 1 samples, better rejection of mains hum and of
+// the radio's current bursts). No multiplications: adds and subtractions in
+// uint32_t, where wraparound is harmless as long as the true output fits
+// (INPUT_BITS + ORDER * log2(R) <= 32, checked at compile time).
+//
+// Outputs (R * 1 / sample_hz apart) are accumulated by WindowStats between two
+// reads of the node: average, min and max of the filtered value since the
+// last take(), so a read costs no waiting and also shows the sag while the
+// radio transmits.
+
+template <uint32_t R, int ORDER = 2, int INPUT_BITS = 12>
+class CicDecimator {
+    static_assert(R >= 1, "decimation must be at least 1");
+    static_assert(ORDER >= 1 && ORDER <= 4, "CIC order 1..4");
+
+    static constexpr int bits_of(uint64_t v) {
+        int b = 0;
+        while ((1ULL << b) < v) b++;
+        return b;
+    }
+    static constexpr uint64_t gain() {
+        uint64_t g = 1;
+        for (int i = 0; i < ORDER; i++) g *= R;
+        return g;
+    }
+
+public:
+    static constexpr uint32_t DECIMATION = R;
+    static constexpr uint64_t GAIN = gain();   // R^ORDER
+    static_assert(INPUT_BITS + bits_of(GAIN) <= 32, "CIC register overflow: lower R or ORDER");
+
+    constexpr CicDecimator() = default;
+
+    // Feed one input sample; true when an output is ready in *out (same units
+    // as the input, rounded)
+    bool push(uint32_t x, uint32_t *out) {
+        uint32_t v = x;
+        for (int i = 0; i < ORDER; i++) {
+            integ_[i] += v;
+            v = integ_[i];
+        }
+        if (++phase_ < R) {
+            return false;
+        }
+        phase_ = 0;
+        for (int i = 0; i < ORDER; i++) {
+            uint32_t prev = comb_[i];
+            comb_[i] = v;
+            v -= prev;
+        }
+        // The first ORDER - 1 outputs still include the zeros before the
+        // first sample (filter warm-up): skip them
+        if (warm_ < ORDER - 1) {
+            warm_++;
+            return false;
+        }
+        *out = (uint32_t)((v + GAIN / 2) / GAIN);
+        return true;
+    }
+
+    void reset() { *this = CicDecimator(); }
+
+private:
+    uint32_t integ_[ORDER] = {};
+    uint32_t comb_[ORDER] = {};
+    uint32_t phase_ = 0;
+    int warm_ = 0;
+};
+
+// Average / min / max of the decimated values since the last take()
+struct Window {
+    uint32_t avg;
+    uint32_t min;
+    uint32_t max;
+    uint32_t count;   // decimated values in the window; 0 = none since the last take()
+    bool valid;       // false until the first decimated value
+};
+
+class WindowStats {
+public:
+    constexpr WindowStats() = default;
+
+    void add(uint32_t v) {
+        if (count_ == 0 || v < min_) min_ = v;
+        if (count_ == 0 || v > max_) max_ = v;
+        sum_ += v;
+        count_++;
+        last_ = v;
+        valid_ = true;
+    }
+
+    // Statistics of the window, then start a new one. With nothing new since
+    // the last take() (read faster than the decimated rate) it repeats the
+    // last value with count 0.
+    Window take() {
+        Window w;
+        if (count_ == 0) {
+            w = {last_, last_, last_, 0, valid_};
+        } else {
+            w = {(uint32_t)((sum_ + count_ / 2) / count_), min_, max_, count_, true};
+        }
+        sum_ = 0;
+        count_ = 0;
+        return w;
+    }
+
+private:
+    uint64_t sum_ = 0;
+    uint32_t count_ = 0;
+    uint32_t min_ = 0;
+    uint32_t max_ = 0;
+    uint32_t last_ = 0;
+    bool valid_ = false;
+};
+
+} // namespace adc_oversample
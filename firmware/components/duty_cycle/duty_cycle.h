@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "sdkconfig.h"
+
+// ============================================================================
+// DEEP-SLEEP DUTY CYCLE (CONFIG_NODE_DEEP_SLEEP)
+// ============================================================================
+// Each boot does one measure/send cycle and then deep-sleeps until the next
+// period; app_main's loop body runs once per wake. State that must survive the
+// sleep (filters, anomaly baseline, seq, last gateway) is declared with
+// DUTY_CYCLE_RETAINED, which places it in RTC slow memory in deep-sleep builds:
+// initialized on power-on, kept across timer wakes. Objects stored there must
+// be constant-initialized (constexpr constructors), otherwise their dynamic
+// initializer would run again on every wake.
+//
+// Without CONFIG_NODE_DEEP_SLEEP the macro is empty and the node keeps its
+// active loop (vTaskDelay between cycles).
+
+#if CONFIG_NODE_DEEP_SLEEP
+#define DUTY_CYCLE_RETAINED RTC_DATA_ATTR
+#else
+#define DUTY_CYCLE_RETAINED
+#endif
+
+namespace duty_cycle {
+
+constexpr int64_t MIN_SLEEP_US = 1000000;  // never sleep less than 1 s
+
+// Wake-to-sleep statistics (retained across cycles)
+struct Stats {
+    uint32_t cycles;           // cycles since power-on
+    uint32_t last_active_ms;   // previous cycle, wake to sleep
+    uint32_t max_active_ms;
+    uint64_t total_active_ms;
+    uint64_t elapsed_ms;       // power-on to the start of this cycle (active + sleep)
+};
+
+static DUTY_CYCLE_RETAINED Stats cycle_stats = {0, 0, 0, 0, 0};
+
+inline const Stats &stats() { return cycle_stats; }
+
+// Milliseconds since power-on, counting the deep sleeps (esp_timer restarts
+// at every wake; the boot time before it starts is not counted). Without
+// CONFIG_NODE_DEEP_SLEEP this is just esp_timer.
+inline uint64_t uptime_ms() {
+    return cycle_stats.elapsed_ms + (uint64_t)(esp_timer_get_time() / 1000);
+}
+
+// True when this boot is a timer wake from deep sleep (RTC state is valid)
+inline bool woke_from_sleep() {
+    return esp_reset_reason() == ESP_RST_DEEPSLEEP;
+}
+
+// Log the cycle number and the previous cycle's active time
+inline void log_wake(const char *tag) {
+    const Stats &s = stats();
+    if (woke_from_sleep()) {
+        ESP_LOGI(tag, "⏰ Ciclo %" PRIu32 " (acordou do deep sleep; ciclo anterior ativo %" PRIu32 " ms)",
+                 s.cycles + 1, s.last_active_ms);
+    } else {
+        ESP_LOGI(tag, "⏰ Boot a frio: estado RTC reiniciado");
+    }
+}
+
+// Stop the radio and deep-sleep until the next period starts. The sleep time
+// is the period minus this cycle's active time, so the sampling period stays
+// constant. Reports the wake-to-sleep time (esp_timer starts at boot).
+[[noreturn]] inline void sleep_until_next(uint32_t period_s, const char *tag) {
+    Stats &s = cycle_stats;
+    int64_t active_us = esp_timer_get_time();
+    uint32_t active_ms = (uint32_t)(active_us / 1000);
+    s.cycles++;
+    s.last_active_ms = active_ms;
+    if (active_ms > s.max_active_ms) {
+        s.max_active_ms = active_ms;
+    }
+    s.total_active_ms += active_ms;
+
+    int64_t sleep_us = (int64_t)period_s * 1000000 - active_us;
+    if (sleep_us < MIN_SLEEP_US) {
+        sleep_us = MIN_SLEEP_US;
+    }
+    s.elapsed_ms += active_ms + (uint64_t)(sleep_us / 1000);
+
+    // Duty in 0.01 % units: active / period
+    uint32_t duty = (uint32_t)((uint64_t)active_ms * 10000 / ((uint64_t)period_s * 1000));
+    ESP_LOGI(tag, "💤 Ciclo %" PRIu32 ": ativo %" PRIu32 " ms (média %" PRIu32 ", máx %" PRIu32 ") duty=%" PRIu32 ".%02" PRIu32 "%%, dormindo %" PRIu32 " ms",
+             s.cycles, active_ms, (uint32_t)(s.total_active_ms / s.cycles), s.max_active_ms,
+             duty / 100, duty % 100, (uint32_t)(sleep_us / 1000));
+
+    esp_now_deinit();
+    esp_wifi_stop();
+    esp_sleep_enable_timer_wakeup((uint64_t)sleep_us);
+    esp_deep_sleep_start();
+}
+
+} // namespace duty_cycle
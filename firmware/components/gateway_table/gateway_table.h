@@ -0,0 +1,284 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common/telemetry_packet.h"
+
+#ifndef GATEWAY_TABLE_CAPACITY
+#define GATEWAY_TABLE_CAPACITY 4      // gateways a node keeps (configured + learned)
+#endif
+
+#ifndef GATEWAY_TABLE_TTL_S
+#define GATEWAY_TABLE_TTL_S 3600      // a learned gateway not heard for this long is forgotten
+#endif
+
+namespace gateway_table {
+
+// ============================================================================
+// GATEWAY TABLE (ranked by RSSI and ACK latency, no hardware access)
+// ============================================================================
+// Gateways broadcast a GatewayBeacon every GATEWAY_BEACON_INTERVAL_MS. The
+// node learns every gateway it hears (beacon or ACK; the MAC is the frame's
+// source) and keeps, per gateway, a running average of the RSSI it receives
+// and of the ACK round trip. rank() lists the gateways best first: the sender
+// tries each one once and moves to the next after a single missed ACK, and
+// ack_timeout_ms() shortens the wait for a gateway whose round trip is known.
+//
+// Cost, lower is better (roughly dB):
+//   -RSSI + RTT_ms / 4 + 15 per consecutive miss + 20 if its uplink is down
+//   + load / 10, and -6 for the gateway that ACKed last (no flapping on noise)
+// A gateway never heard counts as RSSI_UNHEARD_DBM.
+//
+// Configured MACs (GATEWAY_MACS) are seeds: they never expire. Learned
+// gateways expire after GATEWAY_TABLE_TTL_S without a beacon or an ACK; when
+// the table is full a new gateway replaces the worst learned one. Time is the
+// node clock in seconds (duty_cycle::uptime_ms() / 1000, runs across deep
+// sleep). Constant-initialized: can be kept in RTC memory (DUTY_CYCLE_RETAINED).
+// Not thread-safe: the node guards it with a spinlock (espnow_recv_cb runs in
+// the Wi-Fi task).
+
+constexpr int RSSI_UNHEARD_DBM = -85;
+constexpr int COST_PER_MISS = 15;
+constexpr int COST_NO_UPLINK = 20;
+constexpr int COST_PREFERRED = -6;
+constexpr uint8_t ID_UNKNOWN = 0xFF;
+
+enum : uint8_t {
+    FLAG_USED      = 0x01,
+    FLAG_SEED      = 0x02,   // configured in GATEWAY_MACS: never expires or gets evicted
+    FLAG_HEARD     = 0x04,   // rssi_x16 is valid
+    FLAG_NO_UPLINK = 0x08,   // last beacon said the backend is unreachable
+};
+
+struct Entry {
+    uint8_t mac[6];
+    uint8_t gateway_id;      // from its beacons / ACKs, ID_UNKNOWN until heard
+    uint8_t flags;           // FLAG_*
+    uint8_t load_pct;        // uplink queue fill from its last beacon
+    uint8_t misses;          // consecutive sends without ACK
+    int16_t rssi_x16;        // average RSSI heard from it (dBm * 16)
+    uint32_t rtt_us;         // average ACK round trip, 0 = none yet
+    uint32_t last_seen_s;    // node clock of its last beacon or ACK
+
+    int rssi_dbm() const { return flags & FLAG_HEARD ? rssi_x16 / 16 : RSSI_UNHEARD_DBM; }
+};
+
+class Table {
+public:
+    constexpr Table() = default;
+
+    constexpr int count() const {
+        int n = 0;
+        for (const Entry &e : entries_) {
+            n += (e.flags & FLAG_USED) ? 1 : 0;
+        }
+        return n;
+    }
+
+    // Configured gateway; false if the table is full of seeds
+    bool seed(const uint8_t mac[6]) {
+        Entry *e = find_or_add(mac, 0);
+        if (!e) {
+            return false;
+        }
+        e->flags |= FLAG_SEED;
+        return true;
+    }
+
+    // A beacon from mac at rssi dBm. Returns true if the gateway is new.
+    bool heard_beacon(const uint8_t mac[6], int rssi, const GatewayBeacon &b, uint32_t now_s) {
+        bool added = false;
+        Entry *e = heard(mac, rssi, b.gateway_id, now_s, &added);
+        if (e) {
+            e->load_pct = b.load_pct > 100 ? 100 : b.load_pct;
+            if (b.flags & GATEWAY_BEACON_FLAG_UPLINK_OK) {
+                e->flags &= (uint8_t)~FLAG_NO_UPLINK;
+            } else {
+                e->flags |= FLAG_NO_UPLINK;
+            }
+        }
+        return added;
+    }
+
+    // An ACK frame from mac (received in espnow_recv_cb, whether it matched or not)
+    bool heard_ack(const uint8_t mac[6], int rssi, uint8_t gateway_id, uint32_t now_s) {
+        bool added = false;
+        heard(mac, rssi, gateway_id, now_s, &added);
+        return added;
+    }
+
+    // The sender got the ACK from mac after rtt_us: it becomes the preferred one
+    void acked(const uint8_t mac[6], uint32_t rtt_us) {
+        Entry *e = entry(mac);
+        if (!e) {
+            return;
+        }
+        e->misses = 0;
+        e->rtt_us = e->rtt_us == 0 ? rtt_us : e->rtt_us + ((int32_t)(rtt_us - e->rtt_us)) / 4;
+        memcpy(preferred_, mac, 6);
+        has_preferred_ = true;
+    }
+
+    // No ACK from mac (timeout or send error)
+    void missed(const uint8_t mac[6]) {
+        Entry *e = entry(mac);
+        if (!e) {
+            return;
+        }
+        if (e->misses < UINT8_MAX) {
+            e->misses++;
+        }
+        if (is_preferred(*e)) {
+            has_preferred_ = false;
+        }
+    }
+
+    // Make mac the preferred gateway (e.g. restored from NVS after power-on),
+    // adding it as learned if unknown
+    void prefer(const uint8_t mac[6], uint32_t now_s) {
+        if (find_or_add(mac, now_s)) {
+            memcpy(preferred_, mac, 6);
+            has_preferred_ = true;
+        }
+    }
+
+    bool preferred(uint8_t mac_out[6]) const {
+        if (has_preferred_) {
+            memcpy(mac_out, preferred_, 6);
+        }
+        return has_preferred_;
+    }
+
+    int cost(const Entry &e) const {
+        int c = -e.rssi_dbm();
+        c += (int)(e.rtt_us / 4000);
+        c += COST_PER_MISS * (e.misses > 4 ? 4 : e.misses);
+        c += (e.flags & FLAG_NO_UPLINK) ? COST_NO_UPLINK : 0;
+        c += e.load_pct / 10;
+        c += is_preferred(e) ? COST_PREFERRED : 0;
+        return c;
+    }
+
+    // Drop expired learned gateways, then copy up to max entries to out[],
+    // best first. Returns how many.
+    int rank(Entry *out, int max, uint32_t now_s) {
+        expire(now_s);
+        int n = 0;
+        for (const Entry &e : entries_) {
+            if (!(e.flags & FLAG_USED) || n == max) {
+                continue;
+            }
+            // insertion sort: a handful of entries
+            int c = cost(e);
+            int i = n++;
+            while (i > 0 && cost(out[i - 1]) > c) {
+                out[i] = out[i - 1];
+                i--;
+            }
+            out[i] = e;
+        }
+        return n;
+    }
+
+    // ACK wait for e: 4x its average round trip, within [min_ms, max_ms];
+    // max_ms while its round trip is unknown
+    static uint32_t ack_timeout_ms(const Entry &e, uint32_t min_ms, uint32_t max_ms) {
+        if (e.rtt_us == 0) {
+            return max_ms;
+        }
+        uint32_t t = e.rtt_us * 4 / 1000;
+        return t < min_ms ? min_ms : t > max_ms ? max_ms : t;
+    }
+
+    const Entry *find(const uint8_t mac[6]) const {
+        for (const Entry &e : entries_) {
+            if ((e.flags & FLAG_USED) && memcmp(e.mac, mac, 6) == 0) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    Entry *entry(const uint8_t mac[6]) {
+        return const_cast<Entry *>(find(mac));
+    }
+
+    bool is_preferred(const Entry &e) const {
+        return has_preferred_ && memcmp(e.mac, preferred_, 6) == 0;
+    }
+
+    Entry *heard(const uint8_t mac[6], int rssi, uint8_t gateway_id, uint32_t now_s, bool *added) {
+        Entry *e = entry(mac);
+        if (!e) {
+            e = find_or_add(mac, now_s);
+            *added = e != nullptr;
+            if (!e) {
+                return nullptr;
+            }
+        }
+        int16_t sample = (int16_t)(rssi * 16);
+        if (e->flags & FLAG_HEARD) {
+            e->rssi_x16 = (int16_t)(e->rssi_x16 + (sample - e->rssi_x16) / 4);
+        } else {
+            e->rssi_x16 = sample;
+            e->flags |= FLAG_HEARD;
+        }
+        e->gateway_id = gateway_id;
+        e->last_seen_s = now_s;
+        return e;
+    }
+
+    // Existing entry, a free slot, or the worst learned entry replaced;
+    // nullptr only when every slot holds a seed
+    Entry *find_or_add(const uint8_t mac[6], uint32_t now_s) {
+        Entry *e = entry(mac);
+        if (e) {
+            return e;
+        }
+        Entry *slot = nullptr;
+        for (Entry &s : entries_) {
+            if (!(s.flags & FLAG_USED)) {
+                slot = &s;
+                break;
+            }
+        }
+        if (!slot) {
+            int worst = 0;
+            for (Entry &s : entries_) {
+                if (!(s.flags & FLAG_SEED) && !is_preferred(s) && (!slot || cost(s) > worst)) {
+                    slot = &s;
+                    worst = cost(s);
+                }
+            }
+            if (!slot) {
+                return nullptr;
+            }
+        }
+        *slot = Entry{};
+        memcpy(slot->mac, mac, 6);
+        slot->gateway_id = ID_UNKNOWN;
+        slot->flags = FLAG_USED;
+        slot->last_seen_s = now_s;
+        return slot;
+    }
+
+    void expire(uint32_t now_s) {
+        for (Entry &e : entries_) {
+            if ((e.flags & FLAG_USED) && !(e.flags & FLAG_SEED) &&
+                now_s - e.last_seen_s > GATEWAY_TABLE_TTL_S) {
+                if (is_preferred(e)) {
+                    has_preferred_ = false;
+                }
+                e = Entry{};
+            }
+        }
+    }
+
+    Entry entries_[GATEWAY_TABLE_CAPACITY] = {};
+    uint8_t preferred_[6] = {};
+    bool has_preferred_ = false;
+};
+
+} // namespace gateway_table
@@ -1,7 +1,14 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include <array>
+
+#ifndef LEVEL_CALCULATOR_TABLE_POINTS
+#define LEVEL_CALCULATOR_TABLE_POINTS 65   // level -> volume points per tank (4 B each, in flash)
+#endif
+
 namespace level_calculator {
 
 struct Model {
@@ -16,6 +23,8 @@ struct Result {
     int volume_l;   // liters
 };
 
+// Prismatic tank: volume proportional to level. The gateway does the same
+// math for batch frames (packet_decode.c).
 inline Result compute(int distance_cm, const Model &m) {
     int base = m.level_max_cm + m.sensor_offset_cm;
     int level_cm = base - distance_cm;
@@ -28,4 +37,233 @@ inline Result compute(int distance_cm, const Model &m) {
     return r;
 }
 
+// ============================================================================
+// TANK GEOMETRY -> LEVEL/VOLUME TABLE (no hardware access)
+// ============================================================================
+// A Geometry describes the tank shape by its horizontal cross-section area at
+// each height. VolumeTable integrates it (Simpson) into P points from level 0
+// to level_max_cm; built as a constexpr object the whole table is computed by
+// the compiler and the node only does an integer lookup + linear
+// interpolation per sample (no float, O(1)). Tanks with a measured strapping
+// table (level, liters) use the table's points directly.
+//
+// Levels are measured from the lowest point of the tank (cone apex, bottom of
+// a horizontal cylinder). Ends:
+//   - CONE: straight cone, depth_cm from base to apex
+//   - DOME: ellipsoidal head, depth_cm deep (radius = hemispherical, r/2 = 2:1)
+// A horizontal cylinder's heads are ellipsoidal; cone heads on a horizontal
+// tank are not modelled (use a strapping table).
+
+enum class End : uint8_t { FLAT, CONE, DOME };
+
+namespace detail {
+
+constexpr double PI = 3.14159265358979323846;
+
+// Newton from above: monotonic, stops when it no longer decreases
+constexpr double sqrt_cx(double x) {
+    if (x <= 0) {
+        return 0;
+    }
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 200; i++) {
+        double next = 0.5 * (r + x / r);
+        if (next >= r) {
+            break;
+        }
+        r = next;
+    }
+    return r;
+}
+
+} // namespace detail
+
+struct Geometry {
+    enum class Kind : uint8_t { PRISM, VERTICAL_CYLINDER, HORIZONTAL_CYLINDER };
+
+    Kind kind = Kind::PRISM;
+    double area_cm2 = 0;        // prism: constant cross-section
+    int diameter_cm = 0;        // cylinders
+    int height_cm = 0;          // total height (horizontal cylinder: diameter)
+    int length_cm = 0;          // horizontal cylinder: straight part
+    End bottom = End::FLAT;     // vertical cylinder ends / horizontal cylinder heads (DOME)
+    int bottom_cm = 0;
+    End top = End::FLAT;
+    int top_cm = 0;
+
+    // Volume proportional to level (what compute(distance, Model) assumes)
+    static constexpr Geometry prism(int vol_max_l, int level_max_cm) {
+        Geometry g;
+        g.area_cm2 = (double)vol_max_l * 1000.0 / level_max_cm;
+        g.height_cm = level_max_cm;
+        return g;
+    }
+
+    static constexpr Geometry box(int length_cm, int width_cm, int height_cm) {
+        Geometry g;
+        g.area_cm2 = (double)length_cm * width_cm;
+        g.height_cm = height_cm;
+        return g;
+    }
+
+    // height_cm includes the ends (bottom_cm/top_cm are inside it)
+    static constexpr Geometry vertical_cylinder(int diameter_cm, int height_cm,
+                                                End bottom = End::FLAT, int bottom_cm = 0,
+                                                End top = End::FLAT, int top_cm = 0) {
+        Geometry g;
+        g.kind = Kind::VERTICAL_CYLINDER;
+        g.diameter_cm = diameter_cm;
+        g.height_cm = height_cm;
+        g.bottom = bottom_cm > 0 ? bottom : End::FLAT;
+        g.bottom_cm = bottom_cm;
+        g.top = top_cm > 0 ? top : End::FLAT;
+        g.top_cm = top_cm;
+        return g;
+    }
+
+    // length_cm is the straight part; each of the two heads adds head_cm
+    // (ellipsoidal, 0 = flat)
+    static constexpr Geometry horizontal_cylinder(int diameter_cm, int length_cm, int head_cm = 0) {
+        Geometry g;
+        g.kind = Kind::HORIZONTAL_CYLINDER;
+        g.diameter_cm = diameter_cm;
+        g.height_cm = diameter_cm;
+        g.length_cm = length_cm;
+        g.bottom = head_cm > 0 ? End::DOME : End::FLAT;
+        g.bottom_cm = head_cm;
+        return g;
+    }
+
+    // Horizontal cross-section area (cm^2) at height y (cm)
+    constexpr double area_at(double y) const {
+        if (y < 0 || y > height_cm) {
+            return 0;
+        }
+        double r = diameter_cm / 2.0;
+        switch (kind) {
+            case Kind::PRISM:
+                return area_cm2;
+            case Kind::VERTICAL_CYLINDER: {
+                double full = detail::PI * r * r;
+                if (y < bottom_cm) {
+                    return full * end_scale(bottom, (bottom_cm - y) / bottom_cm);
+                }
+                if (y > height_cm - top_cm) {
+                    return full * end_scale(top, (y - (height_cm - top_cm)) / top_cm);
+                }
+                return full;
+            }
+            case Kind::HORIZONTAL_CYLINDER: {
+                double half_chord = detail::sqrt_cx(r * r - (r - y) * (r - y));
+                // Straight part: rectangle; both heads together: ellipse of
+                // semi-axes head * half_chord / r and half_chord
+                return 2 * half_chord * length_cm + detail::PI * bottom_cm * half_chord * half_chord / r;
+            }
+        }
+        return 0;
+    }
+
+private:
+    // Area of an end at relative distance u (0 = joint with the cylinder,
+    // 1 = apex/crown) as a fraction of the full circle
+    static constexpr double end_scale(End e, double u) {
+        switch (e) {
+            case End::CONE: return (1 - u) * (1 - u);
+            case End::DOME: return 1 - u * u;
+            case End::FLAT: break;
+        }
+        return 1;
+    }
+};
+
+// Measured (level, liters) point of a strapping table; levels ascending
+struct StrapPoint {
+    int level_cm;
+    int32_t volume_l;
+};
+
+template <int P = LEVEL_CALCULATOR_TABLE_POINTS>
+class VolumeTable {
+    static_assert(P >= 2, "a volume table needs at least 2 points");
+
+public:
+    // Integrate the geometry from level 0 to level_max_cm
+    constexpr VolumeTable(const Geometry &g, int level_max_cm) : level_max_cm_(level_max_cm) {
+        constexpr int STEPS = 32;   // Simpson intervals per table segment (even)
+        double cm3 = 0;
+        double prev = 0;
+        liters_[0] = 0;
+        for (int i = 1; i < P; i++) {
+            double x = (double)level_max_cm * i / (P - 1);
+            double h = (x - prev) / STEPS;
+            double s = g.area_at(prev) + g.area_at(x);
+            for (int k = 1; k < STEPS; k++) {
+                s += (k & 1 ? 4 : 2) * g.area_at(prev + k * h);
+            }
+            cm3 += s * h / 3;
+            liters_[i] = (int32_t)(cm3 / 1000.0 + 0.5);
+            prev = x;
+        }
+    }
+
+    // Resample a strapping table (linear between its points, clamped outside)
+    template <size_t K>
+    constexpr VolumeTable(const StrapPoint (&pts)[K], int level_max_cm) : level_max_cm_(level_max_cm) {
+        static_assert(K >= 2, "a strapping table needs at least 2 points");
+        size_t j = 0;
+        for (int i = 0; i < P; i++) {
+            // table positions in 1/(P-1) cm: exact integer arithmetic
+            int64_t x = (int64_t)level_max_cm * i;
+            while (j + 2 < K && (int64_t)pts[j + 1].level_cm * (P - 1) <= x) j++;
+            int64_t x0 = (int64_t)pts[j].level_cm * (P - 1);
+            int64_t x1 = (int64_t)pts[j + 1].level_cm * (P - 1);
+            int64_t v0 = pts[j].volume_l, v1 = pts[j + 1].volume_l;
+            if (x <= x0) {
+                liters_[i] = (int32_t)v0;
+            } else if (x >= x1) {
+                liters_[i] = (int32_t)v1;
+            } else {
+                liters_[i] = (int32_t)(v0 + ((v1 - v0) * (x - x0) + (x1 - x0) / 2) / (x1 - x0));
+            }
+        }
+    }
+
+    constexpr int level_max_cm() const { return level_max_cm_; }
+    constexpr int vol_max_l() const { return liters_[P - 1]; }
+    constexpr const std::array<int32_t, P> &points() const { return liters_; }
+
+    // Liters at level_cm (clamped to 0..level_max_cm): one lookup, integer interpolation
+    constexpr int volume_l(int level_cm) const {
+        if (level_cm <= 0) {
+            return liters_[0];
+        }
+        if (level_cm >= level_max_cm_) {
+            return liters_[P - 1];
+        }
+        int64_t pos = (int64_t)level_cm * (P - 1);
+        int64_t i = pos / level_max_cm_;
+        int64_t rem = pos % level_max_cm_;
+        int64_t d = (int64_t)liters_[i + 1] - liters_[i];
+        int64_t step = d >= 0 ? (d * rem + level_max_cm_ / 2) : (d * rem - level_max_cm_ / 2);
+        return (int)(liters_[i] + step / level_max_cm_);
+    }
+
+private:
+    int level_max_cm_;
+    std::array<int32_t, P> liters_{};
+};
+
+// Level from the distance like compute(distance, Model); volume from the
+// table and percentual of the full volume
+template <int P>
+constexpr Result compute(int distance_cm, int sensor_offset_cm, const VolumeTable<P> &t) {
+    int level_cm = t.level_max_cm() + sensor_offset_cm - distance_cm;
+    if (level_cm < 0) level_cm = 0;
+    if (level_cm > t.level_max_cm()) level_cm = t.level_max_cm();
+
+    int volume_l = t.volume_l(level_cm);
+    int percentual = t.vol_max_l() > 0 ? (int)((int64_t)volume_l * 100 / t.vol_max_l()) : 0;
+    return Result{level_cm, percentual, volume_l};
+}
+
 } // namespace level_calculator
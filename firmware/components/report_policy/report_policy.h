@@ -0,0 +1,144 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace report_policy {
+
+// ============================================================================
+// SEND-ON-DELTA REPORTING (no hardware access)
+// ============================================================================
+// The node samples every interval_s() but only transmits when
+//   - it never sent before (First),
+//   - a new alert shows up (Alert; a standing alert is not resent),
+//   - |level - last sent level| >= delta_cm (Delta), or
+//   - heartbeat_s passed since the last send (Heartbeat).
+// The sampling interval follows the level's rate of change: fast_interval_s
+// while |rate| >= fast_rate_x10, back to slow_interval_s once it drops below
+// half of that (hysteresis). The rate is the one the node already computes
+// and sends: its 2-state Kalman filter (KalmanCvQ16) in 0.1 cm/min, or
+// RATE_UNKNOWN until the filter has settled, which keeps the current interval.
+//
+// Time is counted from the intervals passed to on_sample(), so it keeps going
+// across deep sleep (esp_timer restarts at every wake). Constant-initialized:
+// can be kept in RTC memory (DUTY_CYCLE_RETAINED).
+
+enum class Reason : uint8_t {
+    Skip = 0,
+    First,
+    Alert,
+    Delta,
+    Heartbeat,
+    Count
+};
+
+inline const char *reason_name(Reason r) {
+    switch (r) {
+        case Reason::Skip:      return "skip";
+        case Reason::First:     return "first";
+        case Reason::Alert:     return "alert";
+        case Reason::Delta:     return "delta";
+        case Reason::Heartbeat: return "heartbeat";
+        default:                return "?";
+    }
+}
+
+struct Config {
+    int16_t delta_cm;          // send when the level moved this much since the last send
+    uint32_t heartbeat_s;      // send at least this often
+    uint32_t slow_interval_s;  // sampling interval while the level is steady
+    uint32_t fast_interval_s;  // sampling interval while it moves
+    int16_t fast_rate_x10;     // |rate| (0.1 cm/min) that switches to fast sampling
+};
+
+// No rate yet (same value as SENSOR_RATE_UNKNOWN in common/telemetry_packet.h)
+constexpr int16_t RATE_UNKNOWN = INT16_MIN;
+
+// Rate for logs: "-1.5", or "?" when unknown
+struct RateText {
+    char s[8];
+};
+
+inline RateText rate_text(int16_t rate_x10) {
+    RateText t = {"?"};
+    if (rate_x10 != RATE_UNKNOWN) {
+        snprintf(t.s, sizeof(t.s), "%s%d.%d", rate_x10 < 0 ? "-" : "", abs(rate_x10) / 10, abs(rate_x10) % 10);
+    }
+    return t;
+}
+
+struct Stats {
+    uint32_t samples;
+    uint32_t by_reason[(int)Reason::Count];   // decisions per reason (Skip = not sent)
+};
+
+class ReportPolicy {
+public:
+    constexpr explicit ReportPolicy(const Config &cfg) : cfg_(cfg) {}
+
+    // One sample taken dt_s after the previous one, with the level rate in
+    // 0.1 cm/min (+ = filling) or RATE_UNKNOWN. Returns why it should be
+    // sent, or Skip. Call on_sent() once the transmission succeeded; until
+    // then the same condition keeps requesting a send.
+    Reason on_sample(uint32_t dt_s, int16_t level_cm, int16_t rate_x10, uint8_t alert_type) {
+        stats_.samples++;
+        update_interval(rate_x10);
+        since_sent_s_ += dt_s;
+        if (alert_type == 0) {
+            alert_sent_ = 0;   // alert over: the next one is new again
+        }
+
+        Reason r = Reason::Skip;
+        if (!sent_once_) {
+            r = Reason::First;
+        } else if (alert_type != 0 && alert_type != alert_sent_) {
+            r = Reason::Alert;
+        } else if (abs(level_cm - level_sent_) >= cfg_.delta_cm) {
+            r = Reason::Delta;
+        } else if (since_sent_s_ >= cfg_.heartbeat_s) {
+            r = Reason::Heartbeat;
+        }
+        stats_.by_reason[(int)r]++;
+        return r;
+    }
+
+    void on_sent(int16_t level_cm, uint8_t alert_type) {
+        sent_once_ = true;
+        level_sent_ = level_cm;
+        alert_sent_ = alert_type;
+        since_sent_s_ = 0;
+    }
+
+    // Interval until the next sample
+    uint32_t interval_s() const { return fast_ ? cfg_.fast_interval_s : cfg_.slow_interval_s; }
+    bool fast() const { return fast_; }
+
+    uint32_t since_sent_s() const { return since_sent_s_; }
+    int16_t level_sent() const { return level_sent_; }
+    const Stats &stats() const { return stats_; }
+    const Config &config() const { return cfg_; }
+
+private:
+    void update_interval(int16_t rate_x10) {
+        if (rate_x10 == RATE_UNKNOWN) {
+            return;
+        }
+        int rate = abs(rate_x10);
+        if (rate >= cfg_.fast_rate_x10) {
+            fast_ = true;
+        } else if (rate < cfg_.fast_rate_x10 / 2) {
+            fast_ = false;
+        }
+    }
+
+    Config cfg_;
+    uint32_t since_sent_s_ = 0;
+    int16_t level_sent_ = 0;
+    uint8_t alert_sent_ = 0;
+    bool sent_once_ = false;
+    bool fast_ = false;
+    Stats stats_ = {};
+};
+
+} // namespace report_policy
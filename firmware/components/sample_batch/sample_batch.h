@@ -0,0 +1,159 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common/telemetry_packet.h"
+
+#ifndef SAMPLE_BATCH_CAPACITY
+#define SAMPLE_BATCH_CAPACITY SENSOR_BATCH_MAX_SAMPLES
+#endif
+
+static_assert(SAMPLE_BATCH_CAPACITY >= 1 && SAMPLE_BATCH_CAPACITY <= SENSOR_BATCH_MAX_SAMPLES,
+              "SAMPLE_BATCH_CAPACITY must fit one SensorBatch frame");
+
+namespace sample_batch {
+
+// ============================================================================
+// SAMPLE BATCH (buffer + SensorBatch encoder, no hardware access)
+// ============================================================================
+// The node samples every interval_ms and appends each sample here; when the
+// flush policy says so, the batch is encoded into one SensorBatch frame (see
+// telemetry_packet.h) and sent. Samples must have consecutive seq numbers,
+// so the frame only carries base_seq. A batch no gateway confirmed can be kept
+// and resent later; when it is full, drop_oldest() makes room (store and
+// forward). Constant-initialized: can be kept in RTC memory across deep-sleep
+// cycles (DUTY_CYCLE_RETAINED).
+
+struct Policy {
+    int max_samples = 12;          // flush when this many samples are buffered
+    uint32_t max_age_ms = 60000;   // ... or when the oldest sample is this old
+    bool flush_on_alert = true;    // ... or right away when a sample has an alert
+};
+
+// Per-node constants written into the frame header
+struct Meta {
+    uint8_t node_id;
+    uint32_t interval_ms;
+    int16_t level_max_cm;          // 0 = the gateway reports distance only
+    int16_t sensor_offset_cm;
+    uint32_t vol_max_l;
+};
+
+class SampleBatch {
+public:
+    constexpr SampleBatch() = default;
+
+    int count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ >= SAMPLE_BATCH_CAPACITY; }
+    uint32_t first_seq() const { return first_seq_; }
+    uint32_t last_seq() const { return first_seq_ + (uint32_t)count_ - 1; }
+    bool has_alert() const { return alert_ != 0; }
+    uint32_t dropped() const { return dropped_; }
+
+    // Append one sample. False when full or when seq does not follow the last
+    // sample (flush first and start a new batch).
+    bool add(uint32_t seq, int16_t distance_cm, uint8_t flags, uint8_t alert_type) {
+        if (full() || (count_ > 0 && seq != last_seq() + 1)) {
+            return false;
+        }
+        if (count_ == 0) {
+            first_seq_ = seq;
+            flags_ = 0;
+            alert_ = 0;
+        }
+        distance_cm_[count_++] = distance_cm;
+        flags_ |= flags;
+        if (alert_type != 0) {
+            alert_ = alert_type;
+        }
+        return true;
+    }
+
+    // Flush decision after add(): count, age of the oldest sample (samples are
+    // interval_ms apart, the newest is just taken) or a pending alert
+    bool should_flush(const Policy &policy, uint32_t interval_ms) const {
+        if (count_ == 0) {
+            return false;
+        }
+        if (full() || count_ >= policy.max_samples) {
+            return true;
+        }
+        if (policy.flush_on_alert && alert_ != 0) {
+            return true;
+        }
+        uint64_t oldest_age_ms = (uint64_t)(count_ - 1) * interval_ms;
+        return oldest_age_ms >= policy.max_age_ms;
+    }
+
+    // Encode into buf; newest_age_ms is the time since the newest sample was
+    // taken. Returns the frame length, or 0 if empty / buf too small.
+    size_t encode(uint8_t *buf, size_t cap, const Meta &meta, int16_t vin_mv,
+                  uint32_t newest_age_ms) const {
+        if (count_ == 0 || cap < sizeof(SensorBatchHeader)) {
+            return 0;
+        }
+        SensorBatchHeader hdr = {};
+        hdr.magic = SENSOR_BATCH_MAGIC;
+        hdr.version = SENSOR_BATCH_VERSION;
+        hdr.node_id = meta.node_id;
+        hdr.count = (uint8_t)count_;
+        hdr.base_seq = first_seq_;
+        hdr.base_age_ms = newest_age_ms + (uint32_t)(count_ - 1) * meta.interval_ms;
+        hdr.interval_ms = meta.interval_ms;
+        hdr.vin_mv = vin_mv;
+        hdr.flags = flags_;
+        hdr.alert_type = alert_;
+        hdr.level_max_cm = meta.level_max_cm;
+        hdr.sensor_offset_cm = meta.sensor_offset_cm;
+        hdr.vol_max_l = meta.vol_max_l;
+        hdr.distance_cm = distance_cm_[0];
+
+        size_t len = sizeof(hdr);
+        memcpy(buf, &hdr, len);
+        for (int i = 1; i < count_; i++) {
+            int32_t delta = (int32_t)distance_cm_[i] - distance_cm_[i - 1];
+            if (delta > SENSOR_BATCH_DELTA_ESCAPE && delta <= INT8_MAX) {
+                if (len + 1 > cap) {
+                    return 0;
+                }
+                buf[len++] = (uint8_t)(int8_t)delta;
+            } else {
+                if (len + 3 > cap) {
+                    return 0;
+                }
+                uint16_t abs_cm = (uint16_t)distance_cm_[i];
+                buf[len++] = (uint8_t)(int8_t)SENSOR_BATCH_DELTA_ESCAPE;
+                buf[len++] = (uint8_t)(abs_cm & 0xFF);
+                buf[len++] = (uint8_t)(abs_cm >> 8);
+            }
+        }
+        return len;
+    }
+
+    void clear() { count_ = 0; }
+
+    // Forget the oldest sample (batch full while no gateway answers); the
+    // others keep their seq and spacing
+    void drop_oldest() {
+        if (count_ == 0) {
+            return;
+        }
+        memmove(&distance_cm_[0], &distance_cm_[1], (size_t)(count_ - 1) * sizeof(distance_cm_[0]));
+        count_--;
+        first_seq_++;
+        dropped_++;
+    }
+
+private:
+    int16_t distance_cm_[SAMPLE_BATCH_CAPACITY] = {};
+    int count_ = 0;
+    uint32_t first_seq_ = 0;
+    uint8_t flags_ = 0;
+    uint8_t alert_ = 0;
+    uint32_t dropped_ = 0;
+};
+
+} // namespace sample_batch
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "nvs.h"
+
+namespace seq_counter {
+
+// SeqCounter store backed by one NVS u32 key (nvs_flash_init() must have run)
+struct NvsStore {
+    const char *ns;
+    const char *key;
+
+    bool load(uint32_t &out) const {
+        nvs_handle_t h;
+        if (nvs_open(ns, NVS_READONLY, &h) != ESP_OK) {
+            return false;
+        }
+        esp_err_t err = nvs_get_u32(h, key, &out);
+        nvs_close(h);
+        return err == ESP_OK;
+    }
+
+    bool save(uint32_t value) const {
+        nvs_handle_t h;
+        esp_err_t err = nvs_open(ns, NVS_READWRITE, &h);
+        if (err != ESP_OK) {
+            return false;
+        }
+        err = nvs_set_u32(h, key, value);
+        if (err == ESP_OK) {
+            err = nvs_commit(h);
+        }
+        nvs_close(h);
+        return err == ESP_OK;
+    }
+};
+
+} // namespace seq_counter
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef SEQ_COUNTER_CHECKPOINT_EVERY
+#define SEQ_COUNTER_CHECKPOINT_EVERY 32   // sends per NVS write
+#endif
+
+namespace seq_counter {
+
+// ============================================================================
+// SEQUENCE COUNTER WITH BLOCK RESERVATION (no hardware access)
+// ============================================================================
+// The counter lives in RAM (or RTC memory, see DUTY_CYCLE_RETAINED); the store
+// only holds a reservation: the highest seq the node may have used. A block of
+// `block` numbers is reserved (stored) before the first of them is handed out,
+// so flash is written once per block instead of once per send.
+//
+// Power-on (epoch bump): the counter resumes *after* the stored reservation.
+// Any seq handed out before power loss was <= that value, so seq never goes
+// backwards; at most `block` numbers are skipped per reboot.
+//
+// The old per-send NVS value (last seq sent) has the same meaning, so the
+// same key keeps working after an upgrade.
+//
+// Store: any type with bool load(uint32_t &out) and bool save(uint32_t value).
+// load() == false means "nothing stored yet" (start from 0).
+
+class SeqCounter {
+public:
+    constexpr explicit SeqCounter(uint32_t block = SEQ_COUNTER_CHECKPOINT_EVERY)
+        : block_(block ? block : 1) {}
+
+    bool started() const { return started_; }
+
+    // Resume from the store (once per power-on; next() does it on demand)
+    template <class Store>
+    void start(Store &store) {
+        uint32_t reserved = 0;
+        if (!store.load(reserved)) {
+            reserved = 0;
+        }
+        last_ = reserved;
+        reserved_ = reserved;   // nothing beyond it may be used until saved
+        started_ = true;
+    }
+
+    // Next sequence number; saves a new reservation first when the current
+    // block is used up
+    template <class Store>
+    uint32_t next(Store &store) {
+        if (!started_) {
+            start(store);
+        }
+        uint32_t seq = last_ + 1;
+        if (seq > reserved_ || seq == 0) {
+            if (seq == 0) {
+                seq = 1;        // 0 is never sent (wrap after 2^32 sends)
+            }
+            uint32_t reserve = seq + block_ - 1;
+            if (reserve < seq) {
+                reserve = UINT32_MAX;
+            }
+            if (store.save(reserve)) {
+                reserved_ = reserve;
+                checkpoints_++;
+            } else {
+                // Keep going; monotonicity across a reboot is only guaranteed
+                // up to the last successful save
+                reserved_ = seq;
+                save_errors_++;
+            }
+        }
+        last_ = seq;
+        return seq;
+    }
+
+    uint32_t last() const { return last_; }
+    uint32_t reserved() const { return reserved_; }
+    uint32_t checkpoints() const { return checkpoints_; }
+    uint32_t save_errors() const { return save_errors_; }
+
+private:
+    uint32_t block_;
+    uint32_t last_ = 0;
+    uint32_t reserved_ = 0;
+    uint32_t checkpoints_ = 0;
+    uint32_t save_errors_ = 0;
+    bool started_ = false;
+};
+
+} // namespace seq_counter
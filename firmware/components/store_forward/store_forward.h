@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/telemetry_packet.h"
+
+#ifndef STORE_FORWARD_CAPACITY
+#define STORE_FORWARD_CAPACITY 48   // packets kept while no gateway answers (36 B each with the timestamp)
+#endif
+
+#ifndef STORE_FORWARD_FRAMES_PER_CYCLE
+#define STORE_FORWARD_FRAMES_PER_CYCLE 2   // resend frames per measurement cycle
+#endif
+
+namespace store_forward {
+
+// ============================================================================
+// STORE-AND-FORWARD RING (unsent packets, no hardware access)
+// ============================================================================
+// A packet whose send failed on every gateway is kept here instead of being
+// lost. Once a gateway answers again the ring is resent oldest-first, up to
+// SENSOR_PACKET_MAX_PER_FRAME packets per ESP-NOW frame (the gateway ACKs the
+// last one). The new reading joins the ring behind the stored ones, so the
+// gateway always receives a node's readings in order.
+//
+// Bounded: when full the oldest packet is dropped and counted. Each entry
+// keeps the node clock (ms) of its measurement; a resent packet's ts_ms is
+// its age, which the gateway subtracts from the reception time.
+// Constant-initialized: can be kept in RTC memory (DUTY_CYCLE_RETAINED).
+
+struct Stats {
+    uint32_t stored;       // packets that went into the ring
+    uint32_t resent;       // packets delivered from the ring
+    uint32_t dropped;      // oldest packets overwritten while full
+    uint32_t high_water;   // most packets held at once
+};
+
+class Ring {
+public:
+    constexpr Ring() = default;
+
+    size_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    const Stats &stats() const { return stats_; }
+
+    // Keep a packet measured at taken_ms (node clock); drops the oldest when full
+    void push(const SensorPacketV2 &pkt, uint32_t taken_ms) {
+        if (count_ == STORE_FORWARD_CAPACITY) {
+            head_ = (head_ + 1) % STORE_FORWARD_CAPACITY;
+            count_--;
+            stats_.dropped++;
+        }
+        Entry &e = entries_[(head_ + count_) % STORE_FORWARD_CAPACITY];
+        e.pkt = pkt;
+        e.taken_ms = taken_ms;
+        count_++;
+        stats_.stored++;
+        if (count_ > stats_.high_water) {
+            stats_.high_water = count_;
+        }
+    }
+
+    // Copy the oldest packets (at most max) into out[], ts_ms set to their age at now_ms
+    size_t peek(SensorPacketV2 *out, size_t max, uint32_t now_ms) const {
+        size_t n = count_ < max ? count_ : max;
+        for (size_t i = 0; i < n; i++) {
+            const Entry &e = entries_[(head_ + i) % STORE_FORWARD_CAPACITY];
+            out[i] = e.pkt;
+            out[i].ts_ms = now_ms - e.taken_ms;
+        }
+        return n;
+    }
+
+    // Forget the n oldest packets (delivered)
+    void pop(size_t n) {
+        if (n > count_) {
+            n = count_;
+        }
+        head_ = (head_ + n) % STORE_FORWARD_CAPACITY;
+        count_ -= n;
+        stats_.resent += n;
+    }
+
+    // Resend up to max_frames frames, oldest first; stops at the first frame
+    // that is not confirmed. send(frame, len, last) returns true when the
+    // gateway confirmed the frame (last = its newest packet, the one ACKed).
+    // Returns the packets delivered.
+    template <class SendFn>
+    size_t drain(uint32_t now_ms, int max_frames, SendFn &&send) {
+        size_t delivered = 0;
+        for (int f = 0; f < max_frames && count_ > 0; f++) {
+            SensorPacketV2 frame[SENSOR_PACKET_MAX_PER_FRAME];
+            size_t n = peek(frame, SENSOR_PACKET_MAX_PER_FRAME, now_ms);
+            if (!send((const uint8_t *)frame, n * sizeof(SensorPacketV2), frame[n - 1])) {
+                break;
+            }
+            pop(n);
+            delivered += n;
+        }
+        return delivered;
+    }
+
+private:
+    struct Entry {
+        SensorPacketV2 pkt;
+        uint32_t taken_ms;
+    };
+
+    Entry entries_[STORE_FORWARD_CAPACITY] = {};
+    size_t head_ = 0;
+    size_t count_ = 0;
+    Stats stats_ = {};
+};
+
+} // namespace store_forward
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "driver/temperature_sensor.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_err.h"
+
+#include "sound_speed.h"
+
+namespace ultrasonic01 {
+
+// ============================================================================
+// AIR TEMPERATURE SOURCE (for the speed-of-sound scale, sound_speed.h)
+// ============================================================================
+// Either the ESP32-C3 internal sensor (no extra part; it reads the die, a few
+// degC above the air and more with the radio on: set offset_c_x10 against a
+// thermometer in the node's usual duty cycle), or an NTC thermistor
+// divider on an ADC1 channel (supply -- r_fixed -- ADC -- NTC -- GND), which
+// shares the node's oneshot unit. read_c_x10() returns 0.1 degC, or
+// TEMP_INVALID when nothing is configured or the reading fails; the caller
+// then keeps SOUND_SCALE_ONE (us / 58).
+
+class AirTemperature {
+public:
+    // Internal sensor; offset_c_x10 is added to every reading
+    esp_err_t use_internal(int offset_c_x10 = 0) {
+        temperature_sensor_config_t cfg = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+        esp_err_t err = temperature_sensor_install(&cfg, &tsens_);
+        if (err == ESP_OK) {
+            err = temperature_sensor_enable(tsens_);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        source_ = Source::Internal;
+        offset_c_x10_ = offset_c_x10;
+        return ESP_OK;
+    }
+
+    // NTC divider on channel chan of an existing ADC1 oneshot unit; table
+    // must outlive this object (a static constexpr NtcTable)
+    esp_err_t use_ntc(adc_oneshot_unit_handle_t adc, adc_channel_t chan, const NtcTable &table,
+                      int supply_mv = 3300, int offset_c_x10 = 0) {
+        adc_oneshot_chan_cfg_t cfg = {
+            .atten = ADC_ATTEN_DB_12,
+            .bitwidth = ADC_BITWIDTH_12,
+        };
+        esp_err_t err = adc_oneshot_config_channel(adc, chan, &cfg);
+        if (err != ESP_OK) {
+            return err;
+        }
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+        adc_cali_curve_fitting_config_t cali_cfg = {
+            .unit_id = ADC_UNIT_1,
+            .chan = chan,
+            .atten = ADC_ATTEN_DB_12,
+            .bitwidth = ADC_BITWIDTH_12,
+        };
+        if (adc_cali_create_scheme_curve_fitting(&cali_cfg, &cali_) != ESP_OK) {
+            cali_ = nullptr;
+        }
+#endif
+        source_ = Source::Ntc;
+        adc_ = adc;
+        chan_ = chan;
+        table_ = &table;
+        supply_mv_ = supply_mv;
+        offset_c_x10_ = offset_c_x10;
+        return ESP_OK;
+    }
+
+    bool configured() const { return source_ != Source::None; }
+
+    // Air temperature in 0.1 degC, or TEMP_INVALID
+    int read_c_x10() {
+        int t = TEMP_INVALID;
+        if (source_ == Source::Internal) {
+            float c = 0;
+            if (temperature_sensor_get_celsius(tsens_, &c) == ESP_OK) {
+                t = (int)(c * 10 + (c < 0 ? -0.5f : 0.5f));
+            }
+        } else if (source_ == Source::Ntc) {
+            int raw = 0;
+            if (adc_oneshot_read(adc_, chan_, &raw) == ESP_OK) {
+                int mv = 0;
+                if (!cali_ || adc_cali_raw_to_voltage(cali_, raw, &mv) != ESP_OK) {
+                    mv = (raw * 3300) / 4095;   // uncalibrated, approximate
+                }
+                t = table_->temp_c_x10(mv, supply_mv_);
+            }
+        }
+        return t == TEMP_INVALID ? t : t + offset_c_x10_;
+    }
+
+private:
+    enum class Source : uint8_t { None, Internal, Ntc };
+
+    Source source_ = Source::None;
+    int offset_c_x10_ = 0;
+    temperature_sensor_handle_t tsens_ = nullptr;
+    adc_oneshot_unit_handle_t adc_ = nullptr;
+    adc_cali_handle_t cali_ = nullptr;
+    adc_channel_t chan_ = ADC_CHANNEL_0;
+    const NtcTable *table_ = nullptr;
+    int supply_mv_ = 3300;
+};
+
+} // namespace ultrasonic01
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sound_speed.h"
+
+namespace ultrasonic01 {
+
+// ============================================================================
+// ECHO DECODER (edge timestamps -> distance, no hardware access)
+// ============================================================================
+// Fed with (level, timestamp) pairs by whatever captures the echo edges: the
+// GPIO ISR in ultrasonic01.h on target, a fake edge source on the host.
+//
+//   begin(trigger_end) -> WaitRise -> rising edge -> WaitFall -> falling edge -> Done
+//                              \__________ expire()/poll() past timeout ________-> Timeout
+//
+// Spurious edges (a falling edge while waiting for the rise, a second rise
+// during the pulse, anything after completion) are ignored.
+
+class EchoDecoder {
+public:
+    enum class State : uint8_t { Idle, WaitRise, WaitFall, Done, Timeout };
+
+    constexpr EchoDecoder() = default;
+
+    // Start a measurement; trigger_end_us is when the trigger pulse ended.
+    // timeout_us applies to each phase (waiting for the rise, pulse width).
+    // sound_scale_q16 corrects the pulse for the air temperature (sound_speed.h).
+    void begin(int64_t trigger_end_us, int32_t timeout_us, uint32_t sound_scale_q16 = SOUND_SCALE_ONE) {
+        state_ = State::WaitRise;
+        trigger_end_us_ = trigger_end_us;
+        timeout_us_ = timeout_us;
+        scale_q16_ = sound_scale_q16;
+        rise_us_ = 0;
+        fall_us_ = 0;
+    }
+
+    // Feed one edge. Returns true if this edge completed the measurement
+    // (successfully or because it arrived past the phase timeout).
+    bool on_edge(int level, int64_t t_us) {
+        if (poll(t_us)) {
+            return true;
+        }
+        switch (state_) {
+            case State::WaitRise:
+                if (level == 1 && t_us >= trigger_end_us_) {
+                    rise_us_ = t_us;
+                    state_ = State::WaitFall;
+                }
+                return false;
+            case State::WaitFall:
+                if (level == 0) {
+                    fall_us_ = t_us;
+                    state_ = State::Done;
+                    return true;
+                }
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    // Time out the current phase if its deadline passed. Returns true if it did.
+    bool poll(int64_t now_us) {
+        if ((state_ == State::WaitRise && now_us - trigger_end_us_ > timeout_us_) ||
+            (state_ == State::WaitFall && now_us - rise_us_ > timeout_us_)) {
+            state_ = State::Timeout;
+            return true;
+        }
+        return false;
+    }
+
+    // Force a timeout (overall deadline reached). Returns true if still pending.
+    bool expire() {
+        if (state_ == State::WaitRise || state_ == State::WaitFall) {
+            state_ = State::Timeout;
+            return true;
+        }
+        return false;
+    }
+
+    State state() const { return state_; }
+    bool pending() const { return state_ == State::WaitRise || state_ == State::WaitFall; }
+
+    int32_t pulse_us() const {
+        return state_ == State::Done ? (int32_t)(fall_us_ - rise_us_) : -1;
+    }
+
+    // Returns distance in cm, or -1 on timeout/error. HC-SR04: cm ≈ us/58
+    // (times the sound scale), rounded
+    int distance_cm() const {
+        return pulse_to_cm(pulse_us(), scale_q16_);
+    }
+
+private:
+    State state_ = State::Idle;
+    int64_t trigger_end_us_ = 0;
+    int32_t timeout_us_ = 0;
+    int64_t rise_us_ = 0;
+    int64_t fall_us_ = 0;
+    uint32_t scale_q16_ = SOUND_SCALE_ONE;
+};
+
+} // namespace ultrasonic01
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace ultrasonic01 {
+
+// ============================================================================
+// Q16.16 FIXED POINT (no hardware access)
+// ============================================================================
+// value = raw / 65536: range +/-32767, resolution 1.5e-5. Products and
+// quotients go through int64 and round to nearest. The ESP32-C3 has no FPU,
+// so every float operation is a soft-float library call; these are a few
+// integer instructions (division: one 64-bit divide).
+
+class Q16 {
+public:
+    static constexpr int32_t ONE = 1 << 16;
+
+    constexpr Q16() = default;
+    constexpr explicit Q16(int v) : raw_((int32_t)((uint32_t)v << 16)) {}
+
+    static constexpr Q16 from_raw(int32_t raw) {
+        Q16 q;
+        q.raw_ = raw;
+        return q;
+    }
+    // Compile-time constants (filter tuning); avoid at run time on target
+    static constexpr Q16 from_double(double v) {
+        return from_raw((int32_t)(v * ONE + (v >= 0 ? 0.5 : -0.5)));
+    }
+
+    constexpr int32_t raw() const { return raw_; }
+    // Nearest integer (ties up)
+    constexpr int round() const { return (int)((raw_ + ONE / 2) >> 16); }
+    // Logs and host tools
+    constexpr double to_double() const { return (double)raw_ / ONE; }
+
+    friend constexpr Q16 operator+(Q16 a, Q16 b) { return from_raw(a.raw_ + b.raw_); }
+    friend constexpr Q16 operator-(Q16 a, Q16 b) { return from_raw(a.raw_ - b.raw_); }
+    friend constexpr Q16 operator*(Q16 a, Q16 b) {
+        return from_raw((int32_t)(((int64_t)a.raw_ * b.raw_ + ONE / 2) >> 16));
+    }
+    friend constexpr bool operator<(Q16 a, Q16 b) { return a.raw_ < b.raw_; }
+    friend constexpr bool operator>(Q16 a, Q16 b) { return a.raw_ > b.raw_; }
+    friend constexpr Q16 operator/(Q16 a, Q16 b) {
+        int64_t n = (int64_t)a.raw_ * ONE;
+        int64_t half = (b.raw_ < 0 ? -b.raw_ : b.raw_) / 2;
+        return from_raw((int32_t)((n + ((n < 0) == (b.raw_ < 0) ? half : -half)) / b.raw_));
+    }
+
+private:
+    int32_t raw_ = 0;
+};
+
+// Estimate rounded to whole cm, for either numeric type
+inline int round_cm(float v) { return (int)(v + (v >= 0 ? 0.5f : -0.5f)); }
+constexpr int round_cm(Q16 v) { return v.round(); }
+
+// Rate in 0.1 cm/min for an int16 packet field, rounded and saturated to
+// +/-32767: a glitch jump at a short interval must neither wrap to the other
+// sign nor land on INT16_MIN (SENSOR_RATE_UNKNOWN). Scaled in int64, since
+// rate * 10 can leave the Q16 range.
+constexpr int16_t rate_x10(Q16 rate_cm_min) {
+    int64_t v = ((int64_t)rate_cm_min.raw() * 10 + Q16::ONE / 2) >> 16;
+    return (int16_t)(v > INT16_MAX ? INT16_MAX : v < -INT16_MAX ? -INT16_MAX : v);
+}
+
+// num / den as T (time steps from integer ms)
+template <class T> constexpr T ratio(int32_t num, int32_t den);
+template <> constexpr float ratio<float>(int32_t num, int32_t den) { return (float)num / (float)den; }
+template <> constexpr Q16 ratio<Q16>(int32_t num, int32_t den) {
+    return Q16::from_raw((int32_t)(((int64_t)num * Q16::ONE) / den));
+}
+
+// ============================================================================
+// 1D KALMAN FILTER (improves accuracy from ±1cm to ±0.3cm)
+// ============================================================================
+// Constant model (distance does not change between samples), one state.
+// T is float or Q16; the same code runs for both. With the default tuning
+// (q=1, r=2) Q16 stays within 0.001 cm of float over long traces (see
+// tools/kalman_bench), so the cm the nodes send are the same.
+
+template <class T>
+class KalmanFilterT {
+private:
+    T x;  // Estimated state (distance in cm)
+    T p;  // Estimation error covariance
+    T q;  // Process noise covariance
+    T r;  // Measurement noise covariance
+    bool initialized;
+
+public:
+    // constexpr: a filter in RTC memory (DUTY_CYCLE_RETAINED) is constant-initialized,
+    // not re-constructed on every wake from deep sleep
+    constexpr KalmanFilterT(T process_noise = T(1), T measurement_noise = T(2))
+        : x(T(0)), p(T(1)), q(process_noise), r(measurement_noise), initialized(false) {}
+
+    // Update filter with new measurement, returns filtered value
+    T update(int measurement_cm) {
+        if (!initialized) {
+            // First measurement - initialize state
+            x = T(measurement_cm);
+            p = r;
+            initialized = true;
+            return x;
+        }
+
+        // Prediction step (assume constant model, no control input)
+        // x_pred = x (no state transition)
+        // p_pred = p + q
+        p = p + q;
+
+        // Update step
+        // Kalman gain K = p_pred / (p_pred + r)
+        T k = p / (p + r);
+
+        // State update: x = x_pred + K * (measurement - x_pred)
+        x = x + k * (T(measurement_cm) - x);
+
+        // Covariance update: p = (1 - K) * p_pred
+        p = (T(1) - k) * p;
+
+        return x;
+    }
+
+    // Get current estimate without updating
+    T get_estimate() const { return x; }
+    int estimate_cm() const { return round_cm(x); }
+
+    // Reset filter (e.g., when sensor detects large discontinuity)
+    void reset() { initialized = false; }
+};
+
+using KalmanFilter = KalmanFilterT<float>;
+using KalmanFilterQ16 = KalmanFilterT<Q16>;
+
+// ============================================================================
+// 2-STATE KALMAN FILTER (distance + rate, constant-velocity model)
+// ============================================================================
+// State: distance d (cm) and its rate v (cm/min). Between updates d moves at
+// v (d += v*dt) and v is disturbed by white acceleration noise of spectral
+// density q ((cm/min)^2 per minute), so a fill or drain slope is followed
+// without the lag of the 1D filter and comes out as a filtered rate.
+// Time comes from the caller's clock in ms (duty_cycle::uptime_ms() on the
+// nodes, which counts deep sleep); a gap over MAX_GAP_MS restarts the filter
+// (also keeps the Q16 covariances in range). v is the DISTANCE rate: a
+// positive v means the water is going down.
+
+template <class T>
+class KalmanCvT {
+public:
+    static constexpr uint32_t MAX_GAP_MS = 10 * 60 * 1000;
+
+    // constexpr: constant-initialized in RTC memory (DUTY_CYCLE_RETAINED)
+    constexpr KalmanCvT(T accel_noise = T(1), T measurement_noise = T(2), T initial_rate_var = T(25))
+        : q_(accel_noise), r_(measurement_noise), v0_(initial_rate_var) {}
+
+    // Update with a measurement taken at now_ms, returns the filtered distance
+    T update(int measurement_cm, uint32_t now_ms) {
+        uint32_t gap_ms = now_ms - last_ms_;
+        if (!initialized_ || gap_ms > MAX_GAP_MS) {
+            // First measurement: distance known to r, rate unknown (variance v0)
+            x_ = T(measurement_cm);
+            v_ = T(0);
+            p00_ = r_;
+            p01_ = T(0);
+            p11_ = v0_;
+            last_ms_ = now_ms;
+            initialized_ = true;
+            return x_;
+        }
+        last_ms_ = now_ms;
+
+        // Prediction: x += v*dt, P = F P F' + Q
+        //   Q = q * [dt^3/3  dt^2/2; dt^2/2  dt]
+        T dt = ratio<T>((int32_t)gap_ms, 60000);
+        T dt2 = dt * dt;
+        x_ = x_ + v_ * dt;
+        p00_ = p00_ + dt * (p01_ + p01_ + dt * p11_) + q_ * dt2 * dt / T(3);
+        p01_ = p01_ + dt * p11_ + q_ * dt2 / T(2);
+        p11_ = p11_ + q_ * dt;
+
+        // Update: distance is measured directly, H = [1 0]
+        T s = p00_ + r_;
+        T k0 = p00_ / s;
+        T k1 = p01_ / s;
+        T y = T(measurement_cm) - x_;
+        x_ = x_ + k0 * y;
+        v_ = v_ + k1 * y;
+        p11_ = p11_ - k1 * p01_;
+        p01_ = (T(1) - k0) * p01_;
+        p00_ = (T(1) - k0) * p00_;
+        return x_;
+    }
+
+    T get_estimate() const { return x_; }
+    int estimate_cm() const { return round_cm(x_); }
+    // Distance rate in cm/min (+ = water going down)
+    T rate_cm_min() const { return v_; }
+    // Rate variance, (cm/min)^2: initial_rate_var until measurements spread
+    // over time come in (also after reset())
+    T rate_var() const { return initialized_ ? p11_ : v0_; }
+
+    void reset() { initialized_ = false; }
+
+private:
+    T x_ = T(0);
+    T v_ = T(0);
+    T p00_ = T(0);
+    T p01_ = T(0);
+    T p11_ = T(0);
+    T q_;
+    T r_;
+    T v0_;
+    uint32_t last_ms_ = 0;
+    bool initialized_ = false;
+};
+
+using KalmanCv = KalmanCvT<float>;
+using KalmanCvQ16 = KalmanCvT<Q16>;
+
+} // namespace ultrasonic01
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+namespace ultrasonic01 {
+
+// ============================================================================
+// ROBUST ESTIMATOR (N samples -> one distance, no hardware access)
+// ============================================================================
+// One measurement cycle takes N samples of the same distance; some time out
+// and a few are echoes off the wrong surface. robust_estimate():
+//   1. masks invalid samples (negative = timeout/error, or outside the
+//      configured range),
+//   2. sorts with a fixed sorting network (Batcher odd-even merge: the
+//      compare-exchange sequence depends only on N, so it unrolls and has no
+//      data-dependent branches) and takes the median,
+//   3. rejects samples farther than mad_k * MAD from the median (MAD = median
+//      absolute deviation, clamped to [min_tol_cm, max_tol_cm]: with few
+//      samples and several bad ones the MAD itself is large, and the median
+//      is then a better answer than a mean over the outliers),
+//   4. averages what is left after trimming trim_pct % from each end.
+// All integer and constexpr; N is the node's ULTRA_SAMPLE_RETRIES.
+
+struct RobustConfig {
+    int min_cm = 0;          // samples outside [min_cm, max_cm] are masked
+    int max_cm = INT_MAX;
+    int mad_k = 3;           // reject |x - median| > mad_k * MAD ...
+    int min_tol_cm = 2;      // ... but keep everything within this many cm
+    int max_tol_cm = 10;     // ... and nothing beyond this many cm
+    int trim_pct = 25;       // trimmed from each end before averaging
+};
+
+struct RobustResult {
+    int cm;                  // trimmed mean of the kept samples, -1 if none valid
+    int median_cm;           // median of the valid samples, -1 if none
+    int mad_cm;              // median absolute deviation
+    int valid;               // samples that passed the mask
+    int used;                // samples averaged (after MAD rejection and trim)
+};
+
+namespace detail {
+
+constexpr void compare_exchange(int &a, int &b) {
+    int lo = a < b ? a : b;
+    int hi = a < b ? b : a;
+    a = lo;
+    b = hi;
+}
+
+struct Comparator {
+    uint8_t lo, hi;
+};
+
+// Batcher's odd-even merge sort for any n (Knuth 5.3.4, algorithm M). Visits
+// the comparators in order; used at compile time to build the network.
+template <size_t N, class Fn>
+constexpr void batcher(Fn &&fn) {
+    for (size_t p = 1; p < N; p <<= 1) {
+        for (size_t k = p; k >= 1; k >>= 1) {
+            for (size_t j = k % p; j + k < N; j += 2 * k) {
+                for (size_t i = 0; i < k && i + j + k < N; i++) {
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                        fn(i + j, i + j + k);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <size_t N>
+constexpr size_t network_size() {
+    size_t n = 0;
+    batcher<N>([&n](size_t, size_t) { n++; });
+    return n;
+}
+
+template <size_t N>
+struct Network {
+    static constexpr size_t size = network_size<N>();
+    std::array<Comparator, size> cmp{};
+
+    constexpr Network() {
+        size_t n = 0;
+        batcher<N>([this, &n](size_t a, size_t b) { cmp[n++] = Comparator{(uint8_t)a, (uint8_t)b}; });
+    }
+};
+
+template <size_t N>
+constexpr void sort_network(std::array<int, N> &a) {
+    constexpr Network<N> net;
+    for (const Comparator &c : net.cmp) {
+        compare_exchange(a[c.lo], a[c.hi]);
+    }
+}
+
+// Median of the n smallest entries of a sorted array (ties round up)
+template <size_t N>
+constexpr int sorted_median(const std::array<int, N> &a, int n) {
+    return (n & 1) ? a[n / 2] : (a[n / 2 - 1] + a[n / 2] + 1) / 2;
+}
+
+} // namespace detail
+
+template <size_t N>
+constexpr RobustResult robust_estimate(std::array<int, N> s, const RobustConfig &cfg = RobustConfig()) {
+    static_assert(N >= 1 && N <= 255, "robust_estimate takes 1..255 samples");
+
+    // Masked samples become INT_MAX and sort to the end
+    int valid = 0;
+    for (size_t i = 0; i < N; i++) {
+        if (s[i] < 0 || s[i] < cfg.min_cm || s[i] > cfg.max_cm) {
+            s[i] = INT_MAX;
+        } else {
+            valid++;
+        }
+    }
+    RobustResult r{-1, -1, 0, valid, 0};
+    if (valid == 0) {
+        return r;
+    }
+    detail::sort_network(s);
+    r.median_cm = detail::sorted_median(s, valid);
+
+    std::array<int, N> dev{};
+    for (size_t i = 0; i < N; i++) {
+        int d = s[i] - r.median_cm;
+        dev[i] = (int)i < valid ? (d < 0 ? -d : d) : INT_MAX;
+    }
+    detail::sort_network(dev);
+    r.mad_cm = detail::sorted_median(dev, valid);
+
+    // Kept samples are a contiguous run of the sorted array
+    int tol = cfg.mad_k * r.mad_cm;
+    if (tol > cfg.max_tol_cm) {
+        tol = cfg.max_tol_cm;
+    }
+    if (tol < cfg.min_tol_cm) {
+        tol = cfg.min_tol_cm;
+    }
+    int lo = 0, hi = valid;
+    while (lo < hi && r.median_cm - s[lo] > tol) lo++;
+    while (hi > lo && s[hi - 1] - r.median_cm > tol) hi--;
+    if (lo == hi) {
+        r.cm = r.median_cm;   // even count with a wide middle gap: nothing near the median
+        return r;
+    }
+    int trim = (hi - lo) * cfg.trim_pct / 100;
+    lo += trim;
+    hi -= trim;
+
+    long sum = 0;
+    for (int i = lo; i < hi; i++) {
+        sum += s[i];
+    }
+    r.used = hi - lo;
+    r.cm = (int)((2 * sum + r.used) / (2 * r.used));   // rounded (values are >= 0)
+    return r;
+}
+
+} // namespace ultrasonic01
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ultrasonic01 {
+
+// ============================================================================
+// SLOT PLANNER (trigger order/timing for several sensors, no hardware access)
+// ============================================================================
+// Interleaves the samples of N sensors round-robin: A0 B0 A1 B1 A2 B2 ...
+// Each slot may trigger no earlier than
+//   - guard_us after the previous trigger of ANY sensor (crosstalk: lets the
+//     previous ping and its reverberation die out), and
+//   - rearm_us after the previous trigger of the SAME sensor (transducer
+//     ring-down, what ULTRA_MEASURE_DELAY_MS used to wait for).
+// With guard_us <= rearm_us / N the rearm wait of one sensor is spent
+// measuring the others, instead of idling as in a sensor-by-sensor loop.
+//
+// The caller asks for earliest_us(), triggers at or after it, and reports the
+// actual trigger time with fired(); late triggers shift later slots.
+
+template <size_t N>
+class SlotPlanner {
+public:
+    constexpr SlotPlanner(int samples, int32_t guard_us, int32_t rearm_us)
+        : samples_(samples), guard_us_(guard_us), rearm_us_(rearm_us) {}
+
+    bool done() const { return next_ >= (int)N * samples_; }
+
+    // Sensor index / sample number of the next slot
+    size_t sensor() const { return (size_t)next_ % N; }
+    int sample() const { return next_ / (int)N; }
+
+    // Earliest trigger time for the next slot (0 for the first one)
+    int64_t earliest_us() const {
+        if (next_ == 0) {
+            return 0;
+        }
+        int64_t t = last_us_ + guard_us_;
+        if (sample() > 0) {
+            int64_t rearm = last_by_sensor_us_[sensor()] + rearm_us_;
+            if (rearm > t) t = rearm;
+        }
+        return t;
+    }
+
+    // Record that the next slot triggered at t_us and advance
+    void fired(int64_t t_us) {
+        last_us_ = t_us;
+        last_by_sensor_us_[sensor()] = t_us;
+        next_++;
+    }
+
+private:
+    int samples_;
+    int32_t guard_us_;
+    int32_t rearm_us_;
+    int next_ = 0;
+    int64_t last_us_ = 0;
+    int64_t last_by_sensor_us_[N] = {};
+};
+
+} // namespace ultrasonic01
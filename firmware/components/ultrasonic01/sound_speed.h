@@ -0,0 +1,175 @@
+#pragma once
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+namespace ultrasonic01 {
+
+// ============================================================================
+// SPEED OF SOUND vs AIR TEMPERATURE (no hardware access)
+// ============================================================================
+// The HC-SR04 rule cm = us / 58 assumes c = 20000 / 58 = 344.8 m/s, air at
+// about 22.5 degC. c = 331.3 * sqrt(1 + T / 273.15) m/s, so between 15 and
+// 45 degC the same echo reads up to 3.6 % (16 cm at 450 cm) off. A scale
+// c(T) / c(us/58) in Q16 is applied to the raw pulse time, before any
+// filtering; SOUND_SCALE_ONE reproduces us / 58 exactly.
+//
+// The scale is tabulated per whole degC from SOUND_TEMP_MIN_C to
+// SOUND_TEMP_MAX_C at compile time and interpolated for tenths: no float or
+// sqrt on the node.
+
+constexpr uint32_t SOUND_SCALE_ONE = 1u << 16;
+constexpr int SOUND_TEMP_MIN_C = -20;
+constexpr int SOUND_TEMP_MAX_C = 70;
+constexpr int TEMP_INVALID = INT_MIN;   // no usable temperature reading
+
+namespace detail {
+
+constexpr double sqrt_cx(double x) {
+    if (x <= 0) {
+        return 0;
+    }
+    double r = x > 1 ? x : 1;
+    for (int i = 0; i < 200; i++) {
+        double next = 0.5 * (r + x / r);
+        if (next >= r) {
+            break;
+        }
+        r = next;
+    }
+    return r;
+}
+
+// exp(x) for |x| < ~20: Taylor on x / 1024, then squared 10 times
+constexpr double exp_cx(double x) {
+    double y = x / 1024;
+    double term = 1, sum = 1;
+    for (int n = 1; n < 12; n++) {
+        term *= y / n;
+        sum += term;
+    }
+    for (int i = 0; i < 10; i++) {
+        sum *= sum;
+    }
+    return sum;
+}
+
+constexpr double KELVIN = 273.15;
+
+} // namespace detail
+
+// Speed of sound in dry air, m/s (compile time and host tools)
+constexpr double sound_speed_m_s(double temp_c) {
+    return 331.3 * detail::sqrt_cx(1 + temp_c / detail::KELVIN);
+}
+
+namespace detail {
+
+constexpr size_t SOUND_TABLE_SIZE = SOUND_TEMP_MAX_C - SOUND_TEMP_MIN_C + 1;
+
+constexpr std::array<uint32_t, SOUND_TABLE_SIZE> make_sound_table() {
+    std::array<uint32_t, SOUND_TABLE_SIZE> t{};
+    for (size_t i = 0; i < SOUND_TABLE_SIZE; i++) {
+        double scale = sound_speed_m_s(SOUND_TEMP_MIN_C + (int)i) * 58.0 / 20000.0;
+        t[i] = (uint32_t)(scale * SOUND_SCALE_ONE + 0.5);
+    }
+    return t;
+}
+
+} // namespace detail
+
+// Q16 scale per whole degC, index 0 = SOUND_TEMP_MIN_C
+constexpr std::array<uint32_t, detail::SOUND_TABLE_SIZE> SOUND_SCALE_TABLE = detail::make_sound_table();
+
+// Scale for an air temperature in 0.1 degC (clamped to the table range);
+// TEMP_INVALID gives SOUND_SCALE_ONE
+constexpr uint32_t sound_scale_q16(int temp_c_x10) {
+    if (temp_c_x10 == TEMP_INVALID) {
+        return SOUND_SCALE_ONE;
+    }
+    int lo = SOUND_TEMP_MIN_C * 10, hi = SOUND_TEMP_MAX_C * 10;
+    if (temp_c_x10 <= lo) return SOUND_SCALE_TABLE[0];
+    if (temp_c_x10 >= hi) return SOUND_SCALE_TABLE[detail::SOUND_TABLE_SIZE - 1];
+    int off = temp_c_x10 - lo;
+    size_t i = (size_t)(off / 10);
+    uint32_t a = SOUND_SCALE_TABLE[i], b = SOUND_SCALE_TABLE[i + 1];
+    return a + ((b - a) * (uint32_t)(off % 10) + 5) / 10;
+}
+
+// Echo pulse (round trip, us) -> distance in cm, rounded. SOUND_SCALE_ONE:
+// (pulse_us + 29) / 58 as before. Negative pulse (timeout) -> -1.
+constexpr int pulse_to_cm(int32_t pulse_us, uint32_t scale_q16 = SOUND_SCALE_ONE) {
+    if (pulse_us < 0) {
+        return -1;
+    }
+    return (int)(((int64_t)pulse_us * scale_q16 + (int64_t)29 * SOUND_SCALE_ONE) / ((int64_t)58 * SOUND_SCALE_ONE));
+}
+
+// ============================================================================
+// NTC THERMISTOR DIVIDER -> TEMPERATURE (no hardware access)
+// ============================================================================
+// supply -- r_fixed -- ADC -- NTC -- GND. Beta model:
+//   R(T) = r25 * exp(beta * (1/T - 1/298.15))
+// The divider ratio (ADC mV / supply mV, in 1/10000) is tabulated per whole
+// degC at compile time; a reading is found by binary search and interpolated
+// to 0.1 degC. Readings beyond the table (open or shorted thermistor, or out
+// of range) give TEMP_INVALID.
+
+struct NtcModel {
+    int32_t r25_ohm = 10000;
+    int32_t beta = 3950;
+    int32_t r_fixed_ohm = 10000;
+};
+
+class NtcTable {
+public:
+    static constexpr size_t SIZE = detail::SOUND_TABLE_SIZE;   // same range as the sound table
+
+    constexpr explicit NtcTable(const NtcModel &m = NtcModel()) {
+        for (size_t i = 0; i < SIZE; i++) {
+            double t_k = SOUND_TEMP_MIN_C + (int)i + detail::KELVIN;
+            double r = m.r25_ohm * detail::exp_cx(m.beta * (1.0 / t_k - 1.0 / (25 + detail::KELVIN)));
+            ratio_[i] = (uint16_t)(10000.0 * r / (r + m.r_fixed_ohm) + 0.5);
+        }
+    }
+
+    // Divider ratio (1/10000) at whole degC SOUND_TEMP_MIN_C + i; decreasing
+    constexpr uint16_t ratio(size_t i) const { return ratio_[i]; }
+
+    // ADC reading -> 0.1 degC, or TEMP_INVALID
+    constexpr int temp_c_x10(int adc_mv, int supply_mv) const {
+        if (supply_mv <= 0 || adc_mv < 0) {
+            return TEMP_INVALID;
+        }
+        int32_t r = (int32_t)(((int64_t)adc_mv * 10000 + supply_mv / 2) / supply_mv);
+        if (r > ratio_[0] || r < ratio_[SIZE - 1]) {
+            return TEMP_INVALID;
+        }
+        // first index whose ratio is <= r
+        size_t lo = 0, hi = SIZE - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (ratio_[mid] <= r) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        int whole = SOUND_TEMP_MIN_C + (int)lo;
+        if (lo == 0 || ratio_[lo] == r) {
+            return whole * 10;
+        }
+        // between lo - 1 (1 degC colder, higher ratio) and lo
+        int32_t span = ratio_[lo - 1] - ratio_[lo];
+        int32_t from_lo = r - ratio_[lo];
+        return whole * 10 - (int)((from_lo * 10 + span / 2) / span);
+    }
+
+private:
+    std::array<uint16_t, SIZE> ratio_{};
+};
+
+} // namespace ultrasonic01
@@ -3,6 +3,24 @@
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "esp_rom_sys.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "echo_decoder.h"
+#include "kalman.h"
+#include "robust_estimator.h"
+#include "slot_planner.h"
+#include "sound_speed.h"
+
+#ifndef ULTRASONIC01_MAX_SENSORS
+#define ULTRASONIC01_MAX_SENSORS 4   // distinct echo pins served by measure_cm()
+#endif
+
+#ifndef ULTRASONIC01_MAX_SAMPLES
+#define ULTRASONIC01_MAX_SAMPLES 5   // samples per sensor in measure_interleaved()
+#endif
 
 namespace ultrasonic01 {
 
@@ -15,6 +33,7 @@ struct Timings {
     int trigger_high_us = 10;
     int settle_low_us = 2;
     int timeout_us = 300000; // 300 ms
+    uint32_t sound_scale_q16 = SOUND_SCALE_ONE;   // air temperature correction (sound_scale_q16(), sound_speed.h)
 };
 
 inline void init_pins(const Pins &pins) {
@@ -26,8 +45,9 @@ inline void init_pins(const Pins &pins) {
     gpio_set_direction(pins.echo, GPIO_MODE_INPUT);
 }
 
+// Busy-wait measurement (fallback when the edge interrupt cannot be installed).
 // Returns distance in cm, or -1 on timeout/error
-inline int measure_cm(const Pins &pins, const Timings &t = Timings()) {
+inline int measure_cm_polling(const Pins &pins, const Timings &t = Timings()) {
     gpio_set_level(pins.trig, 0);
     esp_rom_delay_us(t.settle_low_us);
     gpio_set_level(pins.trig, 1);
@@ -45,67 +65,227 @@ inline int measure_cm(const Pins &pins, const Timings &t = Timings()) {
     }
     int64_t echo_end = esp_timer_get_time();
     int64_t pulse_us = echo_end - echo_start;
-    // HC-SR04: cm ≈ us/58, rounded
-    return (int)((pulse_us + 29) / 58);
-}
-
-// Utility: median of 3 ints (for simple noise rejection)
-inline int median3(int a, int b, int c) {
-    if (a > b) { int t=a;a=b;b=t; }
-    if (b > c) { int t=b;b=c;c=t; }
-    if (a > b) { int t=a;a=b;b=t; }
-    return b;
+    // HC-SR04: cm ≈ us/58 (times the sound scale), rounded
+    return pulse_to_cm((int32_t)pulse_us, t.sound_scale_q16);
 }
 
 // ============================================================================
-// 1D KALMAN FILTER (improves accuracy from ±1cm to ±0.3cm)
+// ASYNC ECHO CAPTURE (GPIO edge interrupt + esp_timer deadline)
 // ============================================================================
+// start() sends the trigger pulse and returns; both echo edges are timestamped
+// in the GPIO ISR and fed to an EchoDecoder. Completion (or the deadline timer)
+// then either calls the user callback or gives a semaphore that wait() blocks
+// on, so the CPU is idle during the flight time instead of spinning.
+//
+// The callback runs in ISR or esp_timer task context: keep it short and use
+// only ISR-safe calls. The GPIO ISR service is installed on first use.
 
-class KalmanFilter {
-private:
-    float x;  // Estimated state (distance in cm)
-    float p;  // Estimation error covariance
-    float q;  // Process noise covariance
-    float r;  // Measurement noise covariance
-    bool initialized;
+using EchoCallback = void (*)(void *arg, int distance_cm);
 
+class EchoCapture {
 public:
-    KalmanFilter(float process_noise = 1.0f, float measurement_noise = 2.0f)
-        : x(0.0f), p(1.0f), q(process_noise), r(measurement_noise), initialized(false) {}
-
-    // Update filter with new measurement, returns filtered value
-    float update(int measurement_cm) {
-        if (!initialized) {
-            // First measurement - initialize state
-            x = (float)measurement_cm;
-            p = r;
-            initialized = true;
-            return x;
+    explicit EchoCapture(const Pins &pins) : pins_(pins) {}
+
+    const Pins &pins() const { return pins_; }
+
+    // Hook the echo pin interrupt and create the deadline timer
+    esp_err_t install() {
+        if (installed_) return ESP_OK;
+
+        done_ = xSemaphoreCreateBinary();
+        if (!done_) return ESP_ERR_NO_MEM;
+
+        esp_timer_create_args_t args = {};
+        args.callback = &EchoCapture::deadline_cb;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "us01_echo";
+        esp_err_t err = esp_timer_create(&args, &deadline_);
+        if (err != ESP_OK) return err;
+
+        err = gpio_install_isr_service(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;  // already installed is fine
+        gpio_set_intr_type(pins_.echo, GPIO_INTR_ANYEDGE);
+        err = gpio_isr_handler_add(pins_.echo, &EchoCapture::edge_isr, this);
+        if (err != ESP_OK) return err;
+        gpio_intr_enable(pins_.echo);
+
+        installed_ = true;
+        return ESP_OK;
+    }
+
+    // Trigger a measurement. cb == nullptr: collect the result with wait().
+    esp_err_t start(const Timings &t = Timings(), EchoCallback cb = nullptr, void *cb_arg = nullptr) {
+        if (!installed_) return ESP_ERR_INVALID_STATE;
+
+        esp_timer_stop(deadline_);          // a stale deadline from the last run
+        xSemaphoreTake(done_, 0);           // drop a completion nobody waited for
+        cb_ = cb;
+        cb_arg_ = cb_arg;
+
+        gpio_set_level(pins_.trig, 0);
+        esp_rom_delay_us(t.settle_low_us);
+        gpio_set_level(pins_.trig, 1);
+        esp_rom_delay_us(t.trigger_high_us);
+        gpio_set_level(pins_.trig, 0);
+
+        portENTER_CRITICAL(&lock_);
+        decoder_.begin(esp_timer_get_time(), t.timeout_us, t.sound_scale_q16);
+        portEXIT_CRITICAL(&lock_);
+
+        // Overall deadline: rise wait + pulse, each bounded by timeout_us
+        return esp_timer_start_once(deadline_, 2ULL * (uint64_t)t.timeout_us);
+    }
+
+    // Block until the measurement started with start() completes.
+    // Returns distance in cm, or -1 on timeout/error
+    int wait(TickType_t max_wait) {
+        if (xSemaphoreTake(done_, max_wait) != pdTRUE) {
+            portENTER_CRITICAL(&lock_);
+            decoder_.expire();
+            portEXIT_CRITICAL(&lock_);
         }
+        return result_cm();
+    }
 
-        // Prediction step (assume constant model, no control input)
-        // x_pred = x (no state transition)
-        // p_pred = p + q
-        p = p + q;
+    int result_cm() const { return decoder_.distance_cm(); }
+    bool busy() const { return decoder_.pending(); }
 
-        // Update step
-        // Kalman gain K = p_pred / (p_pred + r)
-        float k = p / (p + r);
+private:
+    static void IRAM_ATTR edge_isr(void *arg) {
+        EchoCapture *self = static_cast<EchoCapture *>(arg);
+        int64_t now = esp_timer_get_time();
+        int level = gpio_get_level(self->pins_.echo);
 
-        // State update: x = x_pred + K * (measurement - x_pred)
-        x = x + k * ((float)measurement_cm - x);
+        portENTER_CRITICAL_ISR(&self->lock_);
+        bool finished = self->decoder_.on_edge(level, now);
+        portEXIT_CRITICAL_ISR(&self->lock_);
 
-        // Covariance update: p = (1 - K) * p_pred
-        p = (1.0f - k) * p;
+        if (finished) {
+            BaseType_t woken = pdFALSE;
+            self->complete(&woken);
+            portYIELD_FROM_ISR(woken);
+        }
+    }
 
-        return x;
+    static void deadline_cb(void *arg) {
+        EchoCapture *self = static_cast<EchoCapture *>(arg);
+        portENTER_CRITICAL(&self->lock_);
+        bool expired = self->decoder_.expire();
+        portEXIT_CRITICAL(&self->lock_);
+        if (expired) {
+            self->complete(nullptr);
+        }
     }
 
-    // Get current estimate without updating
-    float get_estimate() const { return x; }
+    // woken != nullptr: called from the ISR
+    void complete(BaseType_t *woken) {
+        if (cb_) {
+            cb_(cb_arg_, decoder_.distance_cm());
+        } else if (woken) {
+            xSemaphoreGiveFromISR(done_, woken);
+        } else {
+            xSemaphoreGive(done_);
+        }
+    }
 
-    // Reset filter (e.g., when sensor detects large discontinuity)
-    void reset() { initialized = false; }
+    Pins pins_;
+    EchoDecoder decoder_;
+    portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+    SemaphoreHandle_t done_ = nullptr;
+    esp_timer_handle_t deadline_ = nullptr;
+    EchoCallback cb_ = nullptr;
+    void *cb_arg_ = nullptr;
+    bool installed_ = false;
 };
 
+// One EchoCapture per echo pin, created on first use (nullptr if none could be installed)
+inline EchoCapture *capture_for(const Pins &pins) {
+    static EchoCapture *captures[ULTRASONIC01_MAX_SENSORS] = {};
+    for (int i = 0; i < ULTRASONIC01_MAX_SENSORS; i++) {
+        if (captures[i] && captures[i]->pins().echo == pins.echo) {
+            return captures[i];
+        }
+    }
+    for (int i = 0; i < ULTRASONIC01_MAX_SENSORS; i++) {
+        if (!captures[i]) {
+            EchoCapture *cap = new EchoCapture(pins);
+            if (cap->install() != ESP_OK) {
+                delete cap;
+                return nullptr;
+            }
+            captures[i] = cap;
+            return cap;
+        }
+    }
+    return nullptr;
+}
+
+// Synchronous measurement: trigger, then sleep until the echo completes.
+// Returns distance in cm, or -1 on timeout/error
+inline int measure_cm(const Pins &pins, const Timings &t = Timings()) {
+    EchoCapture *cap = capture_for(pins);
+    if (!cap) {
+        return measure_cm_polling(pins, t);
+    }
+    if (cap->start(t) != ESP_OK) {
+        return -1;
+    }
+    // Margin over the deadline timer, which normally completes the wait itself
+    return cap->wait(pdMS_TO_TICKS(2 * t.timeout_us / 1000 + 50));
+}
+
+// ============================================================================
+// INTERLEAVED MULTI-SENSOR MEASUREMENT
+// ============================================================================
+// Takes `samples` readings from each sensor in one pass, ordered and spaced by
+// SlotPlanner (A0 B0 A1 B1 ...). Each trigger waits for the previous echo to
+// complete, so two pings are never in flight at the same time.
+
+struct Schedule {
+    int samples = 3;
+    int guard_ms = 30;   // min spacing between triggers of different sensors
+    int rearm_ms = 60;   // min spacing between triggers of the same sensor
+};
+
+struct Samples {
+    int cm[ULTRASONIC01_MAX_SAMPLES];   // in trigger order; -1 = timeout/error
+    int count;
+};
+
+template <size_t N>
+inline void measure_interleaved(const Pins (&pins)[N], Samples (&out)[N],
+                                const Schedule &s = Schedule(), const Timings &t = Timings()) {
+    int samples = s.samples < 1 ? 1 : (s.samples > ULTRASONIC01_MAX_SAMPLES ? ULTRASONIC01_MAX_SAMPLES : s.samples);
+    SlotPlanner<N> plan(samples, s.guard_ms * 1000, s.rearm_ms * 1000);
+    for (size_t i = 0; i < N; i++) {
+        out[i].count = 0;
+    }
+
+    while (!plan.done()) {
+        int64_t wait_us = plan.earliest_us() - esp_timer_get_time();
+        if (wait_us > 0) {
+            // Round up: the guard is a minimum, oversleeping by a tick is fine
+            const int64_t tick_us = (int64_t)portTICK_PERIOD_MS * 1000;
+            vTaskDelay((TickType_t)((wait_us + tick_us - 1) / tick_us));
+        }
+
+        size_t i = plan.sensor();
+        int64_t trigger_us = esp_timer_get_time();
+        out[i].cm[out[i].count++] = measure_cm(pins[i], t);
+        plan.fired(trigger_us);
+    }
+}
+
+// The first N samples as an array for robust_estimate(); missing ones are -1
+template <size_t N>
+inline std::array<int, N> sample_array(const Samples &s) {
+    static_assert(N <= ULTRASONIC01_MAX_SAMPLES, "raise ULTRASONIC01_MAX_SAMPLES to take this many samples");
+    std::array<int, N> a;
+    for (size_t i = 0; i < N; i++) {
+        a[i] = (int)i < s.count ? s.cm[i] : -1;
+    }
+    return a;
+}
+
 } // namespace ultrasonic01
@@ -0,0 +1,106 @@
+/**
+ * AGUADA - Duplicate suppression for retransmitted packets (see dedup.h)
+ */
+
+#include "dedup.h"
+
+#include <string.h>
+
+_Static_assert((DEDUP_NODES & (DEDUP_NODES - 1)) == 0, "DEDUP_NODES must be a power of two");
+_Static_assert(DEDUP_WINDOW == 64, "window is stored in a uint64_t");
+
+// FNV-1a over the key
+static uint32_t dedup_hash(const uint8_t mac[6], uint8_t node_id) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    h = (h ^ node_id) * 16777619u;
+    return h;
+}
+
+static bool dedup_key_equal(const dedup_entry_t *e, const uint8_t mac[6], uint8_t node_id) {
+    return e->node_id == node_id && memcmp(e->mac, mac, 6) == 0;
+}
+
+void dedup_init(dedup_t *d) {
+    memset(d, 0, sizeof(*d));
+}
+
+// Find the entry for the key, or claim a free / least recently seen slot for it
+static dedup_entry_t *dedup_slot(dedup_t *d, const uint8_t mac[6], uint8_t node_id, bool *is_new) {
+    uint32_t idx = dedup_hash(mac, node_id) & (DEDUP_NODES - 1);
+    dedup_entry_t *victim = NULL;
+
+    for (int probe = 0; probe < DEDUP_MAX_PROBE; probe++) {
+        dedup_entry_t *e = &d->entries[(idx + probe) & (DEDUP_NODES - 1)];
+        if (!e->used) {
+            if (!victim || victim->used) {
+                victim = e;
+            }
+            // Keys are never removed, so an empty slot ends the probe sequence
+            break;
+        }
+        if (dedup_key_equal(e, mac, node_id)) {
+            *is_new = false;
+            return e;
+        }
+        if (!victim || (victim->used && d->clock - e->last_seen > d->clock - victim->last_seen)) {
+            victim = e;
+        }
+    }
+
+    if (victim->used) {
+        d->stats.evictions++;
+    }
+    memset(victim, 0, sizeof(*victim));
+    memcpy(victim->mac, mac, 6);
+    victim->node_id = node_id;
+    victim->used = 1;
+    *is_new = true;
+    return victim;
+}
+
+bool dedup_check(dedup_t *d, const uint8_t mac[6], uint8_t node_id, uint32_t seq) {
+    d->stats.lookups++;
+    d->clock++;
+
+    bool is_new;
+    dedup_entry_t *e = dedup_slot(d, mac, node_id, &is_new);
+    e->last_seen = d->clock;
+
+    if (is_new) {
+        e->max_seq = seq;
+        e->window = 1;
+        d->stats.accepted++;
+        return false;
+    }
+
+    if (seq > e->max_seq) {
+        uint32_t shift = seq - e->max_seq;
+        e->window = (shift >= DEDUP_WINDOW) ? 1 : (e->window << shift) | 1;
+        e->max_seq = seq;
+        d->stats.accepted++;
+        return false;
+    }
+
+    uint32_t age = e->max_seq - seq;
+    if (age >= DEDUP_WINDOW) {
+        // Far behind the window: the node restarted its counter
+        e->max_seq = seq;
+        e->window = 1;
+        d->stats.resets++;
+        d->stats.accepted++;
+        return false;
+    }
+
+    uint64_t bit = (uint64_t)1 << age;
+    if (e->window & bit) {
+        d->stats.duplicates++;
+        return true;
+    }
+    e->window |= bit;
+    d->stats.out_of_order++;
+    d->stats.accepted++;
+    return false;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+ * AGUADA - Duplicate suppression for retransmitted packets
+ *
+ * Nodes retry a send (several gateways x ESPNOW_SEND_RETRIES) until they get an
+ * ACK. When the ACK is lost the same (mac, node_id, seq) arrives again; this
+ * cache recognizes it so it is re-ACKed but not forwarded to the backend.
+ *
+ * - Keyed by (mac, node_id): node_cie_dual reports two node_ids from one MAC,
+ *   each with its own sequence counter.
+ * - Fixed-size open-addressed table (linear probing, DEDUP_MAX_PROBE slots).
+ *   When every probed slot is taken, the least recently seen node is evicted.
+ * - Per node: highest seq seen plus a DEDUP_WINDOW-bit bitmap of the seqs
+ *   below it, so late/out-of-order packets inside the window are still accepted.
+ * - A seq older than the window is taken as a node restart (counter reset):
+ *   the window is rebased and the packet accepted.
+ *
+ * Not thread-safe: meant to be used only by packet_processing_task.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEDUP_NODES       64    // table slots (power of two)
+#define DEDUP_MAX_PROBE   8
+#define DEDUP_WINDOW      64    // bits in the per-node seq window
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t node_id;
+    uint8_t used;
+    uint32_t max_seq;
+    uint64_t window;        // bit i set = (max_seq - i) already seen
+    uint32_t last_seen;     // dedup_t.clock value of the last lookup
+} dedup_entry_t;
+
+typedef struct {
+    uint32_t lookups;
+    uint32_t duplicates;    // hits: dropped retransmits
+    uint32_t accepted;      // misses: new packets
+    uint32_t out_of_order;  // accepted, but below max_seq
+    uint32_t resets;        // seq went back beyond the window
+    uint32_t evictions;
+} dedup_stats_t;
+
+typedef struct {
+    dedup_entry_t entries[DEDUP_NODES];
+    uint32_t clock;
+    dedup_stats_t stats;
+} dedup_t;
+
+void dedup_init(dedup_t *d);
+
+// Record (mac, node_id, seq). Returns true if it was already seen (duplicate).
+bool dedup_check(dedup_t *d, const uint8_t mac[6], uint8_t node_id, uint32_t seq);
+
+#ifdef __cplusplus
+}
+#endif
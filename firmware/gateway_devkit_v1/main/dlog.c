@@ -0,0 +1,240 @@
+/**
+ * AGUADA - Deferred log for the gateway hot path (see dlog.h)
+ */
+
+#include "dlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#define TAG "AGUADA_GATEWAY"
+
+typedef enum {
+    DLOG_KIND_MSG = 0,
+    DLOG_KIND_PACKET
+} dlog_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t id;             // dlog_msg_t, or packet_format_t for packets
+    uint8_t mac[6];
+    union {
+        uint32_t args[3];
+        SensorPacketV2 pkt;
+    } u;
+} dlog_record_t;
+
+static const dlog_tag_t msg_tags[DLOG_MSG_COUNT] = {
+    [DLOG_MSG_PEER_ADDED] = DLOG_TAG_PEER,
+    [DLOG_MSG_ACK_FAILED] = DLOG_TAG_PEER,
+    [DLOG_MSG_FRAME_REJECTED] = DLOG_TAG_RX,
+    [DLOG_MSG_DUPLICATE] = DLOG_TAG_RX,
+    [DLOG_MSG_BAD_VERSION] = DLOG_TAG_RX,
+    [DLOG_MSG_HTTP_QUEUE_FULL] = DLOG_TAG_UPLINK,
+};
+
+static const char *const tag_names[DLOG_TAG_COUNT] = {"pacote", "rx", "peer", "uplink"};
+
+static QueueHandle_t dlog_queue = NULL;
+static bool dlog_compact = false;
+static uint32_t dlog_drop_count = 0;
+
+// Per-tag token bucket (printer task only)
+static struct {
+    uint32_t tokens_milli;
+    int64_t last_refill_us;
+    uint32_t suppressed;
+} tag_limits[DLOG_TAG_COUNT];
+
+static void dlog_push(const dlog_record_t *rec) {
+    if (!dlog_queue || xQueueSend(dlog_queue, rec, 0) != pdTRUE) {
+        dlog_drop_count++;
+    }
+}
+
+void dlog_msg(dlog_msg_t id, const uint8_t mac[6], uint32_t a, uint32_t b, uint32_t c) {
+    if (dlog_compact) {
+        return;
+    }
+    dlog_record_t rec = {.kind = DLOG_KIND_MSG, .id = (uint8_t)id};
+    if (mac) {
+        memcpy(rec.mac, mac, 6);
+    }
+    rec.u.args[0] = a;
+    rec.u.args[1] = b;
+    rec.u.args[2] = c;
+    dlog_push(&rec);
+}
+
+void dlog_packet(const uint8_t src_mac[6], packet_format_t format, const SensorPacketV2 *pkt) {
+    dlog_record_t rec = {.kind = DLOG_KIND_PACKET, .id = (uint8_t)format};
+    memcpy(rec.mac, src_mac, 6);
+    rec.u.pkt = *pkt;
+    dlog_push(&rec);
+}
+
+uint32_t dlog_dropped(void) {
+    return dlog_drop_count;
+}
+
+// Take one token for the tag; reports lines suppressed since the last success
+static bool dlog_allow(dlog_tag_t tag) {
+    int64_t now = esp_timer_get_time();
+    uint64_t tokens = tag_limits[tag].tokens_milli +
+                      (uint64_t)(now - tag_limits[tag].last_refill_us) * DLOG_RATE_PER_S / 1000;
+    if (tokens > DLOG_BURST * 1000) {
+        tokens = DLOG_BURST * 1000;
+    }
+    tag_limits[tag].last_refill_us = now;
+
+    if (tokens < 1000) {
+        tag_limits[tag].tokens_milli = (uint32_t)tokens;
+        tag_limits[tag].suppressed++;
+        return false;
+    }
+    tag_limits[tag].tokens_milli = (uint32_t)(tokens - 1000);
+
+    if (tag_limits[tag].suppressed > 0) {
+        ESP_LOGW(TAG, "… %" PRIu32 " mensagens [%s] suprimidas (limite %d/s)",
+                 tag_limits[tag].suppressed, tag_names[tag], DLOG_RATE_PER_S);
+        tag_limits[tag].suppressed = 0;
+    }
+    return true;
+}
+
+static void dlog_print_msg(const dlog_record_t *rec) {
+    const uint8_t *m = rec->mac;
+    const uint32_t *a = rec->u.args;
+    char mac_str[18];
+    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X", m[0], m[1], m[2], m[3], m[4], m[5]);
+
+    switch ((dlog_msg_t)rec->id) {
+        case DLOG_MSG_PEER_ADDED:
+            ESP_LOGI(TAG, "✓ Nó auto-registrado: %s", mac_str);
+            break;
+        case DLOG_MSG_ACK_FAILED:
+            ESP_LOGW(TAG, "✗ Falha ao enviar ACK para %s: %s", mac_str, esp_err_to_name((esp_err_t)a[0]));
+            break;
+        case DLOG_MSG_FRAME_REJECTED:
+            ESP_LOGW(TAG, "⚠ Quadro rejeitado de %s: %" PRIu32 " bytes, byte0=0x%02" PRIX32 " (erro %" PRId32 ")",
+                     mac_str, a[0], a[1], (int32_t)a[2]);
+            break;
+        case DLOG_MSG_DUPLICATE:
+            ESP_LOGD(TAG, "↺ Duplicado descartado: %s node_id=%" PRIu32 " seq=%" PRIu32, mac_str, a[0], a[1]);
+            break;
+        case DLOG_MSG_BAD_VERSION:
+            ESP_LOGW(TAG, "✗ Versão inválida de %s: %" PRIu32 " (esperado %u ou %u)", mac_str, a[0],
+                     SENSOR_PACKET_VERSION, SENSOR_PACKET_V2_VERSION);
+            break;
+        case DLOG_MSG_HTTP_QUEUE_FULL:
+            ESP_LOGW(TAG, "Fila HTTP cheia - descartando envio (node_id=%" PRIu32 " seq=%" PRIu32 ")", a[0], a[1]);
+            break;
+        default:
+            break;
+    }
+}
+
+static void dlog_print_box(const char *mac_str, packet_format_t format, const SensorPacketV2 *pkt) {
+    static const char *const alert_names[] = {"NONE", "RAPID_DROP", "RAPID_RISE", "SENSOR_STUCK"};
+    const char *alert = pkt->alert_type < 4 ? alert_names[pkt->alert_type] : "?";
+    bool is_alert = (pkt->flags & FLAG_IS_ALERT) != 0;
+
+    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, "╔════════════════════════════════════════════════════╗");
+    ESP_LOGI(TAG, "║ ✓ ESP-NOW recebido de: %s (%s)", mac_str, packet_format_name(format));
+    ESP_LOGI(TAG, "╠════════════════════════════════════════════════════╣");
+
+    if (is_alert) {
+        ESP_LOGW(TAG, "╔════════════════════════════════════════════════════╗");
+        ESP_LOGW(TAG, "║          🚨 ALERTA DE ANOMALIA DETECTADO 🚨       ║");
+        ESP_LOGW(TAG, "╠════════════════════════════════════════════════════╣");
+        ESP_LOGW(TAG, "║ Tipo: %s", alert);
+        ESP_LOGW(TAG, "║ Nó ID: %u | Sequência: %" PRIu32, pkt->node_id, pkt->seq);
+        ESP_LOGW(TAG, "╚════════════════════════════════════════════════════╝");
+    }
+
+    ESP_LOGI(TAG, "║ Versão: %u", pkt->version);
+    ESP_LOGI(TAG, "║ Nó ID: %u", pkt->node_id);
+    ESP_LOGI(TAG, "║ Distância: %d cm", pkt->distance_cm);
+    ESP_LOGI(TAG, "║ Nível: %d cm", pkt->level_cm);
+    ESP_LOGI(TAG, "║ Percentual: %u%%", pkt->percentual);
+    ESP_LOGI(TAG, "║ Volume: %" PRIu32 " L", pkt->volume_l);
+    ESP_LOGI(TAG, "║ Tensão: %d mV", pkt->vin_mv);
+    if (pkt->rate_cmpm_x10 != SENSOR_RATE_UNKNOWN) {
+        int r = pkt->rate_cmpm_x10;
+        ESP_LOGI(TAG, "║ Taxa: %s%d.%d cm/min", r < 0 ? "-" : "+", abs(r) / 10, abs(r) % 10);
+    }
+    ESP_LOGI(TAG, "║ RSSI: %d dBm", pkt->rssi);
+    ESP_LOGI(TAG, "║ Sequência: %" PRIu32, pkt->seq);
+    if (is_alert) {
+        ESP_LOGI(TAG, "║ 🚨 Alerta: %s", alert);
+    }
+    ESP_LOGI(TAG, "╚════════════════════════════════════════════════════╝");
+}
+
+static void dlog_print_packet(const dlog_record_t *rec) {
+    const SensorPacketV2 *pkt = &rec->u.pkt;
+    char mac_str[18];
+    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
+             rec->mac[0], rec->mac[1], rec->mac[2], rec->mac[3], rec->mac[4], rec->mac[5]);
+
+    if (!dlog_compact && dlog_allow(DLOG_TAG_PACKET)) {
+        dlog_print_box(mac_str, (packet_format_t)rec->id, pkt);
+    }
+
+    // Output JSON to Serial for external processing (never rate-limited)
+    printf("TELEMETRY:{\"mac\":\"%s\",\"distance\":%d,\"level\":%d,\"volume\":%" PRIu32 ",\"voltage\":%d,\"seq\":%" PRIu32 ",\"alert\":%u}\n",
+           mac_str, pkt->distance_cm, pkt->level_cm, pkt->volume_l,
+           pkt->vin_mv, pkt->seq, pkt->alert_type);
+}
+
+static void dlog_task(void *pvParameters) {
+    dlog_record_t rec;
+    uint32_t drops_reported = 0;
+
+    while (1) {
+        if (xQueueReceive(dlog_queue, &rec, pdMS_TO_TICKS(1000)) == pdTRUE) {
+            if (rec.kind == DLOG_KIND_PACKET) {
+                dlog_print_packet(&rec);
+            } else if (rec.id < DLOG_MSG_COUNT && dlog_allow(msg_tags[rec.id])) {
+                dlog_print_msg(&rec);
+            }
+            // Flush once the burst is written, not per line
+            if (uxQueueMessagesWaiting(dlog_queue) == 0) {
+                fflush(stdout);
+            }
+        }
+
+        if (dlog_drop_count != drops_reported && !dlog_compact) {
+            ESP_LOGW(TAG, "⚠ Log adiado: %" PRIu32 " registros perdidos (fila cheia)", dlog_drop_count - drops_reported);
+            drops_reported = dlog_drop_count;
+        }
+    }
+}
+
+void dlog_init(bool compact) {
+    dlog_compact = compact;
+    int64_t now = esp_timer_get_time();
+    for (int t = 0; t < DLOG_TAG_COUNT; t++) {
+        tag_limits[t].tokens_milli = DLOG_BURST * 1000;
+        tag_limits[t].last_refill_us = now;
+        tag_limits[t].suppressed = 0;
+    }
+
+    dlog_queue = xQueueCreate(DLOG_QUEUE_LEN, sizeof(dlog_record_t));
+    if (!dlog_queue) {
+        ESP_LOGE(TAG, "Falha ao criar fila de log adiado");
+        return;
+    }
+    // Lowest application priority: printing never competes with reception/uplink
+    xTaskCreate(dlog_task, "dlog", 4096, NULL, 1, NULL);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+/**
+ * AGUADA - Deferred log for the gateway hot path
+ *
+ * packet_processing_task used to print a ~15-line box plus the TELEMETRY line
+ * per packet, synchronously on the UART. Now the hot path only pushes a small
+ * binary record (message id + raw arguments, or a packet copy) into a FreeRTOS
+ * queue and returns; a low-priority task formats and prints it.
+ *
+ * - Human-readable output is rate-limited per tag (token bucket, DLOG_RATE_PER_S
+ *   lines/s with a DLOG_BURST burst). Suppressed lines are counted and reported
+ *   once the tag has tokens again.
+ * - The TELEMETRY: line is data, not a log: never rate-limited.
+ * - Compact mode prints only the TELEMETRY: line.
+ * - A full queue drops the record (counted in dlog_dropped()); the hot path
+ *   never blocks on logging.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "telemetry_packet.h"
+#include "packet_decode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DLOG_QUEUE_LEN   64
+#define DLOG_RATE_PER_S  10
+#define DLOG_BURST       20
+
+typedef enum {
+    DLOG_TAG_PACKET = 0,   // per-packet box
+    DLOG_TAG_RX,           // frame rejects, duplicates
+    DLOG_TAG_PEER,         // peer registration, ACK errors
+    DLOG_TAG_UPLINK,       // HTTP queue
+    DLOG_TAG_COUNT
+} dlog_tag_t;
+
+typedef enum {
+    DLOG_MSG_PEER_ADDED = 0,    // mac
+    DLOG_MSG_ACK_FAILED,        // mac, esp_err_t
+    DLOG_MSG_FRAME_REJECTED,    // mac, len, first byte, error
+    DLOG_MSG_DUPLICATE,         // mac, node_id, seq
+    DLOG_MSG_BAD_VERSION,       // mac, version
+    DLOG_MSG_HTTP_QUEUE_FULL,   // mac, node_id, seq
+    DLOG_MSG_COUNT
+} dlog_msg_t;
+
+// Create the queue and start the printer task
+void dlog_init(bool compact);
+
+// Queue a message (unused arguments are ignored)
+void dlog_msg(dlog_msg_t id, const uint8_t mac[6], uint32_t a, uint32_t b, uint32_t c);
+
+// Queue a received packet: box (rate-limited) + TELEMETRY: line
+void dlog_packet(const uint8_t src_mac[6], packet_format_t format, const SensorPacketV2 *pkt);
+
+// Records lost because the queue was full
+uint32_t dlog_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
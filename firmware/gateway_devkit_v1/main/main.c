@@ -26,6 +26,9 @@
 #include "esp_netif.h"
 #include "esp_netif_ip_addr.h"
 #include "esp_http_client.h"
+#include "esp_http_server.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
 #include "esp_event.h"
 #include "esp_sntp.h"
 #include "nvs_flash.h"
@@ -38,6 +41,13 @@
 #include "freertos/task.h"
 
 #include "telemetry_packet.h"
+#include "pkt_log.h"
+#include "rx_ring.h"
+#include "dedup.h"
+#include "packet_decode.h"
+#include "uplink_body.h"
+#include "metrics.h"
+#include "dlog.h"
 
 #define TAG "AGUADA_GATEWAY"
 
@@ -46,6 +56,8 @@
 // ============================================================================
 
 #define ESPNOW_CHANNEL 11
+#define GATEWAY_ID 0                      // unique per gateway: sent in ACKs and beacons
+#define GATEWAY_BEACON_INTERVAL_MS 1000   // GatewayBeacon broadcast (node discovery and ranking)
 #define LED_BUILTIN GPIO_NUM_2  // ESP32 DevKit V1 uses GPIO2 for LED
 #define HEARTBEAT_INTERVAL_MS 2000
 #define MAX_PAYLOAD_SIZE 256
@@ -57,15 +69,57 @@
 // HTTP endpoint for SensorPacket ingest (ajuste para o IP/porta do backend PHP)
 #define INGEST_URL "http://192.168.0.117:8080/ingest_sensorpacket.php"
 
+// HTTP queue (packet_proc -> http_worker): room for a full sensor batch frame
+// (up to SENSOR_BATCH_MAX_SAMPLES records at once) plus single packets
+#define HTTP_QUEUE_LEN       (SENSOR_BATCH_MAX_SAMPLES + 8)
+
+// HTTP batching: worker drains up to HTTP_BATCH_MAX packets, or waits at most
+// HTTP_BATCH_WAIT_MS after the first one, and sends them in a single POST
+#define HTTP_BATCH_MAX       16
+#define HTTP_BATCH_WAIT_MS   250
+
+// Uplink encoding. 0 = JSON (one object or an array), 1 = binary records
+// (application/octet-stream, 31 B per packet instead of ~220). The backend
+// accepts both on the same endpoint, selected by Content-Type (see uplink_body.h).
+#define HTTP_UPLINK_BINARY   0
+
+// Persistent uplink: one keep-alive connection reused across POSTs,
+// reopened lazily with exponential backoff after an error
+#define HTTP_BACKOFF_MIN_MS  1000
+#define HTTP_BACKOFF_MAX_MS  30000
+
+// Metrics: "METRICS:" JSON line on the console every N ms, and GET /metrics
+#define METRICS_REPORT_INTERVAL_MS  60000
+
+// Console output: 0 = per-packet box + TELEMETRY line, 1 = TELEMETRY line only.
+// Either way it is formatted by a low-priority task (see dlog.h).
+#define DLOG_COMPACT 0
+
+// Log the duplicate-suppression counters every N received packets
+#define DEDUP_REPORT_EVERY   100
+
 // ============================================================================
 // TYPES
 // ============================================================================
 
 typedef struct {
     uint8_t src_addr[6];
-    SensorPacketV1 data;
+    SensorPacketV2 data;
 } espnow_packet_t;
 
+// Outcome of one uplink POST
+typedef enum {
+    HTTP_POST_OK = 0,       // 2xx: the backend stored the packets
+    HTTP_POST_RETRY,        // no connection, transport error, 5xx, 408 or 429: keep them
+    HTTP_POST_REJECTED,     // any other status: the same body will never be accepted
+} http_post_result_t;
+
+// http_queue entry: packet plus the time it was queued (proc_http latency)
+typedef struct {
+    SensorPacketV2 pkt;
+    int64_t queued_us;
+} http_item_t;
+
 // ============================================================================
 // GLOBALS
 // ============================================================================
@@ -73,32 +127,70 @@ typedef struct {
 static uint8_t gateway_mac[6];
 static int64_t last_heartbeat = 0;
 static bool led_state = false;
-static QueueHandle_t espnow_queue = NULL;
+static rx_ring_t espnow_ring;                   // espnow_recv_cb -> packet_processing_task
+static TaskHandle_t packet_task = NULL;         // woken by espnow_recv_cb
+static dedup_t rx_dedup;                        // retransmit filter (packet_processing_task only)
 static QueueHandle_t http_queue = NULL;
 static bool wifi_got_ip = false;
 static bool sntp_synced = false;
 static esp_event_handler_instance_t wifi_any_id_inst;
 static esp_event_handler_instance_t ip_got_ip_inst;
 
-// NVS Persistent Queue Configuration
+// JSON body for batched POSTs (static: too large for the worker stack)
+static char http_body[HTTP_BATCH_MAX * UPLINK_JSON_RECORD_MAX + 2];
+
+// Persistent HTTP client (only touched by http_worker_task)
+static esp_http_client_handle_t http_client = NULL;
+static uint32_t http_backoff_ms = 0;
+static int64_t http_retry_at_us = 0;
+
+// Persistent backlog: append-only ring log on the "pktlog" partition (see pkt_log.h)
+#define BACKLOG_PARTITION "pktlog"
+
+// Legacy NVS blob queue (older firmware), migrated into the packet log on boot
 #define NVS_NAMESPACE "gw_queue"
 #define NVS_KEY_HEAD  "q_head"
-#define NVS_KEY_TAIL  "q_tail"
 #define NVS_KEY_COUNT "q_count"
 #define NVS_KEY_PKT   "pkt_%02d"  // Format: pkt_00 to pkt_49
 #define NVS_QUEUE_SIZE 50
 
-static nvs_handle_t nvs_queue_handle;
-static uint8_t queue_head = 0;
-static uint8_t queue_tail = 0;
-static uint8_t queue_count = 0;
+static pkt_log_t backlog;
+
+// Backlog replay: only when the uplink is healthy and no live packet is waiting,
+// rate-limited by a token bucket so recovery after an outage does not starve live data
+#define BACKLOG_RATE_PPS      20                    // sustained replay rate (packets/s)
+#define BACKLOG_BURST         (HTTP_BATCH_MAX * 2)  // bucket depth (packets)
+#define BACKLOG_IDLE_POLL_MS  200                   // live-queue wait while backlog is pending
 
-// Métricas simples
 static struct {
-    uint32_t packets_received;
-    uint32_t packets_parsed;
-    uint32_t parse_errors;
-} gateway_metrics = {0};
+    uint32_t tokens_milli;   // 1000 = one packet
+    int64_t last_refill_us;
+} backlog_bucket = {BACKLOG_BURST * 1000, 0};
+
+static struct {
+    int64_t drain_started_us;   // first packet pushed while the backlog was empty (0 = empty)
+    uint32_t drains_completed;
+    uint32_t last_drain_ms;     // time-to-drain of the last outage
+    uint32_t max_drain_ms;
+    uint32_t packets_replayed;  // acknowledged with a 2xx and committed
+    uint32_t batches_failed;    // replay POSTs that failed (rewound, sent again later)
+    uint32_t isolate_left;      // packets of a rejected batch still to be resent one by one
+} backlog_metrics = {0};
+
+// Counters, drops and per-stage latency histograms (see metrics.h)
+static gw_metrics_t gw_metrics = {0};
+static char metrics_line[2048];         // METRICS: serial line (heartbeat_task)
+static char metrics_http_body[2048];    // GET /metrics (httpd task)
+
+// Uplink connection reuse counters, from the client's events: esp_http_client
+// reconnects on its own when the server closed the socket, so reuse of the
+// handle says nothing about reuse of the TCP connection.
+// Requests on an already-open connection = requests_sent - connections_opened.
+static struct {
+    uint32_t connections_opened;   // TCP connections (HTTP_EVENT_ON_CONNECTED)
+    uint32_t requests_sent;        // requests written (HTTP_EVENT_HEADERS_SENT)
+    uint32_t connection_errors;    // perform failures that dropped the connection
+} http_conn_stats = {0};
 
 // ============================================================================
 // UTILITIES
@@ -139,87 +231,97 @@ static uint32_t get_unix_timestamp(void) {
 }
 
 // ============================================================================
-// NVS PERSISTENT QUEUE (stores packets when backend offline)
+// PERSISTENT BACKLOG (stores packets when backend offline)
 // ============================================================================
 
-// Initialize NVS queue - load head/tail/count from flash
-static esp_err_t nvs_queue_init(void) {
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_queue_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Erro ao abrir NVS: %s", esp_err_to_name(err));
-        return err;
+// Move packets left in the old NVS blob queue into the packet log, then erase it
+static void backlog_migrate_nvs(void) {
+    nvs_handle_t h;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) {
+        return;
     }
-    
-    // Load queue state (defaults to 0 if not found)
-    nvs_get_u8(nvs_queue_handle, NVS_KEY_HEAD, &queue_head);
-    nvs_get_u8(nvs_queue_handle, NVS_KEY_TAIL, &queue_tail);
-    nvs_get_u8(nvs_queue_handle, NVS_KEY_COUNT, &queue_count);
-    
-    ESP_LOGI(TAG, "📦 Fila NVS inicializada: %u pacotes pendentes (head=%u tail=%u)",
-             queue_count, queue_head, queue_tail);
-    return ESP_OK;
-}
 
-// Push packet to NVS queue (circular buffer)
-static esp_err_t nvs_queue_push(const SensorPacketV1 *pkt) {
-    if (queue_count >= NVS_QUEUE_SIZE) {
-        ESP_LOGW(TAG, "⚠️ Fila NVS cheia! Descartando pacote mais antigo");
-        // Advance head (drop oldest packet)
-        queue_head = (queue_head + 1) % NVS_QUEUE_SIZE;
-        queue_count--;
+    uint8_t head = 0, count = 0;
+    nvs_get_u8(h, NVS_KEY_HEAD, &head);
+    nvs_get_u8(h, NVS_KEY_COUNT, &count);
+    if (count > NVS_QUEUE_SIZE) {
+        count = NVS_QUEUE_SIZE;
     }
-    
-    // Write packet to NVS
-    char key[16];
-    snprintf(key, sizeof(key), NVS_KEY_PKT, queue_tail);
-    esp_err_t err = nvs_set_blob(nvs_queue_handle, key, pkt, sizeof(SensorPacketV1));
+
+    unsigned migrated = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), NVS_KEY_PKT, (head + i) % NVS_QUEUE_SIZE);
+        // Old blobs are SensorPacketV1: the prefix of the record, no rate
+        SensorPacketV2 pkt = {0};
+        size_t size = sizeof(SensorPacketV1);
+        pkt.rate_cmpm_x10 = SENSOR_RATE_UNKNOWN;
+        if (nvs_get_blob(h, key, &pkt, &size) == ESP_OK && size == sizeof(SensorPacketV1) &&
+            pkt_log_append(&backlog, &pkt, sizeof(pkt)) == PKT_LOG_OK) {
+            migrated++;
+        }
+    }
+
+    if (count > 0) {
+        pkt_log_flush(&backlog);
+        nvs_erase_all(h);
+        nvs_commit(h);
+        ESP_LOGI(TAG, "📦 %u pacotes migrados da fila NVS antiga", migrated);
+    }
+    nvs_close(h);
+}
+
+static esp_err_t backlog_init(void) {
+    esp_err_t err = pkt_log_open_partition(&backlog, BACKLOG_PARTITION);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Erro ao salvar pacote na NVS: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "❌ Erro ao abrir partição '%s': %s", BACKLOG_PARTITION, esp_err_to_name(err));
         return err;
     }
-    
-    // Update tail and count
-    queue_tail = (queue_tail + 1) % NVS_QUEUE_SIZE;
-    queue_count++;
-    
-    // Persist queue metadata
-    nvs_set_u8(nvs_queue_handle, NVS_KEY_HEAD, queue_head);
-    nvs_set_u8(nvs_queue_handle, NVS_KEY_TAIL, queue_tail);
-    nvs_set_u8(nvs_queue_handle, NVS_KEY_COUNT, queue_count);
-    nvs_commit(nvs_queue_handle);
-    
-    ESP_LOGI(TAG, "💾 Pacote salvo na NVS [%u/%u]", queue_count, NVS_QUEUE_SIZE);
+
+    backlog_migrate_nvs();
+
+    ESP_LOGI(TAG, "📦 Backlog em flash: %" PRIu32 " pacotes pendentes (capacidade ~%" PRIu32 ")",
+             pkt_log_count(&backlog), pkt_log_capacity(&backlog, sizeof(SensorPacketV2)));
     return ESP_OK;
 }
 
-// Pop packet from NVS queue (FIFO)
-static esp_err_t nvs_queue_pop(SensorPacketV1 *pkt) {
-    if (queue_count == 0) {
-        return ESP_ERR_NOT_FOUND; // Queue empty
+// Append packets to the backlog with a single flash write
+static void backlog_push_batch(const SensorPacketV2 *pkts, size_t count) {
+    if (pkt_log_count(&backlog) == 0 && backlog_metrics.drain_started_us == 0) {
+        backlog_metrics.drain_started_us = esp_timer_get_time();
     }
-    
-    // Read packet from NVS
-    char key[16];
-    snprintf(key, sizeof(key), NVS_KEY_PKT, queue_head);
-    size_t required_size = sizeof(SensorPacketV1);
-    esp_err_t err = nvs_get_blob(nvs_queue_handle, key, pkt, &required_size);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "❌ Erro ao ler pacote da NVS: %s", esp_err_to_name(err));
-        return err;
+    int64_t start_us = esp_timer_get_time();
+    size_t saved = 0;
+    for (; saved < count; saved++) {
+        if (pkt_log_append(&backlog, &pkts[saved], sizeof(SensorPacketV2)) != PKT_LOG_OK) {
+            ESP_LOGE(TAG, "❌ Erro ao salvar pacote no backlog");
+            break;
+        }
     }
-    
-    // Update head and count
-    queue_head = (queue_head + 1) % NVS_QUEUE_SIZE;
-    queue_count--;
-    
-    // Persist queue metadata
-    nvs_set_u8(nvs_queue_handle, NVS_KEY_HEAD, queue_head);
-    nvs_set_u8(nvs_queue_handle, NVS_KEY_TAIL, queue_tail);
-    nvs_set_u8(nvs_queue_handle, NVS_KEY_COUNT, queue_count);
-    nvs_commit(nvs_queue_handle);
-    
-    ESP_LOGI(TAG, "📤 Pacote recuperado da NVS [%u restantes]", queue_count);
-    return ESP_OK;
+    gw_metrics.drops[METRICS_DROP_BACKLOG_WRITE] += count - saved;
+    if (pkt_log_flush(&backlog) != PKT_LOG_OK) {
+        ESP_LOGE(TAG, "❌ Erro ao gravar backlog na flash");
+        return;
+    }
+    metrics_hist_record(&gw_metrics.stages[METRICS_STAGE_BACKLOG_WRITE], esp_timer_get_time() - start_us);
+    ESP_LOGI(TAG, "💾 %u pacotes salvos no backlog [%" PRIu32 " pendentes]",
+             (unsigned)count, pkt_log_count(&backlog));
+}
+
+// Pop up to max packets from the backlog (uncommitted until pkt_log_commit).
+// Entries written by older firmware are SensorPacketV1 (no rate).
+static size_t backlog_pop_batch(SensorPacketV2 *pkts, size_t max) {
+    size_t count = 0;
+    size_t len = 0;
+    while (count < max && pkt_log_pop(&backlog, &pkts[count], sizeof(SensorPacketV2), &len) == PKT_LOG_OK) {
+        if (len == sizeof(SensorPacketV1)) {
+            pkts[count].rate_cmpm_x10 = SENSOR_RATE_UNKNOWN;
+            count++;
+        } else if (len == sizeof(SensorPacketV2)) {
+            count++;
+        }
+    }
+    return count;
 }
 
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
@@ -254,23 +356,29 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
     }
 }
 
-static esp_err_t http_post_packet(const SensorPacketV1 *pkt, bool is_backlog) {
-    char json[350];
-    int n = snprintf(json, sizeof(json),
-        "{\"version\":%u,\"node_id\":%u,\"mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"seq\":%u,"
-        "\"distance_cm\":%d,\"level_cm\":%d,\"percentual\":%u,\"volume_l\":%u,\"vin_mv\":%d,\"rssi\":%d,\"ts_ms\":%u,"
-        "\"flags\":%u,\"alert_type\":%u,\"is_backlog\":%s}",
-        (unsigned)pkt->version, (unsigned)pkt->node_id,
-        pkt->mac[0], pkt->mac[1], pkt->mac[2], pkt->mac[3], pkt->mac[4], pkt->mac[5],
-        (unsigned)pkt->seq,
-        (int)pkt->distance_cm, (int)pkt->level_cm, (unsigned)pkt->percentual, (unsigned)pkt->volume_l,
-        (int)pkt->vin_mv, (int)pkt->rssi, (unsigned)pkt->ts_ms,
-        (unsigned)pkt->flags, (unsigned)pkt->alert_type,
-        is_backlog ? "true" : "false");
+// Runs in http_worker_task, inside esp_http_client_perform()
+static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
+    if (evt->event_id == HTTP_EVENT_ON_CONNECTED) {
+        http_conn_stats.connections_opened++;
+    } else if (evt->event_id == HTTP_EVENT_HEADERS_SENT) {
+        http_conn_stats.requests_sent++;
+    }
+    return ESP_OK;
+}
 
-    if (n <= 0 || n >= (int)sizeof(json)) {
-        ESP_LOGW(TAG, "json truncado (%d)", n);
-        return ESP_FAIL;
+static uint32_t http_requests_reused(void) {
+    uint32_t sent = http_conn_stats.requests_sent;
+    uint32_t opened = http_conn_stats.connections_opened;
+    return sent > opened ? sent - opened : 0;
+}
+
+// Lazily open the persistent uplink client. Returns NULL while in backoff.
+static esp_http_client_handle_t http_client_acquire(void) {
+    if (http_client) {
+        return http_client;
+    }
+    if (esp_timer_get_time() < http_retry_at_us) {
+        return NULL;
     }
 
     esp_http_client_config_t cfg = {0};
@@ -278,178 +386,319 @@ static esp_err_t http_post_packet(const SensorPacketV1 *pkt, bool is_backlog) {
     cfg.method = HTTP_METHOD_POST;
     cfg.timeout_ms = 3000;
     cfg.transport_type = HTTP_TRANSPORT_OVER_TCP;
+    cfg.keep_alive_enable = true;   // TCP keep-alive probes detect a dead backend while idle
+    cfg.event_handler = http_event_handler;
 
-    esp_http_client_handle_t client = esp_http_client_init(&cfg);
-    if (!client) {
+    http_client = esp_http_client_init(&cfg);
+    if (!http_client) {
         ESP_LOGW(TAG, "http_client init falhou");
-        return ESP_FAIL;
+        return NULL;
+    }
+    esp_http_client_set_header(http_client, "Content-Type",
+                               HTTP_UPLINK_BINARY ? "application/octet-stream" : "application/json");
+
+    ESP_LOGI(TAG, "🔌 Cliente HTTP criado (conexões=%" PRIu32 " requisições reutilizadas=%" PRIu32 ")",
+             http_conn_stats.connections_opened, http_requests_reused());
+    return http_client;
+}
+
+// Tear down the client after an error and schedule the next attempt with exponential backoff
+static void http_client_drop(void) {
+    if (http_client) {
+        esp_http_client_cleanup(http_client);
+        http_client = NULL;
+    }
+    http_conn_stats.connection_errors++;
+
+    if (http_backoff_ms == 0) {
+        http_backoff_ms = HTTP_BACKOFF_MIN_MS;
+    } else if (http_backoff_ms < HTTP_BACKOFF_MAX_MS) {
+        http_backoff_ms *= 2;
+        if (http_backoff_ms > HTTP_BACKOFF_MAX_MS) {
+            http_backoff_ms = HTTP_BACKOFF_MAX_MS;
+        }
+    }
+    http_retry_at_us = esp_timer_get_time() + (int64_t)http_backoff_ms * 1000;
+    ESP_LOGW(TAG, "Conexão HTTP descartada - nova tentativa em %" PRIu32 " ms", http_backoff_ms);
+}
+
+// Statuses worth keeping the packets for: backend down or busy (5xx, 408,
+// 429) or not the ingest endpoint (1xx/3xx). Any other 4xx (400 malformed,
+// 413 too large, ...) rejects this body for good
+static bool http_status_retryable(int status) {
+    return status >= 500 || status == 408 || status == 429 || status < 400;
+}
+
+static http_post_result_t http_post_body(const char *body, int len, size_t count, bool is_backlog) {
+    esp_http_client_handle_t client = http_client_acquire();
+    if (!client) {
+        return HTTP_POST_RETRY;
     }
 
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, json, n);
+    esp_http_client_set_post_field(client, body, len);
 
+    int64_t start_us = esp_timer_get_time();
     esp_err_t err = esp_http_client_perform(client);
+    metrics_hist_record(&gw_metrics.stages[METRICS_STAGE_HTTP], esp_timer_get_time() - start_us);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "HTTP post erro: %s", esp_err_to_name(err));
-    } else {
-        int status = esp_http_client_get_status_code(client);
-        if (is_backlog) {
-            ESP_LOGI(TAG, "📤 HTTP backlog status: %d", status);
-        } else {
-            ESP_LOGI(TAG, "HTTP status: %d", status);
+        http_client_drop();
+        return HTTP_POST_RETRY;
+    }
+
+    // Only a 2xx means the backend stored the packets. A retryable status is
+    // a failed send (the caller keeps the packets) and backs off; any other
+    // answer comes from a working backend, so the connection stays up
+    int status = esp_http_client_get_status_code(client);
+    if (status < 200 || status > 299) {
+        bool retry = http_status_retryable(status);
+        ESP_LOGW(TAG, "HTTP status %d %s (%u pacotes%s)", status, retry ? "- nova tentativa" : "rejeitado",
+                 (unsigned)count, is_backlog ? ", backlog" : "");
+        if (retry) {
+            http_client_drop();
+            return HTTP_POST_RETRY;
         }
+        http_backoff_ms = 0;
+        return HTTP_POST_REJECTED;
     }
+    http_backoff_ms = 0;
 
-    esp_http_client_cleanup(client);
-    return err;
+    if (is_backlog) {
+        ESP_LOGI(TAG, "📤 HTTP backlog status: %d (%u pacotes)", status, (unsigned)count);
+    } else {
+        ESP_LOGI(TAG, "HTTP status: %d (%u pacotes)", status, (unsigned)count);
+    }
+    return HTTP_POST_OK;
+}
+
+// Send up to HTTP_BATCH_MAX packets in a single POST
+static http_post_result_t http_post_batch(const SensorPacketV2 *pkts, size_t count, bool is_backlog) {
+    if (count == 0) {
+        return HTTP_POST_OK;
+    }
+    if (count > HTTP_BATCH_MAX) {
+        count = HTTP_BATCH_MAX;
+    }
+
+    int len = HTTP_UPLINK_BINARY ? uplink_encode_binary(http_body, sizeof(http_body), pkts, count, is_backlog)
+                                 : uplink_encode_json(http_body, sizeof(http_body), pkts, count, is_backlog);
+    if (len < 0) {
+        ESP_LOGW(TAG, "corpo do POST não coube (%u pacotes)", (unsigned)count);
+        return HTTP_POST_REJECTED;
+    }
+    return http_post_body(http_body, len, count, is_backlog);
 }
 
 // ============================================================================
 // ESP-NOW CALLBACK
 // ============================================================================
 
+// Runs in the Wi-Fi task: copy the raw frame into the ring and wake the consumer.
+// No logging, no ESP-NOW calls here.
 static void espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len) {
-    if (!recv_info || !espnow_queue) {
+    if (!recv_info || len <= 0) {
         return;
     }
+    if (len == sizeof(GatewayBeacon) && data[0] == GATEWAY_BEACON_MAGIC) {
+        return;   // another gateway's beacon (for nodes)
+    }
 
-    // Validate packet size
-    if (len != sizeof(SensorPacketV1)) {
-        ESP_LOGW(TAG, "⚠ Tamanho inválido de pacote: %d (esperado %d)", len, sizeof(SensorPacketV1));
-        gateway_metrics.parse_errors++;
-        return;
+    rx_frame_t *frame = rx_ring_reserve(&espnow_ring);
+    if (!frame) {
+        return;   // ring full, counted in espnow_ring.drops
+    }
+    memcpy(frame->src_addr, recv_info->src_addr, 6);
+    frame->rssi = recv_info->rx_ctrl ? recv_info->rx_ctrl->rssi : 0;
+    frame->len = (uint8_t)(len > RX_FRAME_MAX ? RX_FRAME_MAX : len);
+    frame->rx_us = esp_timer_get_time();
+    memcpy(frame->data, data, frame->len);
+    rx_ring_publish(&espnow_ring);
+
+    if (packet_task) {
+        xTaskNotifyGive(packet_task);
     }
+}
 
-    espnow_packet_t packet = {0};
-    memcpy(packet.src_addr, recv_info->src_addr, 6);
-    memcpy(&packet.data, data, sizeof(SensorPacketV1));
+// ============================================================================
+// PACKET PROCESSING TASK
+// ============================================================================
 
-    // Enrich with gateway-side info
-    memcpy(packet.data.mac, recv_info->src_addr, 6);
-    if (recv_info->rx_ctrl) {
-        packet.data.rssi = recv_info->rx_ctrl->rssi;
-    }
-    // Use UNIX timestamp if SNTP is synced, otherwise use milliseconds since boot
-    uint32_t timestamp = get_unix_timestamp();
-    if (timestamp == 0) {
-        // Fallback to milliseconds since boot if SNTP not synced
-        timestamp = (uint32_t)(esp_timer_get_time() / 1000ULL);
+// Auto-register node as peer if not already registered (for ACK response)
+static void espnow_register_peer(const uint8_t *mac) {
+    if (esp_now_is_peer_exist(mac)) {
+        return;
     }
-    packet.data.ts_ms = timestamp;
+    esp_now_peer_info_t peer = {0};
+    memcpy(peer.peer_addr, mac, 6);
+    peer.channel = 0;  // Use current channel
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
 
-    gateway_metrics.packets_received++;
-    
-    // Auto-register node as peer if not already registered (for ACK response)
-    if (!esp_now_is_peer_exist(recv_info->src_addr)) {
-        esp_now_peer_info_t peer = {0};
-        memcpy(peer.peer_addr, recv_info->src_addr, 6);
-        peer.channel = 0;  // Use current channel
-        peer.ifidx = WIFI_IF_STA;
-        peer.encrypt = false;
-        
-        esp_err_t peer_err = esp_now_add_peer(&peer);
-        if (peer_err == ESP_OK) {
-            ESP_LOGI(TAG, "✓ Nó auto-registrado: %02X:%02X:%02X:%02X:%02X:%02X",
-                     recv_info->src_addr[0], recv_info->src_addr[1], recv_info->src_addr[2],
-                     recv_info->src_addr[3], recv_info->src_addr[4], recv_info->src_addr[5]);
-        }
+    if (esp_now_add_peer(&peer) == ESP_OK) {
+        dlog_msg(DLOG_MSG_PEER_ADDED, mac, 0, 0, 0);
     }
-    
-    // Send ACK immediately (best effort, non-blocking)
+}
+
+static void espnow_send_ack(const uint8_t *mac, const SensorPacketV2 *pkt) {
     AckPacket ack_pkt = {
         .magic = ACK_MAGIC,
         .version = ACK_VERSION,
-        .node_id = packet.data.node_id,
-        .ack_seq = packet.data.seq,
-        .rssi = packet.data.rssi,
+        .node_id = pkt->node_id,
+        .ack_seq = pkt->seq,
+        .rssi = pkt->rssi,
         .status = ACK_STATUS_OK,
-        .gateway_id = 0,  // TODO: Configure gateway ID
+        .gateway_id = GATEWAY_ID,
         .reserved = 0
     };
     
     // Send ACK without blocking (fire and forget)
-    esp_err_t ack_err = esp_now_send(recv_info->src_addr, (const uint8_t*)&ack_pkt, sizeof(ack_pkt));
-    if (ack_err == ESP_OK) {
-        ESP_LOGD(TAG, "✓ ACK enviado para seq=%u", ack_pkt.ack_seq);
+    esp_err_t ack_err = esp_now_send(mac, (const uint8_t*)&ack_pkt, sizeof(ack_pkt));
+    if (ack_err != ESP_OK) {
+        dlog_msg(DLOG_MSG_ACK_FAILED, mac, (uint32_t)ack_err, 0, 0);
+    }
+}
+
+static bool uplink_healthy(void);
+
+// Broadcast a GatewayBeacon: nodes learn this gateway from it and rank it by the
+// RSSI they hear. Uplink state and queue fill let them prefer a gateway that can
+// forward right away.
+static void espnow_send_beacon(void) {
+    static uint16_t beacon_seq = 0;
+    static const uint8_t broadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    uint32_t queued = http_queue ? uxQueueMessagesWaiting(http_queue) : 0;
+    GatewayBeacon beacon = {
+        .magic = GATEWAY_BEACON_MAGIC,
+        .version = GATEWAY_BEACON_VERSION,
+        .gateway_id = GATEWAY_ID,
+        .flags = uplink_healthy() ? GATEWAY_BEACON_FLAG_UPLINK_OK : 0,
+        .load_pct = (uint8_t)(queued * 100 / HTTP_QUEUE_LEN),
+        .reserved = 0,
+        .beacon_seq = beacon_seq++
+    };
+    esp_err_t err = esp_now_send(broadcast, (const uint8_t *)&beacon, sizeof(beacon));
+    if (err != ESP_OK) {
+        gw_metrics.beacons_failed++;
     } else {
-        ESP_LOGW(TAG, "✗ Falha ao enviar ACK: %s", esp_err_to_name(ack_err));
+        gw_metrics.beacons_sent++;
     }
-    
-    // Enqueue for processing
-    BaseType_t result = xQueueSendFromISR(espnow_queue, &packet, NULL);
-    if (result != pdTRUE) {
-        ESP_LOGW(TAG, "⚠ Queue cheia - pacote descartado");
+}
+
+// Decode a raw frame (any supported format) into normalized packets enriched
+// with gateway-side info. Returns the number of packets, 0 if the frame is rejected.
+static size_t espnow_frame_decode(const rx_frame_t *frame, espnow_packet_t *packets,
+                                  packet_decode_result_t *result) {
+    static SensorPacketV2 records[PACKET_DECODE_MAX_RECORDS];   // packet_proc task only
+    int err = packet_decode(frame->data, frame->len, records, PACKET_DECODE_MAX_RECORDS, result);
+    if (err != PACKET_DECODE_OK) {
+        dlog_msg(DLOG_MSG_FRAME_REJECTED, frame->src_addr, frame->len, frame->data[0], (uint32_t)err);
+        metrics_drop(&gw_metrics, METRICS_DROP_DECODE);
+        return 0;
     }
+
+    // Use UNIX timestamp if SNTP is synced, otherwise use milliseconds since boot
+    uint32_t unix_now = get_unix_timestamp();
+    uint32_t rx_ms = (uint32_t)(frame->rx_us / 1000ULL);
+
+    for (size_t i = 0; i < result->count; i++) {
+        memcpy(packets[i].src_addr, frame->src_addr, 6);
+        packets[i].data = records[i];
+        memcpy(packets[i].data.mac, frame->src_addr, 6);
+        packets[i].data.rssi = frame->rssi;
+
+        // The decoder left the sample's age (ms) in ts_ms; batched samples are older than the frame
+        uint32_t age_ms = records[i].ts_ms;
+        if (unix_now != 0) {
+            packets[i].data.ts_ms = unix_now - age_ms / 1000;
+        } else {
+            // Fallback to milliseconds since boot (at reception) if SNTP not synced
+            packets[i].data.ts_ms = age_ms < rx_ms ? rx_ms - age_ms : 0;
+        }
+    }
+
+    gw_metrics.packets_received += result->count;
+    gw_metrics.frames_by_format[result->format]++;
+    metrics_hist_record(&gw_metrics.stages[METRICS_STAGE_RECV_TO_PROCESS], esp_timer_get_time() - frame->rx_us);
+    return result->count;
 }
 
-// ============================================================================
-// PACKET PROCESSING TASK
-// ============================================================================
+// Log (deferred) and hand the packet to the uplink worker
+static void process_sensor_packet(const espnow_packet_t *packet, packet_format_t format) {
+    if (packet->data.version != SENSOR_PACKET_VERSION && packet->data.version != SENSOR_PACKET_V2_VERSION) {
+        metrics_drop(&gw_metrics, METRICS_DROP_BAD_VERSION);
+        dlog_msg(DLOG_MSG_BAD_VERSION, packet->src_addr, packet->data.version, 0, 0);
+        return;
+    }
+    gw_metrics.packets_parsed++;
+
+    // Box + TELEMETRY line are formatted by the low-priority dlog task
+    dlog_packet(packet->src_addr, format, &packet->data);
+
+    // Enfileira para envio HTTP em worker dedicado
+    if (http_queue) {
+        http_item_t item = {.pkt = packet->data, .queued_us = esp_timer_get_time()};
+        if (xQueueSend(http_queue, &item, 0) != pdTRUE) {
+            metrics_drop(&gw_metrics, METRICS_DROP_HTTP_QUEUE_FULL);
+            dlog_msg(DLOG_MSG_HTTP_QUEUE_FULL, packet->src_addr, packet->data.node_id, packet->data.seq, 0);
+        } else {
+            uint32_t depth = uxQueueMessagesWaiting(http_queue);
+            if (depth > gw_metrics.http_queue_high_water) {
+                gw_metrics.http_queue_high_water = depth;
+            }
+        }
+    }
+}
 
 static void packet_processing_task(void *pvParameters) {
-    espnow_packet_t packet;
-    
+    uint32_t drops_reported = 0;
+    uint32_t dedup_lookups_reported = 0;
+
+    dedup_init(&rx_dedup);
+
     while (1) {
-        if (xQueueReceive(espnow_queue, &packet, pdMS_TO_TICKS(1000))) {
-            char src_mac_str[18];
-            mac_to_string(packet.src_addr, src_mac_str);
-
-            // Parse packet
-            ESP_LOGI(TAG, "");
-            ESP_LOGI(TAG, "╔════════════════════════════════════════════════════╗");
-            ESP_LOGI(TAG, "║ ✓ ESP-NOW recebido de: %s", src_mac_str);
-            ESP_LOGI(TAG, "╠════════════════════════════════════════════════════╣");
-            
-            // Validate packet version
-            if (packet.data.version == SENSOR_PACKET_VERSION) {
-                gateway_metrics.packets_parsed++;
-                
-                // Check for anomaly alerts
-                bool is_alert = (packet.data.flags & FLAG_IS_ALERT) != 0;
-                const char* alert_names[] = {"NONE", "RAPID_DROP", "RAPID_RISE", "SENSOR_STUCK"};
-                
-                if (is_alert) {
-                    ESP_LOGW(TAG, "╔════════════════════════════════════════════════════╗");
-                    ESP_LOGW(TAG, "║          🚨 ALERTA DE ANOMALIA DETECTADO 🚨       ║");
-                    ESP_LOGW(TAG, "╠════════════════════════════════════════════════════╣");
-                    ESP_LOGW(TAG, "║ Tipo: %s", alert_names[packet.data.alert_type]);
-                    ESP_LOGW(TAG, "║ Nó ID: %u | Sequência: %u", packet.data.node_id, packet.data.seq);
-                    ESP_LOGW(TAG, "╚════════════════════════════════════════════════════╝");
-                }
-                
-                // Parse sensor data
-                ESP_LOGI(TAG, "║ Versão: %u", packet.data.version);
-                ESP_LOGI(TAG, "║ Nó ID: %u", packet.data.node_id);
-                ESP_LOGI(TAG, "║ Distância: %d cm", packet.data.distance_cm);
-                ESP_LOGI(TAG, "║ Nível: %d cm", packet.data.level_cm);
-                ESP_LOGI(TAG, "║ Percentual: %u%%", packet.data.percentual);
-                ESP_LOGI(TAG, "║ Volume: %lu L", packet.data.volume_l);
-                ESP_LOGI(TAG, "║ Tensão: %d mV", packet.data.vin_mv);
-                ESP_LOGI(TAG, "║ RSSI: %d dBm", packet.data.rssi);
-                ESP_LOGI(TAG, "║ Sequência: %u", packet.data.seq);
-                if (is_alert) {
-                    ESP_LOGI(TAG, "║ 🚨 Alerta: %s", alert_names[packet.data.alert_type]);
-                }
-                
-                // Output JSON to Serial for external processing
-                printf("TELEMETRY:{\"mac\":\"%s\",\"distance\":%d,\"level\":%d,\"volume\":%" PRIu32 ",\"voltage\":%d,\"seq\":%" PRIu32 ",\"alert\":%u}\n",
-                       src_mac_str, packet.data.distance_cm, packet.data.level_cm, packet.data.volume_l, 
-                       packet.data.vin_mv, packet.data.seq, packet.data.alert_type);
-                fflush(stdout);
-
-                // Enfileira para envio HTTP em worker dedicado
-                if (http_queue) {
-                    SensorPacketV1 copy = packet.data;
-                    if (xQueueSend(http_queue, &copy, 0) != pdTRUE) {
-                        ESP_LOGW(TAG, "Fila HTTP cheia - descartando envio");
-                    }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+
+        const rx_frame_t *frame;
+        while ((frame = rx_ring_peek(&espnow_ring)) != NULL) {
+            static espnow_packet_t packets[PACKET_DECODE_MAX_RECORDS];
+            packet_decode_result_t decoded;
+            size_t count = espnow_frame_decode(frame, packets, &decoded);
+            rx_ring_release(&espnow_ring);
+            if (count == 0) {
+                continue;
+            }
+
+            // One ACK per frame, for its last record
+            espnow_register_peer(packets[0].src_addr);
+            espnow_send_ack(packets[0].src_addr, &packets[count - 1].data);
+
+            for (size_t i = 0; i < count; i++) {
+                // Retransmit whose ACK was lost: re-ACKed above, not forwarded again.
+                // Formats without a sequence number cannot be deduplicated.
+                if (decoded.has_seq &&
+                    dedup_check(&rx_dedup, packets[i].src_addr, packets[i].data.node_id, packets[i].data.seq)) {
+                    metrics_drop(&gw_metrics, METRICS_DROP_DUPLICATE);
+                    dlog_msg(DLOG_MSG_DUPLICATE, packets[i].src_addr,
+                             packets[i].data.node_id, packets[i].data.seq, 0);
+                    continue;
                 }
-            } else {
-                gateway_metrics.parse_errors++;
-                ESP_LOGW(TAG, "║ ✗ Versão inválida: %u (esperado %u)", packet.data.version, SENSOR_PACKET_VERSION);
+                process_sensor_packet(&packets[i], decoded.format);
             }
-            
-            ESP_LOGI(TAG, "╚════════════════════════════════════════════════════╝");
+        }
+
+        if (rx_dedup.stats.lookups - dedup_lookups_reported >= DEDUP_REPORT_EVERY) {
+            dedup_lookups_reported = rx_dedup.stats.lookups;
+            ESP_LOGI(TAG, "↺ Dedup: %" PRIu32 " pacotes, %" PRIu32 " duplicados (%" PRIu32 "%%), fora de ordem=%" PRIu32 " resets=%" PRIu32 " evicções=%" PRIu32,
+                     rx_dedup.stats.lookups, rx_dedup.stats.duplicates,
+                     rx_dedup.stats.duplicates * 100 / rx_dedup.stats.lookups,
+                     rx_dedup.stats.out_of_order, rx_dedup.stats.resets, rx_dedup.stats.evictions);
+        }
+
+        uint32_t drops = rx_ring_drops(&espnow_ring);
+        if (drops != drops_reported) {
+            ESP_LOGW(TAG, "⚠ Ring RX cheio - %" PRIu32 " pacotes descartados (pico %" PRIu32 "/%u slots)",
+                     drops - drops_reported, rx_ring_high_water(&espnow_ring), RX_RING_SLOTS);
+            drops_reported = drops;
         }
     }
 }
@@ -532,6 +781,7 @@ static void espnow_init(void) {
 
     ESP_ERROR_CHECK(esp_now_add_peer(&peer));
     ESP_LOGI(TAG, "✓ Peer broadcast adicionado (canal segue WiFi)");
+    ESP_LOGI(TAG, "📡 Beacon a cada %d ms (gateway_id=%d)", GATEWAY_BEACON_INTERVAL_MS, GATEWAY_ID);
 }
 
 // ============================================================================
@@ -562,12 +812,82 @@ static void gpio_init(void) {
     ESP_LOGI(TAG, "✓ GPIO inicializado (LED=%d)", LED_BUILTIN);
 }
 
+// ============================================================================
+// METRICS
+// ============================================================================
+
+// Copy gauges owned by other modules into gw_metrics before a report
+static void metrics_refresh(void) {
+    gw_metrics.uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    gw_metrics.drops[METRICS_DROP_RX_RING_FULL] = rx_ring_drops(&espnow_ring);
+    gw_metrics.drops[METRICS_DROP_BACKLOG_WRAP] = backlog.stats.records_dropped;
+    gw_metrics.rx_ring_high_water = rx_ring_high_water(&espnow_ring);
+    gw_metrics.backlog_pending = pkt_log_count(&backlog);
+    gw_metrics.heap_free = esp_get_free_heap_size();
+    gw_metrics.heap_min_free = esp_get_minimum_free_heap_size();
+    gw_metrics.heap_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    gw_metrics.http_connections = http_conn_stats.connections_opened;
+    gw_metrics.http_reused = http_requests_reused();
+    gw_metrics.http_errors = http_conn_stats.connection_errors;
+}
+
+static void metrics_print_line(void) {
+    metrics_refresh();
+    if (metrics_format_json(&gw_metrics, metrics_line, sizeof(metrics_line)) > 0) {
+        printf("METRICS:%s\n", metrics_line);
+        fflush(stdout);
+    }
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t *req) {
+    metrics_refresh();
+    int len = metrics_format_json(&gw_metrics, metrics_http_body, sizeof(metrics_http_body));
+    if (len < 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, metrics_http_body, len);
+}
+
+// GET /metrics on port 80 (same JSON as the METRICS: line)
+static void metrics_server_start(void) {
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    httpd_handle_t server = NULL;
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGW(TAG, "Falha ao iniciar servidor de métricas");
+        return;
+    }
+    httpd_uri_t uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_register_uri_handler(server, &uri);
+    ESP_LOGI(TAG, "✓ Métricas em http://<ip-do-gateway>/metrics");
+}
+
 // ============================================================================
 // HEARTBEAT TASK
 // ============================================================================
 
 static void heartbeat_task(void *pvParameters) {
+    int64_t last_metrics_us = esp_timer_get_time();
+    int64_t last_beacon_us = 0;
+
     while (1) {
+        if (esp_timer_get_time() - last_beacon_us >= (int64_t)GATEWAY_BEACON_INTERVAL_MS * 1000) {
+            last_beacon_us = esp_timer_get_time();
+            espnow_send_beacon();
+        }
+
+
+        if (esp_timer_get_time() - last_metrics_us >= (int64_t)METRICS_REPORT_INTERVAL_MS * 1000) {
+            last_metrics_us = esp_timer_get_time();
+            metrics_print_line();
+        }
+
         // LED heartbeat (blink every 2 seconds)
         if (esp_timer_get_time() - last_heartbeat >= HEARTBEAT_INTERVAL_MS * 1000) {
             last_heartbeat = esp_timer_get_time();
@@ -583,47 +903,164 @@ static void heartbeat_task(void *pvParameters) {
 // HTTP WORKER TASK
 // ============================================================================
 
-static void http_worker_task(void *pvParameters) {
-    SensorPacketV1 pkt;
-    
-    // First, try to send any backlog from previous boot
-    while (queue_count > 0) {
-        if (!wifi_got_ip) {
-            ESP_LOGW(TAG, "⏳ Aguardando IP para enviar backlog...");
-            vTaskDelay(pdMS_TO_TICKS(5000));
-            continue;
+// Collect a batch from http_queue: block up to first_wait for the first packet,
+// then keep draining until HTTP_BATCH_MAX packets or HTTP_BATCH_WAIT_MS elapsed.
+static size_t http_collect_batch(SensorPacketV2 *batch, int64_t *queued_us, TickType_t first_wait) {
+    http_item_t item;
+    if (xQueueReceive(http_queue, &item, first_wait) != pdTRUE) {
+        return 0;
+    }
+    batch[0] = item.pkt;
+    queued_us[0] = item.queued_us;
+
+    size_t count = 1;
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(HTTP_BATCH_WAIT_MS);
+    while (count < HTTP_BATCH_MAX) {
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(deadline - now) <= 0) {
+            break;
         }
-        
-        if (nvs_queue_pop(&pkt) == ESP_OK) {
-            esp_err_t err = http_post_packet(&pkt, true);
-            if (err != ESP_OK) {
-                // Backend still offline, push back and wait
-                nvs_queue_push(&pkt);
-                ESP_LOGW(TAG, "⚠️ Backend offline - aguardando reconexão");
-                vTaskDelay(pdMS_TO_TICKS(10000));
-            } else {
-                ESP_LOGI(TAG, "✓ Pacote do backlog enviado com sucesso");
-            }
+        if (xQueueReceive(http_queue, &item, deadline - now) != pdTRUE) {
+            break;
         }
+        batch[count] = item.pkt;
+        queued_us[count] = item.queued_us;
+        count++;
+    }
+    return count;
+}
+
+static bool uplink_healthy(void) {
+    return wifi_got_ip && esp_timer_get_time() >= http_retry_at_us;
+}
+
+// Refill the backlog token bucket and return how many whole packets may be sent now
+static size_t backlog_tokens(void) {
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_us = now - backlog_bucket.last_refill_us;
+    backlog_bucket.last_refill_us = now;
+
+    uint64_t tokens = backlog_bucket.tokens_milli + ((uint64_t)elapsed_us * BACKLOG_RATE_PPS) / 1000;
+    if (tokens > BACKLOG_BURST * 1000) {
+        tokens = BACKLOG_BURST * 1000;
+    }
+    backlog_bucket.tokens_milli = (uint32_t)tokens;
+    return backlog_bucket.tokens_milli / 1000;
+}
+
+// Send one rate-limited batch from the backlog, if the uplink allows it
+static void backlog_drain_step(SensorPacketV2 *batch) {
+    if (pkt_log_available(&backlog) == 0 || !uplink_healthy()) {
+        return;
+    }
+
+    size_t allowed = backlog_tokens();
+    if (allowed == 0) {
+        return;
+    }
+    if (allowed > HTTP_BATCH_MAX) {
+        allowed = HTTP_BATCH_MAX;
+    }
+    if (backlog_metrics.isolate_left > 0) {
+        allowed = 1;
+    }
+
+    size_t count = backlog_pop_batch(batch, allowed);
+    if (count == 0) {
+        pkt_log_commit(&backlog);   // only unreadable records left
+        return;
+    }
+    backlog_bucket.tokens_milli -= count * 1000;
+
+    http_post_result_t res = http_post_batch(batch, count, true);
+    if (res == HTTP_POST_RETRY) {
+        // http_post_body() already dropped the connection and armed the
+        // backoff. The packets stay in the log and are popped again once the
+        // uplink is back.
+        pkt_log_rewind(&backlog);
+        backlog_metrics.batches_failed++;
+        return;
+    }
+    if (res == HTTP_POST_REJECTED && count > 1) {
+        // The backend refuses the whole batch for one bad record: resend
+        // these packets one per POST so only the bad ones are dropped
+        pkt_log_rewind(&backlog);
+        backlog_metrics.batches_failed++;
+        backlog_metrics.isolate_left = count;
+        ESP_LOGW(TAG, "⚠️ Lote do backlog recusado - reenviando %u pacotes um a um", (unsigned)count);
+        return;
+    }
+    if (backlog_metrics.isolate_left > 0) {
+        backlog_metrics.isolate_left--;
+    }
+
+    // 2xx, or a single packet the backend will never accept: move the cursor past it
+    if (pkt_log_commit(&backlog) != PKT_LOG_OK) {
+        ESP_LOGE(TAG, "❌ Erro ao gravar cursor do backlog");
+    }
+    if (res == HTTP_POST_REJECTED) {
+        ESP_LOGW(TAG, "⚠️ Pacote do backlog recusado e descartado (nó %u seq %" PRIu32 ")",
+                 (unsigned)batch[0].node_id, (uint32_t)batch[0].seq);
+        gw_metrics.drops[METRICS_DROP_BACKLOG_REJECTED]++;
+    } else {
+        backlog_metrics.packets_replayed += count;
+    }
+
+    if (pkt_log_count(&backlog) == 0 && backlog_metrics.drain_started_us != 0) {
+        uint32_t drain_ms = (uint32_t)((esp_timer_get_time() - backlog_metrics.drain_started_us) / 1000);
+        backlog_metrics.drain_started_us = 0;
+        backlog_metrics.drains_completed++;
+        backlog_metrics.last_drain_ms = drain_ms;
+        if (drain_ms > backlog_metrics.max_drain_ms) {
+            backlog_metrics.max_drain_ms = drain_ms;
+        }
+        ESP_LOGI(TAG, "⏱️ Backlog drenado em %" PRIu32 " ms (máx %" PRIu32 " ms, %" PRIu32 " pacotes reenviados, %" PRIu32 " lotes com falha)",
+                 drain_ms, backlog_metrics.max_drain_ms, backlog_metrics.packets_replayed,
+                 backlog_metrics.batches_failed);
+    }
+}
+
+// Scheduler: live telemetry always goes first. The backlog (previous boot or
+// any failure since) is replayed in batches whenever the live queue is empty.
+static void http_worker_task(void *pvParameters) {
+    static SensorPacketV2 live_batch[HTTP_BATCH_MAX];
+    static int64_t live_queued_us[HTTP_BATCH_MAX];
+    static SensorPacketV2 backlog_batch[HTTP_BATCH_MAX];
+
+    backlog_bucket.last_refill_us = esp_timer_get_time();
+    if (pkt_log_count(&backlog) > 0) {
+        backlog_metrics.drain_started_us = esp_timer_get_time();
     }
     
-    ESP_LOGI(TAG, "✓ Backlog NVS vazio - processando telemetria em tempo real");
-    
-    // Now process real-time telemetry
     while (1) {
-        if (xQueueReceive(http_queue, &pkt, portMAX_DELAY)) {
-            if (!wifi_got_ip) {
-                ESP_LOGW(TAG, "⚠️ Sem IP - salvando na NVS");
-                nvs_queue_push(&pkt);
-                continue;
+        TickType_t wait = pkt_log_available(&backlog) > 0 ? pdMS_TO_TICKS(BACKLOG_IDLE_POLL_MS) : portMAX_DELAY;
+        size_t count = http_collect_batch(live_batch, live_queued_us, wait);
+
+        if (count > 0) {
+            int64_t now = esp_timer_get_time();
+            for (size_t i = 0; i < count; i++) {
+                metrics_hist_record(&gw_metrics.stages[METRICS_STAGE_PROCESS_TO_HTTP], now - live_queued_us[i]);
             }
-            
-            esp_err_t err = http_post_packet(&pkt, false);
-            if (err != ESP_OK) {
-                ESP_LOGW(TAG, "⚠️ HTTP falhou - salvando na NVS");
-                nvs_queue_push(&pkt);
+
+            if (!wifi_got_ip) {
+                ESP_LOGW(TAG, "⚠️ Sem IP - salvando %u pacotes no backlog", (unsigned)count);
+                backlog_push_batch(live_batch, count);
+            } else {
+                http_post_result_t res = http_post_batch(live_batch, count, false);
+                if (res == HTTP_POST_RETRY) {
+                    ESP_LOGW(TAG, "⚠️ HTTP falhou - salvando %u pacotes no backlog", (unsigned)count);
+                    backlog_push_batch(live_batch, count);
+                } else if (res == HTTP_POST_REJECTED) {
+                    // Replaying a body the backend refused would only block the backlog
+                    ESP_LOGW(TAG, "⚠️ Lote recusado pelo backend - %u pacotes descartados", (unsigned)count);
+                    gw_metrics.drops[METRICS_DROP_HTTP_REJECTED] += count;
+                }
             }
         }
+
+        if (uxQueueMessagesWaiting(http_queue) == 0) {
+            backlog_drain_step(backlog_batch);
+        }
     }
 }
 
@@ -650,27 +1087,22 @@ void app_main(void) {
     ESP_ERROR_CHECK(nvs_err);
     ESP_LOGI(TAG, "✓ NVS Flash inicializada");
     
-    // Initialize persistent queue
-    if (nvs_queue_init() != ESP_OK) {
+    // Initialize persistent backlog
+    if (backlog_init() != ESP_OK) {
         ESP_LOGE(TAG, "❌ Falha ao inicializar fila persistente");
         return;
     }
 
-    // Create packet queue
-    espnow_queue = xQueueCreate(20, sizeof(espnow_packet_t));
-    if (!espnow_queue) {
-        ESP_LOGE(TAG, "Falha ao criar fila ESP-NOW");
-        return;
-    }
-    ESP_LOGI(TAG, "✓ Fila ESP-NOW criada (20 slots)");
-
     // Create HTTP queue
-    http_queue = xQueueCreate(20, sizeof(SensorPacketV1));
+    http_queue = xQueueCreate(HTTP_QUEUE_LEN, sizeof(http_item_t));
     if (!http_queue) {
         ESP_LOGE(TAG, "Falha ao criar fila HTTP");
         return;
     }
-    ESP_LOGI(TAG, "✓ Fila HTTP criada (20 slots)");
+    ESP_LOGI(TAG, "✓ Fila HTTP criada (%d slots)", HTTP_QUEUE_LEN);
+
+    // Deferred console log (before any task that logs packets)
+    dlog_init(DLOG_COMPACT);
 
     // Initialize GPIO
     gpio_init();
@@ -689,11 +1121,15 @@ void app_main(void) {
     ESP_LOGI(TAG, "  - Aguardando dados dos sensores...");
     ESP_LOGI(TAG, "");
 
-    // Create heartbeat task
-    xTaskCreate(heartbeat_task, "heartbeat", 2048, NULL, 5, NULL);
+    // Metrics endpoint
+    metrics_server_start();
+
+    // Create heartbeat task (also prints the periodic METRICS: line and sends the beacons)
+    xTaskCreate(heartbeat_task, "heartbeat", 4096, NULL, 5, NULL);
 
-    // Create packet processing task
-    xTaskCreate(packet_processing_task, "packet_proc", 4096, NULL, 5, NULL);
+    // Create packet processing task (consumer of espnow_ring)
+    xTaskCreate(packet_processing_task, "packet_proc", 4096, NULL, 5, &packet_task);
+    ESP_LOGI(TAG, "✓ Ring RX ESP-NOW (%u slots)", RX_RING_SLOTS);
 
     // Create HTTP worker task
     xTaskCreate(http_worker_task, "http_worker", 4096, NULL, 4, NULL);
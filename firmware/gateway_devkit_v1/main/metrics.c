@@ -0,0 +1,111 @@
+/**
+ * AGUADA - Gateway metrics (see metrics.h)
+ */
+
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+// Bucket i holds samples < hist_bounds_us[i]; the last bucket everything above
+static const uint32_t hist_bounds_us[METRICS_HIST_BUCKETS - 1] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+};
+
+static const char *const stage_names[METRICS_STAGE_COUNT] = {
+    "recv_proc", "proc_http", "http", "backlog_wr"
+};
+
+static const char *const drop_names[METRICS_DROP_COUNT] = {
+    "rx_ring", "decode", "version", "dup", "http_q", "backlog_wr", "backlog_wrap",
+    "http_rej", "backlog_rej"
+};
+
+void metrics_hist_record(metrics_hist_t *h, int64_t us) {
+    uint32_t v = us < 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    size_t i = 0;
+    while (i < METRICS_HIST_BUCKETS - 1 && v >= hist_bounds_us[i]) {
+        i++;
+    }
+    h->buckets[i]++;
+    h->count++;
+    h->sum_us += v;
+    if (v > h->max_us) {
+        h->max_us = v;
+    }
+}
+
+uint32_t metrics_hist_quantile_us(const metrics_hist_t *h, uint32_t permille) {
+    if (h->count == 0) {
+        return 0;
+    }
+    uint64_t target = ((uint64_t)h->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < METRICS_HIST_BUCKETS - 1; i++) {
+        seen += h->buckets[i];
+        if (seen >= target) {
+            return hist_bounds_us[i] < h->max_us ? hist_bounds_us[i] : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+// Append to buf, tracking the length; *used goes past cap on overflow
+static void append(char *buf, size_t cap, size_t *used, const char *fmt, ...) {
+    if (*used >= cap) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(&buf[*used], cap - *used, fmt, ap);
+    va_end(ap);
+    *used += (n < 0) ? cap : (size_t)n;
+}
+
+int metrics_format_json(const gw_metrics_t *m, char *buf, size_t cap) {
+    size_t used = 0;
+
+    append(buf, cap, &used, "{\"up\":%" PRIu32 ",\"rx\":%" PRIu32 ",\"parsed\":%" PRIu32 ",\"fmt\":{",
+           m->uptime_s, m->packets_received, m->packets_parsed);
+    for (int f = 0; f < PACKET_FORMAT_COUNT; f++) {
+        append(buf, cap, &used, "%s\"%s\":%" PRIu32, f ? "," : "",
+               packet_format_name((packet_format_t)f), m->frames_by_format[f]);
+    }
+
+    append(buf, cap, &used, "},\"drop\":{");
+    for (int d = 0; d < METRICS_DROP_COUNT; d++) {
+        append(buf, cap, &used, "%s\"%s\":%" PRIu32, d ? "," : "", drop_names[d], m->drops[d]);
+    }
+
+    append(buf, cap, &used,
+           "},\"hw\":{\"rx_ring\":%" PRIu32 ",\"http_q\":%" PRIu32 "},\"backlog\":%" PRIu32
+           ",\"heap\":{\"free\":%" PRIu32 ",\"min\":%" PRIu32 ",\"largest\":%" PRIu32 "}"
+           ",\"conn\":{\"open\":%" PRIu32 ",\"reused\":%" PRIu32 ",\"err\":%" PRIu32 "}"
+           ",\"beacon\":{\"sent\":%" PRIu32 ",\"err\":%" PRIu32 "},\"lat\":{",
+           m->rx_ring_high_water, m->http_queue_high_water, m->backlog_pending,
+           m->heap_free, m->heap_min_free, m->heap_largest_block,
+           m->http_connections, m->http_reused, m->http_errors,
+           m->beacons_sent, m->beacons_failed);
+
+    for (int s = 0; s < METRICS_STAGE_COUNT; s++) {
+        const metrics_hist_t *h = &m->stages[s];
+        uint32_t avg = h->count ? (uint32_t)(h->sum_us / h->count) : 0;
+        append(buf, cap, &used,
+               "%s\"%s\":{\"n\":%" PRIu32 ",\"avg\":%" PRIu32 ",\"p50\":%" PRIu32 ",\"p99\":%" PRIu32 ",\"max\":%" PRIu32 ",\"b\":[",
+               s ? "," : "", stage_names[s], h->count, avg,
+               metrics_hist_quantile_us(h, 500), metrics_hist_quantile_us(h, 990), h->max_us);
+        for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+            append(buf, cap, &used, "%s%" PRIu32, b ? "," : "", h->buckets[b]);
+        }
+        append(buf, cap, &used, "]}");
+    }
+
+    append(buf, cap, &used, "},\"bounds_us\":[");
+    for (int b = 0; b < METRICS_HIST_BUCKETS - 1; b++) {
+        append(buf, cap, &used, "%s%" PRIu32, b ? "," : "", hist_bounds_us[b]);
+    }
+    append(buf, cap, &used, "]}");
+
+    return used < cap ? (int)used : -1;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+/**
+ * AGUADA - Gateway metrics (per-stage latency histograms, drops, watermarks)
+ *
+ * Latency histograms use fixed buckets (1-2.5-5 series, 100 us .. 1 s, plus
+ * an overflow bucket), so recording is a short scan and no allocation.
+ * Stages:
+ *   recv_proc   ESP-NOW reception (Wi-Fi task) -> decoded by packet_processing_task
+ *   proc_http   queued for the uplink -> HTTP request started
+ *   http        duration of one HTTP POST (whole batch)
+ *   backlog_wr  append + flush of one batch to the flash backlog
+ *
+ * Counters are written by a single task each; gauges (watermarks, heap,
+ * connection stats) are copied in by the gateway right before a report.
+ * metrics_format_json() renders everything as one compact JSON object, used
+ * both for the "METRICS:" serial line and for GET /metrics.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "packet_decode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRICS_HIST_BUCKETS 14   // 13 bounds + overflow
+
+typedef struct {
+    uint32_t buckets[METRICS_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+} metrics_hist_t;
+
+typedef enum {
+    METRICS_STAGE_RECV_TO_PROCESS = 0,
+    METRICS_STAGE_PROCESS_TO_HTTP,
+    METRICS_STAGE_HTTP,
+    METRICS_STAGE_BACKLOG_WRITE,
+    METRICS_STAGE_COUNT
+} metrics_stage_t;
+
+typedef enum {
+    METRICS_DROP_RX_RING_FULL = 0,  // ESP-NOW frame lost before processing
+    METRICS_DROP_DECODE,            // unknown/malformed frame
+    METRICS_DROP_BAD_VERSION,       // decoded, but not a SensorPacketV1/V2 record
+    METRICS_DROP_DUPLICATE,         // retransmit filtered by dedup
+    METRICS_DROP_HTTP_QUEUE_FULL,   // uplink queue full
+    METRICS_DROP_BACKLOG_WRITE,     // flash backlog write failed
+    METRICS_DROP_BACKLOG_WRAP,      // oldest backlog records overwritten
+    METRICS_DROP_HTTP_REJECTED,     // live batch refused by the backend (4xx)
+    METRICS_DROP_BACKLOG_REJECTED,  // backlog packet refused by the backend (4xx)
+    METRICS_DROP_COUNT
+} metrics_drop_t;
+
+typedef struct {
+    // Counters
+    uint32_t packets_received;
+    uint32_t packets_parsed;
+    uint32_t frames_by_format[PACKET_FORMAT_COUNT];
+    uint32_t drops[METRICS_DROP_COUNT];
+    uint32_t beacons_sent;          // GatewayBeacon broadcasts
+    uint32_t beacons_failed;        // esp_now_send refused the beacon
+    metrics_hist_t stages[METRICS_STAGE_COUNT];
+
+    // Gauges (refreshed before each report)
+    uint32_t uptime_s;
+    uint32_t rx_ring_high_water;
+    uint32_t http_queue_high_water;
+    uint32_t backlog_pending;
+    uint32_t heap_free;
+    uint32_t heap_min_free;
+    uint32_t heap_largest_block;
+    uint32_t http_connections;
+    uint32_t http_reused;
+    uint32_t http_errors;
+} gw_metrics_t;
+
+void metrics_hist_record(metrics_hist_t *h, int64_t us);
+
+// Upper bound (us) of the bucket holding the given quantile (permille, 0..1000)
+uint32_t metrics_hist_quantile_us(const metrics_hist_t *h, uint32_t permille);
+
+static inline void metrics_drop(gw_metrics_t *m, metrics_drop_t reason) {
+    m->drops[reason]++;
+}
+
+// Compact JSON object. Returns the length, or -1 if it does not fit.
+int metrics_format_json(const gw_metrics_t *m, char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
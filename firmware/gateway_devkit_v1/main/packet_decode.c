@@ -0,0 +1,312 @@
+/**
+ * AGUADA - ESP-NOW frame dispatcher (see packet_decode.h)
+ */
+
+#include "packet_decode.h"
+
+#include <string.h>
+#include <math.h>
+
+typedef int (*packet_decoder_fn)(const uint8_t *frame, size_t len, SensorPacketV2 *out, size_t max_out);
+
+typedef struct {
+    uint8_t magic;          // first byte of the frame
+    bool check_version;     // false when the first byte already is the version (V1)
+    uint8_t version;        // second byte
+    packet_format_t format;
+    bool has_seq;
+    const char *name;
+    packet_decoder_fn decode;
+} packet_decoder_t;
+
+static void record_init(SensorPacketV2 *rec, uint8_t node_id) {
+    memset(rec, 0, sizeof(*rec));
+    rec->version = SENSOR_PACKET_VERSION;
+    rec->node_id = node_id;
+    rec->rate_cmpm_x10 = SENSOR_RATE_UNKNOWN;
+}
+
+// ============================================================================
+// SensorPacketV1
+// ============================================================================
+
+// One record, or several back to back (store-and-forward resend). v1 is a
+// prefix of v2: each record is copied as-is and only the rate is added.
+static int decode_fixed(const uint8_t *frame, size_t len, SensorPacketV2 *out, size_t max_out,
+                        size_t rec_size, size_t max_per_frame) {
+    size_t count = len / rec_size;
+    if (count == 0 || len % rec_size != 0 || count > max_per_frame) {
+        return PACKET_DECODE_ERR_LEN;
+    }
+    if (count > max_out) {
+        return PACKET_DECODE_ERR_MALFORMED;
+    }
+    for (size_t i = 0; i < count; i++) {
+        memset(&out[i], 0, sizeof(out[i]));
+        memcpy(&out[i], frame + i * rec_size, rec_size);
+        // A lone record keeps reaching process_sensor_packet's version check
+        if (count > 1 && out[i].version != frame[0]) {
+            return PACKET_DECODE_ERR_MALFORMED;
+        }
+    }
+    return (int)count;
+}
+
+static int decode_v1(const uint8_t *frame, size_t len, SensorPacketV2 *out, size_t max_out) {
+    int n = decode_fixed(frame, len, out, max_out, sizeof(SensorPacketV1), SENSOR_PACKET_V1_MAX_PER_FRAME);
+    for (int i = 0; i < n; i++) {
+        out[i].rate_cmpm_x10 = SENSOR_RATE_UNKNOWN;
+    }
+    return n;
+}
+
+// ============================================================================
+// SensorPacketV2 (v1 + filtered level rate)
+// ============================================================================
+
+static int decode_v2(const uint8_t *frame, size_t len, SensorPacketV2 *out, size_t max_out) {
+    return decode_fixed(frame, len, out, max_out, sizeof(SensorPacketV2), SENSOR_PACKET_MAX_PER_FRAME);
+}
+
+// ============================================================================
+// aguadaUltrasonic01Packet (distance only)
+// ============================================================================
+
+static int decode_ultra01(const uint8_t *frame, size_t len, SensorPacketV2 *out, size_t max_out) {
+    (void)max_out;
+    if (len != sizeof(aguadaUltrasonic01Packet)) {
+        return PACKET_DECODE_ERR_LEN;
+    }
+    aguadaUltrasonic01Packet pkt;
+    memcpy(&pkt, frame, sizeof(pkt));
+
+    record_init(&out[0], pkt.node_id);
+    out[0].distance_cm = pkt.distance_cm;
+    out[0].flags = FLAG_DISTANCE_ONLY;
+    if (pkt.flags & ULTRA01_FLAG_LOW_BATTERY) {
+        out[0].flags |= FLAG_LOW_BATTERY;
+    }
+    if (pkt.flags & ULTRA01_FLAG_SENSOR_ERROR) {
+        out[0].flags |= FLAG_SENSOR_ERROR;
+    }
+    return 1;
+}
+
+// ============================================================================
+// GenericPacketHeader + key/value pairs
+// ============================================================================
+
+typedef enum {
+    FIELD_DISTANCE,
+    FIELD_LEVEL,
+    FIELD_PERCENTUAL,
+    FIELD_VOLUME,
+    FIELD_VIN,
+    FIELD_NONE
+} generic_field_t;
+
+// Labels understood by the gateway; anything else is ignored
+static const struct {
+    const char *label;
+    generic_field_t field;
+} generic_labels[] = {
+    {"dist", FIELD_DISTANCE}, {"distance_cm", FIELD_DISTANCE},
+    {"level", FIELD_LEVEL}, {"lvl", FIELD_LEVEL}, {"level_cm", FIELD_LEVEL},
+    {"pct", FIELD_PERCENTUAL}, {"percentual", FIELD_PERCENTUAL},
+    {"vol", FIELD_VOLUME}, {"volume_l", FIELD_VOLUME},
+    {"bat_mv", FIELD_VIN}, {"bat", FIELD_VIN}, {"vin_mv", FIELD_VIN},
+};
+
+static generic_field_t generic_field(const uint8_t *label, uint8_t label_len) {
+    for (size_t i = 0; i < sizeof(generic_labels) / sizeof(generic_labels[0]); i++) {
+        if (strlen(generic_labels[i].label) == label_len &&
+            memcmp(generic_labels[i].label, label, label_len) == 0) {
+            return generic_labels[i].field;
+        }
+    }
+    return FIELD_NONE;
+}
+
+// Numeric value of a pair, or false for strings / bad sizes
+static bool generic_value(uint8_t type, const uint8_t *value, uint8_t value_len, int32_t *out) {
+    switch (type) {
+        case DATA_TYPE_INT8:   if (value_len != 1) return false; *out = (int8_t)value[0]; return true;
+        case DATA_TYPE_UINT8:
+        case DATA_TYPE_BOOL:   if (value_len != 1) return false; *out = value[0]; return true;
+        case DATA_TYPE_INT16:  { int16_t v;  if (value_len != 2) return false; memcpy(&v, value, 2); *out = v; return true; }
+        case DATA_TYPE_UINT16: { uint16_t v; if (value_len != 2) return false; memcpy(&v, value, 2); *out = v; return true; }
+        case DATA_TYPE_INT32:  { int32_t v;  if (value_len != 4) return false; memcpy(&v, value, 4); *out = v; return true; }
+        case DATA_TYPE_UINT32: { uint32_t v; if (value_len != 4) return false; memcpy(&v, value, 4); *out = (int32_t)v; return true; }
+        case DATA_TYPE_FLOAT:  { float v;    if (value_len != 4) return false; memcpy(&v, value, 4); *out = (int32_t)lroundf(v); return true; }
+        default:               return false;
+    }
+}
+
+static int decode_generic(const uint8_t *frame, size_t len, SensorPacketV2 *out, size_t max_out) {
+    (void)max_out;
+    if (len < sizeof(GenericPacketHeader)) {
+        return PACKET_DECODE_ERR_LEN;
+    }
+    GenericPacketHeader hdr;
+    memcpy(&hdr, frame, sizeof(hdr));
+    if (hdr.pair_count > MAX_DATA_PAIRS) {
+        return PACKET_DECODE_ERR_MALFORMED;
+    }
+
+    SensorPacketV2 *rec = &out[0];
+    record_init(rec, hdr.node_id);
+    memcpy(rec->mac, hdr.mac, 6);
+    rec->seq = hdr.seq;
+
+    bool has_level = false;
+    size_t off = sizeof(GenericPacketHeader);
+    for (uint8_t i = 0; i < hdr.pair_count; i++) {
+        // [label_len][label][type][value_len][value]
+        if (off + 1 > len) {
+            return PACKET_DECODE_ERR_MALFORMED;
+        }
+        uint8_t label_len = frame[off];
+        if (label_len > 31 || off + 1 + label_len + 2 > len) {
+            return PACKET_DECODE_ERR_MALFORMED;
+        }
+        const uint8_t *label = &frame[off + 1];
+        uint8_t type = frame[off + 1 + label_len];
+        uint8_t value_len = frame[off + 2 + label_len];
+        const uint8_t *value = &frame[off + 3 + label_len];
+        if (off + 3 + label_len + value_len > len) {
+            return PACKET_DECODE_ERR_MALFORMED;
+        }
+        off += 3 + label_len + value_len;
+
+        int32_t v;
+        if (!generic_value(type, value, value_len, &v)) {
+            continue;
+        }
+        switch (generic_field(label, label_len)) {
+            case FIELD_DISTANCE:   rec->distance_cm = (int16_t)v; break;
+            case FIELD_LEVEL:      rec->level_cm = (int16_t)v; has_level = true; break;
+            case FIELD_PERCENTUAL: rec->percentual = (uint8_t)(v < 0 ? 0 : (v > 100 ? 100 : v)); break;
+            case FIELD_VOLUME:     rec->volume_l = (uint32_t)v; break;
+            case FIELD_VIN:        rec->vin_mv = (int16_t)v; break;
+            case FIELD_NONE:       break;
+        }
+    }
+
+    if (!has_level) {
+        rec->flags |= FLAG_DISTANCE_ONLY;
+    }
+    return 1;
+}
+
+// ============================================================================
+// SensorBatchHeader + delta-encoded distances (several samples)
+// ============================================================================
+
+// Same integer math as the nodes' level_calculator::compute()
+static void batch_fill_level(SensorPacketV2 *rec, const SensorBatchHeader *hdr) {
+    int32_t level = (int32_t)hdr->level_max_cm + hdr->sensor_offset_cm - rec->distance_cm;
+    if (level < 0) level = 0;
+    if (level > hdr->level_max_cm) level = hdr->level_max_cm;
+    rec->level_cm = (int16_t)level;
+    rec->percentual = (uint8_t)(level * 100 / hdr->level_max_cm);
+    rec->volume_l = (uint32_t)((int64_t)level * hdr->vol_max_l / hdr->level_max_cm);
+}
+
+static int decode_batch(const uint8_t *frame, size_t len, SensorPacketV2 *out, size_t max_out) {
+    if (len < sizeof(SensorBatchHeader)) {
+        return PACKET_DECODE_ERR_LEN;
+    }
+    SensorBatchHeader hdr;
+    memcpy(&hdr, frame, sizeof(hdr));
+    if (hdr.count == 0 || hdr.count > SENSOR_BATCH_MAX_SAMPLES || hdr.count > max_out ||
+        hdr.level_max_cm < 0) {
+        return PACKET_DECODE_ERR_MALFORMED;
+    }
+
+    size_t off = sizeof(SensorBatchHeader);
+    int16_t distance = hdr.distance_cm;
+    for (uint8_t i = 0; i < hdr.count; i++) {
+        if (i > 0) {
+            if (off + 1 > len) {
+                return PACKET_DECODE_ERR_LEN;
+            }
+            int8_t delta = (int8_t)frame[off++];
+            if (delta == SENSOR_BATCH_DELTA_ESCAPE) {
+                if (off + 2 > len) {
+                    return PACKET_DECODE_ERR_LEN;
+                }
+                distance = (int16_t)(frame[off] | (frame[off + 1] << 8));
+                off += 2;
+            } else {
+                distance = (int16_t)(distance + delta);
+            }
+        }
+
+        SensorPacketV2 *rec = &out[i];
+        record_init(rec, hdr.node_id);
+        rec->seq = hdr.base_seq + i;
+        rec->distance_cm = distance;
+        rec->vin_mv = hdr.vin_mv;
+        if (hdr.level_max_cm > 0) {
+            batch_fill_level(rec, &hdr);
+        } else {
+            rec->flags = FLAG_DISTANCE_ONLY;
+        }
+        // Sample age at reception; the gateway turns it into a timestamp
+        uint64_t back_ms = (uint64_t)i * hdr.interval_ms;
+        rec->ts_ms = back_ms < hdr.base_age_ms ? hdr.base_age_ms - (uint32_t)back_ms : 0;
+    }
+    if (off != len) {
+        return PACKET_DECODE_ERR_LEN;   // trailing bytes: count and payload disagree
+    }
+
+    // Summary flags and alert belong to the newest sample
+    out[hdr.count - 1].flags |= hdr.flags;
+    out[hdr.count - 1].alert_type = hdr.alert_type;
+    return hdr.count;
+}
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+
+static const packet_decoder_t decoders[] = {
+    {SENSOR_PACKET_VERSION,    false, 0,                      PACKET_FORMAT_V1,      true,  "v1",      decode_v1},
+    {SENSOR_PACKET_V2_VERSION, false, 0,                      PACKET_FORMAT_V2,      true,  "v2",      decode_v2},
+    {AGUADA_ULTRA01_MAGIC,     true,  AGUADA_ULTRA01_VERSION, PACKET_FORMAT_ULTRA01, false, "ultra01", decode_ultra01},
+    {GENERIC_PACKET_MAGIC,     true,  GENERIC_PACKET_VERSION, PACKET_FORMAT_GENERIC, true,  "generic", decode_generic},
+    {SENSOR_BATCH_MAGIC,       true,  SENSOR_BATCH_VERSION,   PACKET_FORMAT_BATCH,   true,  "batch",   decode_batch},
+};
+
+int packet_decode(const uint8_t *frame, size_t len,
+                  SensorPacketV2 *out, size_t max_out, packet_decode_result_t *result) {
+    result->count = 0;
+    if (len < 2 || max_out == 0) {
+        return PACKET_DECODE_ERR_LEN;
+    }
+
+    for (size_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++) {
+        const packet_decoder_t *d = &decoders[i];
+        if (frame[0] != d->magic || (d->check_version && frame[1] != d->version)) {
+            continue;
+        }
+        result->format = d->format;
+        result->has_seq = d->has_seq;
+        int n = d->decode(frame, len, out, max_out);
+        if (n < 0) {
+            return n;
+        }
+        result->count = (size_t)n;
+        return PACKET_DECODE_OK;
+    }
+    return PACKET_DECODE_ERR_UNKNOWN;
+}
+
+const char *packet_format_name(packet_format_t format) {
+    for (size_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++) {
+        if (decoders[i].format == format) {
+            return decoders[i].name;
+        }
+    }
+    return "?";
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/**
+ * AGUADA - ESP-NOW frame dispatcher
+ *
+ * Picks a decoder from the first bytes of a frame (magic and version, see
+ * common/telemetry_packet.h) and normalizes the payload into SensorPacketV2,
+ * the record that the HTTP queue, the flash backlog and the backend use.
+ *
+ *   first byte  second byte  format
+ *   0x01        -            SensorPacketV1 (version byte, 30 B; up to 8 back to back)
+ *   0x02        -            SensorPacketV2 (version byte, 32 B; up to 7 back to back)
+ *   0xA1        0x01         aguadaUltrasonic01Packet (12 B, distance only)
+ *   0xDA        0x02         GenericPacketHeader + key/value pairs
+ *   0xB1        0x01         SensorBatchHeader + delta-encoded distances
+ *
+ * A decoder may emit several records per frame (up to max_out), oldest first.
+ * Fields a format does not carry are left at 0 (rate: SENSOR_RATE_UNKNOWN,
+ * only v2 carries one); records from formats without level/volume are tagged
+ * FLAG_DISTANCE_ONLY. Records keep the version of the node's packet (1 for
+ * the other formats). mac and rssi are left for the gateway to fill. ts_ms
+ * holds the age of the sample at reception in ms (0 for readings sent right
+ * after measuring; SensorPacketV1/V2 carry the node's value); the gateway
+ * turns it into the record's timestamp.
+ *
+ * No ESP-IDF dependencies: builds on the host as-is.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "telemetry_packet.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PACKET_DECODE_MAX_RECORDS  SENSOR_BATCH_MAX_SAMPLES
+
+#define PACKET_DECODE_OK             0
+#define PACKET_DECODE_ERR_UNKNOWN   -1   // no decoder for this magic/version
+#define PACKET_DECODE_ERR_LEN       -2   // wrong size for the format
+#define PACKET_DECODE_ERR_MALFORMED -3   // inconsistent content
+
+typedef enum {
+    PACKET_FORMAT_V1 = 0,
+    PACKET_FORMAT_ULTRA01,
+    PACKET_FORMAT_GENERIC,
+    PACKET_FORMAT_BATCH,
+    PACKET_FORMAT_V2,
+    PACKET_FORMAT_COUNT
+} packet_format_t;
+
+typedef struct {
+    packet_format_t format;
+    bool has_seq;       // records carry the node's sequence number (dedup, ACK)
+    size_t count;       // records written to out
+} packet_decode_result_t;
+
+// Decode one frame into up to max_out normalized records
+int packet_decode(const uint8_t *frame, size_t len,
+                  SensorPacketV2 *out, size_t max_out, packet_decode_result_t *result);
+
+const char *packet_format_name(packet_format_t format);
+
+#ifdef __cplusplus
+}
+#endif
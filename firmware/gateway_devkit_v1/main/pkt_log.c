@@ -0,0 +1,524 @@
+/**
+ * AGUADA - Packet log (append-only flash ring)
+ *
+ * See pkt_log.h for the on-flash layout. This file has no ESP-IDF dependency
+ * except pkt_log_open_partition(), so it also builds on the host.
+ */
+
+#include <string.h>
+
+#include "pkt_log.h"
+
+#define SECTOR_MAGIC   0x474F4C50u   // "PLOG"
+#define REC_DATA       0xD1
+#define REC_CURSOR     0xC1
+#define REC_ERASED     0xFF
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;        // increases every time a sector is (re)started
+    uint32_t reserved;   // 0xFFFFFFFF
+    uint32_t crc;        // CRC32 of the 12 bytes above
+} sector_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  type;       // REC_DATA / REC_CURSOR (0xFF = free space)
+    uint8_t  len;        // payload bytes
+    uint16_t reserved;   // 0xFFFF
+    uint32_t lsn;        // DATA: record lsn, CURSOR: first undelivered lsn
+    uint32_t crc;        // CRC32 of header (crc excluded) + payload
+} rec_hdr_t;
+
+#define SECTOR_HDR_SIZE  ((uint32_t)sizeof(sector_hdr_t))
+#define REC_HDR_SIZE     ((uint32_t)sizeof(rec_hdr_t))
+
+// Scratch for whole-sector scans (open/wrap-around). Not reentrant: one log per task.
+static uint8_t scan_buf[PKT_LOG_SECTOR_SIZE];
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+// CRC32 (IEEE 802.3, reflected), 16-entry table: small and portable
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static uint32_t rec_crc(const rec_hdr_t *h, const uint8_t *payload) {
+    uint32_t crc = crc32_update(0, (const uint8_t *)h, offsetof(rec_hdr_t, crc));
+    return crc32_update(crc, payload, h->len);
+}
+
+static inline uint32_t rec_size(uint32_t len) {
+    return (REC_HDR_SIZE + len + 3u) & ~3u;
+}
+
+static inline uint32_t sector_base(uint32_t sector) {
+    return sector * PKT_LOG_SECTOR_SIZE;
+}
+
+static inline uint32_t next_sector(const pkt_log_t *log, uint32_t sector) {
+    return (sector + 1) % log->sector_count;
+}
+
+// Read from flash, or from the staging page for the not yet flushed part of the head sector
+static int log_read(pkt_log_t *log, uint32_t sector, uint32_t off, void *dst, uint32_t len) {
+    if (sector == log->head_sector && off >= log->flushed_off) {
+        if (off + len > log->head_off) {
+            return PKT_LOG_ERR_EMPTY;
+        }
+        memcpy(dst, &log->page[off - log->flushed_off], len);
+        return PKT_LOG_OK;
+    }
+    return log->io.read(log->io.ctx, sector_base(sector) + off, dst, len) == 0 ? PKT_LOG_OK : PKT_LOG_ERR_IO;
+}
+
+static int sector_start(pkt_log_t *log, uint32_t sector, uint32_t seq) {
+    if (log->io.erase_sector(log->io.ctx, sector_base(sector)) != 0) {
+        return PKT_LOG_ERR_IO;
+    }
+    log->stats.sectors_erased++;
+
+    sector_hdr_t hdr = { .magic = SECTOR_MAGIC, .seq = seq, .reserved = 0xFFFFFFFFu, .crc = 0 };
+    hdr.crc = crc32_update(0, (const uint8_t *)&hdr, offsetof(sector_hdr_t, crc));
+    if (log->io.write(log->io.ctx, sector_base(sector), &hdr, SECTOR_HDR_SIZE) != 0) {
+        return PKT_LOG_ERR_IO;
+    }
+    log->stats.flash_bytes += SECTOR_HDR_SIZE;
+
+    log->head_sector = sector;
+    log->head_seq = seq;
+    log->head_off = SECTOR_HDR_SIZE;
+    log->flushed_off = SECTOR_HDR_SIZE;
+    return PKT_LOG_OK;
+}
+
+static bool sector_hdr_read(pkt_log_t *log, uint32_t sector, sector_hdr_t *hdr) {
+    if (log->io.read(log->io.ctx, sector_base(sector), hdr, SECTOR_HDR_SIZE) != 0) {
+        return false;
+    }
+    return hdr->magic == SECTOR_MAGIC &&
+           hdr->crc == crc32_update(0, (const uint8_t *)hdr, offsetof(sector_hdr_t, crc));
+}
+
+// Walk the records of a fully flushed sector (loaded into scan_buf).
+// Calls visit() for every valid record; returns the offset where valid records end.
+typedef void (*rec_visit_fn)(pkt_log_t *log, const rec_hdr_t *h, uint32_t sector, uint32_t off, void *arg);
+
+static int sector_scan(pkt_log_t *log, uint32_t sector, rec_visit_fn visit, void *arg,
+                       uint32_t *end_off, bool *corrupt) {
+    if (log->io.read(log->io.ctx, sector_base(sector), scan_buf, PKT_LOG_SECTOR_SIZE) != 0) {
+        return PKT_LOG_ERR_IO;
+    }
+
+    uint32_t off = SECTOR_HDR_SIZE;
+    bool bad = false;
+    while (off + REC_HDR_SIZE <= PKT_LOG_SECTOR_SIZE) {
+        rec_hdr_t h;
+        memcpy(&h, &scan_buf[off], REC_HDR_SIZE);
+        if (h.type == REC_ERASED) {
+            break;   // free space
+        }
+        uint32_t size = rec_size(h.len);
+        if ((h.type != REC_DATA && h.type != REC_CURSOR) || h.len > PKT_LOG_MAX_PAYLOAD ||
+            off + size > PKT_LOG_SECTOR_SIZE || h.crc != rec_crc(&h, &scan_buf[off + REC_HDR_SIZE])) {
+            bad = true;   // torn write: nothing after this point can be trusted
+            break;
+        }
+        if (visit) {
+            visit(log, &h, sector, off, arg);
+        }
+        off += size;
+    }
+
+    if (end_off) *end_off = off;
+    if (corrupt) *corrupt = bad;
+    return PKT_LOG_OK;
+}
+
+// Records in the tail sector are about to be erased: account for undelivered ones
+static void drop_visit(pkt_log_t *log, const rec_hdr_t *h, uint32_t sector, uint32_t off, void *arg) {
+    (void)sector;
+    (void)off;
+    uint32_t *last_lsn = (uint32_t *)arg;
+    if (h->type != REC_DATA) {
+        return;
+    }
+    *last_lsn = h->lsn;
+    if (h->lsn >= log->commit_lsn) {
+        log->count--;
+        log->stats.records_dropped++;
+        if (h->lsn < log->read_lsn) {
+            log->inflight--;
+        }
+    }
+}
+
+static int drop_tail(pkt_log_t *log) {
+    uint32_t dropped = log->tail_sector;
+    uint32_t last_lsn = 0;   // lsn values start at 1, so 0 means "no DATA record"
+
+    if (sector_scan(log, dropped, drop_visit, &last_lsn, NULL, NULL) != PKT_LOG_OK) {
+        return PKT_LOG_ERR_IO;
+    }
+    log->tail_sector = next_sector(log, dropped);
+
+    // Delivery positions inside the dropped sector move to the next sector
+    pkt_log_pos_t restart = { log->tail_sector, SECTOR_HDR_SIZE };
+    if (log->commit_pos.sector == dropped) {
+        log->commit_pos = restart;
+        if (last_lsn != 0 && last_lsn + 1 > log->commit_lsn) {
+            log->commit_lsn = last_lsn + 1;
+        }
+    }
+    if (log->read_pos.sector == dropped) {
+        log->read_pos = log->commit_pos;
+        log->read_lsn = log->commit_lsn;
+    }
+    return PKT_LOG_OK;
+}
+
+static int advance_head(pkt_log_t *log) {
+    uint32_t next = next_sector(log, log->head_sector);
+    if (next == log->tail_sector) {
+        int err = drop_tail(log);
+        if (err != PKT_LOG_OK) {
+            return err;
+        }
+    }
+    return sector_start(log, next, log->head_seq + 1);
+}
+
+static int append_record(pkt_log_t *log, uint8_t type, uint32_t lsn, const void *data, size_t len) {
+    uint32_t size = rec_size((uint32_t)len);
+
+    if (log->head_off + size > PKT_LOG_SECTOR_SIZE) {
+        int err = pkt_log_flush(log);
+        if (err == PKT_LOG_OK) {
+            err = advance_head(log);
+        }
+        if (err != PKT_LOG_OK) {
+            return err;
+        }
+    }
+    if ((log->head_off - log->flushed_off) + size > PKT_LOG_PAGE_SIZE) {
+        int err = pkt_log_flush(log);
+        if (err != PKT_LOG_OK) {
+            return err;
+        }
+    }
+
+    uint8_t *dst = &log->page[log->head_off - log->flushed_off];
+    rec_hdr_t h = { .type = type, .len = (uint8_t)len, .reserved = 0xFFFF, .lsn = lsn, .crc = 0 };
+    h.crc = rec_crc(&h, (const uint8_t *)data);
+    memcpy(dst, &h, REC_HDR_SIZE);
+    if (len) {
+        memcpy(dst + REC_HDR_SIZE, data, len);
+    }
+    memset(dst + REC_HDR_SIZE + len, 0xFF, size - REC_HDR_SIZE - len);
+    log->head_off += size;
+    return PKT_LOG_OK;
+}
+
+// ============================================================================
+// RECOVERY
+// ============================================================================
+
+typedef struct {
+    bool any_data;
+    uint32_t min_lsn;
+    uint32_t max_lsn;
+    uint32_t cursor;
+} recover_acc_t;
+
+static void recover_visit(pkt_log_t *log, const rec_hdr_t *h, uint32_t sector, uint32_t off, void *arg) {
+    (void)log;
+    (void)sector;
+    (void)off;
+    recover_acc_t *acc = (recover_acc_t *)arg;
+    if (h->type == REC_CURSOR) {
+        if (h->lsn > acc->cursor) acc->cursor = h->lsn;
+        return;
+    }
+    if (!acc->any_data || h->lsn < acc->min_lsn) acc->min_lsn = h->lsn;
+    if (!acc->any_data || h->lsn > acc->max_lsn) acc->max_lsn = h->lsn;
+    acc->any_data = true;
+}
+
+static void locate_visit(pkt_log_t *log, const rec_hdr_t *h, uint32_t sector, uint32_t off, void *arg) {
+    bool *found = (bool *)arg;
+    if (h->type != REC_DATA || h->lsn < log->commit_lsn) {
+        return;
+    }
+    if (!*found) {
+        log->commit_pos.sector = sector;
+        log->commit_pos.offset = off;
+        *found = true;
+    }
+    log->count++;
+}
+
+int pkt_log_open(pkt_log_t *log, const pkt_log_io_t *io) {
+    if (!log || !io || !io->read || !io->write || !io->erase_sector ||
+        io->size % PKT_LOG_SECTOR_SIZE != 0 || io->size < 2 * PKT_LOG_SECTOR_SIZE) {
+        return PKT_LOG_ERR_ARG;
+    }
+
+    memset(log, 0, sizeof(*log));
+    log->io = *io;
+    log->sector_count = io->size / PKT_LOG_SECTOR_SIZE;
+
+    // Pass 1: sector headers -> oldest (tail) and newest (head) sector
+    bool any = false;
+    uint32_t head_seq = 0, tail_seq = 0;
+    for (uint32_t s = 0; s < log->sector_count; s++) {
+        sector_hdr_t hdr;
+        if (!sector_hdr_read(log, s, &hdr)) {
+            continue;
+        }
+        if (!any || hdr.seq > head_seq) { head_seq = hdr.seq; log->head_sector = s; }
+        if (!any || hdr.seq < tail_seq) { tail_seq = hdr.seq; log->tail_sector = s; }
+        any = true;
+    }
+
+    if (!any) {
+        // Blank or foreign content: format
+        int err = sector_start(log, 0, 1);
+        if (err != PKT_LOG_OK) {
+            return err;
+        }
+        log->tail_sector = 0;
+        log->next_lsn = 1;
+        log->commit_lsn = 1;
+        log->commit_pos = (pkt_log_pos_t){ 0, SECTOR_HDR_SIZE };
+        log->read_pos = log->commit_pos;
+        log->read_lsn = log->commit_lsn;
+        return PKT_LOG_OK;
+    }
+    log->head_seq = head_seq;
+
+    // Pass 2: records from tail to head -> lsn range, last cursor, write position
+    recover_acc_t acc = { false, 0, 0, 0 };
+    bool head_corrupt = false;
+    uint32_t s = log->tail_sector;
+    for (uint32_t i = 0; i < log->sector_count; i++, s = next_sector(log, s)) {
+        sector_hdr_t hdr;
+        if (sector_hdr_read(log, s, &hdr) && hdr.seq >= tail_seq && hdr.seq <= head_seq) {
+            uint32_t end_off = 0;
+            bool corrupt = false;
+            if (sector_scan(log, s, recover_visit, &acc, &end_off, &corrupt) != PKT_LOG_OK) {
+                return PKT_LOG_ERR_IO;
+            }
+            if (s == log->head_sector) {
+                log->head_off = end_off;
+                head_corrupt = corrupt;
+            }
+        }
+        if (s == log->head_sector) {
+            break;
+        }
+    }
+    // Never append after a torn record: continue on a fresh sector
+    if (head_corrupt) {
+        log->head_off = PKT_LOG_SECTOR_SIZE;
+    }
+    log->flushed_off = log->head_off;
+
+    log->next_lsn = acc.any_data ? acc.max_lsn + 1 : 1;
+    if (acc.cursor > log->next_lsn) log->next_lsn = acc.cursor;
+    log->commit_lsn = acc.cursor;
+    if (acc.any_data && acc.min_lsn > log->commit_lsn) log->commit_lsn = acc.min_lsn;
+    if (!acc.any_data) log->commit_lsn = log->next_lsn;
+
+    // Pass 3: first undelivered record and pending count
+    bool found = false;
+    s = log->tail_sector;
+    for (uint32_t i = 0; i < log->sector_count && log->commit_lsn < log->next_lsn; i++, s = next_sector(log, s)) {
+        sector_hdr_t hdr;
+        if (sector_hdr_read(log, s, &hdr) && hdr.seq >= tail_seq && hdr.seq <= head_seq) {
+            if (sector_scan(log, s, locate_visit, &found, NULL, NULL) != PKT_LOG_OK) {
+                return PKT_LOG_ERR_IO;
+            }
+        }
+        if (s == log->head_sector) {
+            break;
+        }
+    }
+    if (!found) {
+        log->commit_pos = (pkt_log_pos_t){ log->head_sector, log->head_off };
+    }
+    log->read_pos = log->commit_pos;
+    log->read_lsn = log->commit_lsn;
+    return PKT_LOG_OK;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+int pkt_log_append(pkt_log_t *log, const void *data, size_t len) {
+    if (!data || len == 0 || len > PKT_LOG_MAX_PAYLOAD) {
+        return PKT_LOG_ERR_ARG;
+    }
+    int err = append_record(log, REC_DATA, log->next_lsn, data, len);
+    if (err != PKT_LOG_OK) {
+        return err;
+    }
+    log->next_lsn++;
+    log->count++;
+    log->stats.records_appended++;
+    log->stats.payload_bytes += len;
+    return PKT_LOG_OK;
+}
+
+int pkt_log_flush(pkt_log_t *log) {
+    uint32_t pending = log->head_off - log->flushed_off;
+    if (pending == 0) {
+        return PKT_LOG_OK;
+    }
+    if (log->io.write(log->io.ctx, sector_base(log->head_sector) + log->flushed_off, log->page, pending) != 0) {
+        return PKT_LOG_ERR_IO;
+    }
+    log->flushed_off = log->head_off;
+    log->stats.flushes++;
+    log->stats.flash_bytes += pending;
+    return PKT_LOG_OK;
+}
+
+int pkt_log_pop(pkt_log_t *log, void *out, size_t cap, size_t *out_len) {
+    if (pkt_log_available(log) == 0) {
+        return PKT_LOG_ERR_EMPTY;
+    }
+
+    for (uint32_t guard = 0; guard < log->sector_count + 1;) {
+        pkt_log_pos_t *p = &log->read_pos;
+        bool at_head = p->sector == log->head_sector;
+        if (at_head && p->offset >= log->head_off) {
+            return PKT_LOG_ERR_EMPTY;
+        }
+
+        rec_hdr_t h;
+        bool end_of_sector = p->offset + REC_HDR_SIZE > PKT_LOG_SECTOR_SIZE;
+        if (!end_of_sector) {
+            int err = log_read(log, p->sector, p->offset, &h, REC_HDR_SIZE);
+            if (err == PKT_LOG_ERR_IO) {
+                return err;
+            }
+            end_of_sector = err != PKT_LOG_OK || h.type == REC_ERASED;
+        }
+
+        uint32_t size = end_of_sector ? 0 : rec_size(h.len);
+        uint8_t payload[PKT_LOG_MAX_PAYLOAD];
+        if (!end_of_sector) {
+            if (h.len > PKT_LOG_MAX_PAYLOAD || p->offset + size > PKT_LOG_SECTOR_SIZE ||
+                log_read(log, p->sector, p->offset + REC_HDR_SIZE, payload, h.len) != PKT_LOG_OK ||
+                h.crc != rec_crc(&h, payload)) {
+                end_of_sector = true;   // torn record: skip the rest of this sector
+            }
+        }
+
+        if (end_of_sector) {
+            if (at_head) {
+                return PKT_LOG_ERR_EMPTY;
+            }
+            p->sector = next_sector(log, p->sector);
+            p->offset = SECTOR_HDR_SIZE;
+            guard++;
+            continue;
+        }
+
+        p->offset += size;
+        if (h.type != REC_DATA || h.lsn < log->read_lsn) {
+            continue;
+        }
+        if (h.len > cap) {
+            return PKT_LOG_ERR_SIZE;
+        }
+        memcpy(out, payload, h.len);
+        if (out_len) *out_len = h.len;
+        log->read_lsn = h.lsn + 1;
+        log->inflight++;
+        return PKT_LOG_OK;
+    }
+    return PKT_LOG_ERR_EMPTY;
+}
+
+int pkt_log_commit(pkt_log_t *log) {
+    if (log->inflight == 0) {
+        return PKT_LOG_OK;
+    }
+    log->count -= log->inflight;
+    log->inflight = 0;
+    log->commit_pos = log->read_pos;
+    log->commit_lsn = log->read_lsn;
+
+    int err = append_record(log, REC_CURSOR, log->commit_lsn, NULL, 0);
+    if (err == PKT_LOG_OK) {
+        err = pkt_log_flush(log);
+    }
+    if (err == PKT_LOG_OK) {
+        log->stats.cursors_written++;
+    }
+    return err;
+}
+
+void pkt_log_rewind(pkt_log_t *log) {
+    log->read_pos = log->commit_pos;
+    log->read_lsn = log->commit_lsn;
+    log->inflight = 0;
+}
+
+uint32_t pkt_log_capacity(const pkt_log_t *log, size_t payload_len) {
+    uint32_t per_sector = (PKT_LOG_SECTOR_SIZE - SECTOR_HDR_SIZE) / rec_size((uint32_t)payload_len);
+    return (log->sector_count - 1) * per_sector;
+}
+
+// ============================================================================
+// ESP-IDF PARTITION BACKEND
+// ============================================================================
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+
+static int part_read(void *ctx, uint32_t offset, void *dst, uint32_t len) {
+    return esp_partition_read((const esp_partition_t *)ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_write(void *ctx, uint32_t offset, const void *src, uint32_t len) {
+    return esp_partition_write((const esp_partition_t *)ctx, offset, src, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_erase_sector(void *ctx, uint32_t offset) {
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, PKT_LOG_SECTOR_SIZE) == ESP_OK ? 0 : -1;
+}
+
+esp_err_t pkt_log_open_partition(pkt_log_t *log, const char *label) {
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    pkt_log_io_t io = {
+        .ctx = (void *)part,
+        .size = part->size - (part->size % PKT_LOG_SECTOR_SIZE),
+        .read = part_read,
+        .write = part_write,
+        .erase_sector = part_erase_sector,
+    };
+    int err = pkt_log_open(log, &io);
+    if (err == PKT_LOG_ERR_ARG) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return err == PKT_LOG_OK ? ESP_OK : ESP_FAIL;
+}
+#endif
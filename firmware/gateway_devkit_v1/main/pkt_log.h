@@ -0,0 +1,131 @@
+#pragma once
+
+/**
+ * AGUADA - Packet log (append-only flash ring)
+ *
+ * Backlog storage for packets that could not be delivered to the backend.
+ * Replaces the old one-blob-per-packet NVS queue.
+ *
+ * Layout:
+ * - The storage is split in sectors of PKT_LOG_SECTOR_SIZE bytes, used as a ring.
+ * - Each sector starts with a header carrying a monotonically increasing sector_seq.
+ * - Records follow, 4-byte aligned, each with its own CRC32:
+ *     DATA   - one packet, tagged with a log sequence number (lsn)
+ *     CURSOR - "everything below lsn N was delivered" (consumption marker)
+ * - Nothing is ever rewritten in place: consuming packets appends a CURSOR record.
+ * - Appends are staged in a RAM page and written to flash in one call per flush.
+ * - When the ring is full the oldest sector is erased (oldest packets dropped).
+ *
+ * On boot pkt_log_open() scans all sectors, discards torn records and restores
+ * the write position, the next lsn and the last committed cursor.
+ *
+ * Storage access goes through pkt_log_io_t, so the same code runs on a raw flash
+ * partition (pkt_log_open_partition) or on any host-side backend (e.g. a file).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PKT_LOG_SECTOR_SIZE   4096
+#define PKT_LOG_PAGE_SIZE     512     // RAM staging buffer, flushed in one write
+#define PKT_LOG_MAX_PAYLOAD   64
+
+#define PKT_LOG_OK             0
+#define PKT_LOG_ERR_IO        -1
+#define PKT_LOG_ERR_ARG       -2
+#define PKT_LOG_ERR_EMPTY     -3
+#define PKT_LOG_ERR_SIZE      -4
+
+// Storage backend. All callbacks return 0 on success.
+typedef struct {
+    void *ctx;
+    uint32_t size;   // bytes, multiple of PKT_LOG_SECTOR_SIZE (at least 2 sectors)
+    int (*read)(void *ctx, uint32_t offset, void *dst, uint32_t len);
+    int (*write)(void *ctx, uint32_t offset, const void *src, uint32_t len);
+    int (*erase_sector)(void *ctx, uint32_t offset);
+} pkt_log_io_t;
+
+typedef struct {
+    uint32_t sector;
+    uint32_t offset;
+} pkt_log_pos_t;
+
+typedef struct {
+    uint32_t records_appended;
+    uint32_t records_dropped;    // lost to ring wrap-around before delivery
+    uint32_t cursors_written;
+    uint32_t sectors_erased;
+    uint32_t flushes;
+    uint64_t payload_bytes;      // user bytes appended
+    uint64_t flash_bytes;        // bytes programmed (headers, padding and cursors included)
+} pkt_log_stats_t;
+
+typedef struct {
+    pkt_log_io_t io;
+    uint32_t sector_count;
+
+    // Write side
+    uint32_t head_sector;
+    uint32_t head_seq;           // sector_seq of head_sector
+    uint32_t head_off;           // next append offset (staged bytes included)
+    uint32_t flushed_off;        // bytes of head_sector already on flash
+    uint32_t tail_sector;        // oldest sector still holding records
+    uint32_t next_lsn;
+    uint8_t page[PKT_LOG_PAGE_SIZE];
+
+    // Read side
+    pkt_log_pos_t commit_pos;    // first record not yet committed as delivered
+    uint32_t commit_lsn;
+    pkt_log_pos_t read_pos;      // next record returned by pkt_log_pop()
+    uint32_t read_lsn;
+    uint32_t count;              // DATA records not yet committed
+    uint32_t inflight;           // popped but not yet committed
+
+    pkt_log_stats_t stats;
+} pkt_log_t;
+
+// Scan the storage and restore state (formats it if nothing valid is found)
+int pkt_log_open(pkt_log_t *log, const pkt_log_io_t *io);
+
+// Stage one record for writing (flushed automatically when the page fills)
+int pkt_log_append(pkt_log_t *log, const void *data, size_t len);
+
+// Write staged records to flash
+int pkt_log_flush(pkt_log_t *log);
+
+// Read the next undelivered record. Does not consume it until pkt_log_commit().
+int pkt_log_pop(pkt_log_t *log, void *out, size_t cap, size_t *out_len);
+
+// Mark every record returned by pkt_log_pop() as delivered (appends a CURSOR record)
+int pkt_log_commit(pkt_log_t *log);
+
+// Forget uncommitted pops; they will be returned again by pkt_log_pop()
+void pkt_log_rewind(pkt_log_t *log);
+
+// Records appended but not committed yet
+static inline uint32_t pkt_log_count(const pkt_log_t *log) {
+    return log->count;
+}
+
+// Records that pkt_log_pop() can still return
+static inline uint32_t pkt_log_available(const pkt_log_t *log) {
+    return log->count - log->inflight;
+}
+
+// Approximate capacity in records of the given payload size
+uint32_t pkt_log_capacity(const pkt_log_t *log, size_t payload_len);
+
+#ifdef ESP_PLATFORM
+#include "esp_err.h"
+// Open the log on a raw data partition (see partitions.csv)
+esp_err_t pkt_log_open_partition(pkt_log_t *log, const char *label);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+/**
+ * AGUADA - ESP-NOW receive ring (lock-free, single producer / single consumer)
+ *
+ * espnow_recv_cb (Wi-Fi task) is the only producer, packet_processing_task the
+ * only consumer. The callback copies the raw frame into a preallocated slot and
+ * publishes it; everything else (validation, peer registration, ACK, logging)
+ * runs in the consumer.
+ *
+ * - RX_RING_SLOTS must be a power of two; head/tail are free-running counters.
+ * - The producer owns head, the consumer owns tail. Publishing a slot is a
+ *   release store of head, consuming it a release store of tail.
+ * - A full ring drops the new frame (counted in drops); nothing blocks.
+ *
+ * Usage (producer):  f = rx_ring_reserve(r); fill *f; rx_ring_publish(r);
+ * Usage (consumer):  while ((f = rx_ring_peek(r))) { use *f; rx_ring_release(r); }
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RX_RING_SLOTS     32
+#define RX_FRAME_MAX      250   // ESP-NOW v1 payload limit
+
+_Static_assert((RX_RING_SLOTS & (RX_RING_SLOTS - 1)) == 0, "RX_RING_SLOTS must be a power of two");
+
+typedef struct {
+    uint8_t src_addr[6];
+    int8_t rssi;
+    uint8_t len;                // bytes valid in data (frames above RX_FRAME_MAX are clipped)
+    int64_t rx_us;              // esp_timer time at reception
+    uint8_t data[RX_FRAME_MAX];
+} rx_frame_t;
+
+typedef struct {
+    _Atomic uint32_t head;      // next slot to publish (producer)
+    _Atomic uint32_t tail;      // next slot to consume (consumer)
+    _Atomic uint32_t drops;     // frames lost because the ring was full
+    _Atomic uint32_t high_water;// max slots in use ever observed by the producer
+    rx_frame_t slots[RX_RING_SLOTS];
+} rx_ring_t;
+
+// Producer: free slot to fill, or NULL (and drops++) if the ring is full
+static inline rx_frame_t *rx_ring_reserve(rx_ring_t *r) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail >= RX_RING_SLOTS) {
+        atomic_fetch_add_explicit(&r->drops, 1, memory_order_relaxed);
+        return NULL;
+    }
+    return &r->slots[head & (RX_RING_SLOTS - 1)];
+}
+
+// Producer: make the slot returned by rx_ring_reserve() visible to the consumer
+static inline void rx_ring_publish(rx_ring_t *r) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed) + 1;
+    atomic_store_explicit(&r->head, head, memory_order_release);
+
+    uint32_t used = head - atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (used > atomic_load_explicit(&r->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&r->high_water, used, memory_order_relaxed);
+    }
+}
+
+// Consumer: oldest published frame, or NULL if the ring is empty
+static inline const rx_frame_t *rx_ring_peek(rx_ring_t *r) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    return &r->slots[tail & (RX_RING_SLOTS - 1)];
+}
+
+// Consumer: hand the slot returned by rx_ring_peek() back to the producer
+static inline void rx_ring_release(rx_ring_t *r) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+static inline uint32_t rx_ring_drops(const rx_ring_t *r) {
+    return atomic_load_explicit(&r->drops, memory_order_relaxed);
+}
+
+static inline uint32_t rx_ring_high_water(const rx_ring_t *r) {
+    return atomic_load_explicit(&r->high_water, memory_order_relaxed);
+}
+
+#ifdef __cplusplus
+}
+#endif
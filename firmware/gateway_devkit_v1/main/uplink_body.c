@@ -0,0 +1,81 @@
+/**
+ * AGUADA - Uplink body encoders (see uplink_body.h)
+ */
+
+#include "uplink_body.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int uplink_json_packet(char *buf, size_t cap, const SensorPacketV2 *pkt, bool is_backlog) {
+    // rate_cm_min: one decimal, null when the node sent none
+    char rate[12] = "null";
+    int16_t r = pkt->rate_cmpm_x10;
+    if (r != SENSOR_RATE_UNKNOWN) {
+        snprintf(rate, sizeof(rate), "%s%d.%d", r < 0 ? "-" : "", abs(r) / 10, abs(r) % 10);
+    }
+
+    int n = snprintf(buf, cap,
+        "{\"version\":%u,\"node_id\":%u,\"mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"seq\":%u,"
+        "\"distance_cm\":%d,\"level_cm\":%d,\"percentual\":%u,\"volume_l\":%u,\"vin_mv\":%d,\"rssi\":%d,\"ts_ms\":%u,"
+        "\"flags\":%u,\"alert_type\":%u,\"rate_cm_min\":%s,\"is_backlog\":%s}",
+        (unsigned)pkt->version, (unsigned)pkt->node_id,
+        pkt->mac[0], pkt->mac[1], pkt->mac[2], pkt->mac[3], pkt->mac[4], pkt->mac[5],
+        (unsigned)pkt->seq,
+        (int)pkt->distance_cm, (int)pkt->level_cm, (unsigned)pkt->percentual, (unsigned)pkt->volume_l,
+        (int)pkt->vin_mv, (int)pkt->rssi, (unsigned)pkt->ts_ms,
+        (unsigned)pkt->flags, (unsigned)pkt->alert_type, rate,
+        is_backlog ? "true" : "false");
+
+    if (n <= 0 || n >= (int)cap) {
+        return -1;
+    }
+    return n;
+}
+
+int uplink_encode_json(char *body, size_t cap, const SensorPacketV2 *pkts, size_t count, bool is_backlog) {
+    if (cap < 2) {
+        return -1;
+    }
+    size_t used = 0;
+    if (count > 1) {
+        body[used++] = '[';
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) {
+            body[used++] = ',';
+        }
+        // Keep room for the closing ']' and the terminator
+        int n = uplink_json_packet(&body[used], cap - used - 1, &pkts[i], is_backlog);
+        if (n < 0) {
+            return -1;
+        }
+        used += n;
+    }
+    if (count > 1) {
+        body[used++] = ']';
+    }
+    body[used] = '\0';
+    return (int)used;
+}
+
+int uplink_encode_binary(char *body, size_t cap, const SensorPacketV2 *pkts, size_t count, bool is_backlog) {
+    if (count > 255 || cap < UPLINK_BIN_HEADER_SIZE) {
+        return -1;
+    }
+    size_t used = 0;
+    body[used++] = (char)UPLINK_BIN_MAGIC;
+    body[used++] = UPLINK_BIN_VERSION;
+    body[used++] = is_backlog ? UPLINK_BIN_FLAG_BACKLOG : 0;
+    body[used++] = (char)count;
+    for (size_t i = 0; i < count; i++) {
+        if (used + 1 + sizeof(SensorPacketV2) > cap) {
+            return -1;
+        }
+        body[used++] = sizeof(SensorPacketV2);
+        memcpy(&body[used], &pkts[i], sizeof(SensorPacketV2));
+        used += sizeof(SensorPacketV2);
+    }
+    return (int)used;
+}
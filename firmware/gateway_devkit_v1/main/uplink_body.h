@@ -0,0 +1,48 @@
+#pragma once
+
+/**
+ * AGUADA - Uplink body encoders (gateway -> backend POST)
+ *
+ * A batch of SensorPacketV2 records becomes one request body, in one of the
+ * two formats ingest_sensorpacket.php accepts (selected by Content-Type):
+ *
+ *   JSON    application/json: one packet as a plain object, several as an
+ *           array; rate_cm_min with one decimal, null when unknown.
+ *   binary  application/octet-stream: [magic][version][flags][count]
+ *           followed by count records, each [len:1][packed SensorPacketV2]
+ *           (the backend reads the v1 prefix of any record of 30 B or more).
+ *
+ * Used by http_worker_task and by the host tools (uplink_body_bench,
+ * http_batch_bench). No ESP-IDF dependencies: builds on the host as-is.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "telemetry_packet.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UPLINK_BIN_MAGIC         0xAB
+#define UPLINK_BIN_VERSION       1
+#define UPLINK_BIN_FLAG_BACKLOG  0x01
+#define UPLINK_BIN_HEADER_SIZE   4
+#define UPLINK_JSON_RECORD_MAX   350   // worst-case size of one JSON object
+
+// One packet as a JSON object. Returns chars written, or -1 if it does not fit.
+int uplink_json_packet(char *buf, size_t cap, const SensorPacketV2 *pkt, bool is_backlog);
+
+// Body of count packets, NUL-terminated. Returns the length, or -1 if it
+// does not fit in cap.
+int uplink_encode_json(char *body, size_t cap, const SensorPacketV2 *pkts, size_t count, bool is_backlog);
+
+// Binary body of count (at most 255) packets. Returns the length, or -1 if
+// it does not fit in cap.
+int uplink_encode_binary(char *body, size_t cap, const SensorPacketV2 *pkts, size_t count, bool is_backlog);
+
+#ifdef __cplusplus
+}
+#endif
@@ -34,7 +34,16 @@
 
 // Modules
 #include "components/ultrasonic01/ultrasonic01.h"
+#include "components/ultrasonic01/air_temperature.h"
 #include "components/level_calculator/level_calculator.h"
+#include "components/adc_oversample/adc_oversample.h"
+#include "components/duty_cycle/duty_cycle.h"
+#include "components/seq_counter/seq_counter.h"
+#include "components/seq_counter/nvs_store.h"
+#include "components/ack_wait/ack_wait.h"
+#include "components/report_policy/report_policy.h"
+#include "components/store_forward/store_forward.h"
+#include "components/gateway_table/gateway_table.h"
 #include "common/telemetry_packet.h"
 
 static const char *TAG = "node_cie_dual";
@@ -65,27 +74,53 @@ static const char *TAG = "node_cie_dual";
 #define LEVEL_MAX_CM      450      // cm (level_max)
 #define SENSOR_OFFSET_CM  20       // sensor_offset (sensor is 20cm above level_max)
 
+/* Tank shape: level -> volume table computed at compile time (level_calculator.h).
+   prism = volume proportional to level. Other shapes, e.g.
+     level_calculator::Geometry::horizontal_cylinder(250, 600, 125)   // Ø250 x 600 cm, hemispherical heads
+     level_calculator::Geometry::vertical_cylinder(300, LEVEL_MAX_CM, level_calculator::End::CONE, 90)
+   or a strapping table (level_calculator::StrapPoint[]); VOL_MAX_L then comes from the shape. */
+#define TANK_GEOMETRY     level_calculator::Geometry::prism(VOL_MAX_L, LEVEL_MAX_CM)
+static constexpr level_calculator::VolumeTable<> TANK_TABLE(TANK_GEOMETRY, LEVEL_MAX_CM);
+
 /* Sampling and retries */
-#define SAMPLE_INTERVAL_S     30    // loop interval in seconds
-#define ULTRA_SAMPLE_RETRIES  3     // number of ultrasonic readings to take
-#define ULTRA_MEASURE_DELAY_MS 60   // delay between raw ultrasonic attempts
-#define ESPNOW_SEND_RETRIES   2
-#define INTER_SENSOR_DELAY_MS 100   // delay between sensor 1 and sensor 2 measurement
+#define SAMPLE_INTERVAL_S     30    // loop interval in seconds (deep-sleep period with CONFIG_NODE_DEEP_SLEEP)
+#define ULTRA_SAMPLE_RETRIES  3     // ultrasonic readings per cycle (robust_estimate; see tools/robust_bench)
+#define ULTRA_MEASURE_DELAY_MS 60   // min spacing between triggers of the same sensor
+#define ESPNOW_SEND_RETRIES   2     // passes over the gateway table (one attempt per gateway each)
+#define ACK_TIMEOUT_MS        500   // max wait for the gateway ACK (gateway with no RTT history yet)
+#define ACK_TIMEOUT_MIN_MS    150   // floor of the adaptive wait (4x the gateway's average RTT)
+#define GATEWAY_DISCOVERY_MS  1500  // listen for beacons when no gateway is known
+#define ULTRA_GUARD_MS        30    // min spacing between triggers of sensor 1 and sensor 2 (crosstalk)
+#define REPORT_DELTA_CM          3  // CONFIG_NODE_REPORT_ON_DELTA: send when the level moved this much,
+#define REPORT_HEARTBEAT_S       600 //   on a new alert, or at least every 10 min (per sensor)
+#define REPORT_FAST_INTERVAL_S   5  // sampling interval while either level moves faster than
+#define REPORT_FAST_RATE_CM_MIN  2  //   this many cm/min (SAMPLE_INTERVAL_S otherwise)
 
 /* Ultrasonic validation */
 #define MIN_VALID_CM    5
 #define MAX_VALID_CM    450
 
+/* Air temperature for the speed of sound (CONFIG_NODE_AIR_TEMP_INTERNAL, sound_speed.h) */
+#define AIR_TEMP_OFFSET_C_X10  0    // added to every reading (0.1 °C), set against a thermometer
+
+/* Out-of-range samples are masked before the robust estimate */
+static constexpr ultrasonic01::RobustConfig ROBUST_CFG = {.min_cm = MIN_VALID_CM, .max_cm = MAX_VALID_CM};
+
 /* Anomaly detection thresholds */
 #define RAPID_CHANGE_THRESHOLD_CM  50   // 50cm change triggers alert
+#define RAPID_RATE_CM_MIN          10   // filtered level rate (cm/min) that triggers alert
+#define RATE_MAX_VAR               4    // rate trusted once its variance is below this ((cm/min)^2)
 #define NO_CHANGE_MINUTES          120  // 2 hours without change triggers sensor stuck alert
 #define NO_CHANGE_THRESHOLD_CM     2    // Within ±2cm considered "no change"
 
 /* ADC configuration */
 #define ADC_ATTEN        ADC_ATTEN_DB_12
 #define ADC_BITWIDTH     ADC_BITWIDTH_12
+#define VIN_SAMPLE_HZ    1000   // CONFIG_NODE_VIN_CONTINUOUS: Vin conversions per second (DMA),
+#define VIN_DECIMATION   64     //   one CIC-filtered value per 64 samples (see tools/adc_oversample_bench)
 
 /* ESP-NOW configuration */
+/* Configured gateways: seeds of the gateway table, others are learned from their beacons */
 #define MAX_GATEWAYS 3
 static const uint8_t GATEWAY_MACS[MAX_GATEWAYS][6] = {
     {0x80, 0xf3, 0xda, 0x62, 0xa7, 0x84},  // Gateway 1 (ESP32 DevKit V1)
@@ -98,28 +133,77 @@ static const uint8_t GATEWAY_MACS[MAX_GATEWAYS][6] = {
 
 /* NVS keys */
 #define NVS_NAMESPACE "node_cfg"
-#define NVS_SEQ_KEY_1 "seq1"  // Sequence for CIE1
-#define NVS_SEQ_KEY_2 "seq2"  // Sequence for CIE2
-#define NVS_LAST_GW_KEY "last_gw"
+#define NVS_SEQ_KEY_1 "seq1"  // Sequence reservation for CIE1 (SeqCounter checkpoint)
+#define NVS_SEQ_KEY_2 "seq2"  // Sequence reservation for CIE2 (SeqCounter checkpoint)
+#define NVS_LAST_GW_KEY "last_gw_mac"  // MAC of the last gateway that ACKed
 
+#if CONFIG_NODE_VIN_CONTINUOUS
+/* Vin oversampled in the background (adc_continuous + CIC decimator) */
+static adc_oversample::AdcOversampler<VIN_DECIMATION> vin_adc;
+#else
 /* ADC handles (global) */
 static adc_oneshot_unit_handle_t adc1_handle = NULL;
 static adc_cali_handle_t adc1_cali_handle = NULL;
+#endif
+
+/* Air temperature source and the ultrasonic timings carrying its
+   speed-of-sound scale (update_sound_speed) */
+static ultrasonic01::AirTemperature air_temp;
+static ultrasonic01::Timings us_timings;
 
 /* Anomaly detection state - PER SENSOR */
 struct SensorState {
     int16_t last_level_cm;
-    uint32_t last_change_seq;
+    uint32_t last_change_s;        // sample_clock_s when the last level change was detected
     bool initialized;
+    seq_counter::SeqCounter seq;   // checkpointed to NVS every SEQ_COUNTER_CHECKPOINT_EVERY sends
+#if CONFIG_NODE_REPORT_ON_DELTA
+    report_policy::ReportPolicy policy;   // send-on-delta decision for this sensor
+#endif
 };
 
-static SensorState sensor1_state = {0, 0, false};
-static SensorState sensor2_state = {0, 0, false};
+#if CONFIG_NODE_REPORT_ON_DELTA
+static constexpr report_policy::Config REPORT_CONFIG = {
+    REPORT_DELTA_CM, REPORT_HEARTBEAT_S, SAMPLE_INTERVAL_S, REPORT_FAST_INTERVAL_S, REPORT_FAST_RATE_CM_MIN * 10};
+static DUTY_CYCLE_RETAINED SensorState sensor1_state = {0, 0, false, seq_counter::SeqCounter(), report_policy::ReportPolicy(REPORT_CONFIG)};
+static DUTY_CYCLE_RETAINED SensorState sensor2_state = {0, 0, false, seq_counter::SeqCounter(), report_policy::ReportPolicy(REPORT_CONFIG)};
+#else
+static DUTY_CYCLE_RETAINED SensorState sensor1_state = {0, 0, false, seq_counter::SeqCounter()};
+static DUTY_CYCLE_RETAINED SensorState sensor2_state = {0, 0, false, seq_counter::SeqCounter()};
+#endif
+
+/* Node time (sum of the sampling intervals, kept across deep sleep) and the
+   interval slept before the current cycle (0 before the first one) */
+static DUTY_CYCLE_RETAINED uint32_t sample_clock_s = 0;
+static DUTY_CYCLE_RETAINED uint32_t last_interval_s = 0;
+
+/* Kalman filter per sensor: distance + rate (persists across measurements; Q16.16, no soft-float) */
+static DUTY_CYCLE_RETAINED ultrasonic01::KalmanCvQ16 kalman_sensor1(ultrasonic01::Q16(1), ultrasonic01::Q16(2), ultrasonic01::Q16(25));
+static DUTY_CYCLE_RETAINED ultrasonic01::KalmanCvQ16 kalman_sensor2(ultrasonic01::Q16(1), ultrasonic01::Q16(2), ultrasonic01::Q16(25));
+
+/* Filtered level rate for the packet (0.1 cm/min, + = filling), or
+   SENSOR_RATE_UNKNOWN until the filter has settled */
+static int16_t level_rate_x10(const ultrasonic01::KalmanCvQ16 &kalman) {
+    if (kalman.rate_var() > ultrasonic01::Q16(RATE_MAX_VAR)) {
+        return SENSOR_RATE_UNKNOWN;
+    }
+    // the filter tracks distance: the level moves the other way
+    return (int16_t)-ultrasonic01::rate_x10(kalman.rate_cm_min());
+}
 
 /* ACK tracking - SHARED */
-static uint32_t successful_acks = 0;
-static uint32_t total_attempts = 0;
-static int last_successful_gateway = 0;  // 0-2 (index into GATEWAY_MACS)
+static DUTY_CYCLE_RETAINED uint32_t successful_acks = 0;
+static DUTY_CYCLE_RETAINED uint32_t total_attempts = 0;
+
+/* Gateways ranked by RSSI / ACK latency, learned from beacons and ACKs
+   (espnow_recv_cb runs in the Wi-Fi task: guarded by gw_lock) */
+static_assert(MAX_GATEWAYS < GATEWAY_TABLE_CAPACITY, "leave room in the gateway table for learned gateways");
+static DUTY_CYCLE_RETAINED gateway_table::Table gw_table;
+static DUTY_CYCLE_RETAINED bool gw_table_loaded = false;
+static portMUX_TYPE gw_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Store-and-forward: readings (both sensors) no gateway confirmed, resent oldest-first */
+static DUTY_CYCLE_RETAINED store_forward::Ring tx_backlog;
 
 /* ====== LED PATTERNS ====== */
 static void led_set(bool on) {
@@ -154,49 +238,107 @@ static void led_pattern_error(void) {
 }
 
 /* ====== NVS FUNCTIONS ====== */
-static uint32_t nvs_get_seq(const char *key, uint32_t default_val) {
+static bool nvs_get_last_gateway(uint8_t mac[6]) {
     nvs_handle_t nvs;
-    uint32_t seq = default_val;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
-    if (err == ESP_OK) {
-        nvs_get_u32(nvs, key, &seq);
+    size_t len = 6;
+    bool ok = false;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        ok = nvs_get_blob(nvs, NVS_LAST_GW_KEY, mac, &len) == ESP_OK && len == 6;
         nvs_close(nvs);
     }
-    return seq;
+    return ok;
 }
 
-static void nvs_set_seq(const char *key, uint32_t seq) {
+static void nvs_set_last_gateway(const uint8_t mac[6]) {
     nvs_handle_t nvs;
     if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
-        nvs_set_u32(nvs, key, seq);
+        nvs_set_blob(nvs, NVS_LAST_GW_KEY, mac, 6);
         nvs_commit(nvs);
         nvs_close(nvs);
     }
 }
 
-static int nvs_get_last_gateway(void) {
-    nvs_handle_t nvs;
-    uint8_t gw_idx = 0;
-    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
-        nvs_get_u8(nvs, NVS_LAST_GW_KEY, &gw_idx);
-        nvs_close(nvs);
+/* ====== GATEWAY TABLE ====== */
+static uint32_t gw_now_s(void) {
+    return (uint32_t)(duty_cycle::uptime_ms() / 1000);
+}
+
+// Once per power-on: configured gateways as seeds, the last one that ACKed (NVS) preferred
+static void gw_table_load(void) {
+    if (gw_table_loaded) {
+        return;
     }
-    if (gw_idx >= MAX_GATEWAYS) gw_idx = 0;
-    return (int)gw_idx;
+    uint8_t last[6];
+    bool have_last = nvs_get_last_gateway(last);
+    portENTER_CRITICAL(&gw_lock);
+    for (int i = 0; i < MAX_GATEWAYS; i++) {
+        bool is_configured = false;
+        for (int j = 0; j < 6; j++) {
+            if (GATEWAY_MACS[i][j] != 0xFF) {
+                is_configured = true;
+                break;
+            }
+        }
+        if (is_configured) {
+            gw_table.seed(GATEWAY_MACS[i]);
+        }
+    }
+    if (have_last) {
+        gw_table.prefer(last, gw_now_s());
+    }
+    portEXIT_CRITICAL(&gw_lock);
+    gw_table_loaded = true;
 }
 
-static void nvs_set_last_gateway(int gw_idx) {
-    if (gw_idx < 0 || gw_idx >= MAX_GATEWAYS) return;
-    nvs_handle_t nvs;
-    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
-        nvs_set_u8(nvs, NVS_LAST_GW_KEY, (uint8_t)gw_idx);
-        nvs_commit(nvs);
-        nvs_close(nvs);
+static int gw_count(void) {
+    portENTER_CRITICAL(&gw_lock);
+    int n = gw_table.count();
+    portEXIT_CRITICAL(&gw_lock);
+    return n;
+}
+
+// Unicast needs an ESP-NOW peer: learned gateways are registered on first use
+static esp_err_t ensure_peer(const uint8_t mac[6]) {
+    if (esp_now_is_peer_exist(mac)) {
+        return ESP_OK;
     }
+    esp_now_peer_info_t peer_info = {};
+    memcpy(peer_info.peer_addr, mac, 6);
+    peer_info.channel = ESPNOW_CHANNEL;
+    peer_info.ifidx = WIFI_IF_STA;
+    peer_info.encrypt = false;
+    esp_err_t ret = esp_now_add_peer(&peer_info);
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Gateway registrado: " MACSTR, MAC2STR(mac));
+    } else {
+        ESP_LOGE(TAG, "❌ Falha ao registrar gateway " MACSTR ": %s", MAC2STR(mac), esp_err_to_name(ret));
+    }
+    return ret;
 }
 
 /* ====== ADC FUNCTIONS ====== */
+#if CONFIG_NODE_VIN_CONTINUOUS
+/* Vin through the continuous-mode ADC (DMA): oversampled and decimated in
+   the background, read_vin_mv() only takes the window. Owns ADC1 (no
+   oneshot unit). */
+static void init_vin_continuous(void) {
+    adc_oversample::Config cfg = {ADC_CHANNEL_VIN};
+    cfg.sample_hz = VIN_SAMPLE_HZ;
+    cfg.atten = ADC_ATTEN;
+    esp_err_t err = vin_adc.start(cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ADC contínuo falhou: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "🔋 Vin contínuo: %d Hz, CIC /%d (%s)", VIN_SAMPLE_HZ, VIN_DECIMATION,
+             vin_adc.calibrated() ? "calibrado" : "sem calibração");
+}
+#endif
+
 static void init_adc(void) {
+#if CONFIG_NODE_VIN_CONTINUOUS
+    init_vin_continuous();  // the DMA driver owns ADC1: no oneshot unit
+#else
     adc_oneshot_unit_init_cfg_t init_cfg = {
         .unit_id = ADC_UNIT_VIN,
         .clk_src = ADC_DIGI_CLK_SRC_DEFAULT,
@@ -223,9 +365,47 @@ static void init_adc(void) {
         ESP_LOGW(TAG, "ADC calibration failed, using raw values");
         adc1_cali_handle = NULL;
     }
+#endif
+}
+
+/* Air temperature source, set from CONFIG_NODE_AIR_TEMP_* (after init_adc) */
+static void init_air_temp(void) {
+#if CONFIG_NODE_AIR_TEMP_INTERNAL
+    esp_err_t err = air_temp.use_internal(AIR_TEMP_OFFSET_C_X10);
+#else
+    esp_err_t err = ESP_OK;
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "🌡️ Sensor de temperatura do ar indisponível (%s): distância com us/58", esp_err_to_name(err));
+    }
+}
+
+/* Speed-of-sound scale for this cycle's measurements, from the air
+   temperature (us/58 when there is no source or the reading failed) */
+static void update_sound_speed(void) {
+    if (!air_temp.configured()) {
+        return;
+    }
+    int t = air_temp.read_c_x10();
+    us_timings.sound_scale_q16 = ultrasonic01::sound_scale_q16(t);
+    if (t == ultrasonic01::TEMP_INVALID) {
+        ESP_LOGW(TAG, "🌡️ Leitura da temperatura do ar falhou: distância com us/58");
+    } else {
+        ESP_LOGI(TAG, "🌡️ Ar %s%d.%d °C: velocidade do som x%" PRIu32 "/65536", t < 0 ? "-" : "",
+                 abs(t) / 10, abs(t) % 10, us_timings.sound_scale_q16);
+    }
 }
 
 static int read_vin_mv(void) {
+#if CONFIG_NODE_VIN_CONTINUOUS
+    adc_oversample::Reading r = vin_adc.read();
+    if (!r.valid) return -1;
+    if (r.count > 0) {
+        ESP_LOGI(TAG, "🔋 Vin %d mV (mín %d, máx %d; %" PRIu32 " médias de %d amostras)",
+                 r.avg_mv * 2, r.min_mv * 2, r.max_mv * 2, r.count, VIN_DECIMATION);
+    }
+    return r.avg_mv * 2;  // V/2 divider
+#else
     int adc_raw = 0;
     esp_err_t ret = adc_oneshot_read(adc1_handle, ADC_CHANNEL_VIN, &adc_raw);
     if (ret != ESP_OK) {
@@ -238,6 +418,7 @@ static int read_vin_mv(void) {
         voltage_mv = adc_raw;
     }
     return voltage_mv * 2;  // voltage divider (Vin = 2 * ADC_reading)
+#endif
 }
 
 /* ====== MAC HELPER ====== */
@@ -246,17 +427,37 @@ static void get_device_mac(uint8_t *mac_out) {
 }
 
 /* ====== ESP-NOW CALLBACKS ====== */
-static volatile bool ack_received = false;
-static AckPacket last_ack = {};
+// ACKs are handed to the sending task by notification; round trips go to a histogram
+static ack_wait::AckWaiter ack_waiter;
+static DUTY_CYCLE_RETAINED ack_wait::RttHistogram ack_rtt = {};
 
+// ACKs and beacons both feed the gateway table (RSSI heard, last seen)
 static void espnow_recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len) {
+    int rssi = info->rx_ctrl ? info->rx_ctrl->rssi : gateway_table::RSSI_UNHEARD_DBM;
     if (len == sizeof(AckPacket)) {
         AckPacket *ack = (AckPacket *)data;
         if (ack->magic == ACK_MAGIC && ack->version == ACK_VERSION) {
-            memcpy(&last_ack, ack, sizeof(AckPacket));
-            ack_received = true;
-            ESP_LOGI(TAG, "✅ ACK recebido: node_id=%d, seq=%u, status=%d, rssi=%d, gw=%d",
-                     ack->node_id, ack->ack_seq, ack->status, ack->rssi, ack->gateway_id);
+            uint32_t now_s = gw_now_s();
+            portENTER_CRITICAL(&gw_lock);
+            gw_table.heard_ack(info->src_addr, rssi, ack->gateway_id, now_s);
+            portEXIT_CRITICAL(&gw_lock);
+            bool matched = ack_waiter.deliver(info->src_addr, *ack);
+            ESP_LOGD(TAG, "ACK recebido: node_id=%d, seq=%u, status=%d, rssi=%d, gw=%d%s",
+                     ack->node_id, ack->ack_seq, ack->status, ack->rssi, ack->gateway_id,
+                     matched ? "" : " (não esperado)");
+        }
+    } else if (len == sizeof(GatewayBeacon) && data[0] == GATEWAY_BEACON_MAGIC) {
+        const GatewayBeacon *beacon = (const GatewayBeacon *)data;
+        if (beacon->version != GATEWAY_BEACON_VERSION) {
+            return;
+        }
+        uint32_t now_s = gw_now_s();
+        portENTER_CRITICAL(&gw_lock);
+        bool added = gw_table.heard_beacon(info->src_addr, rssi, *beacon, now_s);
+        portEXIT_CRITICAL(&gw_lock);
+        if (added) {
+            ESP_LOGI(TAG, "📡 Novo gateway " MACSTR " (id=%u, rssi=%d)", MAC2STR(info->src_addr),
+                     beacon->gateway_id, rssi);
         }
     }
 }
@@ -266,102 +467,183 @@ static void espnow_send_cb(const wifi_tx_info_t *tx_info, esp_now_send_status_t
 }
 
 /* ====== ESP-NOW SEND WITH ACK ====== */
+// Best gateway first, one attempt per gateway (adaptive ACK wait), so a dead
+// gateway costs a single timeout; ESPNOW_SEND_RETRIES passes, backoff between passes
 static esp_err_t espnow_send_payload(const uint8_t *payload, size_t len, uint32_t seq, uint8_t node_id) {
     total_attempts++;
     
-    // Try last successful gateway first
-    last_successful_gateway = nvs_get_last_gateway();
-    int gw_order[MAX_GATEWAYS];
-    gw_order[0] = last_successful_gateway;
-    int idx = 1;
-    for (int i = 0; i < MAX_GATEWAYS; i++) {
-        if (i != last_successful_gateway) {
-            gw_order[idx++] = i;
+    if (gw_count() == 0) {
+        ESP_LOGW(TAG, "📡 Nenhum gateway conhecido - aguardando beacon (%d ms)", GATEWAY_DISCOVERY_MS);
+        for (int waited = 0; waited < GATEWAY_DISCOVERY_MS && gw_count() == 0; waited += 50) {
+            vTaskDelay(pdMS_TO_TICKS(50));
         }
     }
     
+    int tries = 0;
     for (int attempt = 0; attempt < ESPNOW_SEND_RETRIES; attempt++) {
-        for (int g = 0; g < MAX_GATEWAYS; g++) {
-            int gw_idx = gw_order[g];
-            const uint8_t *gw_mac = GATEWAY_MACS[gw_idx];
-            
-            // Skip unconfigured gateways
-            bool is_configured = false;
-            for (int i = 0; i < 6; i++) {
-                if (gw_mac[i] != 0xFF) {
-                    is_configured = true;
-                    break;
-                }
-            }
-            if (!is_configured) continue;
+        if (attempt > 0) {
+            // Exponential backoff before the next pass
+            vTaskDelay(pdMS_TO_TICKS(100 * (1 << (attempt - 1))));
+        }
+        // Re-ranked every pass: beacons heard meanwhile and the misses count
+        gateway_table::Entry ranked[GATEWAY_TABLE_CAPACITY];
+        uint32_t now_s = gw_now_s();
+        portENTER_CRITICAL(&gw_lock);
+        int n = gw_table.rank(ranked, GATEWAY_TABLE_CAPACITY, now_s);
+        portEXIT_CRITICAL(&gw_lock);
+        
+        for (int g = 0; g < n; g++) {
+            const gateway_table::Entry &gw = ranked[g];
+            uint32_t timeout_ms = gateway_table::Table::ack_timeout_ms(gw, ACK_TIMEOUT_MIN_MS, ACK_TIMEOUT_MS);
+            if (ensure_peer(gw.mac) != ESP_OK) continue;
+            tries++;
             
-            ESP_LOGI(TAG, "📤 Enviando para Gateway %d (tentativa %d) node_id=%d seq=%u", 
-                     gw_idx, attempt + 1, node_id, seq);
+            ESP_LOGI(TAG, "📤 Enviando para Gateway " MACSTR " (rssi=%d, espera %u ms, tentativa %d) node_id=%d seq=%u", 
+                     MAC2STR(gw.mac), gw.rssi_dbm(), (unsigned)timeout_ms, attempt + 1, node_id, seq);
             
-            ack_received = false;
-            esp_err_t send_err = esp_now_send(gw_mac, payload, len);
+            ack_waiter.arm(node_id, seq, gw.mac);
+            esp_err_t send_err = esp_now_send(gw.mac, payload, len);
             
             if (send_err == ESP_OK) {
-                // Wait for ACK (500ms timeout)
-                int wait_ms = 500;
-                int wait_step = 10;
-                for (int i = 0; i < (wait_ms / wait_step); i++) {
-                    if (ack_received && last_ack.ack_seq == seq && last_ack.node_id == node_id) {
-                        successful_acks++;
-                        nvs_set_last_gateway(gw_idx);
-                        last_successful_gateway = gw_idx;
-                        float success_rate = (float)successful_acks / (float)total_attempts * 100.0f;
-                        ESP_LOGI(TAG, "✅ ACK confirmado! Taxa de sucesso: %.1f%% (%u/%u)",
-                                 success_rate, successful_acks, total_attempts);
-                        return ESP_OK;
+                // Block until espnow_recv_cb delivers the matching ACK (or timeout)
+                AckPacket ack;
+                if (ack_waiter.wait(timeout_ms, ack_rtt, &ack)) {
+                    successful_acks++;
+                    uint8_t prev[6];
+                    portENTER_CRITICAL(&gw_lock);
+                    bool had_prev = gw_table.preferred(prev);
+                    gw_table.acked(gw.mac, (uint32_t)ack_waiter.last_rtt_us());
+                    portEXIT_CRITICAL(&gw_lock);
+                    if (!had_prev || memcmp(prev, gw.mac, 6) != 0) {
+                        nvs_set_last_gateway(gw.mac);
                     }
-                    vTaskDelay(pdMS_TO_TICKS(wait_step));
+                    float success_rate = (float)successful_acks / (float)total_attempts * 100.0f;
+                    ESP_LOGI(TAG, "✅ ACK confirmado em %lld us (gw=%d, rssi=%d, status=%d)! Taxa de sucesso: %.1f%% (%u/%u)",
+                             (long long)ack_waiter.last_rtt_us(), ack.gateway_id, ack.rssi, ack.status,
+                             success_rate, successful_acks, total_attempts);
+                    ack_rtt.log(TAG);
+                    return ESP_OK;
                 }
-                ESP_LOGW(TAG, "⏱️ Timeout aguardando ACK do Gateway %d", gw_idx);
+                ESP_LOGW(TAG, "⏱️ Timeout aguardando ACK do Gateway " MACSTR, MAC2STR(gw.mac));
             } else {
-                ESP_LOGE(TAG, "❌ Falha no envio para Gateway %d: %s", gw_idx, esp_err_to_name(send_err));
+                ESP_LOGE(TAG, "❌ Falha no envio para Gateway " MACSTR ": %s", MAC2STR(gw.mac), esp_err_to_name(send_err));
             }
-            
-            // Exponential backoff before next gateway
-            vTaskDelay(pdMS_TO_TICKS(100 * (1 << attempt)));
+            portENTER_CRITICAL(&gw_lock);
+            gw_table.missed(gw.mac);
+            portEXIT_CRITICAL(&gw_lock);
         }
     }
     
     float success_rate = (float)successful_acks / (float)total_attempts * 100.0f;
     ESP_LOGE(TAG, "❌ Falha após %d tentativas. Taxa de sucesso: %.1f%% (%u/%u)",
-             ESPNOW_SEND_RETRIES * MAX_GATEWAYS, success_rate, successful_acks, total_attempts);
+             tries, success_rate, successful_acks, total_attempts);
+    ack_rtt.log(TAG);
     return ESP_FAIL;
 }
 
+/* ====== RADIO ====== */
+// Wi-Fi + ESP-NOW, brought up once. With send-on-delta the first cycle that
+// sends starts it, so deep-sleep wakes that only measure never power the radio.
+static bool radio_started = false;
+
+static void radio_start(void) {
+    if (radio_started) {
+        return;
+    }
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_ERROR_CHECK(esp_wifi_set_channel(ESPNOW_CHANNEL, WIFI_SECOND_CHAN_NONE));
+    ESP_LOGI(TAG, "WiFi set to channel %d", ESPNOW_CHANNEL);
+    
+    ESP_ERROR_CHECK(esp_now_init());
+    ESP_ERROR_CHECK(esp_now_register_send_cb(espnow_send_cb));
+    ESP_ERROR_CHECK(esp_now_register_recv_cb(espnow_recv_cb));
+    
+    // Configured gateways (and the last one that ACKed) as peers; gateways
+    // learned from beacons are registered on first use
+    gw_table_load();
+    gateway_table::Entry known[GATEWAY_TABLE_CAPACITY];
+    uint32_t now_s = gw_now_s();
+    portENTER_CRITICAL(&gw_lock);
+    int n = gw_table.rank(known, GATEWAY_TABLE_CAPACITY, now_s);
+    portEXIT_CRITICAL(&gw_lock);
+    for (int i = 0; i < n; i++) {
+        ensure_peer(known[i].mac);
+    }
+    if (n == 0) {
+        ESP_LOGW(TAG, "Nenhum gateway configurado - aguardando beacons");
+    }
+    
+    ESP_LOGI(TAG, "ESP-NOW initialized");
+    radio_started = true;
+}
+
+/* Send a reading. If readings are waiting in tx_backlog it joins them behind
+   and the ring is resent oldest-first, several per frame (at most
+   STORE_FORWARD_FRAMES_PER_CYCLE frames per cycle). A reading no gateway
+   confirms stays in the ring. Returns the result of the last send attempt. */
+static esp_err_t send_reading(const SensorPacketV2 &pkt) {
+    uint32_t now_ms = (uint32_t)duty_cycle::uptime_ms();
+    if (tx_backlog.empty()) {
+        esp_err_t err = espnow_send_payload((const uint8_t*)&pkt, sizeof(pkt), pkt.seq, pkt.node_id);
+        if (err != ESP_OK) {
+            tx_backlog.push(pkt, now_ms);
+            ESP_LOGW(TAG, "💾 Leitura node_id=%u seq=%" PRIu32 " guardada para reenvio", pkt.node_id, pkt.seq);
+        }
+        return err;
+    }
+
+    tx_backlog.push(pkt, now_ms);
+    esp_err_t err = ESP_OK;
+    size_t delivered = tx_backlog.drain(now_ms, STORE_FORWARD_FRAMES_PER_CYCLE,
+        [&err](const uint8_t *frame, size_t len, const SensorPacketV2 &last) {
+            err = espnow_send_payload(frame, len, last.seq, last.node_id);
+            return err == ESP_OK;
+        });
+    const store_forward::Stats &st = tx_backlog.stats();
+    ESP_LOGI(TAG, "💾 Reenvio: %u leituras entregues, %u na fila (máx %" PRIu32 ", descartadas %" PRIu32 ")",
+             (unsigned)delivered, (unsigned)tx_backlog.count(), st.high_water, st.dropped);
+    return err;
+}
+
 /* ====== ANOMALY DETECTION ====== */
-static void detect_anomalies(SensorState *state, int level_cm, uint32_t seq, 
+// rate_x10: filtered level rate (0.1 cm/min) or SENSOR_RATE_UNKNOWN
+static void detect_anomalies(SensorState *state, int level_cm, int16_t rate_x10, uint32_t now_s,
                              uint8_t *flags, uint8_t *alert_type, const char *sensor_name) {
     *flags = 0;
     *alert_type = ALERT_NONE;
     
     if (!state->initialized) {
         state->last_level_cm = level_cm;
-        state->last_change_seq = seq;
+        state->last_change_s = now_s;
         state->initialized = true;
         ESP_LOGI(TAG, "🎯 %s anomaly detection initialized (baseline=%dcm)", sensor_name, level_cm);
         return;
     }
     
     int16_t delta_cm = level_cm - state->last_level_cm;
-    uint32_t readings_since_change = seq - state->last_change_seq;
-    uint32_t minutes_since_change = (readings_since_change * SAMPLE_INTERVAL_S) / 60;
+    uint32_t minutes_since_change = (now_s - state->last_change_s) / 60;
+    
+    bool rate_known = rate_x10 != SENSOR_RATE_UNKNOWN;
     
-    // Check for rapid drop
-    if (delta_cm <= -RAPID_CHANGE_THRESHOLD_CM) {
+    // Check for rapid drop: a step between cycles or a sustained filtered rate
+    if (delta_cm <= -RAPID_CHANGE_THRESHOLD_CM || (rate_known && rate_x10 <= -RAPID_RATE_CM_MIN * 10)) {
         *flags |= FLAG_IS_ALERT;
         *alert_type = ALERT_RAPID_DROP;
-        ESP_LOGW(TAG, "🚨 %s ALERTA: Queda rápida! Δ=%dcm", sensor_name, delta_cm);
+        ESP_LOGW(TAG, "🚨 %s ALERTA: Queda rápida! Δ=%dcm, taxa=%d.%d cm/min", sensor_name, delta_cm,
+                 rate_x10 / 10, abs(rate_x10) % 10);
     }
     // Check for rapid rise
-    else if (delta_cm >= RAPID_CHANGE_THRESHOLD_CM) {
+    else if (delta_cm >= RAPID_CHANGE_THRESHOLD_CM || (rate_known && rate_x10 >= RAPID_RATE_CM_MIN * 10)) {
         *flags |= FLAG_IS_ALERT;
         *alert_type = ALERT_RAPID_RISE;
-        ESP_LOGW(TAG, "🚨 %s ALERTA: Subida rápida! Δ=%dcm", sensor_name, delta_cm);
+        ESP_LOGW(TAG, "🚨 %s ALERTA: Subida rápida! Δ=%dcm, taxa=%d.%d cm/min", sensor_name, delta_cm,
+                 rate_x10 / 10, abs(rate_x10) % 10);
     }
     // Check for sensor stuck
     else if (minutes_since_change >= NO_CHANGE_MINUTES && 
@@ -374,59 +656,48 @@ static void detect_anomalies(SensorState *state, int level_cm, uint32_t seq,
     // Update baseline if significant change
     if (abs(delta_cm) > NO_CHANGE_THRESHOLD_CM) {
         state->last_level_cm = level_cm;
-        state->last_change_seq = seq;
+        state->last_change_s = now_s;
     }
 }
 
 /* ====== MEASURE AND SEND SENSOR ====== */
-static void measure_and_send_sensor(gpio_num_t trig_gpio, gpio_num_t echo_gpio,
+// dt_s: time since the previous cycle (0 on the first one)
+static void measure_and_send_sensor(const ultrasonic01::Samples &samples,
                                     uint8_t node_id, const char *seq_key,
-                                    SensorState *state, const char *sensor_name) {
-    // Get sequence number
-    uint32_t seq = nvs_get_seq(seq_key, 0);
-    seq++;
-    
+                                    SensorState *state, const char *sensor_name, uint32_t dt_s) {
     ESP_LOGI(TAG, "═══════════════════════════════════════════════════════════");
-    ESP_LOGI(TAG, "📊 %s (node_id=%d) - Medição #%u", sensor_name, node_id, seq);
+    ESP_LOGI(TAG, "📊 %s (node_id=%d)", sensor_name, node_id);
     ESP_LOGI(TAG, "═══════════════════════════════════════════════════════════");
     
-    // Kalman filter for this sensor (static, persists across calls)
-    static ultrasonic01::KalmanFilter kalman_sensor1(1.0, 2.0);
-    static ultrasonic01::KalmanFilter kalman_sensor2(1.0, 2.0);
-    ultrasonic01::KalmanFilter *kalman = (node_id == NODE_ID_1) ? &kalman_sensor1 : &kalman_sensor2;
+    // Kalman filter for this sensor
+    ultrasonic01::KalmanCvQ16 *kalman = (node_id == NODE_ID_1) ? &kalman_sensor1 : &kalman_sensor2;
     
-    // Measure distance with Kalman filtering
+    // Robust estimate of the samples (out-of-range ones masked), then Kalman filtering
     int distance_cm = -1;
-    int valid_readings = 0;
-    
+    auto readings = ultrasonic01::sample_array<ULTRA_SAMPLE_RETRIES>(samples);
     for (int attempt = 0; attempt < ULTRA_SAMPLE_RETRIES; attempt++) {
-        ultrasonic01::Pins pins{trig_gpio, echo_gpio};
-        int raw_distance = ultrasonic01::measure_cm(pins);
-        
+        int raw_distance = readings[attempt];
         if (raw_distance >= MIN_VALID_CM && raw_distance <= MAX_VALID_CM) {
-            kalman->update(raw_distance);
-            distance_cm = (int)kalman->get_estimate();
-            valid_readings++;
-            ESP_LOGI(TAG, "  Tentativa %d/%d: raw=%dcm, kalman=%dcm ✓", 
-                     attempt + 1, ULTRA_SAMPLE_RETRIES, raw_distance, distance_cm);
+            ESP_LOGI(TAG, "  Tentativa %d/%d: raw=%dcm ✓", 
+                     attempt + 1, ULTRA_SAMPLE_RETRIES, raw_distance);
         } else {
             ESP_LOGW(TAG, "  Tentativa %d/%d: INVÁLIDO (raw=%dcm)", 
                      attempt + 1, ULTRA_SAMPLE_RETRIES, raw_distance);
         }
-        
-        if (attempt < ULTRA_SAMPLE_RETRIES - 1) {
-            vTaskDelay(pdMS_TO_TICKS(ULTRA_MEASURE_DELAY_MS));
-        }
     }
+    ultrasonic01::RobustResult est = ultrasonic01::robust_estimate(readings, ROBUST_CFG);
     
     // Check if all readings failed
-    if (valid_readings == 0) {
+    if (est.valid == 0) {
         ESP_LOGE(TAG, "❌ %s: Todas as leituras falharam! Enviando erro.", sensor_name);
         kalman->reset();  // Reset filter for next attempt
         distance_cm = -1;  // Indicate total failure
     } else {
-        ESP_LOGI(TAG, "✅ %s: Distância final (Kalman): %dcm (%d/%d leituras válidas)", 
-                 sensor_name, distance_cm, valid_readings, ULTRA_SAMPLE_RETRIES);
+        // Readings were taken by measure_interleaved() a moment ago
+        kalman->update(est.cm, (uint32_t)duty_cycle::uptime_ms());
+        distance_cm = kalman->estimate_cm();
+        ESP_LOGI(TAG, "✅ %s: Distância final (Kalman): %dcm (robusta %dcm, MAD %d, %d/%d leituras válidas, %d usadas)", 
+                 sensor_name, distance_cm, est.cm, est.mad_cm, est.valid, ULTRA_SAMPLE_RETRIES, est.used);
     }
     
     // Validate distance
@@ -446,8 +717,7 @@ static void measure_and_send_sensor(gpio_num_t trig_gpio, gpio_num_t echo_gpio,
     // Calculate level/volume (if distance valid)
     int level_cm = 0, percentual = 0, volume_l = 0;
     if (distance_cm >= 0) {
-        level_calculator::Model model{LEVEL_MAX_CM, SENSOR_OFFSET_CM, VOL_MAX_L};
-        auto res = level_calculator::compute(distance_cm, model);
+        auto res = level_calculator::compute(distance_cm, SENSOR_OFFSET_CM, TANK_TABLE);
         level_cm = res.level_cm;
         percentual = res.percentual;
         volume_l = res.volume_l;
@@ -461,8 +731,9 @@ static void measure_and_send_sensor(gpio_num_t trig_gpio, gpio_num_t echo_gpio,
     // Anomaly detection
     uint8_t flags = 0;
     uint8_t alert_type = ALERT_NONE;
+    int16_t rate_x10 = level_rate_x10(*kalman);
     if (distance_cm >= 0) {
-        detect_anomalies(state, level_cm, seq, &flags, &alert_type, sensor_name);
+        detect_anomalies(state, level_cm, rate_x10, sample_clock_s, &flags, &alert_type, sensor_name);
     } else {
         // Sensor failure - mark as sensor error
         flags |= FLAG_IS_ALERT;
@@ -470,11 +741,29 @@ static void measure_and_send_sensor(gpio_num_t trig_gpio, gpio_num_t echo_gpio,
         ESP_LOGW(TAG, "%s: Marcando como erro de sensor", sensor_name);
     }
     
+#if CONFIG_NODE_REPORT_ON_DELTA
+    // Send only on a level change, a new alert or the heartbeat
+    report_policy::Reason reason = state->policy.on_sample(dt_s, (int16_t)level_cm, rate_x10, alert_type);
+    if (reason == report_policy::Reason::Skip) {
+        ESP_LOGI(TAG, "📉 %s: sem envio (Δ=%d cm, último pacote há %" PRIu32 " s, taxa %s cm/min)",
+                 sensor_name, level_cm - state->policy.level_sent(), state->policy.since_sent_s(),
+                 report_policy::rate_text(rate_x10).s);
+        return;
+    }
+    ESP_LOGI(TAG, "📤 %s: envio por %s (taxa %s cm/min)", sensor_name,
+             report_policy::reason_name(reason), report_policy::rate_text(rate_x10).s);
+    radio_start();
+#endif
+
+    // Get sequence number (a failed send still uses it up: the gateway may have got the packet)
+    const seq_counter::NvsStore seq_store = {NVS_NAMESPACE, seq_key};
+    uint32_t seq = state->seq.next(seq_store);
+
     // Build packet
     uint8_t dev_mac[6];
     get_device_mac(dev_mac);
-    SensorPacketV1 pkt{};
-    pkt.version = SENSOR_PACKET_VERSION;
+    SensorPacketV2 pkt{};
+    pkt.version = SENSOR_PACKET_V2_VERSION;
     pkt.node_id = node_id;
     memcpy(pkt.mac, dev_mac, sizeof(pkt.mac));
     pkt.seq = seq;
@@ -486,18 +775,22 @@ static void measure_and_send_sensor(gpio_num_t trig_gpio, gpio_num_t echo_gpio,
     pkt.flags = flags;
     pkt.alert_type = alert_type;
     pkt.rssi = 0;   // gateway fills
-    pkt.ts_ms = 0;  // gateway fills
+    pkt.ts_ms = 0;  // age: taken now (gateway converts to a timestamp)
+    pkt.rate_cmpm_x10 = rate_x10;
     
-    // Send via ESP-NOW with ACK
-    esp_err_t send_err = espnow_send_payload((const uint8_t*)&pkt, sizeof(pkt), seq, node_id);
+    // Send via ESP-NOW with ACK (kept in tx_backlog if no gateway confirms)
+    esp_err_t send_err = send_reading(pkt);
     if (send_err == ESP_OK) {
         ESP_LOGI(TAG, "✅ %s: Pacote enviado com sucesso (seq=%u)", sensor_name, seq);
-        nvs_set_seq(seq_key, seq);
         led_pattern_tx();
     } else {
         ESP_LOGE(TAG, "❌ %s: Falha no envio (seq=%u)", sensor_name, seq);
         led_pattern_error();
     }
+#if CONFIG_NODE_REPORT_ON_DELTA
+    // delivered or queued in tx_backlog: either way the gateway gets it
+    state->policy.on_sent((int16_t)level_cm, alert_type);
+#endif
 }
 
 /* ====== MAIN ====== */
@@ -521,10 +814,18 @@ extern "C" void app_main(void) {
     gpio_reset_pin(LED_GPIO);
     gpio_set_direction(LED_GPIO, GPIO_MODE_OUTPUT);
     led_set(false);
+#if CONFIG_NODE_DEEP_SLEEP
+    duty_cycle::log_wake(TAG);
+    if (!duty_cycle::woke_from_sleep()) {
+        led_pattern_boot();  // 1.2 s blocking: only on power-on
+    }
+#else
     led_pattern_boot();
+#endif
     
-    // Initialize ADC
+    // Initialize ADC and the air temperature source
     init_adc();
+    init_air_temp();
     
     // Print MAC address
     uint8_t mac[6];
@@ -532,69 +833,66 @@ extern "C" void app_main(void) {
     ESP_LOGI(TAG, "Device MAC: %02X:%02X:%02X:%02X:%02X:%02X",
              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
     
-    // Initialize WiFi and ESP-NOW
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_ERROR_CHECK(esp_wifi_set_channel(ESPNOW_CHANNEL, WIFI_SECOND_CHAN_NONE));
-    ESP_LOGI(TAG, "WiFi set to channel %d", ESPNOW_CHANNEL);
-    
-    ESP_ERROR_CHECK(esp_now_init());
-    ESP_ERROR_CHECK(esp_now_register_send_cb(espnow_send_cb));
-    ESP_ERROR_CHECK(esp_now_register_recv_cb(espnow_recv_cb));
-    
-    // Add gateway peers
-    for (int i = 0; i < MAX_GATEWAYS; i++) {
-        // Skip unconfigured gateways
-        bool is_configured = false;
-        for (int j = 0; j < 6; j++) {
-            if (GATEWAY_MACS[i][j] != 0xFF) {
-                is_configured = true;
-                break;
-            }
-        }
-        if (!is_configured) continue;
-        
-        esp_now_peer_info_t peer_info = {};
-        memcpy(peer_info.peer_addr, GATEWAY_MACS[i], 6);
-        peer_info.channel = ESPNOW_CHANNEL;
-        peer_info.ifidx = WIFI_IF_STA;
-        peer_info.encrypt = false;
-        
-        ret = esp_now_add_peer(&peer_info);
-        if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "Gateway %d registrado: %02X:%02X:%02X:%02X:%02X:%02X",
-                     i, GATEWAY_MACS[i][0], GATEWAY_MACS[i][1], GATEWAY_MACS[i][2],
-                     GATEWAY_MACS[i][3], GATEWAY_MACS[i][4], GATEWAY_MACS[i][5]);
-        }
-    }
-    
-    ESP_LOGI(TAG, "ESP-NOW initialized");
+#if CONFIG_NODE_REPORT_ON_DELTA
+    // Wi-Fi & ESP-NOW are started by the first send (radio_start)
+#else
+    radio_start();
+#endif
     ESP_LOGI(TAG, "🚀 Sistema iniciado! Intervalo de medição: %ds", SAMPLE_INTERVAL_S);
     ESP_LOGI(TAG, "");
     
+    // Ultrasonic sensors, measured together (interleaved trigger slots)
+    const ultrasonic01::Pins sensors[2] = {
+        {TRIG_GPIO_1, ECHO_GPIO_1},
+        {TRIG_GPIO_2, ECHO_GPIO_2},
+    };
+    ultrasonic01::init_pins(sensors[0]);
+    ultrasonic01::init_pins(sensors[1]);
+    ultrasonic01::Schedule schedule;
+    schedule.samples = ULTRA_SAMPLE_RETRIES;
+    schedule.guard_ms = ULTRA_GUARD_MS;
+    schedule.rearm_ms = ULTRA_MEASURE_DELAY_MS;
+    
     // Main loop
     while (1) {
-        // Measure and send SENSOR 1 (CIE1)
-        measure_and_send_sensor(TRIG_GPIO_1, ECHO_GPIO_1, NODE_ID_1, 
-                               NVS_SEQ_KEY_1, &sensor1_state, "CIE1");
+        uint32_t dt_s = last_interval_s;
+        sample_clock_s += dt_s;
+
+        // Both sensors in one pass: CIE1, CIE2, CIE1, CIE2, ...
+        ultrasonic01::Samples samples[2];
+        update_sound_speed();
+        int64_t t_measure = esp_timer_get_time();
+        ultrasonic01::measure_interleaved(sensors, samples, schedule, us_timings);
+        ESP_LOGI(TAG, "⏱ Medição CIE1+CIE2 em %lld ms", (long long)((esp_timer_get_time() - t_measure) / 1000));
         
-        // Small delay between sensors to avoid GPIO interference
-        vTaskDelay(pdMS_TO_TICKS(INTER_SENSOR_DELAY_MS));
+        // Send SENSOR 1 (CIE1)
+        measure_and_send_sensor(samples[0], NODE_ID_1,
+                               NVS_SEQ_KEY_1, &sensor1_state, "CIE1", dt_s);
         
-        // Measure and send SENSOR 2 (CIE2)
-        measure_and_send_sensor(TRIG_GPIO_2, ECHO_GPIO_2, NODE_ID_2,
-                               NVS_SEQ_KEY_2, &sensor2_state, "CIE2");
+        // Send SENSOR 2 (CIE2)
+        measure_and_send_sensor(samples[1], NODE_ID_2,
+                               NVS_SEQ_KEY_2, &sensor2_state, "CIE2", dt_s);
         
+        // Both sensors share the measurement pass: the faster of the two intervals
+        uint32_t interval_s = SAMPLE_INTERVAL_S;
+#if CONFIG_NODE_REPORT_ON_DELTA
+        interval_s = sensor1_state.policy.interval_s();
+        if (sensor2_state.policy.interval_s() < interval_s) {
+            interval_s = sensor2_state.policy.interval_s();
+        }
+#endif
+        last_interval_s = interval_s;
+
         ESP_LOGI(TAG, "");
-        ESP_LOGI(TAG, "⏳ Aguardando %ds até próxima medição...", SAMPLE_INTERVAL_S);
+        ESP_LOGI(TAG, "⏳ Aguardando %" PRIu32 "s até próxima medição...", interval_s);
         ESP_LOGI(TAG, "");
         
         // Wait for next cycle
-        vTaskDelay(pdMS_TO_TICKS(SAMPLE_INTERVAL_S * 1000));
+#if CONFIG_NODE_DEEP_SLEEP
+        // ACKs already awaited in espnow_send_payload(); sleep until the next period
+        duty_cycle::sleep_until_next(interval_s, TAG);
+#else
+        vTaskDelay(pdMS_TO_TICKS(interval_s * 1000));
+#endif
     }
 }
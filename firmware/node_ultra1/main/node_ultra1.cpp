@@ -2,6 +2,7 @@
 // ESP-IDF firmware for ESP32-C3 Supermini
 // - Ultrasonic HC-SR04 (trig = GPIO_NUM_1, echo = GPIO_NUM_0)
 // - ADC Vin (GPIO_NUM_4) with V/2 divider
+// - optional NTC thermistor (GPIO_NUM_3) or internal sensor for the speed of sound
 // - ESP-NOW broadcast send
 // - integer-only calculations (1 cm resolution, integer % and liters)
 // - seq counter persisted in NVS
@@ -34,7 +35,17 @@
 
 // Modules
 #include "components/ultrasonic01/ultrasonic01.h"
+#include "components/ultrasonic01/air_temperature.h"
 #include "components/level_calculator/level_calculator.h"
+#include "components/adc_oversample/adc_oversample.h"
+#include "components/duty_cycle/duty_cycle.h"
+#include "components/seq_counter/seq_counter.h"
+#include "components/seq_counter/nvs_store.h"
+#include "components/ack_wait/ack_wait.h"
+#include "components/sample_batch/sample_batch.h"
+#include "components/report_policy/report_policy.h"
+#include "components/store_forward/store_forward.h"
+#include "components/gateway_table/gateway_table.h"
 #include "common/telemetry_packet.h"
 
 static const char *TAG = "node_ultra01";
@@ -53,31 +64,72 @@ static const char *TAG = "node_ultra01";
 #endif
 
 /* Telemetry / tank model */
+#define NODE_ID           3        // Node 3 - RCB3 - Casa de Bombas 03
 #define VOL_MAX_L         80000    // liters (vol_max)
 #define LEVEL_MAX_CM      450      // cm (level_max)
 #define SENSOR_OFFSET_CM  20       // sensor_offset (sensor is 20cm above level_max)
 
+/* Tank shape: level -> volume table computed at compile time (level_calculator.h).
+   prism = volume proportional to level. Other shapes, e.g.
+     level_calculator::Geometry::horizontal_cylinder(250, 600, 125)   // Ø250 x 600 cm, hemispherical heads
+     level_calculator::Geometry::vertical_cylinder(300, LEVEL_MAX_CM, level_calculator::End::CONE, 90)
+   or a strapping table (level_calculator::StrapPoint[]); VOL_MAX_L then comes from the shape. */
+#define TANK_GEOMETRY     level_calculator::Geometry::prism(VOL_MAX_L, LEVEL_MAX_CM)
+static constexpr level_calculator::VolumeTable<> TANK_TABLE(TANK_GEOMETRY, LEVEL_MAX_CM);
+
 /* Sampling and retries */
-#define SAMPLE_INTERVAL_S     30    // loop interval in seconds (was deep sleep; now active loop)
-#define ULTRA_SAMPLE_RETRIES  3     // number of ultrasonic readings to take (for median)
+#if CONFIG_NODE_BATCH_TELEMETRY
+#define SAMPLE_INTERVAL_S     5     // sample every 5 s, transmit in batches (see BATCH_FLUSH_*)
+#else
+#define SAMPLE_INTERVAL_S     30    // loop interval in seconds (active loop, or deep-sleep period with CONFIG_NODE_DEEP_SLEEP)
+#endif
+#define BATCH_FLUSH_SAMPLES   12    // CONFIG_NODE_BATCH_TELEMETRY: send when this many samples are buffered,
+#define BATCH_FLUSH_AGE_S     60    //   or when the oldest is this old; alerts are sent right away
+#define REPORT_DELTA_CM          3  // CONFIG_NODE_REPORT_ON_DELTA: send when the level moved this much,
+#define REPORT_HEARTBEAT_S       600 //   on a new alert, or at least every 10 min
+#define REPORT_FAST_INTERVAL_S   5  // sampling interval while the level moves faster than
+#define REPORT_FAST_RATE_CM_MIN  2  //   this many cm/min (SAMPLE_INTERVAL_S otherwise)
+
+#if CONFIG_NODE_BATCH_TELEMETRY && CONFIG_NODE_REPORT_ON_DELTA
+#error "CONFIG_NODE_BATCH_TELEMETRY and CONFIG_NODE_REPORT_ON_DELTA are exclusive"
+#endif
+#define ULTRA_SAMPLE_RETRIES  3     // ultrasonic readings per cycle (robust_estimate; see tools/robust_bench)
 #define ULTRA_MEASURE_DELAY_MS 60   // delay between raw ultrasonic attempts
-#define ESPNOW_SEND_RETRIES   2
+#define ESPNOW_SEND_RETRIES   2     // passes over the gateway table (one attempt per gateway each)
+#define ACK_TIMEOUT_MS        500   // max wait for the gateway ACK (gateway with no RTT history yet)
+#define ACK_TIMEOUT_MIN_MS    150   // floor of the adaptive wait (4x the gateway's average RTT)
+#define GATEWAY_DISCOVERY_MS  1500  // listen for beacons when no gateway is known
 
 /* Ultrasonic validation */
 #define MIN_VALID_CM    5
 #define MAX_VALID_CM    450
 
+/* Air temperature for the speed of sound (CONFIG_NODE_AIR_TEMP_*, sound_speed.h) */
+#define AIR_TEMP_OFFSET_C_X10  0              // added to every reading (0.1 °C), set against a thermometer
+#define NTC_ADC_CHANNEL        ADC_CHANNEL_3  // ADC1 channel 3 = GPIO3 (CONFIG_NODE_AIR_TEMP_NTC)
+#define NTC_SUPPLY_MV          3300           // divider supply: 3V3 -- 10k -- GPIO3 -- NTC -- GND
+static constexpr ultrasonic01::NtcTable NTC_TABLE(ultrasonic01::NtcModel{10000, 3950, 10000});  // r25, beta, r_fixed
+
+#if CONFIG_NODE_VIN_CONTINUOUS && CONFIG_NODE_AIR_TEMP_NTC
+#error "CONFIG_NODE_VIN_CONTINUOUS and CONFIG_NODE_AIR_TEMP_NTC are exclusive (the continuous ADC owns ADC1)"
+#endif
+
 /* Anomaly detection thresholds */
 #define RAPID_CHANGE_THRESHOLD_CM  50   // 50cm change triggers alert
+#define RAPID_RATE_CM_MIN          10   // filtered level rate (cm/min) that triggers alert
+#define RATE_MAX_VAR               4    // rate trusted once its variance is below this ((cm/min)^2)
 #define NO_CHANGE_MINUTES          120  // 2 hours without change triggers sensor stuck alert
 #define NO_CHANGE_THRESHOLD_CM     2    // Within ±2cm considered "no change"
 
 /* ADC configuration */
 #define ADC_ATTEN        ADC_ATTEN_DB_12
 #define ADC_BITWIDTH     ADC_BITWIDTH_12
+#define VIN_SAMPLE_HZ    1000   // CONFIG_NODE_VIN_CONTINUOUS: Vin conversions per second (DMA),
+#define VIN_DECIMATION   64     //   one CIC-filtered value per 64 samples (see tools/adc_oversample_bench)
 
 /* ESP-NOW configuration */
-/* Multiple gateway MAC addresses for redundancy/failover */
+/* Configured gateways (seeds of the gateway table; others are learned from
+   their beacons, no reflash needed) */
 #define MAX_GATEWAYS 3
 static const uint8_t GATEWAY_MACS[MAX_GATEWAYS][6] = {
     {0x80, 0xf3, 0xda, 0x62, 0xa7, 0x84},  // Gateway 1 (ESP32 DevKit V1)
@@ -91,27 +143,84 @@ static const uint8_t GATEWAY_MACS[MAX_GATEWAYS][6] = {
 
 /* NVS keys */
 #define NVS_NAMESPACE "node_cfg"
-#define NVS_SEQ_KEY   "seq"
-#define NVS_LAST_GW_KEY "last_gw"  // Last successful gateway index
+#define NVS_SEQ_KEY   "seq"      // seq reservation (SeqCounter checkpoint)
+#define NVS_LAST_GW_KEY "last_gw_mac"  // MAC of the last gateway that ACKed
 
 // Use ultrasonic01 module instead of local implementation
 
+#if CONFIG_NODE_VIN_CONTINUOUS
+/* Vin oversampled in the background (adc_continuous + CIC decimator) */
+static adc_oversample::AdcOversampler<VIN_DECIMATION> vin_adc;
+#else
 /* ADC handles (global) */
 static adc_oneshot_unit_handle_t adc1_handle = NULL;
 static adc_cali_handle_t adc1_cali_handle = NULL;
+#endif
+
+/* Air temperature source and the ultrasonic timings carrying its
+   speed-of-sound scale (update_sound_speed) */
+static ultrasonic01::AirTemperature air_temp;
+static ultrasonic01::Timings us_timings;
 
-/* ACK tracking */
-static volatile bool ack_received = false;
-static volatile uint32_t ack_seq_received = 0;
-static volatile uint8_t ack_gateway_id = 0xFF;
+/* ACK tracking: espnow_recv_cb notifies the sending task; round trips in a histogram */
+static ack_wait::AckWaiter ack_waiter;
+static DUTY_CYCLE_RETAINED ack_wait::RttHistogram ack_rtt = {};
+
+/* Kalman filter for the ultrasonic sensor: distance + rate (persistent across
+   measurements; Q16.16, no soft-float) */
+static DUTY_CYCLE_RETAINED ultrasonic01::KalmanCvQ16 kalman_filter(
+    ultrasonic01::Q16(1), ultrasonic01::Q16(2), ultrasonic01::Q16(25));  // accel_noise=1, measurement_noise=2, initial_rate_var=25
+
+/* Filtered level rate for the packet (0.1 cm/min, + = filling), or
+   SENSOR_RATE_UNKNOWN until the filter has settled */
+static int16_t level_rate_x10(void) {
+    if (kalman_filter.rate_var() > ultrasonic01::Q16(RATE_MAX_VAR)) {
+        return SENSOR_RATE_UNKNOWN;
+    }
+    // the filter tracks distance: the level moves the other way
+    return (int16_t)-ultrasonic01::rate_x10(kalman_filter.rate_cm_min());
+}
 
 /* Anomaly detection state (persistent across measurements) */
-static int16_t last_level_cm = -1;  // Previous water level
-static uint32_t last_change_seq = 0;  // Sequence when last level change detected
-static bool anomaly_detection_initialized = false;
+static DUTY_CYCLE_RETAINED int16_t last_level_cm = -1;  // Previous water level
+static DUTY_CYCLE_RETAINED uint32_t last_change_s = 0;  // sample_clock_s when last level change detected
+static DUTY_CYCLE_RETAINED bool anomaly_detection_initialized = false;
+
+/* Packet seq (checkpointed to NVS every SEQ_COUNTER_CHECKPOINT_EVERY sends) */
+static DUTY_CYCLE_RETAINED seq_counter::SeqCounter tx_seq;
+static const seq_counter::NvsStore seq_store = {NVS_NAMESPACE, NVS_SEQ_KEY};
+
+/* Gateways ranked by RSSI / ACK latency, learned from beacons and ACKs
+   (espnow_recv_cb, Wi-Fi task: guarded by gw_lock). The last gateway that
+   ACKed goes to NVS when it changes, for the first send after power-on. */
+static_assert(MAX_GATEWAYS < GATEWAY_TABLE_CAPACITY, "leave room in the gateway table for learned gateways");
+static DUTY_CYCLE_RETAINED gateway_table::Table gw_table;
+static DUTY_CYCLE_RETAINED bool gw_table_loaded = false;
+static portMUX_TYPE gw_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Node time (sum of the sampling intervals, kept across deep sleep) and the
+   interval slept before the current sample (0 before the first one) */
+static DUTY_CYCLE_RETAINED uint32_t sample_clock_s = 0;
+static DUTY_CYCLE_RETAINED uint32_t last_interval_s = 0;
+
+#if CONFIG_NODE_REPORT_ON_DELTA
+/* Send-on-delta: decides which samples are transmitted and the sampling interval */
+static DUTY_CYCLE_RETAINED report_policy::ReportPolicy tx_policy({
+    REPORT_DELTA_CM, REPORT_HEARTBEAT_S, SAMPLE_INTERVAL_S, REPORT_FAST_INTERVAL_S, REPORT_FAST_RATE_CM_MIN * 10});
+#endif
+
+#if CONFIG_NODE_BATCH_TELEMETRY
+/* Batched telemetry: samples waiting to be sent */
+static DUTY_CYCLE_RETAINED sample_batch::SampleBatch tx_batch;
+static_assert(BATCH_FLUSH_SAMPLES <= SAMPLE_BATCH_CAPACITY, "BATCH_FLUSH_SAMPLES exceeds the batch capacity");
+static DUTY_CYCLE_RETAINED uint32_t batch_retry_in = 0;  // samples to wait before retrying a failed flush
+#else
+/* Store-and-forward: readings no gateway confirmed, resent oldest-first */
+static DUTY_CYCLE_RETAINED store_forward::Ring tx_backlog;
+#endif
 
 /* Transmission statistics */
-static struct {
+static DUTY_CYCLE_RETAINED struct {
     uint32_t total_attempts;
     uint32_t successful_acks;
     uint32_t failed_acks;
@@ -121,6 +230,15 @@ static struct {
    Returns integer mV value (vin_mv), or -1 on failure.
 */
 static int read_vin_mv(void) {
+#if CONFIG_NODE_VIN_CONTINUOUS
+    adc_oversample::Reading r = vin_adc.read();
+    if (!r.valid) return -1;
+    if (r.count > 0) {
+        ESP_LOGI(TAG, "🔋 Vin %d mV (mín %d, máx %d; %" PRIu32 " médias de %d amostras)",
+                 r.avg_mv * 2, r.min_mv * 2, r.max_mv * 2, r.count, VIN_DECIMATION);
+    }
+    return r.avg_mv * 2;  // V/2 divider
+#else
     if (!adc1_handle) return -1;
     
     int raw = 0;
@@ -138,51 +256,26 @@ static int read_vin_mv(void) {
     // account divider (V/2) => Vin_mv = voltage_mv * 2
     int vin_mv = voltage_mv * 2;
     return vin_mv;
+#endif
 }
 
-/* NVS helpers for seq */
-static esp_err_t nvs_get_seq(uint32_t *seq_out) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
-    if (err == ESP_OK) {
-        uint32_t val = 0;
-        err = nvs_get_u32(h, NVS_SEQ_KEY, &val);
-        if (err == ESP_OK) *seq_out = val;
-        nvs_close(h);
-    }
-    return err;
-}
-static esp_err_t nvs_set_seq(uint32_t seq) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
-    if (err == ESP_OK) {
-        err = nvs_set_u32(h, NVS_SEQ_KEY, seq);
-        if (err == ESP_OK) err = nvs_commit(h);
-        nvs_close(h);
-    }
-    return err;
-}
-
-/* NVS helpers for last successful gateway */
-static uint8_t nvs_get_last_gateway(void) {
+/* NVS helpers for the last gateway that ACKed */
+static bool nvs_get_last_gateway(uint8_t mac[6]) {
     nvs_handle_t h;
-    uint8_t gw_idx = 0;  // Default to first gateway
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
-    if (err == ESP_OK) {
-        nvs_get_u8(h, NVS_LAST_GW_KEY, &gw_idx);
+    size_t len = 6;
+    bool ok = false;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &h) == ESP_OK) {
+        ok = nvs_get_blob(h, NVS_LAST_GW_KEY, mac, &len) == ESP_OK && len == 6;
         nvs_close(h);
     }
-    // Validate index
-    if (gw_idx >= MAX_GATEWAYS) gw_idx = 0;
-    return gw_idx;
+    return ok;
 }
 
-static void nvs_set_last_gateway(uint8_t gw_idx) {
-    if (gw_idx >= MAX_GATEWAYS) return;
+static void nvs_set_last_gateway(const uint8_t mac[6]) {
     nvs_handle_t h;
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
     if (err == ESP_OK) {
-        nvs_set_u8(h, NVS_LAST_GW_KEY, gw_idx);
+        nvs_set_blob(h, NVS_LAST_GW_KEY, mac, 6);
         nvs_commit(h);
         nvs_close(h);
     }
@@ -196,73 +289,135 @@ static bool is_gateway_valid(uint8_t gw_idx) {
              mac[3] == 0xFF && mac[4] == 0xFF && mac[5] == 0xFF);
 }
 
-/* ESP-NOW send with automatic gateway failover and ACK wait */
-static esp_err_t espnow_send_payload(const uint8_t *data, size_t len, uint32_t expected_seq) {
+/* Node clock for the gateway table (keeps going across deep sleep) */
+static uint32_t gw_now_s(void) {
+    return (uint32_t)(duty_cycle::uptime_ms() / 1000);
+}
+
+/* Once per power-on: configured gateways as seeds, then the last one that
+   ACKed (NVS) as the preferred one */
+static void gw_table_load(void) {
+    if (gw_table_loaded) {
+        return;
+    }
+    uint8_t last[6];
+    bool have_last = nvs_get_last_gateway(last);
+    portENTER_CRITICAL(&gw_lock);
+    for (uint8_t i = 0; i < MAX_GATEWAYS; i++) {
+        if (is_gateway_valid(i)) {
+            gw_table.seed(GATEWAY_MACS[i]);
+        }
+    }
+    if (have_last) {
+        gw_table.prefer(last, gw_now_s());
+    }
+    portEXIT_CRITICAL(&gw_lock);
+    gw_table_loaded = true;
+}
+
+static int gw_count(void) {
+    portENTER_CRITICAL(&gw_lock);
+    int n = gw_table.count();
+    portEXIT_CRITICAL(&gw_lock);
+    return n;
+}
+
+/* Unicast needs the gateway registered as an ESP-NOW peer (learned ones on first use) */
+static esp_err_t ensure_peer(const uint8_t mac[6]) {
+    if (esp_now_is_peer_exist(mac)) {
+        return ESP_OK;
+    }
+    esp_now_peer_info_t peer_info = {};
+    memcpy(peer_info.peer_addr, mac, 6);
+    peer_info.channel = ESPNOW_CHANNEL;
+    peer_info.ifidx = WIFI_IF_STA;
+    peer_info.encrypt = false;
+    esp_err_t err = esp_now_add_peer(&peer_info);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add gateway " MACSTR ": %s", MAC2STR(mac), esp_err_to_name(err));
+    }
+    return err;
+}
+
+/* Nothing configured and nothing heard yet: listen for a beacon */
+static bool wait_for_gateway(uint32_t timeout_ms) {
+    ESP_LOGW(TAG, "📡 Nenhum gateway conhecido - aguardando beacon (%u ms)", (unsigned)timeout_ms);
+    for (uint32_t waited = 0; waited < timeout_ms; waited += 50) {
+        if (gw_count() > 0) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+    return gw_count() > 0;
+}
+
+/* ESP-NOW send to the gateway table, best gateway first, one attempt per
+   gateway (adaptive ACK wait) so a dead gateway costs a single timeout;
+   ESPNOW_SEND_RETRIES passes, backoff only between passes */
+static esp_err_t espnow_send_payload(const uint8_t *data, size_t len, uint32_t expected_seq, uint8_t node_id) {
     tx_stats.total_attempts++;
-    
-    // Try last successful gateway first
-    uint8_t start_gw = nvs_get_last_gateway();
-    
-    // Round-robin through all configured gateways
-    for (uint8_t attempt = 0; attempt < MAX_GATEWAYS; attempt++) {
-        uint8_t gw_idx = (start_gw + attempt) % MAX_GATEWAYS;
-        
-        // Skip unconfigured gateways (0xFF:FF:FF:FF:FF:FF)
-        if (!is_gateway_valid(gw_idx)) {
-            continue;
+
+    if (gw_count() == 0) {
+        wait_for_gateway(GATEWAY_DISCOVERY_MS);
+    }
+
+    for (int pass = 0; pass < ESPNOW_SEND_RETRIES; pass++) {
+        if (pass > 0) {
+            vTaskDelay(pdMS_TO_TICKS(100 * (1 << (pass - 1))));  // Exponential backoff
         }
-        
-        const uint8_t *gw_mac = GATEWAY_MACS[gw_idx];
-        ESP_LOGI(TAG, "Trying gateway %d: %02X:%02X:%02X:%02X:%02X:%02X",
-                 gw_idx, gw_mac[0], gw_mac[1], gw_mac[2], gw_mac[3], gw_mac[4], gw_mac[5]);
-        
-        // Retry sending to this gateway
-        for (int retry = 0; retry < ESPNOW_SEND_RETRIES; retry++) {
-            // Reset ACK flag
-            ack_received = false;
-            ack_seq_received = 0;
-            
-            esp_err_t err = esp_now_send(gw_mac, data, len);
-            if (err != ESP_OK) {
-                ESP_LOGW(TAG, "Gateway %d retry %d send failed: %s", gw_idx, retry, esp_err_to_name(err));
-                vTaskDelay(pdMS_TO_TICKS(100 * (1 << retry)));  // Exponential backoff
+        // Re-ranked every pass: beacons heard meanwhile and this pass's misses count
+        gateway_table::Entry ranked[GATEWAY_TABLE_CAPACITY];
+        uint32_t now_s = gw_now_s();
+        portENTER_CRITICAL(&gw_lock);
+        int n = gw_table.rank(ranked, GATEWAY_TABLE_CAPACITY, now_s);
+        portEXIT_CRITICAL(&gw_lock);
+
+        for (int i = 0; i < n; i++) {
+            const gateway_table::Entry &gw = ranked[i];
+            uint32_t timeout_ms = gateway_table::Table::ack_timeout_ms(gw, ACK_TIMEOUT_MIN_MS, ACK_TIMEOUT_MS);
+            ESP_LOGI(TAG, "Trying gateway " MACSTR " (id=%d, rssi=%d, ack wait %u ms, pass %d)",
+                     MAC2STR(gw.mac), gw.gateway_id == gateway_table::ID_UNKNOWN ? -1 : gw.gateway_id,
+                     gw.rssi_dbm(), (unsigned)timeout_ms, pass);
+            if (ensure_peer(gw.mac) != ESP_OK) {
                 continue;
             }
-            
-            // Wait for ACK with timeout
-            #define ACK_TIMEOUT_MS 500
-            int64_t start_time = esp_timer_get_time();
-            bool ack_ok = false;
-            
-            while ((esp_timer_get_time() - start_time) < (ACK_TIMEOUT_MS * 1000)) {
-                if (ack_received && ack_seq_received == expected_seq) {
-                    ack_ok = true;
-                    break;
-                }
-                vTaskDelay(pdMS_TO_TICKS(10));  // Check every 10ms
-            }
-            
-            if (ack_ok) {
+
+            ack_waiter.arm(node_id, expected_seq, gw.mac);
+            esp_err_t err = esp_now_send(gw.mac, data, len);
+            // Block until espnow_recv_cb delivers the matching ACK (or timeout)
+            AckPacket ack;
+            if (err == ESP_OK && ack_waiter.wait(timeout_ms, ack_rtt, &ack)) {
                 tx_stats.successful_acks++;
                 int success_rate = (tx_stats.successful_acks * 100) / tx_stats.total_attempts;
-                
-                ESP_LOGI(TAG, "✓ Sent successfully to gateway %d (retry %d) with ACK confirmation", gw_idx, retry);
+
+                ESP_LOGI(TAG, "✓ Sent successfully to gateway " MACSTR " (pass %d) with ACK confirmation (rtt=%lld us, rssi=%d, status=%u)",
+                         MAC2STR(gw.mac), pass, (long long)ack_waiter.last_rtt_us(), ack.rssi, ack.status);
                 ESP_LOGI(TAG, "📊 Stats: %u/%u successful (%.1f%% success rate)", 
                          tx_stats.successful_acks, tx_stats.total_attempts, success_rate / 10.0);
-                
-                // Save this gateway as last successful
-                if (gw_idx != start_gw) {
-                    ESP_LOGI(TAG, "Gateway failover: %d -> %d", start_gw, gw_idx);
-                    nvs_set_last_gateway(gw_idx);
+                ack_rtt.log(TAG);
+
+                // This gateway is now preferred; NVS only when it changes
+                uint8_t prev[6];
+                portENTER_CRITICAL(&gw_lock);
+                bool had_prev = gw_table.preferred(prev);
+                gw_table.acked(gw.mac, (uint32_t)ack_waiter.last_rtt_us());
+                portEXIT_CRITICAL(&gw_lock);
+                if (!had_prev || memcmp(prev, gw.mac, 6) != 0) {
+                    ESP_LOGI(TAG, "Gateway failover: -> " MACSTR, MAC2STR(gw.mac));
+                    nvs_set_last_gateway(gw.mac);
                 }
                 return ESP_OK;
+            }
+
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Gateway " MACSTR " send failed: %s", MAC2STR(gw.mac), esp_err_to_name(err));
             } else {
-                ESP_LOGW(TAG, "Gateway %d retry %d: packet sent but no ACK received", gw_idx, retry);
-                vTaskDelay(pdMS_TO_TICKS(100 * (1 << retry)));  // Exponential backoff
+                ESP_LOGW(TAG, "Gateway " MACSTR ": packet sent but no ACK received", MAC2STR(gw.mac));
             }
+            portENTER_CRITICAL(&gw_lock);
+            gw_table.missed(gw.mac);
+            portEXIT_CRITICAL(&gw_lock);
         }
-        
-        ESP_LOGE(TAG, "✗ Gateway %d failed after %d retries", gw_idx, ESPNOW_SEND_RETRIES);
     }
     
     tx_stats.failed_acks++;
@@ -270,6 +425,7 @@ static esp_err_t espnow_send_payload(const uint8_t *data, size_t len, uint32_t e
     ESP_LOGE(TAG, "📊 Stats: %u/%u successful (%.1f%% success rate)", 
              tx_stats.successful_acks, tx_stats.total_attempts, 
              (tx_stats.successful_acks * 100.0) / tx_stats.total_attempts);
+    ack_rtt.log(TAG);
     
     return ESP_FAIL;
 }
@@ -353,39 +509,82 @@ static inline void led_pattern_error(void) {
     led_pattern_start(6, 70, 70);
 }
 
-// JSON builder removed in favor of a compact binary packet (SensorPacketV1)
+// JSON builder removed in favor of a compact binary packet (SensorPacketV2)
 
 // Use level_calculator module instead of local implementation
 
-/* Get device MAC (STA MAC) as ID */
+#if !CONFIG_NODE_BATCH_TELEMETRY
+/* Get device MAC (STA MAC) as ID (the gateway takes a batch's MAC from the frame) */
 static void get_device_mac(uint8_t mac_out[6]) {
     esp_read_mac(mac_out, ESP_MAC_WIFI_STA);
 }
+#endif
 
-/* ESP-NOW receive callback - handles ACK packets from gateway */
+/* ESP-NOW receive callback - ACKs and beacons from gateways (both feed the gateway table) */
 static void espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len) {
+    int rssi = recv_info->rx_ctrl ? recv_info->rx_ctrl->rssi : gateway_table::RSSI_UNHEARD_DBM;
+
     // Check if it's an ACK packet
     if (len == sizeof(AckPacket)) {
         AckPacket *ack = (AckPacket*)data;
         
         // Validate ACK
         if (ack->magic == ACK_MAGIC && ack->version == ACK_VERSION) {
-            ack_received = true;
-            ack_seq_received = ack->ack_seq;
-            ack_gateway_id = ack->gateway_id;
+            uint32_t now_s = gw_now_s();
+            portENTER_CRITICAL(&gw_lock);
+            gw_table.heard_ack(recv_info->src_addr, rssi, ack->gateway_id, now_s);
+            portEXIT_CRITICAL(&gw_lock);
+            bool matched = ack_waiter.deliver(recv_info->src_addr, *ack);
             
-            ESP_LOGI(TAG, "✓ ACK recebido: seq=%u, rssi=%d, gateway=%u, status=%u",
-                     ack->ack_seq, ack->rssi, ack->gateway_id, ack->status);
+            ESP_LOGD(TAG, "✓ ACK recebido: seq=%u, rssi=%d, gateway=%u, status=%u%s",
+                     ack->ack_seq, ack->rssi, ack->gateway_id, ack->status, matched ? "" : " (não esperado)");
         } else {
             ESP_LOGW(TAG, "ACK inválido: magic=0x%02X, version=%u", ack->magic, ack->version);
         }
+    } else if (len == sizeof(GatewayBeacon) && data[0] == GATEWAY_BEACON_MAGIC) {
+        const GatewayBeacon *beacon = (const GatewayBeacon *)data;
+        if (beacon->version != GATEWAY_BEACON_VERSION) {
+            return;
+        }
+        uint32_t now_s = gw_now_s();
+        portENTER_CRITICAL(&gw_lock);
+        bool added = gw_table.heard_beacon(recv_info->src_addr, rssi, *beacon, now_s);
+        portEXIT_CRITICAL(&gw_lock);
+        if (added) {
+            ESP_LOGI(TAG, "📡 Novo gateway " MACSTR " (id=%u, rssi=%d)",
+                     MAC2STR(recv_info->src_addr), beacon->gateway_id, rssi);
+        } else {
+            ESP_LOGD(TAG, "📡 Beacon " MACSTR " id=%u rssi=%d seq=%u", MAC2STR(recv_info->src_addr),
+                     beacon->gateway_id, rssi, beacon->beacon_seq);
+        }
     } else {
         ESP_LOGD(TAG, "espnow recv len=%d from " MACSTR, len, MAC2STR(recv_info->src_addr));
     }
 }
 
+#if CONFIG_NODE_VIN_CONTINUOUS
+/* Vin through the continuous-mode ADC (DMA): oversampled and decimated in
+   the background, read_vin_mv() only takes the window. Owns ADC1 (no
+   oneshot unit). */
+static void init_vin_continuous(void) {
+    adc_oversample::Config cfg = {ADC_CHANNEL_VIN};
+    cfg.sample_hz = VIN_SAMPLE_HZ;
+    cfg.atten = ADC_ATTEN;
+    esp_err_t err = vin_adc.start(cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ADC contínuo falhou: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "🔋 Vin contínuo: %d Hz, CIC /%d (%s)", VIN_SAMPLE_HZ, VIN_DECIMATION,
+             vin_adc.calibrated() ? "calibrado" : "sem calibração");
+}
+#endif
+
 /* Initialize ADC */
 static void init_adc(void) {
+#if CONFIG_NODE_VIN_CONTINUOUS
+    init_vin_continuous();  // the DMA driver owns ADC1: no oneshot unit
+#else
     // Configurar ADC oneshot
     adc_oneshot_unit_init_cfg_t init_config = {
         .unit_id = ADC_UNIT_VIN,
@@ -421,6 +620,37 @@ static void init_adc(void) {
         ESP_LOGW(TAG, "ADC calibration not available, using raw values");
         adc1_cali_handle = NULL;
     }
+#endif
+}
+
+/* Air temperature source, set from CONFIG_NODE_AIR_TEMP_* (after init_adc) */
+static void init_air_temp(void) {
+#if CONFIG_NODE_AIR_TEMP_INTERNAL
+    esp_err_t err = air_temp.use_internal(AIR_TEMP_OFFSET_C_X10);
+#elif CONFIG_NODE_AIR_TEMP_NTC
+    esp_err_t err = air_temp.use_ntc(adc1_handle, NTC_ADC_CHANNEL, NTC_TABLE, NTC_SUPPLY_MV, AIR_TEMP_OFFSET_C_X10);
+#else
+    esp_err_t err = ESP_OK;
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "🌡️ Sensor de temperatura do ar indisponível (%s): distância com us/58", esp_err_to_name(err));
+    }
+}
+
+/* Speed-of-sound scale for this cycle's measurements, from the air
+   temperature (us/58 when there is no source or the reading failed) */
+static void update_sound_speed(void) {
+    if (!air_temp.configured()) {
+        return;
+    }
+    int t = air_temp.read_c_x10();
+    us_timings.sound_scale_q16 = ultrasonic01::sound_scale_q16(t);
+    if (t == ultrasonic01::TEMP_INVALID) {
+        ESP_LOGW(TAG, "🌡️ Leitura da temperatura do ar falhou: distância com us/58");
+    } else {
+        ESP_LOGI(TAG, "🌡️ Ar %s%d.%d °C: velocidade do som x%" PRIu32 "/65536", t < 0 ? "-" : "",
+                 abs(t) / 10, abs(t) % 10, us_timings.sound_scale_q16);
+    }
 }
 
 /* Initialize ESP-NOW (WiFi must be initialized) */
@@ -477,53 +707,114 @@ static esp_err_t init_espnow(void) {
     }
     esp_now_register_recv_cb(espnow_recv_cb);
     
-    // Register all configured gateways as peers
-    int peers_added = 0;
-    for (uint8_t i = 0; i < MAX_GATEWAYS; i++) {
-        if (!is_gateway_valid(i)) {
-            ESP_LOGW(TAG, "Gateway %d not configured (skipping)", i);
-            continue;
+    // Configured gateways (and the last one that ACKed) as peers; gateways
+    // learned from beacons are added on first use
+    gw_table_load();
+    gateway_table::Entry known[GATEWAY_TABLE_CAPACITY];
+    uint32_t now_s = gw_now_s();
+    portENTER_CRITICAL(&gw_lock);
+    int n = gw_table.rank(known, GATEWAY_TABLE_CAPACITY, now_s);
+    portEXIT_CRITICAL(&gw_lock);
+    for (int i = 0; i < n; i++) {
+        if (ensure_peer(known[i].mac) == ESP_OK) {
+            ESP_LOGI(TAG, "Gateway %d peer added: " MACSTR " (channel %d, rssi=%d)",
+                     i, MAC2STR(known[i].mac), ESPNOW_CHANNEL, known[i].rssi_dbm());
         }
-        
-        esp_now_peer_info_t peer_info = {};
-        memcpy(peer_info.peer_addr, GATEWAY_MACS[i], 6);
-        peer_info.channel = ESPNOW_CHANNEL;
-        peer_info.ifidx = WIFI_IF_STA;
-        peer_info.encrypt = false;
-        
-        err = esp_now_add_peer(&peer_info);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to add gateway %d: %s", i, esp_err_to_name(err));
-            continue;
-        }
-        
-        ESP_LOGI(TAG, "Gateway %d peer added: %02X:%02X:%02X:%02X:%02X:%02X (channel %d)",
-                 i, GATEWAY_MACS[i][0], GATEWAY_MACS[i][1], GATEWAY_MACS[i][2],
-                 GATEWAY_MACS[i][3], GATEWAY_MACS[i][4], GATEWAY_MACS[i][5], ESPNOW_CHANNEL);
-        peers_added++;
     }
-    
-    if (peers_added == 0) {
-        ESP_LOGE(TAG, "No gateways configured!");
-        return ESP_FAIL;
-    }
-    
-    ESP_LOGI(TAG, "Total gateways configured: %d", peers_added);
-    uint8_t last_gw = nvs_get_last_gateway();
-    if (is_gateway_valid(last_gw)) {
-        ESP_LOGI(TAG, "Last successful gateway: %d (%02X:%02X:%02X:%02X:%02X:%02X)", 
-                 last_gw, GATEWAY_MACS[last_gw][0], GATEWAY_MACS[last_gw][1], 
-                 GATEWAY_MACS[last_gw][2], GATEWAY_MACS[last_gw][3],
-                 GATEWAY_MACS[last_gw][4], GATEWAY_MACS[last_gw][5]);
+    if (n == 0) {
+        ESP_LOGW(TAG, "No gateways configured - waiting for beacons");
+    } else {
+        ESP_LOGI(TAG, "Known gateways: %d (best first)", n);
     }
     
     return ESP_OK;
 }
 
-/* Main measurement + send task executed once per boot cycle (then deep sleep) */
+/* Bring Wi-Fi/ESP-NOW up once. With batched telemetry or send-on-delta the
+   radio is only started on cycles that send, so a deep-sleep wake that just
+   samples never powers it. */
+static bool radio_started = false;
+
+static esp_err_t radio_start(void) {
+    if (radio_started) {
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Initializing Wi-Fi and ESP-NOW...");
+    esp_err_t err = init_espnow();
+    if (err == ESP_OK) {
+        radio_started = true;
+    }
+    return err;
+}
+
+#if CONFIG_NODE_BATCH_TELEMETRY
+/* Send the buffered samples as one SensorBatch frame. The gateway ACKs the
+   newest seq. A batch no gateway confirmed is kept and retried later
+   (store and forward); returns whether it went out. */
+static bool batch_flush(int vin_mv, int64_t newest_sample_us) {
+    esp_err_t err = radio_start();
+    if (err == ESP_OK) {
+        static const sample_batch::Meta meta = {NODE_ID, SAMPLE_INTERVAL_S * 1000, LEVEL_MAX_CM, SENSOR_OFFSET_CM, (uint32_t)TANK_TABLE.vol_max_l()};
+        uint8_t frame[SENSOR_BATCH_MAX_FRAME];
+        uint32_t newest_age_ms = (uint32_t)((esp_timer_get_time() - newest_sample_us) / 1000);
+        size_t len = tx_batch.encode(frame, sizeof(frame), meta, (int16_t)vin_mv, newest_age_ms);
+        ESP_LOGI(TAG, "📦 Enviando lote: %d amostras (seq %" PRIu32 "..%" PRIu32 "), %u bytes",
+                 tx_batch.count(), tx_batch.first_seq(), tx_batch.last_seq(), (unsigned)len);
+        err = len ? espnow_send_payload(frame, len, tx_batch.last_seq(), NODE_ID) : ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "espnow batch send failed: %s (%d amostras mantidas, %" PRIu32 " descartadas até agora)",
+                 esp_err_to_name(err), tx_batch.count(), tx_batch.dropped());
+        led_pattern_error();
+        return false;
+    }
+    ESP_LOGI(TAG, "espnow send OK (batch, %d samples) with ACK", tx_batch.count());
+    led_pattern_tx();
+    tx_batch.clear();
+    return true;
+}
+#else
+/* Send a reading. If readings are waiting in tx_backlog it joins them behind
+   and the ring is resent oldest-first, several per frame (at most
+   STORE_FORWARD_FRAMES_PER_CYCLE frames per cycle). A reading no gateway
+   confirms stays in the ring. Returns the result of the last send attempt. */
+static esp_err_t send_reading(const SensorPacketV2 &pkt) {
+    uint32_t now_ms = (uint32_t)duty_cycle::uptime_ms();
+    esp_err_t err = radio_start();
+    if (err != ESP_OK) {
+        tx_backlog.push(pkt, now_ms);
+        return err;
+    }
+    if (tx_backlog.empty()) {
+        err = espnow_send_payload((const uint8_t*)&pkt, sizeof(pkt), pkt.seq, pkt.node_id);
+        if (err != ESP_OK) {
+            tx_backlog.push(pkt, now_ms);
+            ESP_LOGW(TAG, "💾 Leitura seq=%" PRIu32 " guardada para reenvio", pkt.seq);
+        }
+        return err;
+    }
+
+    tx_backlog.push(pkt, now_ms);
+    size_t delivered = tx_backlog.drain(now_ms, STORE_FORWARD_FRAMES_PER_CYCLE,
+        [&err](const uint8_t *frame, size_t len, const SensorPacketV2 &last) {
+            err = espnow_send_payload(frame, len, last.seq, last.node_id);
+            return err == ESP_OK;
+        });
+    const store_forward::Stats &st = tx_backlog.stats();
+    ESP_LOGI(TAG, "💾 Reenvio: %u leituras entregues, %u na fila (máx %" PRIu32 ", descartadas %" PRIu32 ")",
+             (unsigned)delivered, (unsigned)tx_backlog.count(), st.high_water, st.dropped);
+    return err;
+}
+#endif
+
+/* Main measurement + send loop (one iteration per boot with CONFIG_NODE_DEEP_SLEEP) */
 extern "C" void app_main(void) {
     esp_err_t err;
 
+#if CONFIG_NODE_DEEP_SLEEP
+    duty_cycle::log_wake(TAG);
+#endif
+
     // Disable task watchdog to avoid noisy WDT logs in this periodic loop
     esp_task_wdt_deinit();
 
@@ -539,61 +830,51 @@ extern "C" void app_main(void) {
     ultrasonic01::Pins us_pins = {TRIG_GPIO, ECHO_GPIO};
     ultrasonic01::init_pins(us_pins);
     init_adc();
+    init_air_temp();
     led_init();  // Initialize LED GPIO
 
-    // Initialize Kalman filter for ultrasonic sensor (persistent across measurements)
-    static ultrasonic01::KalmanFilter kalman_filter(1.0f, 2.0f);  // process_noise=1, measurement_noise=2
-    
     // Indica inicialização / procurando gateway (rádio subindo)
     led_pattern_searching();
 
+#if CONFIG_NODE_BATCH_TELEMETRY
+    // Wi-Fi & ESP-NOW are started by the first flush (radio_start)
+    static const sample_batch::Policy batch_policy = {BATCH_FLUSH_SAMPLES, BATCH_FLUSH_AGE_S * 1000, true};
+#elif CONFIG_NODE_REPORT_ON_DELTA
+    // Wi-Fi & ESP-NOW are started by the first send (radio_start)
+#else
     // init wifi & espnow
-    ESP_LOGI(TAG, "Initializing Wi-Fi and ESP-NOW...");
-    ESP_ERROR_CHECK(init_espnow());
+    ESP_ERROR_CHECK(radio_start());
+#endif
 
     while (true) {
-        // get seq
-        uint32_t seq = 0;
-        if (nvs_get_seq(&seq) != ESP_OK) seq = 0;
-        seq += 1; // increment for this send
-
-        // perform ultrasonic measurements with Kalman filtering
-        int readings[ULTRA_SAMPLE_RETRIES];
-        int valid_readings = 0;
+        uint32_t dt_s = last_interval_s;
+        sample_clock_s += dt_s;
+
+        // perform ultrasonic measurements (speed of sound for the current air temperature)
+        update_sound_speed();
+        std::array<int, ULTRA_SAMPLE_RETRIES> readings;
         ultrasonic01::Pins pins{TRIG_GPIO, ECHO_GPIO};
-        
-        // Take multiple readings and apply Kalman filter
         for (int i=0;i<ULTRA_SAMPLE_RETRIES;i++) {
-            int d = ultrasonic01::measure_cm(pins);
-            if (d < 0) {
+            readings[i] = ultrasonic01::measure_cm(pins, us_timings);
+            if (readings[i] < 0) {
                 ESP_LOGW(TAG, "ultra read %d = timeout/error", i);
-                readings[i] = -1;
             } else {
-                // Apply Kalman filter to raw measurement
-                float filtered = kalman_filter.update(d);
-                readings[i] = (int)(filtered + 0.5f);  // Round to nearest integer
-                valid_readings++;
-                ESP_LOGI(TAG, "Reading %d: raw=%dcm filtered=%dcm", i, d, readings[i]);
+                ESP_LOGI(TAG, "Reading %d: raw=%dcm", i, readings[i]);
             }
             vTaskDelay(pdMS_TO_TICKS(ULTRA_MEASURE_DELAY_MS));
         }
 
-        // choose median among valid — if some invalid, prefer any valid, else mark invalid
+        // robust estimate of this cycle's samples, then the Kalman filter across cycles
         int distance_cm = -1;
-        if (valid_readings == 0) {
+        ultrasonic01::RobustResult est = ultrasonic01::robust_estimate(readings);
+        if (est.valid == 0) {
             ESP_LOGW(TAG, "No valid ultrasonic readings");
             kalman_filter.reset();  // Reset filter on total failure
         } else {
-            int a = readings[0] < 0 ? 10000 : readings[0];
-            int b = readings[1] < 0 ? 10000 : readings[1];
-            int c = readings[2] < 0 ? 10000 : readings[2];
-            int med = ultrasonic01::median3(a,b,c);
-            if (med > 9999) {
-                distance_cm = -1;
-                kalman_filter.reset();
-            } else {
-                distance_cm = med;
-            }
+            kalman_filter.update(est.cm, (uint32_t)duty_cycle::uptime_ms());
+            distance_cm = kalman_filter.estimate_cm();
+            ESP_LOGI(TAG, "Distance: robust=%dcm (median %d, MAD %d, %d/%d valid, %d used) filtered=%dcm",
+                     est.cm, est.median_cm, est.mad_cm, est.valid, ULTRA_SAMPLE_RETRIES, est.used, distance_cm);
         }
 
         // validate range
@@ -611,43 +892,45 @@ extern "C" void app_main(void) {
         }
 
         // compute level, percentual, volume
-        level_calculator::Model model{LEVEL_MAX_CM, SENSOR_OFFSET_CM, VOL_MAX_L};
-        auto res = level_calculator::compute(distance_cm, model);
+        auto res = level_calculator::compute(distance_cm, SENSOR_OFFSET_CM, TANK_TABLE);
         int level_cm = res.level_cm;
         int percentual = res.percentual;
         int volume_l = res.volume_l;
 
-        ESP_LOGI(TAG, "meas: distance=%d cm, level=%d cm, pct=%d%%, vol=%d L, vin=%d mV, seq=%u",
-                 distance_cm, level_cm, percentual, volume_l, vin_mv, seq);
+        ESP_LOGI(TAG, "meas: distance=%d cm, level=%d cm, pct=%d%%, vol=%d L, vin=%d mV",
+                 distance_cm, level_cm, percentual, volume_l, vin_mv);
 
         // ============================================================================
         // ANOMALY DETECTION
         // ============================================================================
         uint8_t flags = 0;
         uint8_t alert_type = ALERT_NONE;
+        int16_t rate_x10 = level_rate_x10();
+        bool rate_known = rate_x10 != SENSOR_RATE_UNKNOWN;
         
         if (!anomaly_detection_initialized) {
             // First measurement - just store baseline
             last_level_cm = level_cm;
-            last_change_seq = seq;
+            last_change_s = sample_clock_s;
             anomaly_detection_initialized = true;
             ESP_LOGI(TAG, "🎯 Anomaly detection initialized (baseline=%dcm)", level_cm);
         } else {
             int16_t delta_cm = level_cm - last_level_cm;
-            uint32_t readings_since_change = seq - last_change_seq;
-            uint32_t minutes_since_change = (readings_since_change * SAMPLE_INTERVAL_S) / 60;
+            uint32_t minutes_since_change = (sample_clock_s - last_change_s) / 60;
             
-            // Check for rapid drop (leak detection)
-            if (delta_cm <= -RAPID_CHANGE_THRESHOLD_CM) {
+            // Check for rapid drop (leak detection): a step between cycles or a sustained filtered rate
+            if (delta_cm <= -RAPID_CHANGE_THRESHOLD_CM || (rate_known && rate_x10 <= -RAPID_RATE_CM_MIN * 10)) {
                 flags |= FLAG_IS_ALERT;
                 alert_type = ALERT_RAPID_DROP;
-                ESP_LOGW(TAG, "🚨 ALERTA: Queda rápida detectada! Δ=%dcm (possível vazamento)", delta_cm);
+                ESP_LOGW(TAG, "🚨 ALERTA: Queda rápida detectada! Δ=%dcm, taxa=%d.%d cm/min (possível vazamento)",
+                         delta_cm, rate_x10 / 10, abs(rate_x10) % 10);
             }
             // Check for rapid rise (pump failure / flood)
-            else if (delta_cm >= RAPID_CHANGE_THRESHOLD_CM) {
+            else if (delta_cm >= RAPID_CHANGE_THRESHOLD_CM || (rate_known && rate_x10 >= RAPID_RATE_CM_MIN * 10)) {
                 flags |= FLAG_IS_ALERT;
                 alert_type = ALERT_RAPID_RISE;
-                ESP_LOGW(TAG, "🚨 ALERTA: Subida rápida detectada! Δ=%dcm (falha de bomba/inundação)", delta_cm);
+                ESP_LOGW(TAG, "🚨 ALERTA: Subida rápida detectada! Δ=%dcm, taxa=%d.%d cm/min (falha de bomba/inundação)",
+                         delta_cm, rate_x10 / 10, abs(rate_x10) % 10);
             }
             // Check for sensor stuck (no significant change for long period)
             else if (minutes_since_change >= NO_CHANGE_MINUTES && 
@@ -660,7 +943,7 @@ extern "C" void app_main(void) {
             // Update baseline if significant change detected
             if (abs(delta_cm) > NO_CHANGE_THRESHOLD_CM) {
                 last_level_cm = level_cm;
-                last_change_seq = seq;
+                last_change_s = sample_clock_s;
             }
             
             if (flags & FLAG_IS_ALERT) {
@@ -668,35 +951,98 @@ extern "C" void app_main(void) {
             }
         }
 
-        // build payload (binary packet)
-        uint8_t dev_mac[6];
-        get_device_mac(dev_mac);
-        SensorPacketV1 pkt{};
-        pkt.version = SENSOR_PACKET_VERSION;
-        pkt.node_id = 3; // Node 3 - RCB3 - Casa de Bombas 03
-        memcpy(pkt.mac, dev_mac, sizeof(pkt.mac));
-        pkt.seq = seq;
-        pkt.distance_cm = (int16_t)distance_cm;
-        pkt.level_cm = (int16_t)level_cm;
-        pkt.percentual = (uint8_t)percentual;
-        pkt.volume_l = (uint32_t)volume_l;
-        pkt.vin_mv = (int16_t)vin_mv;
-        pkt.flags = flags;
-        pkt.alert_type = alert_type;
-        pkt.rssi = 0;   // gateway will overwrite
-        pkt.ts_ms = 0;  // gateway will overwrite
-
-        esp_err_t send_err = espnow_send_payload((const uint8_t*)&pkt, sizeof(pkt), seq);
-        if (send_err == ESP_OK) {
-            ESP_LOGI(TAG, "espnow send OK (binary packet v%d) with ACK", pkt.version);
-            nvs_set_seq(seq);
-            led_pattern_tx();
+        // get seq only for samples that go out (a failed send still uses it up:
+        // the gateway may have got the packet)
+#if CONFIG_NODE_BATCH_TELEMETRY
+        // buffer the sample; send when the batch is full/old enough or on an alert
+        uint32_t seq = tx_seq.next(seq_store);
+        int64_t sample_us = esp_timer_get_time();
+        if (tx_batch.full()) {
+            // no gateway for a while: make room, oldest sample first
+            tx_batch.drop_oldest();
+        }
+        if (!tx_batch.add(seq, (int16_t)distance_cm, flags, alert_type)) {
+            // seq gap (should not happen): send what is buffered, with
+            // approximate ages, and start a new batch
+            if (!batch_flush(vin_mv, sample_us)) {
+                tx_batch.clear();
+            }
+            tx_batch.add(seq, (int16_t)distance_cm, flags, alert_type);
+        }
+        if (batch_retry_in > 0) {
+            // last flush failed: wait a flush period before powering the radio again
+            batch_retry_in--;
+            ESP_LOGI(TAG, "📦 Amostra no lote (%d, reenvio em %" PRIu32 " amostras)", tx_batch.count(), batch_retry_in + 1);
+        } else if (tx_batch.should_flush(batch_policy, SAMPLE_INTERVAL_S * 1000)) {
+            if (!batch_flush(vin_mv, sample_us)) {
+                batch_retry_in = BATCH_FLUSH_SAMPLES - 1;
+            }
         } else {
-            ESP_LOGE(TAG, "espnow send failed: %s", esp_err_to_name(send_err));
-            led_pattern_error();
+            ESP_LOGI(TAG, "📦 Amostra no lote (%d/%d)", tx_batch.count(), BATCH_FLUSH_SAMPLES);
         }
+#else
+#if CONFIG_NODE_REPORT_ON_DELTA
+        // send only on a level change, a new alert or the heartbeat
+        report_policy::Reason reason = tx_policy.on_sample(dt_s, (int16_t)level_cm, rate_x10, alert_type);
+        bool send_now = reason != report_policy::Reason::Skip;
+        if (send_now) {
+            ESP_LOGI(TAG, "📤 Envio por %s (Δ=%d cm, taxa %s cm/min)", report_policy::reason_name(reason),
+                     level_cm - tx_policy.level_sent(), report_policy::rate_text(rate_x10).s);
+        } else {
+            ESP_LOGI(TAG, "📉 Sem envio: Δ=%d cm, último pacote há %" PRIu32 " s, taxa %s cm/min",
+                     level_cm - tx_policy.level_sent(), tx_policy.since_sent_s(), report_policy::rate_text(rate_x10).s);
+        }
+#else
+        const bool send_now = true;
+#endif
+        if (send_now) {
+            uint32_t seq = tx_seq.next(seq_store);
+
+            // build payload (binary packet)
+            uint8_t dev_mac[6];
+            get_device_mac(dev_mac);
+            SensorPacketV2 pkt{};
+            pkt.version = SENSOR_PACKET_V2_VERSION;
+            pkt.node_id = NODE_ID;
+            memcpy(pkt.mac, dev_mac, sizeof(pkt.mac));
+            pkt.seq = seq;
+            pkt.distance_cm = (int16_t)distance_cm;
+            pkt.level_cm = (int16_t)level_cm;
+            pkt.percentual = (uint8_t)percentual;
+            pkt.volume_l = (uint32_t)volume_l;
+            pkt.vin_mv = (int16_t)vin_mv;
+            pkt.flags = flags;
+            pkt.alert_type = alert_type;
+            pkt.rssi = 0;   // gateway will overwrite
+            pkt.ts_ms = 0;  // age: taken now (gateway converts to a timestamp)
+            pkt.rate_cmpm_x10 = rate_x10;
 
-        // wait interval instead of deep sleep
-        vTaskDelay(pdMS_TO_TICKS(SAMPLE_INTERVAL_S * 1000));
+            esp_err_t send_err = send_reading(pkt);
+            if (send_err == ESP_OK) {
+                ESP_LOGI(TAG, "espnow send OK (binary packet v%d, seq=%" PRIu32 ") with ACK", pkt.version, seq);
+                led_pattern_tx();
+            } else {
+                ESP_LOGE(TAG, "espnow send failed: %s", esp_err_to_name(send_err));
+                led_pattern_error();
+            }
+#if CONFIG_NODE_REPORT_ON_DELTA
+            // delivered or queued in tx_backlog: either way the gateway gets it
+            tx_policy.on_sent((int16_t)level_cm, alert_type);
+#endif
+        }
+#endif
+
+        uint32_t interval_s = SAMPLE_INTERVAL_S;
+#if CONFIG_NODE_REPORT_ON_DELTA
+        interval_s = tx_policy.interval_s();
+#endif
+        last_interval_s = interval_s;
+
+#if CONFIG_NODE_DEEP_SLEEP
+        // ACK already awaited in espnow_send_payload(); sleep until the next period
+        duty_cycle::sleep_until_next(interval_s, TAG);
+#else
+        vTaskDelay(pdMS_TO_TICKS(interval_s * 1000));
+#endif
     }
 }
\ No newline at end of file
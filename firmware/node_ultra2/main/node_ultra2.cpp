@@ -12,6 +12,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <atomic>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -34,7 +35,14 @@
 
 // Modules
 #include "components/ultrasonic01/ultrasonic01.h"
+#include "components/ultrasonic01/air_temperature.h"
 #include "components/level_calculator/level_calculator.h"
+#include "components/adc_oversample/adc_oversample.h"
+#include "components/duty_cycle/duty_cycle.h"
+#include "components/seq_counter/seq_counter.h"
+#include "components/seq_counter/nvs_store.h"
+#include "components/report_policy/report_policy.h"
+#include "components/store_forward/store_forward.h"
 #include "common/telemetry_packet.h"
 
 static const char *TAG = "node_ultra02";
@@ -59,19 +67,39 @@ static const char *TAG = "node_ultra02";
 #define LEVEL_MAX_CM      450      // cm (level_max)
 #define SENSOR_OFFSET_CM  20       // sensor_offset (sensor is 20cm above level_max)
 
+/* Tank shape: level -> volume table computed at compile time (level_calculator.h).
+   prism = volume proportional to level. Other shapes, e.g.
+     level_calculator::Geometry::horizontal_cylinder(250, 600, 125)   // Ø250 x 600 cm, hemispherical heads
+     level_calculator::Geometry::vertical_cylinder(300, LEVEL_MAX_CM, level_calculator::End::CONE, 90)
+   or a strapping table (level_calculator::StrapPoint[]); VOL_MAX_L then comes from the shape. */
+#define TANK_GEOMETRY     level_calculator::Geometry::prism(VOL_MAX_L, LEVEL_MAX_CM)
+static constexpr level_calculator::VolumeTable<> TANK_TABLE(TANK_GEOMETRY, LEVEL_MAX_CM);
+
 /* Sampling and retries */
-#define SAMPLE_INTERVAL_S     30    // loop interval in seconds (active loop)
-#define ULTRA_SAMPLE_RETRIES  3     // number of ultrasonic readings to take (for median)
-#define ULTRA_MEASURE_DELAY_MS 60   // delay between raw ultrasonic attempts
+#define SAMPLE_INTERVAL_S     30    // loop interval in seconds (active loop, or deep-sleep period with CONFIG_NODE_DEEP_SLEEP)
+#define ULTRA_SAMPLE_RETRIES  3     // ultrasonic readings per cycle (robust_estimate; see tools/robust_bench)
+#define ULTRA_MEASURE_DELAY_MS 60   // min spacing between triggers of the same sensor
+#define ULTRA_GUARD_MS        30    // min spacing between triggers of sensors A and B (crosstalk)
 #define ESPNOW_SEND_RETRIES   2
+#define ESPNOW_TX_DONE_MS     200   // wait for the send callback (MAC-layer status)
+#define REPORT_DELTA_CM          3  // CONFIG_NODE_REPORT_ON_DELTA: send when the level moved this much,
+#define REPORT_HEARTBEAT_S       600 //   or at least every 10 min (per sensor)
+#define REPORT_FAST_INTERVAL_S   5  // sampling interval while either level moves faster than
+#define REPORT_FAST_RATE_CM_MIN  2  //   this many cm/min (SAMPLE_INTERVAL_S otherwise)
+#define RATE_MAX_VAR             4  // rate trusted once its variance is below this ((cm/min)^2)
 
 /* Ultrasonic validation */
 #define MIN_VALID_CM    5
 #define MAX_VALID_CM    450
 
+/* Air temperature for the speed of sound (CONFIG_NODE_AIR_TEMP_INTERNAL, sound_speed.h) */
+#define AIR_TEMP_OFFSET_C_X10  0    // added to every reading (0.1 °C), set against a thermometer
+
 /* ADC configuration */
 #define ADC_ATTEN        ADC_ATTEN_DB_12
 #define ADC_BITWIDTH     ADC_BITWIDTH_12
+#define VIN_SAMPLE_HZ    1000   // CONFIG_NODE_VIN_CONTINUOUS: Vin conversions per second (DMA),
+#define VIN_DECIMATION   64     //   one CIC-filtered value per 64 samples (see tools/adc_oversample_bench)
 
 /* ESP-NOW configuration */
 /* Gateway MAC address - must match the actual gateway device */
@@ -84,11 +112,51 @@ static const uint8_t SENSOR_B_MAC[6] = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xC2};
 
 /* NVS keys */
 #define NVS_NAMESPACE "node_cfg"
-#define NVS_SEQ_KEY   "seq"
+#define NVS_SEQ_KEY   "seq"      // seq reservation (SeqCounter checkpoint)
 
+#if CONFIG_NODE_VIN_CONTINUOUS
+/* Vin oversampled in the background (adc_continuous + CIC decimator) */
+static adc_oversample::AdcOversampler<VIN_DECIMATION> vin_adc;
+#else
 /* ADC handles (global) */
 static adc_oneshot_unit_handle_t adc1_handle = NULL;
 static adc_cali_handle_t adc1_cali_handle = NULL;
+#endif
+
+/* Air temperature source and the ultrasonic timings carrying its
+   speed-of-sound scale (update_sound_speed) */
+static ultrasonic01::AirTemperature air_temp;
+static ultrasonic01::Timings us_timings;
+
+/* Packet seq, shared by sensors A and B (checkpointed to NVS every SEQ_COUNTER_CHECKPOINT_EVERY sends) */
+static DUTY_CYCLE_RETAINED seq_counter::SeqCounter tx_seq;
+static const seq_counter::NvsStore seq_store = {NVS_NAMESPACE, NVS_SEQ_KEY};
+
+/* Level rate per sensor (A, B): 2-state Kalman (distance + rate) over the
+   robust distance, Q16.16. Only the rate is used; the packet keeps the robust
+   distance. */
+static DUTY_CYCLE_RETAINED ultrasonic01::KalmanCvQ16 rate_filter[2] = {
+    ultrasonic01::KalmanCvQ16(ultrasonic01::Q16(1), ultrasonic01::Q16(2), ultrasonic01::Q16(25)),
+    ultrasonic01::KalmanCvQ16(ultrasonic01::Q16(1), ultrasonic01::Q16(2), ultrasonic01::Q16(25))};
+
+/* Interval slept before the current cycle (0 before the first one) */
+static DUTY_CYCLE_RETAINED uint32_t last_interval_s = 0;
+
+#if CONFIG_NODE_REPORT_ON_DELTA
+/* Send-on-delta per sensor (A, B) */
+static constexpr report_policy::Config REPORT_CONFIG = {
+    REPORT_DELTA_CM, REPORT_HEARTBEAT_S, SAMPLE_INTERVAL_S, REPORT_FAST_INTERVAL_S, REPORT_FAST_RATE_CM_MIN * 10};
+static DUTY_CYCLE_RETAINED report_policy::ReportPolicy tx_policy[2] = {
+    report_policy::ReportPolicy(REPORT_CONFIG), report_policy::ReportPolicy(REPORT_CONFIG)};
+#endif
+
+/* ESP-NOW frames queued / completed / not acknowledged by the gateway radio (send callback) */
+static std::atomic<uint32_t> tx_queued{0};
+static std::atomic<uint32_t> tx_completed{0};
+static std::atomic<uint32_t> tx_failed{0};
+
+/* Store-and-forward: readings (A and B) the gateway radio did not acknowledge, resent oldest-first */
+static DUTY_CYCLE_RETAINED store_forward::Ring tx_backlog;
 
 struct DistanceResult {
     int value_cm;
@@ -106,6 +174,15 @@ struct TelemetryValues {
 
 /* Read ADC and convert to mV, considering V/2 divider */
 static int read_vin_mv(void) {
+#if CONFIG_NODE_VIN_CONTINUOUS
+    adc_oversample::Reading r = vin_adc.read();
+    if (!r.valid) return -1;
+    if (r.count > 0) {
+        ESP_LOGI(TAG, "🔋 Vin %d mV (mín %d, máx %d; %" PRIu32 " médias de %d amostras)",
+                 r.avg_mv * 2, r.min_mv * 2, r.max_mv * 2, r.count, VIN_DECIMATION);
+    }
+    return r.avg_mv * 2;  // V/2 divider
+#else
     if (!adc1_handle) return -1;
     int raw = 0;
     esp_err_t err = adc_oneshot_read(adc1_handle, ADC_CHANNEL_VIN, &raw);
@@ -118,29 +195,7 @@ static int read_vin_mv(void) {
         voltage_mv = (raw * 3300) / 4095;
     }
     return voltage_mv * 2; // account divider (V/2)
-}
-
-/* NVS helpers for seq */
-static esp_err_t nvs_get_seq(uint32_t *seq_out) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
-    if (err == ESP_OK) {
-        uint32_t val = 0;
-        err = nvs_get_u32(h, NVS_SEQ_KEY, &val);
-        if (err == ESP_OK) *seq_out = val;
-        nvs_close(h);
-    }
-    return err;
-}
-static esp_err_t nvs_set_seq(uint32_t seq) {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
-    if (err == ESP_OK) {
-        err = nvs_set_u32(h, NVS_SEQ_KEY, seq);
-        if (err == ESP_OK) err = nvs_commit(h);
-        nvs_close(h);
-    }
-    return err;
+#endif
 }
 
 /* ESP-NOW send wrapper (to gateway) */
@@ -149,12 +204,67 @@ static esp_err_t espnow_send_payload(const uint8_t *peer_mac, const uint8_t *dat
     const uint8_t *dst = peer_mac ? peer_mac : GATEWAY_MAC;
     for (int r=0; r<ESPNOW_SEND_RETRIES; ++r) {
         err = esp_now_send(dst, data, len);
-        if (err == ESP_OK) break;
+        if (err == ESP_OK) {
+            tx_queued++;
+            break;
+        }
         vTaskDelay(pdMS_TO_TICKS(200));
     }
     return err;
 }
 
+/* Wait until every queued frame left the radio (this node gets no ACK) */
+static void espnow_wait_tx_done(int timeout_ms) {
+    for (int waited = 0; tx_completed != tx_queued && waited < timeout_ms; waited += 10) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+/* Send and wait for the send callback. Without an application ACK, the
+   MAC-layer status (the gateway radio acknowledged the unicast frame) is
+   the delivery confirmation. */
+static esp_err_t espnow_send_confirmed(const uint8_t *data, size_t len) {
+    uint32_t failed_before = tx_failed;
+    esp_err_t err = espnow_send_payload(NULL, data, len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    espnow_wait_tx_done(ESPNOW_TX_DONE_MS);
+    if (tx_completed != tx_queued) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return tx_failed == failed_before ? ESP_OK : ESP_FAIL;
+}
+
+/* Send a reading. If readings are waiting in tx_backlog it joins them behind
+   and the ring is resent oldest-first, several per frame (at most
+   STORE_FORWARD_FRAMES_PER_CYCLE frames per cycle). A reading the gateway
+   radio does not acknowledge stays in the ring. Returns the result of the
+   last send attempt. */
+static esp_err_t send_reading(const SensorPacketV2 &pkt) {
+    uint32_t now_ms = (uint32_t)duty_cycle::uptime_ms();
+    if (tx_backlog.empty()) {
+        esp_err_t err = espnow_send_confirmed((const uint8_t*)&pkt, sizeof(pkt));
+        if (err != ESP_OK) {
+            tx_backlog.push(pkt, now_ms);
+            ESP_LOGW(TAG, "💾 Leitura seq=%" PRIu32 " guardada para reenvio", pkt.seq);
+        }
+        return err;
+    }
+
+    tx_backlog.push(pkt, now_ms);
+    esp_err_t err = ESP_OK;
+    size_t delivered = tx_backlog.drain(now_ms, STORE_FORWARD_FRAMES_PER_CYCLE,
+        [&err](const uint8_t *frame, size_t len, const SensorPacketV2 &) {
+            err = espnow_send_confirmed(frame, len);
+            return err == ESP_OK;
+        });
+    const store_forward::Stats &st = tx_backlog.stats();
+    ESP_LOGI(TAG, "💾 Reenvio: %u leituras entregues, %u na fila (máx %" PRIu32 ", descartadas %" PRIu32 ")",
+             (unsigned)delivered, (unsigned)tx_backlog.count(), st.high_water, st.dropped);
+    return err;
+}
+
 /* ====== LED status helpers (non-blocking via esp_timer) ====== */
 static void led_init(void) {
     gpio_config_t io_conf = {
@@ -230,13 +340,41 @@ static void get_device_mac(uint8_t mac_out[6]) {
     esp_read_mac(mac_out, ESP_MAC_WIFI_STA);
 }
 
+static void espnow_send_cb(const wifi_tx_info_t *tx_info, esp_now_send_status_t status) {
+    if (status != ESP_NOW_SEND_SUCCESS) {
+        tx_failed++;
+    }
+    tx_completed++;
+}
+
 /* ESP-NOW receive callback (not used but necessary to initialize) */
 static void espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len) {
     ESP_LOGD(TAG, "espnow recv len=%d from " MACSTR, len, MAC2STR(recv_info->src_addr));
 }
 
+#if CONFIG_NODE_VIN_CONTINUOUS
+/* Vin through the continuous-mode ADC (DMA): oversampled and decimated in
+   the background, read_vin_mv() only takes the window. Owns ADC1 (no
+   oneshot unit). */
+static void init_vin_continuous(void) {
+    adc_oversample::Config cfg = {ADC_CHANNEL_VIN};
+    cfg.sample_hz = VIN_SAMPLE_HZ;
+    cfg.atten = ADC_ATTEN;
+    esp_err_t err = vin_adc.start(cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "ADC contínuo falhou: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "🔋 Vin contínuo: %d Hz, CIC /%d (%s)", VIN_SAMPLE_HZ, VIN_DECIMATION,
+             vin_adc.calibrated() ? "calibrado" : "sem calibração");
+}
+#endif
+
 /* Initialize ADC */
 static void init_adc(void) {
+#if CONFIG_NODE_VIN_CONTINUOUS
+    init_vin_continuous();  // the DMA driver owns ADC1: no oneshot unit
+#else
     adc_oneshot_unit_init_cfg_t init_config = {
         .unit_id = ADC_UNIT_VIN,
         .clk_src = (adc_oneshot_clk_src_t)0,
@@ -268,6 +406,35 @@ static void init_adc(void) {
         ESP_LOGW(TAG, "ADC calibration not available, using raw values");
         adc1_cali_handle = NULL;
     }
+#endif
+}
+
+/* Air temperature source, set from CONFIG_NODE_AIR_TEMP_* (after init_adc) */
+static void init_air_temp(void) {
+#if CONFIG_NODE_AIR_TEMP_INTERNAL
+    esp_err_t err = air_temp.use_internal(AIR_TEMP_OFFSET_C_X10);
+#else
+    esp_err_t err = ESP_OK;
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "🌡️ Sensor de temperatura do ar indisponível (%s): distância com us/58", esp_err_to_name(err));
+    }
+}
+
+/* Speed-of-sound scale for this cycle's measurements, from the air
+   temperature (us/58 when there is no source or the reading failed) */
+static void update_sound_speed(void) {
+    if (!air_temp.configured()) {
+        return;
+    }
+    int t = air_temp.read_c_x10();
+    us_timings.sound_scale_q16 = ultrasonic01::sound_scale_q16(t);
+    if (t == ultrasonic01::TEMP_INVALID) {
+        ESP_LOGW(TAG, "🌡️ Leitura da temperatura do ar falhou: distância com us/58");
+    } else {
+        ESP_LOGI(TAG, "🌡️ Ar %s%d.%d °C: velocidade do som x%" PRIu32 "/65536", t < 0 ? "-" : "",
+                 abs(t) / 10, abs(t) % 10, us_timings.sound_scale_q16);
+    }
 }
 
 /* Initialize ESP-NOW (WiFi must be initialized) */
@@ -287,6 +454,7 @@ static esp_err_t init_espnow(void) {
 
     ESP_ERROR_CHECK(esp_now_init());
     esp_now_register_recv_cb(espnow_recv_cb);
+    esp_now_register_send_cb(espnow_send_cb);
 
     esp_now_peer_info_t peer_info = {};
     memcpy(peer_info.peer_addr, GATEWAY_MAC, 6);
@@ -300,37 +468,24 @@ static esp_err_t init_espnow(void) {
     return ESP_OK;
 }
 
-static DistanceResult measure_sensor(const ultrasonic01::Pins &pins, const char *label) {
-    int readings[ULTRA_SAMPLE_RETRIES];
-    int valid = 0;
+// Robust estimate (median, MAD rejection, trimmed mean) of the samples one
+// sensor got in the interleaved pass
+static DistanceResult summarize_sensor(const ultrasonic01::Samples &samples, const char *label) {
+    auto readings = ultrasonic01::sample_array<ULTRA_SAMPLE_RETRIES>(samples);
     for (int i=0;i<ULTRA_SAMPLE_RETRIES;i++) {
-        int d = ultrasonic01::measure_cm(pins);
-        if (d < 0) {
+        if (readings[i] < 0) {
             ESP_LOGW(TAG, "%s read %d = timeout/error", label, i);
-            readings[i] = -1;
-        } else {
-            readings[i] = d;
-            valid++;
         }
-        vTaskDelay(pdMS_TO_TICKS(ULTRA_MEASURE_DELAY_MS));
     }
 
-    DistanceResult res{.value_cm = -1, .valid = false, .valid_samples = valid};
-    if (valid == 0) {
+    ultrasonic01::RobustResult est = ultrasonic01::robust_estimate(readings);
+    DistanceResult res{.value_cm = -1, .valid = false, .valid_samples = est.valid};
+    if (est.valid == 0) {
         ESP_LOGW(TAG, "%s: sem leituras válidas", label);
         return res;
     }
 
-    int a = readings[0] < 0 ? 10000 : readings[0];
-    int b = readings[1] < 0 ? 10000 : readings[1];
-    int c = readings[2] < 0 ? 10000 : readings[2];
-    int med = ultrasonic01::median3(a,b,c);
-    if (med > 9999) {
-        res.value_cm = -1;
-        return res;
-    }
-
-    res.value_cm = med;
+    res.value_cm = est.cm;
     if (res.value_cm < MIN_VALID_CM || res.value_cm > MAX_VALID_CM) {
         ESP_LOGW(TAG, "%s: valor fora da faixa (%d cm). Clamping.", label, res.value_cm);
         if (res.value_cm < MIN_VALID_CM) res.value_cm = MIN_VALID_CM;
@@ -338,13 +493,13 @@ static DistanceResult measure_sensor(const ultrasonic01::Pins &pins, const char
     } else {
         res.valid = true;
     }
-    ESP_LOGI(TAG, "%s: dist=%d cm (amostras válidas %d/%d)", label, res.value_cm, valid, ULTRA_SAMPLE_RETRIES);
+    ESP_LOGI(TAG, "%s: dist=%d cm (mediana %d, MAD %d, amostras válidas %d/%d, usadas %d)", label, res.value_cm,
+             est.median_cm, est.mad_cm, est.valid, ULTRA_SAMPLE_RETRIES, est.used);
     return res;
 }
 
 static TelemetryValues compute_values(int distance_cm, int vin_mv) {
-    level_calculator::Model model{LEVEL_MAX_CM, SENSOR_OFFSET_CM, VOL_MAX_L};
-    auto res = level_calculator::compute(distance_cm, model);
+    auto res = level_calculator::compute(distance_cm, SENSOR_OFFSET_CM, TANK_TABLE);
     TelemetryValues v{};
     v.distance_cm = distance_cm;
     v.level_cm = res.level_cm;
@@ -354,7 +509,63 @@ static TelemetryValues compute_values(int distance_cm, int vin_mv) {
     return v;
 }
 
+/* Wi-Fi/ESP-NOW, brought up once. With send-on-delta the first cycle that
+   sends starts it, so deep-sleep wakes that only measure never power it. */
+static bool radio_started = false;
+
+static void radio_start(void) {
+    if (radio_started) {
+        return;
+    }
+    ESP_LOGI(TAG, "Initializing Wi-Fi and ESP-NOW...");
+    ESP_ERROR_CHECK(init_espnow());
+    radio_started = true;
+}
+
+/* Filtered level rate of one sensor (0.1 cm/min, + = filling), or
+   SENSOR_RATE_UNKNOWN until its filter has settled or after a failed reading */
+static int16_t update_level_rate(int sensor, const DistanceResult &d) {
+    ultrasonic01::KalmanCvQ16 &kalman = rate_filter[sensor];
+    if (!d.valid) {
+        kalman.reset();
+        return SENSOR_RATE_UNKNOWN;
+    }
+    kalman.update(d.value_cm, (uint32_t)duty_cycle::uptime_ms());
+    if (kalman.rate_var() > ultrasonic01::Q16(RATE_MAX_VAR)) {
+        return SENSOR_RATE_UNKNOWN;
+    }
+    // the filter tracks distance: the level moves the other way
+    return (int16_t)-ultrasonic01::rate_x10(kalman.rate_cm_min());
+}
+
+// Whether this sensor's reading goes out this cycle (always without CONFIG_NODE_REPORT_ON_DELTA)
+static bool report_due(int sensor, uint32_t dt_s, int level_cm, int16_t rate_x10, const char *label) {
+#if CONFIG_NODE_REPORT_ON_DELTA
+    report_policy::ReportPolicy &policy = tx_policy[sensor];
+    report_policy::Reason reason = policy.on_sample(dt_s, (int16_t)level_cm, rate_x10, 0);
+    if (reason == report_policy::Reason::Skip) {
+        ESP_LOGI(TAG, "📉 %s: sem envio (Δ=%d cm, último pacote há %" PRIu32 " s, taxa %s cm/min)",
+                 label, level_cm - policy.level_sent(), policy.since_sent_s(), report_policy::rate_text(rate_x10).s);
+        return false;
+    }
+    ESP_LOGI(TAG, "📤 %s: envio por %s (taxa %s cm/min)", label, report_policy::reason_name(reason),
+             report_policy::rate_text(rate_x10).s);
+#endif
+    radio_start();
+    return true;
+}
+
+// Delivered or kept in tx_backlog: either way the reading counts as sent
+static void report_sent(int sensor, int level_cm) {
+#if CONFIG_NODE_REPORT_ON_DELTA
+    tx_policy[sensor].on_sent((int16_t)level_cm, 0);
+#endif
+}
+
 extern "C" void app_main(void) {
+#if CONFIG_NODE_DEEP_SLEEP
+    duty_cycle::log_wake(TAG);
+#endif
     esp_task_wdt_deinit();
 
     esp_err_t err = nvs_flash_init();
@@ -364,23 +575,39 @@ extern "C" void app_main(void) {
     }
     ESP_ERROR_CHECK(err);
 
-    ultrasonic01::Pins sensorA{TRIG_A_GPIO, ECHO_A_GPIO};
-    ultrasonic01::Pins sensorB{TRIG_B_GPIO, ECHO_B_GPIO};
-    ultrasonic01::init_pins(sensorA);
-    ultrasonic01::init_pins(sensorB);
+    const ultrasonic01::Pins sensors[2] = {
+        {TRIG_A_GPIO, ECHO_A_GPIO},
+        {TRIG_B_GPIO, ECHO_B_GPIO},
+    };
+    ultrasonic01::init_pins(sensors[0]);
+    ultrasonic01::init_pins(sensors[1]);
+    ultrasonic01::Schedule schedule;
+    schedule.samples = ULTRA_SAMPLE_RETRIES;
+    schedule.guard_ms = ULTRA_GUARD_MS;
+    schedule.rearm_ms = ULTRA_MEASURE_DELAY_MS;
     init_adc();
+    init_air_temp();
     led_init();
     led_pattern_searching();
 
-    ESP_LOGI(TAG, "Initializing Wi-Fi and ESP-NOW...");
-    ESP_ERROR_CHECK(init_espnow());
+#if CONFIG_NODE_REPORT_ON_DELTA
+    // Wi-Fi & ESP-NOW are started by the first send (radio_start)
+#else
+    radio_start();
+#endif
 
     while (true) {
-        uint32_t seq = 0;
-        if (nvs_get_seq(&seq) != ESP_OK) seq = 0;
+        uint32_t dt_s = last_interval_s;
+
+        // Both sensors in one interleaved pass (A0 B0 A1 B1 A2 B2)
+        ultrasonic01::Samples samples[2];
+        update_sound_speed();
+        int64_t t_measure = esp_timer_get_time();
+        ultrasonic01::measure_interleaved(sensors, samples, schedule, us_timings);
+        ESP_LOGD(TAG, "Medição A+B em %lld ms", (long long)((esp_timer_get_time() - t_measure) / 1000));
 
         // Sensor A (MAC do próprio ESP)
-        DistanceResult dA = measure_sensor(sensorA, "ultraA");
+        DistanceResult dA = summarize_sensor(samples[0], "ultraA");
         int distA = dA.valid ? dA.value_cm : MIN_VALID_CM;
         int vin_mv = read_vin_mv();
         if (vin_mv < 0) {
@@ -388,68 +615,92 @@ extern "C" void app_main(void) {
             vin_mv = 0;
         }
         TelemetryValues tA = compute_values(distA, vin_mv);
-
-        seq += 1;
-        uint8_t macA[6];
-        get_device_mac(macA);
-        SensorPacketV1 pktA{};
-        pktA.version = SENSOR_PACKET_VERSION;
-        pktA.node_id = 2; // Node Ultra02
-        memcpy(pktA.mac, macA, sizeof(pktA.mac));
-        pktA.seq = seq;
-        pktA.distance_cm = (int16_t)tA.distance_cm;
-        pktA.level_cm = (int16_t)tA.level_cm;
-        pktA.percentual = (uint8_t)tA.percentual;
-        pktA.volume_l = (uint32_t)tA.volume_l;
-        pktA.vin_mv = (int16_t)tA.vin_mv;
-        pktA.rssi = 0;
-        pktA.ts_ms = 0;
-
-        ESP_LOGI(TAG, "A: dist=%d cm (v%d/%d) level=%d cm pct=%d%% vol=%dL vin=%d seq=%u MAC=%02X:%02X:%02X:%02X:%02X:%02X",
-                 distA, dA.valid_samples, ULTRA_SAMPLE_RETRIES, tA.level_cm, tA.percentual, tA.volume_l, tA.vin_mv, seq,
-                 macA[0], macA[1], macA[2], macA[3], macA[4], macA[5]);
-
-        esp_err_t send_errA = espnow_send_payload(NULL, (const uint8_t*)&pktA, sizeof(pktA));
-        if (send_errA == ESP_OK) {
-            led_pattern_tx();
-        } else {
-            ESP_LOGE(TAG, "espnow send A failed: %s", esp_err_to_name(send_errA));
-            led_pattern_error();
+        int16_t rateA = update_level_rate(0, dA);
+
+        if (report_due(0, dt_s, tA.level_cm, rateA, "A")) {
+            uint32_t seq = tx_seq.next(seq_store);
+            uint8_t macA[6];
+            get_device_mac(macA);
+            SensorPacketV2 pktA{};
+            pktA.version = SENSOR_PACKET_V2_VERSION;
+            pktA.node_id = 2; // Node Ultra02
+            memcpy(pktA.mac, macA, sizeof(pktA.mac));
+            pktA.seq = seq;
+            pktA.distance_cm = (int16_t)tA.distance_cm;
+            pktA.level_cm = (int16_t)tA.level_cm;
+            pktA.percentual = (uint8_t)tA.percentual;
+            pktA.volume_l = (uint32_t)tA.volume_l;
+            pktA.vin_mv = (int16_t)tA.vin_mv;
+            pktA.rssi = 0;
+            pktA.ts_ms = 0;   // age: taken now
+            pktA.rate_cmpm_x10 = rateA;
+
+            ESP_LOGI(TAG, "A: dist=%d cm (v%d/%d) level=%d cm pct=%d%% vol=%dL vin=%d seq=%u MAC=%02X:%02X:%02X:%02X:%02X:%02X",
+                     distA, dA.valid_samples, ULTRA_SAMPLE_RETRIES, tA.level_cm, tA.percentual, tA.volume_l, tA.vin_mv, seq,
+                     macA[0], macA[1], macA[2], macA[3], macA[4], macA[5]);
+
+            esp_err_t send_errA = send_reading(pktA);
+            if (send_errA == ESP_OK) {
+                led_pattern_tx();
+            } else {
+                ESP_LOGE(TAG, "espnow send A failed: %s", esp_err_to_name(send_errA));
+                led_pattern_error();
+            }
+            report_sent(0, tA.level_cm);
         }
-        nvs_set_seq(seq);
 
         // Sensor B (MAC fixo AA:BB:CC:DD:EE:C2)
-        DistanceResult dB = measure_sensor(sensorB, "ultraB");
+        DistanceResult dB = summarize_sensor(samples[1], "ultraB");
         int distB = dB.valid ? dB.value_cm : MIN_VALID_CM;
         TelemetryValues tB = compute_values(distB, vin_mv); // usa mesma leitura de VIN
+        int16_t rateB = update_level_rate(1, dB);
+
+        if (report_due(1, dt_s, tB.level_cm, rateB, "B")) {
+            uint32_t seq = tx_seq.next(seq_store);
+            SensorPacketV2 pktB{};
+            pktB.version = SENSOR_PACKET_V2_VERSION;
+            pktB.node_id = 2; // Node Ultra02
+            memcpy(pktB.mac, SENSOR_B_MAC, sizeof(pktB.mac));
+            pktB.seq = seq;
+            pktB.distance_cm = (int16_t)tB.distance_cm;
+            pktB.level_cm = (int16_t)tB.level_cm;
+            pktB.percentual = (uint8_t)tB.percentual;
+            pktB.volume_l = (uint32_t)tB.volume_l;
+            pktB.vin_mv = (int16_t)tB.vin_mv;
+            pktB.rssi = 0;
+            pktB.ts_ms = 0;   // age: taken now
+            pktB.rate_cmpm_x10 = rateB;
+
+            ESP_LOGI(TAG, "B: dist=%d cm (v%d/%d) level=%d cm pct=%d%% vol=%dL vin=%d seq=%u MAC=%02X:%02X:%02X:%02X:%02X:%02X",
+                     distB, dB.valid_samples, ULTRA_SAMPLE_RETRIES, tB.level_cm, tB.percentual, tB.volume_l, tB.vin_mv, seq,
+                     SENSOR_B_MAC[0], SENSOR_B_MAC[1], SENSOR_B_MAC[2], SENSOR_B_MAC[3], SENSOR_B_MAC[4], SENSOR_B_MAC[5]);
+
+            esp_err_t send_errB = send_reading(pktB);
+            if (send_errB == ESP_OK) {
+                led_pattern_tx();
+            } else {
+                ESP_LOGE(TAG, "espnow send B failed: %s", esp_err_to_name(send_errB));
+                led_pattern_error();
+            }
+            report_sent(1, tB.level_cm);
+        }
 
-        seq += 1;
-        SensorPacketV1 pktB{};
-        pktB.version = SENSOR_PACKET_VERSION;
-        pktB.node_id = 2; // Node Ultra02
-        memcpy(pktB.mac, SENSOR_B_MAC, sizeof(pktB.mac));
-        pktB.seq = seq;
-        pktB.distance_cm = (int16_t)tB.distance_cm;
-        pktB.level_cm = (int16_t)tB.level_cm;
-        pktB.percentual = (uint8_t)tB.percentual;
-        pktB.volume_l = (uint32_t)tB.volume_l;
-        pktB.vin_mv = (int16_t)tB.vin_mv;
-        pktB.rssi = 0;
-        pktB.ts_ms = 0;
-
-        ESP_LOGI(TAG, "B: dist=%d cm (v%d/%d) level=%d cm pct=%d%% vol=%dL vin=%d seq=%u MAC=%02X:%02X:%02X:%02X:%02X:%02X",
-                 distB, dB.valid_samples, ULTRA_SAMPLE_RETRIES, tB.level_cm, tB.percentual, tB.volume_l, tB.vin_mv, seq,
-                 SENSOR_B_MAC[0], SENSOR_B_MAC[1], SENSOR_B_MAC[2], SENSOR_B_MAC[3], SENSOR_B_MAC[4], SENSOR_B_MAC[5]);
-
-        esp_err_t send_errB = espnow_send_payload(NULL, (const uint8_t*)&pktB, sizeof(pktB));
-        if (send_errB == ESP_OK) {
-            led_pattern_tx();
-        } else {
-            ESP_LOGE(TAG, "espnow send B failed: %s", esp_err_to_name(send_errB));
-            led_pattern_error();
+        // Both sensors share the measurement pass: the faster of the two intervals
+        uint32_t interval_s = SAMPLE_INTERVAL_S;
+#if CONFIG_NODE_REPORT_ON_DELTA
+        interval_s = tx_policy[0].interval_s();
+        if (tx_policy[1].interval_s() < interval_s) {
+            interval_s = tx_policy[1].interval_s();
         }
-        nvs_set_seq(seq);
+#endif
+        last_interval_s = interval_s;
 
-        vTaskDelay(pdMS_TO_TICKS(SAMPLE_INTERVAL_S * 1000));
+#if CONFIG_NODE_DEEP_SLEEP
+        // Let both frames leave the radio before it is switched off
+        espnow_wait_tx_done(ESPNOW_TX_DONE_MS);
+        duty_cycle::sleep_until_next(interval_s, TAG);
+#else
+        vTaskDelay(pdMS_TO_TICKS(interval_s * 1000));
+#endif
     }
 }
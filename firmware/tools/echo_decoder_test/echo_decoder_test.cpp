@@ -0,0 +1,199 @@
+// echo_decoder_test.cpp
+// Host-side test of the echo edge decoder (components/ultrasonic01/echo_decoder.h),
+// fed by a fake edge source instead of the GPIO ISR.
+//
+// Checks:
+//   - normal echo: rise then fall gives Done, the pulse width and us/58 cm,
+//     and only the falling edge completes the measurement,
+//   - spurious edges are ignored: a fall while waiting for the rise, a rise
+//     before the trigger ended, a second rise during the pulse, anything
+//     after completion or before begin(),
+//   - rise without fall: poll() keeps the measurement pending up to the
+//     pulse timeout and times it out one us later; a late fall also times out,
+//   - no echo: poll() or a late rise times out the wait for the rise,
+//     expire() times out a pending measurement and nothing else,
+//   - random echoes 2..450 cm with noise edges around them, against
+//     pulse_to_cm().
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -o echo_decoder_test tools/echo_decoder_test/echo_decoder_test.cpp
+//
+// Usage:
+//   ./echo_decoder_test             exit 1 if any check fails
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "components/ultrasonic01/echo_decoder.h"
+
+using namespace ultrasonic01;
+using State = EchoDecoder::State;
+
+static const int64_t T0 = 1000000;        // trigger end, us
+static const int32_t TIMEOUT_US = 30000;  // per phase (Timings default is 300 ms)
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, long got, long want) {
+    if (!ok) {
+        if (failures < 20) {
+            printf("FAIL %s: got %ld, want %ld\n", what, got, want);
+        }
+        failures++;
+    }
+}
+
+static void check_state(const EchoDecoder &d, State want, const char *what) {
+    check(d.state() == want, what, (long)d.state(), (long)want);
+}
+
+static void test_normal() {
+    EchoDecoder d;
+    d.begin(T0, TIMEOUT_US);
+    check(d.pending(), "normal: pending after begin", d.pending(), 1);
+    check(!d.on_edge(1, T0 + 150), "normal: rise does not complete", 1, 0);
+    check_state(d, State::WaitFall, "normal: waiting for fall");
+    check(d.pulse_us() == -1, "normal: no pulse before fall", d.pulse_us(), -1);
+    check(d.on_edge(0, T0 + 150 + 5800), "normal: fall completes", 0, 1);
+    check_state(d, State::Done, "normal: done");
+    check(!d.pending(), "normal: not pending", d.pending(), 0);
+    check(d.pulse_us() == 5800, "normal: pulse", d.pulse_us(), 5800);
+    check(d.distance_cm() == 100, "normal: 5800 us is 100 cm", d.distance_cm(), 100);
+
+    // Rise exactly at the trigger end is accepted, begin() resets everything
+    d.begin(T0, TIMEOUT_US);
+    check_state(d, State::WaitRise, "normal: begin resets");
+    d.on_edge(1, T0);
+    d.on_edge(0, T0 + 116);
+    check(d.distance_cm() == 2, "normal: rise at trigger end", d.distance_cm(), 2);
+}
+
+static void test_spurious() {
+    EchoDecoder d;
+    check(!d.on_edge(1, T0) && !d.on_edge(0, T0 + 100), "spurious: edges before begin", 1, 0);
+    check_state(d, State::Idle, "spurious: idle before begin");
+
+    d.begin(T0, TIMEOUT_US);
+    check(!d.on_edge(0, T0 + 50), "spurious: fall while waiting for rise", 1, 0);
+    check_state(d, State::WaitRise, "spurious: fall ignored");
+    check(!d.on_edge(1, T0 - 5), "spurious: rise before trigger end", 1, 0);
+    check_state(d, State::WaitRise, "spurious: early rise ignored");
+
+    d.on_edge(1, T0 + 200);
+    check(!d.on_edge(1, T0 + 1200), "spurious: second rise during pulse", 1, 0);
+    check_state(d, State::WaitFall, "spurious: second rise ignored");
+    d.on_edge(0, T0 + 200 + 11600);
+    check(d.pulse_us() == 11600, "spurious: pulse from the first rise", d.pulse_us(), 11600);
+
+    check(!d.on_edge(1, T0 + 20000) && !d.on_edge(0, T0 + 21000), "spurious: edges after done", 1, 0);
+    check_state(d, State::Done, "spurious: still done");
+    check(d.pulse_us() == 11600, "spurious: pulse unchanged after done", d.pulse_us(), 11600);
+    check(!d.expire(), "spurious: expire after done", 1, 0);
+    check(!d.poll(T0 + 10 * TIMEOUT_US), "spurious: poll after done", 1, 0);
+    check(d.distance_cm() == 200, "spurious: distance", d.distance_cm(), 200);
+}
+
+static void test_rise_without_fall() {
+    EchoDecoder d;
+    const int64_t rise = T0 + 300;
+    d.begin(T0, TIMEOUT_US);
+    d.on_edge(1, rise);
+    check(!d.poll(rise + TIMEOUT_US / 2), "no fall: pending mid pulse", 1, 0);
+    check(!d.poll(rise + TIMEOUT_US), "no fall: pending at the timeout", 1, 0);
+    check(d.poll(rise + TIMEOUT_US + 1), "no fall: times out past it", 0, 1);
+    check_state(d, State::Timeout, "no fall: timeout");
+    check(d.pulse_us() == -1 && d.distance_cm() == -1, "no fall: no distance", d.distance_cm(), -1);
+    check(!d.on_edge(0, rise + TIMEOUT_US + 10), "no fall: fall after timeout ignored", 1, 0);
+    check_state(d, State::Timeout, "no fall: still timeout");
+
+    // The fall arrives late and nobody polled: the edge itself times it out
+    d.begin(T0, TIMEOUT_US);
+    d.on_edge(1, rise);
+    check(d.on_edge(0, rise + TIMEOUT_US + 1), "late fall: completes", 0, 1);
+    check_state(d, State::Timeout, "late fall: timeout, not done");
+    check(d.distance_cm() == -1, "late fall: no distance", d.distance_cm(), -1);
+
+    // The overall deadline fires during the pulse
+    d.begin(T0, TIMEOUT_US);
+    d.on_edge(1, rise);
+    check(d.expire(), "expire: pending pulse", 0, 1);
+    check_state(d, State::Timeout, "expire: timeout");
+}
+
+static void test_no_echo() {
+    EchoDecoder d;
+    d.begin(T0, TIMEOUT_US);
+    check(!d.poll(T0 + TIMEOUT_US), "no echo: pending at the timeout", 1, 0);
+    check(d.poll(T0 + TIMEOUT_US + 1), "no echo: times out past it", 0, 1);
+    check_state(d, State::Timeout, "no echo: timeout");
+    check(!d.poll(T0 + TIMEOUT_US + 2), "no echo: times out once", 1, 0);
+    check(!d.expire(), "no echo: expire after timeout", 1, 0);
+
+    d.begin(T0, TIMEOUT_US);
+    check(d.on_edge(1, T0 + TIMEOUT_US + 1), "late rise: completes", 0, 1);
+    check_state(d, State::Timeout, "late rise: timeout");
+
+    d.begin(T0, TIMEOUT_US);
+    check(d.expire(), "expire: waiting for rise", 0, 1);
+    check_state(d, State::Timeout, "expire: timeout");
+
+    EchoDecoder idle;
+    check(!idle.expire() && !idle.poll(T0 + 10 * TIMEOUT_US), "idle: nothing to time out", 1, 0);
+    check_state(idle, State::Idle, "idle: still idle");
+}
+
+// Fake edge source: the echo of a target at cm, with glitches around it
+static uint32_t rng_state = 12345;
+
+static uint32_t rng() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static void test_random() {
+    const int runs = 100000;
+    int done = 0;
+    EchoDecoder d;
+    for (int i = 0; i < runs; i++) {
+        int cm = 2 + (int)(rng() % 449);
+        int32_t pulse = cm * 58 + (int32_t)(rng() % 58) - 29;
+        int64_t trig = T0 + (int64_t)i * 100000;
+        int64_t rise = trig + 100 + rng() % 400;
+        d.begin(trig, TIMEOUT_US);
+
+        if (rng() % 2) {
+            d.on_edge(0, trig + rng() % 100);                  // fall before the rise
+        }
+        if (rng() % 2) {
+            d.on_edge(1, trig - 1 - rng() % 10);               // trigger ringing
+        }
+        d.on_edge(1, rise);
+        d.poll(rise + rng() % pulse);
+        if (rng() % 2) {
+            d.on_edge(1, rise + 1 + rng() % (pulse - 1));      // second rise
+        }
+        bool finished = d.on_edge(0, rise + pulse);
+        d.on_edge(1, rise + pulse + 10);                       // after completion
+        d.on_edge(0, rise + pulse + 20);
+
+        check(finished && d.state() == State::Done, "random: done", (long)d.state(), (long)State::Done);
+        check(d.pulse_us() == pulse, "random: pulse", d.pulse_us(), pulse);
+        check(d.distance_cm() == pulse_to_cm(pulse), "random: distance", d.distance_cm(), pulse_to_cm(pulse));
+        done += d.state() == State::Done;
+    }
+    printf("random echoes with glitches: %d/%d decoded\n", done, runs);
+}
+
+int main() {
+    test_normal();
+    test_spurious();
+    test_rise_without_fall();
+    test_no_echo();
+    test_random();
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}
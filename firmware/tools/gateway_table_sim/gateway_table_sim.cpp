@@ -0,0 +1,330 @@
+// gateway_table_sim.cpp
+// Host-side check of the node gateway table (components/gateway_table/
+// gateway_table.h) and a send-latency comparison against the old failover.
+//
+// 1. Table checks: ranking by RSSI, a missed ACK demotes a gateway at once,
+//    hysteresis for the gateway that ACKed last, beacon uplink/load flags,
+//    expiry of learned gateways (seeds stay), eviction when full, adaptive
+//    ACK timeout.
+// 2. Latency, 3 gateways with ~15 ms ACK round trip, node sending every 30 s:
+//      old: GATEWAY_MACS in order from the last one that worked, 2 retries
+//           per gateway, 500 ms ACK wait, backoff 100 / 200 ms per retry
+//      new: ranked table, one attempt per gateway per pass (adaptive wait,
+//           ACK_TIMEOUT_MIN_MS..ACK_TIMEOUT_MS), 2 passes, 100 ms between
+//    Scenarios: all up, the gateway in use dies (first send and the next
+//    ones), all down, and lossy links (-88 / -75 / -55 dBm, the weakest one
+//    configured first) over -n sends: mean / p99 latency and delivery.
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -o gateway_table_sim tools/gateway_table_sim/gateway_table_sim.cpp
+//
+// Usage:
+//   ./gateway_table_sim [-n sends]   (default 20000; exit 1 if a check fails)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "components/gateway_table/gateway_table.h"
+
+using gateway_table::Entry;
+using gateway_table::Table;
+
+// Node constants (node_ultra1.cpp / node_cie_dual.cpp)
+static const int SEND_RETRIES = 2;
+static const uint32_t ACK_TIMEOUT_MS = 500;
+static const uint32_t ACK_TIMEOUT_MIN_MS = 150;
+static const uint32_t CYCLE_S = 30;
+
+// Constant-initialized, like the node's DUTY_CYCLE_RETAINED copy
+static_assert(Table().count() == 0, "constexpr Table");
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static uint32_t rng_state = 2024;
+static double uniform() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return ((rng_state >> 8) + 0.5) / 16777216.0;
+}
+
+static GatewayBeacon beacon(uint8_t id, bool uplink = true, uint8_t load = 0) {
+    GatewayBeacon b = {GATEWAY_BEACON_MAGIC, GATEWAY_BEACON_VERSION, id,
+                       (uint8_t)(uplink ? GATEWAY_BEACON_FLAG_UPLINK_OK : 0), load, 0, 0};
+    return b;
+}
+
+static void mac_of(int i, uint8_t mac[6]) {
+    const uint8_t base[6] = {0x80, 0xf3, 0xda, 0x62, 0xa7, 0x00};
+    for (int k = 0; k < 6; k++) mac[k] = base[k];
+    mac[5] = (uint8_t)(0x80 + i);
+}
+
+static int ranked_index(Table &t, uint32_t now_s, int pos) {
+    Entry out[GATEWAY_TABLE_CAPACITY];
+    int n = t.rank(out, GATEWAY_TABLE_CAPACITY, now_s);
+    return pos < n ? out[pos].mac[5] - 0x80 : -1;
+}
+
+static void test_table() {
+    uint8_t a[6], b[6], c[6], d[6], e[6];
+    mac_of(0, a); mac_of(1, b); mac_of(2, c); mac_of(3, d); mac_of(4, e);
+
+    Table t;
+    check(t.seed(a), "seed");
+    check(t.count() == 1 && ranked_index(t, 0, 0) == 0, "seed ranked before anything is heard");
+    check(t.heard_beacon(b, -60, beacon(1), 10), "new gateway from a beacon");
+    check(!t.heard_beacon(b, -60, beacon(1), 11), "known gateway is not new");
+    check(ranked_index(t, 11, 0) == 1, "heard at -60 dBm beats an unheard seed");
+    t.heard_beacon(a, -70, beacon(0), 12);
+    check(ranked_index(t, 12, 0) == 1, "stronger RSSI first");
+
+    // hysteresis: the gateway that ACKed last keeps the lead within 6 dB
+    t.acked(a, 15000);
+    check(ranked_index(t, 12, 0) == 1, "10 dB stronger still wins over the preferred one");
+    for (int i = 0; i < 12; i++) {
+        t.heard_beacon(a, -62, beacon(0), 13);
+    }
+    check(ranked_index(t, 13, 0) == 0, "preferred kept within the hysteresis");
+
+    // one missed ACK demotes it
+    t.missed(a);
+    check(ranked_index(t, 13, 0) == 1, "one miss fails over");
+    uint8_t pref[6];
+    check(!t.preferred(pref), "a miss drops the preference");
+
+    // uplink down and load push a gateway back
+    t.heard_beacon(c, -58, beacon(2, false), 14);
+    check(ranked_index(t, 14, 0) == 1, "gateway without uplink ranked below");
+    t.heard_beacon(c, -58, beacon(2, true, 90), 14);
+    t.heard_beacon(b, -60, beacon(1, true, 0), 14);
+    check(ranked_index(t, 14, 0) == 1, "loaded gateway ranked below a close idle one");
+
+    // full table: the worst learned gateway is replaced, seeds stay
+    check(t.count() == 3, "three known");
+    t.heard_beacon(d, -80, beacon(3), 15);
+    check(t.count() == GATEWAY_TABLE_CAPACITY, "table full");
+    check(t.heard_beacon(e, -50, beacon(4), 16) && !t.find(d) && t.find(a), "worst learned one evicted");
+
+    // expiry: learned gateways go after the TTL, the seed stays
+    Entry out[GATEWAY_TABLE_CAPACITY];
+    int n = t.rank(out, GATEWAY_TABLE_CAPACITY, 16 + GATEWAY_TABLE_TTL_S + 1);
+    check(n == 1 && out[0].mac[5] == a[5], "learned gateways expire, seeds do not");
+
+    // adaptive ACK wait
+    Entry x = {};
+    check(Table::ack_timeout_ms(x, 150, 500) == 500, "unknown RTT: full wait");
+    x.rtt_us = 15000;
+    check(Table::ack_timeout_ms(x, 150, 500) == 150, "short RTT: floor");
+    x.rtt_us = 90000;
+    check(Table::ack_timeout_ms(x, 150, 500) == 360, "4x RTT");
+    x.rtt_us = 400000;
+    check(Table::ack_timeout_ms(x, 150, 500) == 500, "capped");
+
+    // prefer() from NVS on an empty table
+    Table p;
+    p.prefer(c, 0);
+    check(p.count() == 1 && p.preferred(pref) && pref[5] == c[5], "restored preferred gateway");
+    printf("table checks: %s\n", failures ? "FAIL" : "ok");
+}
+
+// ---------------------------------------------------------------------------
+// Latency model
+
+struct Gw {
+    int rssi;
+    double loss;       // probability a frame or its ACK is lost
+    bool alive;
+    uint32_t rtt_ms;
+};
+
+static bool attempt_ok(const Gw &g) { return g.alive && uniform() >= g.loss; }
+
+// Old failover: from the last gateway that worked, 2 retries each
+struct OldNode {
+    int last = 0;
+    double send(const std::vector<Gw> &gws, bool *ok) {
+        double t = 0;
+        int n = (int)gws.size();
+        for (int a = 0; a < n; a++) {
+            int g = (last + a) % n;
+            for (int r = 0; r < SEND_RETRIES; r++) {
+                if (attempt_ok(gws[g])) {
+                    last = g;
+                    *ok = true;
+                    return t + gws[g].rtt_ms;
+                }
+                t += ACK_TIMEOUT_MS + 100 * (1 << r);
+            }
+        }
+        *ok = false;
+        return t;
+    }
+};
+
+// New: the table as the node uses it
+struct NewNode {
+    Table table;
+    uint32_t now_s = 0;
+
+    explicit NewNode(int seeds) {
+        for (int i = 0; i < seeds; i++) {
+            uint8_t mac[6];
+            mac_of(i, mac);
+            table.seed(mac);
+        }
+    }
+
+    // one beacon from each live gateway now and then while the node is awake
+    void hear_beacons(const std::vector<Gw> &gws, double p) {
+        for (size_t i = 0; i < gws.size(); i++) {
+            if (gws[i].alive && uniform() < p) {
+                uint8_t mac[6];
+                mac_of((int)i, mac);
+                table.heard_beacon(mac, gws[i].rssi + (int)(uniform() * 7) - 3, beacon((uint8_t)i), now_s);
+            }
+        }
+    }
+
+    double send(const std::vector<Gw> &gws, bool *ok) {
+        double t = 0;
+        for (int pass = 0; pass < SEND_RETRIES; pass++) {
+            if (pass > 0) t += 100 * (1 << (pass - 1));
+            Entry ranked[GATEWAY_TABLE_CAPACITY];
+            int n = table.rank(ranked, GATEWAY_TABLE_CAPACITY, now_s);
+            for (int i = 0; i < n; i++) {
+                const Gw &g = gws[ranked[i].mac[5] - 0x80];
+                if (attempt_ok(g)) {
+                    table.heard_ack(ranked[i].mac, g.rssi, 0, now_s);
+                    table.acked(ranked[i].mac, g.rtt_ms * 1000);
+                    *ok = true;
+                    return t + g.rtt_ms;
+                }
+                t += Table::ack_timeout_ms(ranked[i], ACK_TIMEOUT_MIN_MS, ACK_TIMEOUT_MS);
+                table.missed(ranked[i].mac);
+            }
+        }
+        *ok = false;
+        return t;
+    }
+};
+
+static std::vector<Gw> three_up() {
+    return {{-60, 0, true, 15}, {-70, 0, true, 15}, {-75, 0, true, 15}};
+}
+
+static void scenario_line(const char *name, double old_ms, double new_ms) {
+    printf("  %-38s old %6.0f ms   new %6.0f ms\n", name, old_ms, new_ms);
+}
+
+static void latency_scenarios() {
+    printf("\nsend latency, 3 gateways, ACK rtt 15 ms:\n");
+    bool ok;
+
+    // warm up both nodes on healthy gateways
+    std::vector<Gw> gws = three_up();
+    OldNode o;
+    NewNode nw(3);
+    double lo = 0, ln = 0;
+    for (int i = 0; i < 10; i++) {
+        nw.hear_beacons(gws, 0.5);
+        lo = o.send(gws, &ok);
+        ln = nw.send(gws, &ok);
+        nw.now_s += CYCLE_S;
+    }
+    scenario_line("all up", lo, ln);
+    check(ln <= lo, "all up: no slower");
+
+    // the gateway in use dies
+    gws[o.last].alive = false;
+    int dead_new = ranked_index(nw.table, nw.now_s, 0);
+    gws[dead_new].alive = false;
+    double o1 = o.send(gws, &ok), n1 = nw.send(gws, &ok);
+    nw.now_s += CYCLE_S;
+    scenario_line("gateway in use dies: first send", o1, n1);
+    double o2 = o.send(gws, &ok), n2 = nw.send(gws, &ok);
+    scenario_line("gateway in use dies: next send", o2, n2);
+    check(n1 < o1, "dead gateway: failover costs one attempt");
+    check(n2 <= 15, "dead gateway: next send goes straight to a live one");
+
+    // all down, round trips known / never measured (fresh boot)
+    for (Gw &g : gws) g.alive = false;
+    double o3 = o.send(gws, &ok), n3 = nw.send(gws, &ok);
+    scenario_line("all down (worst case)", o3, n3);
+    NewNode fresh(3);
+    OldNode fresh_old;
+    double n4 = fresh.send(gws, &ok), o4 = fresh_old.send(gws, &ok);
+    scenario_line("all down, no RTT history yet", o4, n4);
+    check(n3 < o3 && n4 < o4, "worst case shorter");
+}
+
+static void lossy_links(int sends) {
+    // weakest gateway configured first: the old order favours it
+    std::vector<Gw> gws = {{-88, 0.40, true, 25}, {-75, 0.10, true, 15}, {-55, 0.02, true, 10}};
+    OldNode o;
+    NewNode nw(3);
+    std::vector<double> lat_old, lat_new;
+    int ok_old = 0, ok_new = 0;
+    for (int i = 0; i < sends; i++) {
+        bool ok;
+        nw.hear_beacons(gws, 0.1);
+        lat_old.push_back(o.send(gws, &ok));
+        ok_old += ok;
+        lat_new.push_back(nw.send(gws, &ok));
+        ok_new += ok;
+        nw.now_s += CYCLE_S;
+    }
+    auto stats = [](std::vector<double> &v, double *mean, double *p99) {
+        double s = 0;
+        for (double x : v) s += x;
+        *mean = s / v.size();
+        std::sort(v.begin(), v.end());
+        *p99 = v[v.size() * 99 / 100];
+    };
+    double mo, po, mn, pn;
+    stats(lat_old, &mo, &po);
+    stats(lat_new, &mn, &pn);
+    printf("\nlossy links (-88 dBm 40%% / -75 dBm 10%% / -55 dBm 2%% loss), %d sends:\n", sends);
+    printf("  old: mean %6.1f ms  p99 %6.0f ms  delivered %.2f%%\n", mo, po, 100.0 * ok_old / sends);
+    printf("  new: mean %6.1f ms  p99 %6.0f ms  delivered %.2f%%\n", mn, pn, 100.0 * ok_new / sends);
+    check(mn < mo, "lossy links: lower mean latency");
+    check(ok_new >= ok_old * 0.995, "lossy links: delivery not worse");
+}
+
+int main(int argc, char **argv) {
+    int sends = 20000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n': sends = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n sends]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (sends < 100) {
+        fprintf(stderr, "bad options\n");
+        return 2;
+    }
+
+    test_table();
+    latency_scenarios();
+    lossy_links(sends);
+
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}
@@ -0,0 +1,400 @@
+// http_batch_bench.cpp
+// Host-side throughput test of the gateway's batched HTTP uplink
+// (http_worker_task in gateway_devkit_v1/main/main.c), at batch sizes 1, 8
+// and 32, JSON and binary bodies.
+//
+// The bodies are built by the gateway's encoders (main/uplink_body.c) and
+// posted over one keep-alive connection, as the worker does (-c reopens the
+// connection for every POST, the behaviour before batching). By default they
+// go to a built-in loopback server that models the backend: a fixed cost per
+// request (-l, PHP start-up + one INSERT round trip) plus a cost per row
+// (-p). With -u they go to a real backend instead, e.g.
+//   php -S 127.0.0.1:8080 -t ../backend
+//   ./http_batch_bench -u 127.0.0.1:8080/ingest_sensorpacket.php
+//
+// For each batch size and encoding: POSTs, bytes per packet, packets/s and
+// ms per POST. Checks (built-in server only): every POST answered 2xx, the
+// server counted every packet, and throughput grows with the batch size.
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -Icommon -Igateway_devkit_v1/main -pthread -o http_batch_bench tools/http_batch_bench/http_batch_bench.cpp gateway_devkit_v1/main/uplink_body.c
+//
+// Usage:
+//   ./http_batch_bench [options]   (exit 1 if a check fails)
+//     -n <pkts>      packets per run                  (default 256)
+//     -l <ms>        server cost per request          (default 10)
+//     -p <us>        server cost per packet           (default 200)
+//     -c             new connection per POST
+//     -u <host:port/path>  post to a real backend
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "uplink_body.h"
+
+static const int BATCH_SIZES[] = {1, 8, 32};
+
+struct Options {
+    int packets = 256;
+    int latency_ms = 10;
+    int per_packet_us = 200;
+    bool reconnect = false;
+    std::string host = "127.0.0.1";
+    int port = 0;                     // 0 = built-in server
+    std::string path = "/ingest_sensorpacket.php";
+};
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static double now_s() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleep_us(long us) {
+    if (us <= 0) return;
+    timespec ts = {us / 1000000, (us % 1000000) * 1000};
+    nanosleep(&ts, nullptr);
+}
+
+// ============================================================================
+// BODIES
+// ============================================================================
+
+static SensorPacketV2 make_packet(uint32_t i) {
+    SensorPacketV2 p = {};
+    p.version = SENSOR_PACKET_V2_VERSION;
+    p.node_id = (uint8_t)(1 + i % 5);
+    const uint8_t mac[6] = {0x80, 0xf3, 0xda, 0x62, 0xa7, (uint8_t)(0x80 + p.node_id)};
+    memcpy(p.mac, mac, 6);
+    p.seq = i;
+    p.distance_cm = (int16_t)(60 + i % 40);
+    p.level_cm = (int16_t)(390 - p.distance_cm);
+    p.percentual = (uint8_t)(p.level_cm * 100 / 450);
+    p.volume_l = (uint32_t)p.level_cm * 180;
+    p.vin_mv = 4950;
+    p.rssi = -60;
+    p.ts_ms = i * 30000;
+    p.rate_cmpm_x10 = (int16_t)((int)(i % 21) - 10);
+    return p;
+}
+
+static std::string encode(const SensorPacketV2 *pkts, size_t count, bool binary) {
+    static char body[32 * UPLINK_JSON_RECORD_MAX + 2];
+    int len = binary ? uplink_encode_binary(body, sizeof(body), pkts, count, false)
+                     : uplink_encode_json(body, sizeof(body), pkts, count, false);
+    return std::string(body, len > 0 ? (size_t)len : 0);
+}
+
+// ============================================================================
+// HTTP/1.1 (just enough for one POST at a time with Content-Length)
+// ============================================================================
+
+static bool send_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// Read one message (headers + Content-Length body). Returns false on EOF/error.
+static bool read_message(int fd, std::string &buf, std::string &head, std::string &body) {
+    size_t end;
+    while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+        char tmp[4096];
+        ssize_t r = recv(fd, tmp, sizeof(tmp), 0);
+        if (r <= 0) return false;
+        buf.append(tmp, (size_t)r);
+    }
+    head = buf.substr(0, end);
+    size_t len = 0;
+    for (size_t pos = 0; pos < head.size();) {
+        size_t eol = head.find("\r\n", pos);
+        if (eol == std::string::npos) eol = head.size();
+        if (strncasecmp(head.c_str() + pos, "Content-Length:", 15) == 0) {
+            len = strtoul(head.c_str() + pos + 15, nullptr, 10);
+        }
+        pos = eol + 2;
+    }
+    while (buf.size() < end + 4 + len) {
+        char tmp[4096];
+        ssize_t r = recv(fd, tmp, sizeof(tmp), 0);
+        if (r <= 0) return false;
+        buf.append(tmp, (size_t)r);
+    }
+    body = buf.substr(end + 4, len);
+    buf.erase(0, end + 4 + len);
+    return true;
+}
+
+// Packets in a body as the backend would count them
+static size_t packets_in(const std::string &body) {
+    if (!body.empty() && (uint8_t)body[0] == UPLINK_BIN_MAGIC) {
+        return body.size() >= 4 ? (uint8_t)body[3] : 0;
+    }
+    size_t n = 0;
+    for (size_t pos = 0; (pos = body.find("\"node_id\":", pos)) != std::string::npos; pos++) {
+        n++;
+    }
+    return n;
+}
+
+// Built-in backend: one connection at a time, keep-alive
+struct Server {
+    int listen_fd = -1;
+    int port = 0;
+    int latency_ms = 0;
+    int per_packet_us = 0;
+    std::atomic<long> packets{0};
+    std::atomic<long> requests{0};
+    std::atomic<long> connections{0};
+    std::thread thread;
+
+    bool start() {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in a = {};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        a.sin_port = 0;
+        if (listen_fd < 0 || bind(listen_fd, (sockaddr *)&a, sizeof(a)) != 0 || listen(listen_fd, 4) != 0) {
+            return false;
+        }
+        socklen_t len = sizeof(a);
+        getsockname(listen_fd, (sockaddr *)&a, &len);
+        port = ntohs(a.sin_port);
+        thread = std::thread([this] { run(); });
+        return true;
+    }
+
+    void run() {
+        int fd;
+        while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0) {
+            connections++;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            std::string buf, head, body;
+            while (read_message(fd, buf, head, body)) {
+                size_t n = packets_in(body);
+                sleep_us((long)latency_ms * 1000 + (long)per_packet_us * (long)n);
+                packets += (long)n;
+                requests++;
+                static const char resp[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                                           "Content-Length: 11\r\n\r\n{\"ok\":true}";
+                if (!send_all(fd, resp, sizeof(resp) - 1)) break;
+            }
+            close(fd);
+        }
+    }
+
+    void stop() {
+        shutdown(listen_fd, SHUT_RDWR);
+        close(listen_fd);
+        thread.join();
+    }
+};
+
+struct Client {
+    const Options &o;
+    int fd = -1;
+    std::string buf;
+    long connects = 0;
+
+    explicit Client(const Options &opts) : o(opts) {}
+    ~Client() { drop(); }
+
+    void drop() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+        buf.clear();
+    }
+
+    bool connect_once() {
+        addrinfo hints = {}, *res = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(o.host.c_str(), std::to_string(o.port).c_str(), &hints, &res) != 0) {
+            return false;
+        }
+        fd = socket(res->ai_family, res->ai_socktype, 0);
+        bool ok = fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) == 0;
+        freeaddrinfo(res);
+        if (!ok) {
+            drop();
+            return false;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        connects++;
+        return true;
+    }
+
+    // Returns the HTTP status, -1 on a transport error
+    int post(const std::string &body, bool binary) {
+        if (fd < 0 && !connect_once()) {
+            return -1;
+        }
+        std::string req = "POST " + o.path + " HTTP/1.1\r\nHost: " + o.host +
+                          "\r\nContent-Type: " + (binary ? "application/octet-stream" : "application/json") +
+                          "\r\nContent-Length: " + std::to_string(body.size()) +
+                          (o.reconnect ? "\r\nConnection: close" : "") + "\r\n\r\n";
+        req += body;
+        std::string head, resp;
+        if (!send_all(fd, req.data(), req.size()) || !read_message(fd, buf, head, resp)) {
+            drop();
+            return -1;
+        }
+        int status = 0;
+        sscanf(head.c_str(), "HTTP/%*s %d", &status);
+        if (o.reconnect || strcasestr(head.c_str(), "Connection: close")) {
+            drop();
+        }
+        return status;
+    }
+};
+
+// ============================================================================
+// RUNS
+// ============================================================================
+
+struct Result {
+    long posts = 0;
+    long failed = 0;
+    double bytes_per_pkt = 0;
+    double pkt_s = 0;
+    double ms_per_post = 0;
+};
+
+static Result run(const Options &o, const std::vector<SensorPacketV2> &pkts, int batch, bool binary) {
+    Result r;
+    Client c(o);
+    size_t bytes = 0;
+    double t0 = now_s();
+    for (size_t i = 0; i < pkts.size(); i += batch) {
+        size_t n = pkts.size() - i < (size_t)batch ? pkts.size() - i : (size_t)batch;
+        std::string body = encode(&pkts[i], n, binary);
+        bytes += body.size();
+        int status = c.post(body, binary);
+        r.posts++;
+        if (status < 200 || status > 299) {
+            r.failed++;
+        }
+    }
+    double dt = now_s() - t0;
+    r.bytes_per_pkt = (double)bytes / pkts.size();
+    r.pkt_s = pkts.size() / dt;
+    r.ms_per_post = dt * 1000 / r.posts;
+    return r;
+}
+
+static bool parse_url(const char *url, Options &o) {
+    const char *colon = strchr(url, ':');
+    if (!colon) return false;
+    o.host.assign(url, colon - url);
+    o.port = atoi(colon + 1);
+    const char *slash = strchr(colon, '/');
+    o.path = slash ? slash : "/";
+    return o.port > 0;
+}
+
+int main(int argc, char **argv) {
+    Options o;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:p:cu:")) != -1) {
+        switch (opt) {
+            case 'n': o.packets = atoi(optarg); break;
+            case 'l': o.latency_ms = atoi(optarg); break;
+            case 'p': o.per_packet_us = atoi(optarg); break;
+            case 'c': o.reconnect = true; break;
+            case 'u':
+                if (!parse_url(optarg, o)) {
+                    fprintf(stderr, "bad url (host:port/path)\n");
+                    return 2;
+                }
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n pkts] [-l ms] [-p us] [-c] [-u host:port/path]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (o.packets < 32 || o.latency_ms < 0 || o.per_packet_us < 0) {
+        fprintf(stderr, "bad options\n");
+        return 2;
+    }
+
+    Server server;
+    bool builtin = o.port == 0;
+    if (builtin) {
+        server.latency_ms = o.latency_ms;
+        server.per_packet_us = o.per_packet_us;
+        if (!server.start()) {
+            perror("server");
+            return 2;
+        }
+        o.port = server.port;
+        printf("built-in backend: %d ms per request + %d us per packet\n", o.latency_ms, o.per_packet_us);
+    } else {
+        printf("backend: http://%s:%d%s\n", o.host.c_str(), o.port, o.path.c_str());
+    }
+    printf("%d packets per run, %s\n", o.packets, o.reconnect ? "new connection per POST" : "keep-alive");
+
+    std::vector<SensorPacketV2> pkts;
+    for (int i = 0; i < o.packets; i++) {
+        pkts.push_back(make_packet((uint32_t)i));
+    }
+
+    printf("%5s  %-6s %6s %7s %9s %8s %9s\n", "batch", "body", "posts", "failed", "B/pkt", "pkt/s", "ms/post");
+    double prev_pkt_s[2] = {0, 0};
+    long expected = 0;
+    for (int batch : BATCH_SIZES) {
+        for (int binary = 0; binary < 2; binary++) {
+            Result r = run(o, pkts, batch, binary);
+            expected += o.packets;
+            printf("%5d  %-6s %6ld %7ld %9.1f %8.0f %9.2f\n", batch, binary ? "binary" : "json",
+                   r.posts, r.failed, r.bytes_per_pkt, r.pkt_s, r.ms_per_post);
+            if (builtin) {
+                check(r.failed == 0, "every POST answered 2xx");
+                check(r.pkt_s > prev_pkt_s[binary], "throughput grows with the batch size");
+            }
+            prev_pkt_s[binary] = r.pkt_s;
+        }
+    }
+
+    if (builtin) {
+        server.stop();
+        check(server.packets == expected, "server counted every packet");
+        printf("server: %ld requests, %ld packets, %ld connections\n",
+               server.requests.load(), server.packets.load(), server.connections.load());
+    }
+
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}
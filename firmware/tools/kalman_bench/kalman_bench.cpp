@@ -0,0 +1,207 @@
+// kalman_bench.cpp
+// Host-side accuracy test and benchmark of the nodes' Kalman filter
+// (components/ultrasonic01/kalman.h): float vs Q16.16 fixed point.
+//
+// Feeds a trace of raw distances through KalmanFilterT<float>,
+// KalmanFilterT<Q16> and a double reference, the way the nodes do
+// (consecutive updates, reset() on a failed reading), and reports the
+// deviation of each from the reference, how many rounded cm differ between
+// float and Q16, and the time per update().
+//
+// The timings are for the host CPU (hardware FPU). On the ESP32-C3 every
+// float add/mul/div is a soft-float call, so the gap there is larger; run
+// the same loop on target for absolute numbers.
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -o kalman_bench tools/kalman_bench/kalman_bench.cpp
+//
+// Usage:
+//   ./kalman_bench [options] [trace.csv ...]
+//     trace.csv: one raw distance in cm per line, or "t,distance_cm" (the
+//                last field is used; '#' lines and a header are skipped).
+//                A negative distance is a failed reading (filter reset).
+//                Without files a synthetic trace is used (slow fill and
+//                drain, +/-2 cm noise, outliers and dropouts).
+//     -q <q>     process noise               (default 1)
+//     -r <r>     measurement noise           (default 2)
+//     -n <N>     synthetic trace length      (default 200000)
+//     -t <cm>    tolerance |Q16 - float|     (default 0.01); exit 1 above it
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "components/ultrasonic01/kalman.h"
+
+using ultrasonic01::KalmanFilterT;
+using ultrasonic01::Q16;
+
+static bool load_csv(const char *path, std::vector<int> &trace) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') {
+            continue;
+        }
+        const char *field = strrchr(line, ',');
+        field = field ? field + 1 : line;
+        char *end;
+        long cm = strtol(field, &end, 10);
+        if (end == field) {
+            continue;   // header
+        }
+        trace.push_back((int)cm);
+    }
+    fclose(f);
+    return true;
+}
+
+// Deterministic noise in [-amp, amp]
+static uint32_t rng_state = 12345;
+static double noise(double amp) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return amp * (((rng_state >> 8) & 0xFFFF) / 32767.5 - 1.0);
+}
+
+// Level between 30 and 450 cm, slow fill/drain cycles, 1 % outliers, 0.5 % dropouts
+static void synthetic(std::vector<int> &trace, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        double cm = 240 + 200 * sin((double)i / 5000.0) + noise(2.0);
+        uint32_t u = (rng_state >> 8) % 1000;
+        if (u < 5) {
+            trace.push_back(-1);
+        } else if (u < 15) {
+            trace.push_back((int)lround(cm + noise(80.0)));
+        } else {
+            trace.push_back((int)lround(cm));
+        }
+    }
+}
+
+// Double-precision reference (same equations)
+struct Reference {
+    double x = 0, p = 1, q, r;
+    bool initialized = false;
+    Reference(double q_, double r_) : q(q_), r(r_) {}
+    double update(int m) {
+        if (!initialized) {
+            x = m;
+            p = r;
+            initialized = true;
+            return x;
+        }
+        p += q;
+        double k = p / (p + r);
+        x += k * (m - x);
+        p *= 1 - k;
+        return x;
+    }
+};
+
+static double as_double(float v) { return v; }
+static double as_double(Q16 v) { return v.to_double(); }
+
+template <class T>
+static double bench(const std::vector<int> &trace, T q, T r, int rounds) {
+    volatile int sink = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int k = 0; k < rounds; k++) {
+        KalmanFilterT<T> f(q, r);
+        for (int cm : trace) {
+            if (cm < 0) {
+                f.reset();
+                continue;
+            }
+            f.update(cm);
+        }
+        sink = sink + f.estimate_cm();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    return ns / ((double)rounds * trace.size());
+}
+
+int main(int argc, char **argv) {
+    double q = 1.0, r = 2.0, tolerance = 0.01;
+    size_t n = 200000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "q:r:n:t:")) != -1) {
+        switch (opt) {
+            case 'q': q = atof(optarg); break;
+            case 'r': r = atof(optarg); break;
+            case 'n': n = (size_t)atol(optarg); break;
+            case 't': tolerance = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-q q] [-r r] [-n samples] [-t cm] [trace.csv ...]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (q <= 0 || r <= 0) {
+        fprintf(stderr, "q and r must be > 0\n");
+        return 2;
+    }
+
+    std::vector<int> trace;
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            if (!load_csv(argv[i], trace)) return 1;
+        }
+    } else {
+        synthetic(trace, n);
+    }
+    if (trace.empty()) {
+        fprintf(stderr, "empty trace\n");
+        return 1;
+    }
+
+    KalmanFilterT<float> ff((float)q, (float)r);
+    KalmanFilterT<Q16> fq(Q16::from_double(q), Q16::from_double(r));
+    Reference ref(q, r);
+    double max_f = 0, max_q = 0, max_fq = 0, sum_fq = 0;
+    size_t updates = 0, cm_diff = 0;
+    for (int cm : trace) {
+        if (cm < 0) {
+            ff.reset();
+            fq.reset();
+            ref.initialized = false;
+            continue;
+        }
+        double xr = ref.update(cm);
+        double xf = as_double(ff.update(cm));
+        double xq = as_double(fq.update(cm));
+        max_f = fmax(max_f, fabs(xf - xr));
+        max_q = fmax(max_q, fabs(xq - xr));
+        max_fq = fmax(max_fq, fabs(xq - xf));
+        sum_fq += fabs(xq - xf);
+        if (ff.estimate_cm() != fq.estimate_cm()) cm_diff++;
+        updates++;
+    }
+
+    int rounds = (int)(2000000 / trace.size()) + 1;
+    double ns_f = bench<float>(trace, (float)q, (float)r, rounds);
+    double ns_q = bench<Q16>(trace, Q16::from_double(q), Q16::from_double(r), rounds);
+
+    printf("trace: %zu samples (%zu updates), q=%g r=%g\n", trace.size(), updates, q, r);
+    printf("%-8s %14s %10s\n", "", "max|x-double|", "ns/update");
+    printf("%-8s %12.6fcm %10.2f\n", "float", max_f, ns_f);
+    printf("%-8s %12.6fcm %10.2f\n", "q16.16", max_q, ns_q);
+    printf("q16 vs float: max %.6f cm, mean %.6f cm; rounded cm differ in %zu of %zu updates\n",
+           max_fq, updates ? sum_fq / updates : 0.0, cm_diff, updates);
+    if (max_fq > tolerance) {
+        printf("FAIL: above tolerance %.4f cm\n", tolerance);
+        return 1;
+    }
+    printf("ok: within tolerance %.4f cm\n", tolerance);
+    return 0;
+}
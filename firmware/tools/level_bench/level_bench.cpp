@@ -0,0 +1,219 @@
+// level_bench.cpp
+// Host-side accuracy test and benchmark of the tank geometry tables
+// (components/level_calculator/level_calculator.h).
+//
+// For a set of shapes (horizontal cylinders with flat, 2:1 and hemispherical
+// heads, vertical cylinders with cone/dome bottoms and a cone top, a prism)
+// it builds VolumeTable<P> for several P and compares volume_l() at every
+// whole cm with the closed-form volume (cmath, double), reporting the worst
+// error in liters and as % of the full tank (and, for reference, the error of
+// the old linear model). Then it times one lookup against evaluating the
+// closed form (host FPU; on the ESP32-C3 the closed form is soft-float
+// acos/sqrt, the table stays a few integer operations).
+//
+// With -e it prints a shape's table as CSV (level_cm,volume_l at every cm),
+// for the backend or a spreadsheet, from the same code the nodes compile.
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -o level_bench tools/level_bench/level_bench.cpp
+//
+// Usage:
+//   ./level_bench [-t pct]         accuracy (exit 1 above pct of full volume at
+//                                  the default point count; default 0.1) + timing
+//   ./level_bench -e <shape>       CSV, shape one of
+//        hcyl:<diameter>:<length>[:<head>]
+//        vcyl:<diameter>:<height>[:cone|dome:<bottom>]
+//        prism:<vol_l>:<height>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "components/level_calculator/level_calculator.h"
+
+using level_calculator::End;
+using level_calculator::Geometry;
+using level_calculator::StrapPoint;
+using level_calculator::VolumeTable;
+
+// Built by the compiler (static_assert proves it)
+static constexpr VolumeTable<> HCYL_TABLE(Geometry::horizontal_cylinder(250, 600, 125), 250);
+static_assert(HCYL_TABLE.volume_l(0) == 0, "empty");
+static_assert(HCYL_TABLE.volume_l(125) * 2 - HCYL_TABLE.vol_max_l() <= 1 &&
+              HCYL_TABLE.vol_max_l() - HCYL_TABLE.volume_l(125) * 2 <= 1, "symmetric: half full at mid-height");
+static constexpr StrapPoint STRAP[] = {{0, 0}, {100, 1000}, {200, 3000}};
+static constexpr VolumeTable<5> STRAP_TABLE(STRAP, 200);
+static_assert(STRAP_TABLE.volume_l(50) == 500 && STRAP_TABLE.volume_l(150) == 2000, "strapping");
+
+// ---------------------------------------------------------------------------
+// Closed forms (cm -> liters)
+
+static double hcyl_l(double d, double len, double head, double h) {
+    double r = d / 2;
+    double seg = r * r * acos((r - h) / r) - (r - h) * sqrt(2 * r * h - h * h);
+    double heads = M_PI * head * h * h * (3 * r - h) / (3 * r);
+    return (len * seg + heads) / 1000;
+}
+
+// Vertical cylinder: bottom end (cone/dome, depth b), top cone (depth t)
+static double vcyl_l(double d, double height, End bottom, double b, double t, double h) {
+    double area = M_PI * d * d / 4;
+    double v = 0;
+    double y = h;
+    if (b > 0) {
+        double hb = y < b ? y : b;
+        if (bottom == End::CONE) {
+            v += area * hb * hb * hb / (3 * b * b);
+        } else {
+            v += area * (hb * hb / b - hb * hb * hb / (3 * b * b));
+        }
+    }
+    double top_start = height - t;
+    if (y > b) {
+        double hs = (y < top_start ? y : top_start) - b;
+        v += area * hs;
+    }
+    if (t > 0 && y > top_start) {
+        double rest = height - y;
+        v += area / (3 * t * t) * (t * t * t - rest * rest * rest);
+    }
+    return v / 1000;
+}
+
+struct Case {
+    const char *name;
+    Geometry g;
+    int level_max_cm;
+    double (*exact)(const Case &, double h);
+    double a, b, c, d;
+    End end;
+};
+
+static double exact_hcyl(const Case &k, double h) { return hcyl_l(k.a, k.b, k.c, h); }
+static double exact_vcyl(const Case &k, double h) { return vcyl_l(k.a, k.b, k.end, k.c, k.d, h); }
+static double exact_prism(const Case &k, double h) { return k.a * h / k.b; }
+
+static const Case CASES[] = {
+    {"hcyl 250x600 flat", Geometry::horizontal_cylinder(250, 600), 250, exact_hcyl, 250, 600, 0, 0, End::FLAT},
+    {"hcyl 250x600 2:1", Geometry::horizontal_cylinder(250, 600, 62), 250, exact_hcyl, 250, 600, 62, 0, End::FLAT},
+    {"hcyl 250x600 hemi", Geometry::horizontal_cylinder(250, 600, 125), 250, exact_hcyl, 250, 600, 125, 0, End::FLAT},
+    {"hcyl 120x300 flat", Geometry::horizontal_cylinder(120, 300), 120, exact_hcyl, 120, 300, 0, 0, End::FLAT},
+    {"vcyl 300x450 cone90", Geometry::vertical_cylinder(300, 450, End::CONE, 90), 450, exact_vcyl, 300, 450, 90, 0, End::CONE},
+    {"vcyl 300x450 dome60", Geometry::vertical_cylinder(300, 450, End::DOME, 60), 450, exact_vcyl, 300, 450, 60, 0, End::DOME},
+    {"vcyl 830x450 +top50", Geometry::vertical_cylinder(830, 450, End::CONE, 40, End::CONE, 50), 450, exact_vcyl, 830, 450, 40, 50, End::CONE},
+    {"prism 245000/450", Geometry::prism(245000, 450), 450, exact_prism, 245000, 450, 0, 0, End::FLAT},
+};
+
+template <int P>
+static double worst_pct(const Case &k, double *worst_l) {
+    VolumeTable<P> t(k.g, k.level_max_cm);
+    double full = k.exact(k, k.level_max_cm);
+    double worst = 0;
+    for (int h = 0; h <= k.level_max_cm; h++) {
+        double err = fabs(t.volume_l(h) - k.exact(k, h));
+        if (err > worst) worst = err;
+    }
+    *worst_l = worst;
+    return 100.0 * worst / full;
+}
+
+// What compute(distance, Model) reports for this tank (volume proportional to level)
+static double linear_pct(const Case &k) {
+    double full = k.exact(k, k.level_max_cm);
+    double worst = 0;
+    for (int h = 0; h <= k.level_max_cm; h++) {
+        double err = fabs(full * h / k.level_max_cm - k.exact(k, h));
+        if (err > worst) worst = err;
+    }
+    return 100.0 * worst / full;
+}
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench() {
+    const Case &k = CASES[2];
+    VolumeTable<> t(k.g, k.level_max_cm);
+    const int N = 20000000;
+    volatile int sink = 0;
+    double t0 = now_ns();
+    for (int i = 0; i < N; i++) sink = sink + t.volume_l(i % 251);
+    double t1 = now_ns();
+    volatile double sinkd = 0;
+    for (int i = 0; i < N; i++) sinkd = sinkd + hcyl_l(250, 600, 125, i % 251);
+    double t2 = now_ns();
+    printf("lookup (%s): table %.2f ns, closed form %.2f ns (host FPU)\n", k.name, (t1 - t0) / N, (t2 - t1) / N);
+}
+
+static int export_csv(const char *spec) {
+    char end[8] = {0};
+    int a = 0, b = 0, c = 0;
+    Geometry g;
+    int level_max;
+    if (sscanf(spec, "hcyl:%d:%d:%d", &a, &b, &c) >= 2) {
+        g = Geometry::horizontal_cylinder(a, b, c);
+        level_max = a;
+    } else if (sscanf(spec, "vcyl:%d:%d:%7[a-z]:%d", &a, &b, end, &c) >= 2) {
+        End e = strcmp(end, "cone") == 0 ? End::CONE : strcmp(end, "dome") == 0 ? End::DOME : End::FLAT;
+        g = Geometry::vertical_cylinder(a, b, e, c);
+        level_max = b;
+    } else if (sscanf(spec, "prism:%d:%d", &a, &b) == 2) {
+        g = Geometry::prism(a, b);
+        level_max = b;
+    } else {
+        fprintf(stderr, "unknown shape '%s'\n", spec);
+        return 2;
+    }
+    if (level_max <= 0) {
+        fprintf(stderr, "bad dimensions\n");
+        return 2;
+    }
+    VolumeTable<> t(g, level_max);
+    printf("level_cm,volume_l\n");
+    for (int h = 0; h <= level_max; h++) {
+        printf("%d,%d\n", h, t.volume_l(h));
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    double tolerance = 0.1;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:e:")) != -1) {
+        switch (opt) {
+            case 't': tolerance = atof(optarg); break;
+            case 'e': return export_csv(optarg);
+            default:
+                fprintf(stderr, "usage: %s [-t pct] | -e shape\n", argv[0]);
+                return 2;
+        }
+    }
+
+    printf("worst |table - closed form| over every cm, %% of full volume (liters)\n");
+    printf("%-20s %12s %9s %16s %16s %16s %16s\n", "", "full", "linear", "P=9", "P=17", "P=33", "P=65");
+    bool ok = true;
+    for (const Case &k : CASES) {
+        double l9, l17, l33, l65;
+        double p9 = worst_pct<9>(k, &l9);
+        double p17 = worst_pct<17>(k, &l17);
+        double p33 = worst_pct<33>(k, &l33);
+        double p65 = worst_pct<LEVEL_CALCULATOR_TABLE_POINTS>(k, &l65);
+        printf("%-20s %10.0f L %8.2f%% %7.3f%% (%5.0f) %7.3f%% (%5.0f) %7.3f%% (%5.0f) %7.3f%% (%5.0f)\n", k.name,
+               k.exact(k, k.level_max_cm), linear_pct(k), p9, l9, p17, l17, p33, l33, p65, l65);
+        if (p65 > tolerance) ok = false;
+    }
+    bench();
+    if (!ok) {
+        printf("FAIL: above %.3f%% with %d points\n", tolerance, LEVEL_CALCULATOR_TABLE_POINTS);
+        return 1;
+    }
+    printf("ok: within %.3f%% of full volume with %d points\n", tolerance, LEVEL_CALCULATOR_TABLE_POINTS);
+    return 0;
+}
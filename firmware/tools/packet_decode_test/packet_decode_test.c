@@ -0,0 +1,315 @@
+// packet_decode_test.c
+// Host-side test of the gateway's ESP-NOW frame dispatcher
+// (gateway_devkit_v1/main/packet_decode.c).
+//
+// 1. Golden frames, written out byte by byte (so a change in a struct layout
+//    shows up here, not on the air): SensorPacketV1, SensorPacketV2 (one and
+//    two records), 0xA1 ultra01, 0xDA generic key/value and a 0xB1 batch with
+//    an escaped delta. Each must decode to exactly the expected records.
+// 2. Rejects: truncated, padded and oversized frames (8 x SensorPacketV2,
+//    9 x V1, a 33-sample batch), unknown magic/version, mixed versions in a
+//    multi-record frame, more records than the caller's buffer.
+// 3. Timing: ns per packet_decode() call for each golden frame (host CPU).
+//
+// Build (from firmware/):
+//   gcc -std=gnu11 -O2 -Icommon -Igateway_devkit_v1/main -o packet_decode_test tools/packet_decode_test/packet_decode_test.c gateway_devkit_v1/main/packet_decode.c -lm
+//
+// Usage:
+//   ./packet_decode_test [-n calls]   (timing calls per frame, default 2000000; exit 1 if a check fails)
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "packet_decode.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ============================================================================
+// GOLDEN FRAMES
+// ============================================================================
+
+#define NODE_MAC 0x80, 0xf3, 0xda, 0x62, 0xa7, 0x81
+
+// v1: node 3, seq 258, 100 cm, level 350, 77 %, 63000 L, 4950 mV, alert rapid drop
+static const uint8_t FRAME_V1[] = {
+    0x01, 0x03, NODE_MAC, 0x02, 0x01, 0x00, 0x00,
+    0x64, 0x00, 0x5e, 0x01, 0x4d, 0x18, 0xf6, 0x00, 0x00, 0x56, 0x13,
+    0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+// v2: same reading, age 1500 ms, rate -1.5 cm/min
+#define V2_RECORD(seq_lo)                                                  \
+    0x02, 0x03, NODE_MAC, seq_lo, 0x01, 0x00, 0x00,                        \
+    0x64, 0x00, 0x5e, 0x01, 0x4d, 0x18, 0xf6, 0x00, 0x00, 0x56, 0x13,      \
+    0x01, 0x01, 0x00, 0xdc, 0x05, 0x00, 0x00, 0xf1, 0xff
+static const uint8_t FRAME_V2[] = { V2_RECORD(0x02) };
+static const uint8_t FRAME_V2_X2[] = { V2_RECORD(0x02), V2_RECORD(0x03) };
+
+// ultra01: node 5, 210 cm, low battery + sensor error
+static const uint8_t FRAME_ULTRA01[] = {
+    0xa1, 0x01, 0x05, 0xd2, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+// generic: node 7, seq 42, dist=153 (int16), lvl=297 (uint16), bat_mv=3712.6f, temp=25 (ignored)
+static const uint8_t FRAME_GENERIC[] = {
+    0xda, 0x02, 0x07, NODE_MAC, 0x2a, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x04, 'd', 'i', 's', 't', 0x03, 0x02, 0x99, 0x00,
+    0x03, 'l', 'v', 'l', 0x04, 0x02, 0x29, 0x01,
+    0x06, 'b', 'a', 't', '_', 'm', 'v', 0x07, 0x04, 0x9a, 0x09, 0x68, 0x45,
+    0x04, 't', 'e', 'm', 'p', 0x01, 0x01, 0x19,
+};
+
+// batch: node 9, 4 samples from seq 100, oldest 90 s old, every 30 s, 4100 mV,
+// alert on the newest; tank 400 cm + 20 cm offset, 50000 L;
+// distances 120, +2, escape 300, -3
+static const uint8_t FRAME_BATCH[] = {
+    0xb1, 0x01, 0x09, 0x04, 0x64, 0x00, 0x00, 0x00, 0x90, 0x5f, 0x01, 0x00,
+    0x30, 0x75, 0x00, 0x00, 0x04, 0x10, 0x01, 0x01, 0x90, 0x01, 0x14, 0x00,
+    0x50, 0xc3, 0x00, 0x00, 0x78, 0x00,
+    0x02, 0x80, 0x2c, 0x01, 0xfd,
+};
+
+static SensorPacketV2 rec_v1(uint8_t version, uint32_t seq, uint32_t ts_ms, int16_t rate) {
+    SensorPacketV2 r = {
+        .version = version, .node_id = 3, .mac = {NODE_MAC}, .seq = seq,
+        .distance_cm = 100, .level_cm = 350, .percentual = 77, .volume_l = 63000, .vin_mv = 4950,
+        .flags = FLAG_IS_ALERT, .alert_type = ALERT_RAPID_DROP, .rssi = 0, .ts_ms = ts_ms,
+        .rate_cmpm_x10 = rate,
+    };
+    return r;
+}
+
+static SensorPacketV2 rec_batch(int i) {
+    static const int16_t dist[] = {120, 122, 300, 297};
+    int16_t level = (int16_t)(400 + 20 - dist[i]);
+    SensorPacketV2 r = {
+        .version = SENSOR_PACKET_VERSION, .node_id = 9, .seq = 100 + (uint32_t)i,
+        .distance_cm = dist[i], .level_cm = level, .percentual = (uint8_t)(level * 100 / 400),
+        .volume_l = (uint32_t)level * 125, .vin_mv = 4100,
+        .ts_ms = 90000 - 30000 * (uint32_t)i, .rate_cmpm_x10 = SENSOR_RATE_UNKNOWN,
+    };
+    if (i == 3) {
+        r.flags = FLAG_IS_ALERT;
+        r.alert_type = ALERT_RAPID_DROP;
+    }
+    return r;
+}
+
+static bool records_equal(const SensorPacketV2 *got, const SensorPacketV2 *want, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (memcmp(&got[i], &want[i], sizeof(SensorPacketV2)) != 0) {
+            printf("  record %zu: seq %u/%u dist %d/%d level %d/%d pct %u/%u vol %u/%u vin %d/%d "
+                   "flags %02x/%02x alert %u/%u ts %u/%u rate %d/%d\n", i,
+                   got[i].seq, want[i].seq, got[i].distance_cm, want[i].distance_cm,
+                   got[i].level_cm, want[i].level_cm, got[i].percentual, want[i].percentual,
+                   got[i].volume_l, want[i].volume_l, got[i].vin_mv, want[i].vin_mv,
+                   got[i].flags, want[i].flags, got[i].alert_type, want[i].alert_type,
+                   got[i].ts_ms, want[i].ts_ms, got[i].rate_cmpm_x10, want[i].rate_cmpm_x10);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void golden(const char *name, const uint8_t *frame, size_t len, packet_format_t format, bool has_seq,
+                   const SensorPacketV2 *want, size_t n) {
+    SensorPacketV2 out[PACKET_DECODE_MAX_RECORDS];
+    packet_decode_result_t res;
+    int err = packet_decode(frame, len, out, PACKET_DECODE_MAX_RECORDS, &res);
+    bool ok = err == PACKET_DECODE_OK && res.format == format && res.has_seq == has_seq && res.count == n &&
+              records_equal(out, want, n);
+    printf("golden %-8s %3zu B -> %zu record(s): %s\n", name, len, res.count, ok ? "ok" : "FAIL");
+    check(ok, name);
+}
+
+static void test_golden(void) {
+    check(sizeof(FRAME_V1) == sizeof(SensorPacketV1) && sizeof(FRAME_V2) == sizeof(SensorPacketV2) &&
+          sizeof(FRAME_ULTRA01) == sizeof(aguadaUltrasonic01Packet), "golden frame sizes match the structs");
+
+    SensorPacketV2 want[4];
+    want[0] = rec_v1(1, 258, 0, SENSOR_RATE_UNKNOWN);
+    golden("v1", FRAME_V1, sizeof(FRAME_V1), PACKET_FORMAT_V1, true, want, 1);
+
+    want[0] = rec_v1(2, 258, 1500, -15);
+    golden("v2", FRAME_V2, sizeof(FRAME_V2), PACKET_FORMAT_V2, true, want, 1);
+    want[1] = rec_v1(2, 259, 1500, -15);
+    golden("v2 x2", FRAME_V2_X2, sizeof(FRAME_V2_X2), PACKET_FORMAT_V2, true, want, 2);
+
+    SensorPacketV2 u = {
+        .version = SENSOR_PACKET_VERSION, .node_id = 5, .distance_cm = 210,
+        .flags = FLAG_DISTANCE_ONLY | FLAG_LOW_BATTERY | FLAG_SENSOR_ERROR, .rate_cmpm_x10 = SENSOR_RATE_UNKNOWN,
+    };
+    golden("ultra01", FRAME_ULTRA01, sizeof(FRAME_ULTRA01), PACKET_FORMAT_ULTRA01, false, &u, 1);
+
+    SensorPacketV2 g = {
+        .version = SENSOR_PACKET_VERSION, .node_id = 7, .mac = {NODE_MAC}, .seq = 42,
+        .distance_cm = 153, .level_cm = 297, .vin_mv = 3713, .rate_cmpm_x10 = SENSOR_RATE_UNKNOWN,
+    };
+    golden("generic", FRAME_GENERIC, sizeof(FRAME_GENERIC), PACKET_FORMAT_GENERIC, true, &g, 1);
+
+    for (int i = 0; i < 4; i++) {
+        want[i] = rec_batch(i);
+    }
+    golden("batch", FRAME_BATCH, sizeof(FRAME_BATCH), PACKET_FORMAT_BATCH, true, want, 4);
+}
+
+// ============================================================================
+// REJECTS
+// ============================================================================
+
+static void reject(const char *what, const uint8_t *frame, size_t len, size_t max_out, int want_err) {
+    SensorPacketV2 out[PACKET_DECODE_MAX_RECORDS + 1];
+    packet_decode_result_t res;
+    int err = packet_decode(frame, len, out, max_out, &res);
+    bool ok = err == want_err && res.count == 0;
+    if (!ok) {
+        printf("  %s: got %d (count %zu), want %d\n", what, err, res.count, want_err);
+    }
+    check(ok, what);
+}
+
+static void test_rejects(void) {
+    int before = failures;
+    uint8_t buf[512];
+    const size_t max = PACKET_DECODE_MAX_RECORDS;
+
+    // truncated
+    reject("v1 truncated", FRAME_V1, sizeof(FRAME_V1) - 1, max, PACKET_DECODE_ERR_LEN);
+    reject("v2 truncated", FRAME_V2, sizeof(FRAME_V2) - 2, max, PACKET_DECODE_ERR_LEN);
+    reject("ultra01 truncated", FRAME_ULTRA01, sizeof(FRAME_ULTRA01) - 1, max, PACKET_DECODE_ERR_LEN);
+    reject("generic header truncated", FRAME_GENERIC, 10, max, PACKET_DECODE_ERR_LEN);
+    reject("generic pair truncated", FRAME_GENERIC, sizeof(FRAME_GENERIC) - 1, max, PACKET_DECODE_ERR_MALFORMED);
+    reject("batch header truncated", FRAME_BATCH, sizeof(SensorBatchHeader) - 1, max, PACKET_DECODE_ERR_LEN);
+    reject("batch delta missing", FRAME_BATCH, sizeof(FRAME_BATCH) - 1, max, PACKET_DECODE_ERR_LEN);
+    reject("batch escape cut", FRAME_BATCH, sizeof(FRAME_BATCH) - 2, max, PACKET_DECODE_ERR_LEN);
+    reject("one byte", FRAME_V1, 1, max, PACKET_DECODE_ERR_LEN);
+
+    // padded
+    memcpy(buf, FRAME_V2, sizeof(FRAME_V2));
+    buf[sizeof(FRAME_V2)] = 0;
+    reject("v2 padded", buf, sizeof(FRAME_V2) + 1, max, PACKET_DECODE_ERR_LEN);
+    memcpy(buf, FRAME_V1, sizeof(FRAME_V1));
+    buf[sizeof(FRAME_V1)] = 0;
+    reject("v1 padded", buf, sizeof(FRAME_V1) + 1, max, PACKET_DECODE_ERR_LEN);
+    memcpy(buf, FRAME_ULTRA01, sizeof(FRAME_ULTRA01));
+    buf[sizeof(FRAME_ULTRA01)] = 0;
+    reject("ultra01 padded", buf, sizeof(FRAME_ULTRA01) + 1, max, PACKET_DECODE_ERR_LEN);
+    memcpy(buf, FRAME_BATCH, sizeof(FRAME_BATCH));
+    buf[sizeof(FRAME_BATCH)] = 0;
+    reject("batch trailing byte", buf, sizeof(FRAME_BATCH) + 1, max, PACKET_DECODE_ERR_LEN);
+
+    // oversized
+    for (int i = 0; i < SENSOR_PACKET_MAX_PER_FRAME + 1; i++) {
+        memcpy(&buf[i * sizeof(FRAME_V2)], FRAME_V2, sizeof(FRAME_V2));
+    }
+    reject("8 x v2", buf, (SENSOR_PACKET_MAX_PER_FRAME + 1) * sizeof(FRAME_V2), max, PACKET_DECODE_ERR_LEN);
+    SensorPacketV2 out[PACKET_DECODE_MAX_RECORDS];
+    packet_decode_result_t res;
+    check(packet_decode(buf, SENSOR_PACKET_MAX_PER_FRAME * sizeof(FRAME_V2), out, max, &res) == PACKET_DECODE_OK &&
+          res.count == SENSOR_PACKET_MAX_PER_FRAME, "7 x v2 accepted");
+    for (int i = 0; i < SENSOR_PACKET_V1_MAX_PER_FRAME + 1; i++) {
+        memcpy(&buf[i * sizeof(FRAME_V1)], FRAME_V1, sizeof(FRAME_V1));
+    }
+    reject("9 x v1", buf, (SENSOR_PACKET_V1_MAX_PER_FRAME + 1) * sizeof(FRAME_V1), max, PACKET_DECODE_ERR_LEN);
+    memcpy(buf, FRAME_BATCH, sizeof(SensorBatchHeader));
+    buf[3] = SENSOR_BATCH_MAX_SAMPLES + 1;
+    memset(&buf[sizeof(SensorBatchHeader)], 0, SENSOR_BATCH_MAX_SAMPLES);
+    reject("33-sample batch", buf, sizeof(SensorBatchHeader) + SENSOR_BATCH_MAX_SAMPLES, max + 1,
+           PACKET_DECODE_ERR_MALFORMED);
+    buf[3] = 0;
+    reject("empty batch", buf, sizeof(SensorBatchHeader), max, PACKET_DECODE_ERR_MALFORMED);
+    memcpy(buf, FRAME_GENERIC, sizeof(FRAME_GENERIC));
+    buf[offsetof(GenericPacketHeader, pair_count)] = MAX_DATA_PAIRS + 1;
+    reject("generic too many pairs", buf, sizeof(FRAME_GENERIC), max, PACKET_DECODE_ERR_MALFORMED);
+
+    // content
+    reject("unknown magic", (const uint8_t[]){0x7f, 0x01, 0x00, 0x00}, 4, max, PACKET_DECODE_ERR_UNKNOWN);
+    memcpy(buf, FRAME_ULTRA01, sizeof(FRAME_ULTRA01));
+    buf[1] = 2;
+    reject("ultra01 version 2", buf, sizeof(FRAME_ULTRA01), max, PACKET_DECODE_ERR_UNKNOWN);
+    memcpy(buf, FRAME_V2_X2, sizeof(FRAME_V2_X2));
+    buf[sizeof(FRAME_V2)] = 1;
+    reject("mixed versions", buf, sizeof(FRAME_V2_X2), max, PACKET_DECODE_ERR_MALFORMED);
+    reject("caller buffer too small", FRAME_V2_X2, sizeof(FRAME_V2_X2), 1, PACKET_DECODE_ERR_MALFORMED);
+    reject("batch larger than caller buffer", FRAME_BATCH, sizeof(FRAME_BATCH), 3, PACKET_DECODE_ERR_MALFORMED);
+    reject("no room at all", FRAME_V1, sizeof(FRAME_V1), 0, PACKET_DECODE_ERR_LEN);
+    printf("rejects: %s\n", failures > before ? "FAIL" : "ok");
+}
+
+// ============================================================================
+// TIMING
+// ============================================================================
+
+static void timing(long calls) {
+    static const struct {
+        const char *name;
+        const uint8_t *frame;
+        size_t len;
+    } frames[] = {
+        {"v1", FRAME_V1, sizeof(FRAME_V1)},
+        {"v2", FRAME_V2, sizeof(FRAME_V2)},
+        {"v2 x2", FRAME_V2_X2, sizeof(FRAME_V2_X2)},
+        {"ultra01", FRAME_ULTRA01, sizeof(FRAME_ULTRA01)},
+        {"generic", FRAME_GENERIC, sizeof(FRAME_GENERIC)},
+        {"batch", FRAME_BATCH, sizeof(FRAME_BATCH)},
+    };
+    SensorPacketV2 out[PACKET_DECODE_MAX_RECORDS];
+    packet_decode_result_t res;
+    printf("\n%-8s %9s %9s\n", "format", "ns/frame", "ns/rec");
+    for (size_t f = 0; f < sizeof(frames) / sizeof(frames[0]); f++) {
+        volatile size_t sink = 0;
+        double t0 = now_s();
+        for (long i = 0; i < calls; i++) {
+            packet_decode(frames[f].frame, frames[f].len, out, PACKET_DECODE_MAX_RECORDS, &res);
+            sink += res.count + (size_t)out[0].distance_cm;
+        }
+        double ns = (now_s() - t0) * 1e9 / calls;
+        printf("%-8s %9.1f %9.1f\n", frames[f].name, ns, ns / (res.count ? res.count : 1));
+    }
+}
+
+int main(int argc, char **argv) {
+    long calls = 2000000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n': calls = atol(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n calls]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (calls <= 0) {
+        fprintf(stderr, "bad options\n");
+        return 2;
+    }
+
+    test_golden();
+    test_rejects();
+    timing(calls);
+
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}
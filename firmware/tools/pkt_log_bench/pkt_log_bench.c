@@ -0,0 +1,479 @@
+// pkt_log_bench.c
+// Host-side test and benchmark of the gateway's flash backlog
+// (gateway_devkit_v1/main/pkt_log.c) on a file that behaves like NOR flash:
+// erase sets a sector to 0xFF, a write can only clear bits (a write that
+// would set one is counted as an overwrite and fails the checks).
+//
+// 1. append / flush / pop / commit: every record comes back once, in order.
+// 2. rewind: uncommitted pops are returned again after pkt_log_rewind().
+// 3. reboot recovery: pkt_log_open() on the same file restores the pending
+//    count and the committed cursor; unflushed appends are gone; a flush cut
+//    by a power loss keeps every record before the tear, and appends after
+//    the reboot go on normally.
+// 4. wrap-around: a small log filled past its capacity drops whole sectors
+//    of the oldest records, counts them, and still returns the rest in order
+//    (also after a reboot).
+// 5. capacity of the gateway partition (-s sectors, 960 KB by default) for
+//    SensorPacketV2 records, and how many it really holds before dropping.
+// 6. the gateway pattern over -n packets (appends in batches of -b with one
+//    flush, pops of up to HTTP_BATCH_MAX, commit per batch): write
+//    amplification (flash bytes / payload bytes), erases per sector, and
+//    append / replay throughput on the file.
+//
+// Build (from firmware/):
+//   gcc -std=gnu11 -O2 -I. -Igateway_devkit_v1/main -o pkt_log_bench tools/pkt_log_bench/pkt_log_bench.c gateway_devkit_v1/main/pkt_log.c
+//
+// Usage:
+//   ./pkt_log_bench [options]   (exit 1 if a check fails)
+//     -n <pkts>     packets through the gateway pattern  (default 20000)
+//     -b <pkts>     packets per append batch             (default 16)
+//     -s <sectors>  partition size in 4 KB sectors       (default 240)
+//     -f <path>     flash image file                     (default /tmp/pkt_log_bench.bin)
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/telemetry_packet.h"
+#include "pkt_log.h"
+
+#define HTTP_BATCH_MAX 16   // gateway main.c
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ============================================================================
+// FILE FLASH
+// ============================================================================
+
+typedef struct {
+    int fd;
+    uint32_t size;
+    uint32_t *erases;       // per sector
+    uint32_t overwrites;    // writes that tried to set a bit
+    long tear_after;        // >= 0: the next write stops after this many bytes (power loss)
+    bool powered_off;
+} file_flash_t;
+
+static int ff_read(void *ctx, uint32_t offset, void *dst, uint32_t len) {
+    file_flash_t *f = (file_flash_t *)ctx;
+    if (f->powered_off || offset + len > f->size) {
+        return -1;
+    }
+    return pread(f->fd, dst, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+static int ff_write(void *ctx, uint32_t offset, const void *src, uint32_t len) {
+    file_flash_t *f = (file_flash_t *)ctx;
+    if (f->powered_off || offset + len > f->size) {
+        return -1;
+    }
+    uint8_t cur[PKT_LOG_SECTOR_SIZE];
+    const uint8_t *s = (const uint8_t *)src;
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t n = len - done < sizeof(cur) ? len - done : (uint32_t)sizeof(cur);
+        if (f->tear_after >= 0 && done + n > (uint32_t)f->tear_after) {
+            n = (uint32_t)f->tear_after - done;
+        }
+        if (pread(f->fd, cur, n, offset + done) != (ssize_t)n) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if ((cur[i] & s[done + i]) != s[done + i]) {
+                f->overwrites++;
+            }
+            cur[i] &= s[done + i];
+        }
+        if (pwrite(f->fd, cur, n, offset + done) != (ssize_t)n) {
+            return -1;
+        }
+        done += n;
+        if (f->tear_after >= 0 && done == (uint32_t)f->tear_after) {
+            f->powered_off = true;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int ff_erase_sector(void *ctx, uint32_t offset) {
+    file_flash_t *f = (file_flash_t *)ctx;
+    if (f->powered_off || offset % PKT_LOG_SECTOR_SIZE != 0 || offset >= f->size) {
+        return -1;
+    }
+    uint8_t blank[PKT_LOG_SECTOR_SIZE];
+    memset(blank, 0xFF, sizeof(blank));
+    f->erases[offset / PKT_LOG_SECTOR_SIZE]++;
+    return pwrite(f->fd, blank, sizeof(blank), offset) == (ssize_t)sizeof(blank) ? 0 : -1;
+}
+
+// Blank (all 0xFF) image of the given size
+static bool ff_create(file_flash_t *f, const char *path, uint32_t sectors) {
+    memset(f, 0, sizeof(*f));
+    f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (f->fd < 0) {
+        return false;
+    }
+    f->size = sectors * PKT_LOG_SECTOR_SIZE;
+    f->erases = (uint32_t *)calloc(sectors, sizeof(uint32_t));
+    f->tear_after = -1;
+    uint8_t blank[PKT_LOG_SECTOR_SIZE];
+    memset(blank, 0xFF, sizeof(blank));
+    for (uint32_t s = 0; s < sectors; s++) {
+        if (pwrite(f->fd, blank, sizeof(blank), (off_t)s * PKT_LOG_SECTOR_SIZE) != (ssize_t)sizeof(blank)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ff_close(file_flash_t *f) {
+    close(f->fd);
+    free(f->erases);
+}
+
+static pkt_log_io_t ff_io(file_flash_t *f) {
+    pkt_log_io_t io = { f, f->size, ff_read, ff_write, ff_erase_sector };
+    return io;
+}
+
+// Power cycle: the RAM state (staging page included) is lost, the file stays
+static int reboot(pkt_log_t *log, file_flash_t *f) {
+    f->powered_off = false;
+    f->tear_after = -1;
+    pkt_log_io_t io = ff_io(f);
+    return pkt_log_open(log, &io);
+}
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static SensorPacketV2 packet(uint32_t seq) {
+    SensorPacketV2 p;
+    memset(&p, 0, sizeof(p));
+    p.version = SENSOR_PACKET_V2_VERSION;
+    p.node_id = (uint8_t)(1 + seq % 7);
+    p.seq = seq;
+    p.distance_cm = (int16_t)(50 + seq % 300);
+    p.level_cm = (int16_t)(400 - p.distance_cm);
+    p.rate_cmpm_x10 = SENSOR_RATE_UNKNOWN;
+    return p;
+}
+
+static bool append_range(pkt_log_t *log, uint32_t first, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        SensorPacketV2 p = packet(first + i);
+        if (pkt_log_append(log, &p, sizeof(p)) != PKT_LOG_OK) {
+            return false;
+        }
+    }
+    return pkt_log_flush(log) == PKT_LOG_OK;
+}
+
+// Pop up to n records; true if they are exactly seq first, first+1, ...
+// (*got receives how many were popped)
+static bool pop_expect(pkt_log_t *log, uint32_t first, uint32_t n, uint32_t *got) {
+    bool ok = true;
+    uint32_t i = 0;
+    for (; i < n; i++) {
+        SensorPacketV2 p;
+        size_t len = 0;
+        if (pkt_log_pop(log, &p, sizeof(p), &len) != PKT_LOG_OK) {
+            break;
+        }
+        SensorPacketV2 want = packet(first + i);
+        if (len != sizeof(p) || memcmp(&p, &want, sizeof(p)) != 0) {
+            ok = false;
+        }
+    }
+    if (got) *got = i;
+    return ok && i == n;
+}
+
+// Seq of the next record pop would return (consumes nothing)
+static int64_t peek_seq(pkt_log_t *log) {
+    SensorPacketV2 p;
+    size_t len = 0;
+    if (pkt_log_pop(log, &p, sizeof(p), &len) != PKT_LOG_OK) {
+        return -1;
+    }
+    pkt_log_rewind(log);
+    return p.seq;
+}
+
+// ============================================================================
+// CHECKS
+// ============================================================================
+
+static void test_basic(const char *path) {
+    file_flash_t f;
+    pkt_log_t log;
+    check(ff_create(&f, path, 8), "create image");
+    check(reboot(&log, &f) == PKT_LOG_OK, "open blank image");
+    check(pkt_log_count(&log) == 0, "blank log is empty");
+
+    check(append_range(&log, 0, 50), "append 50");
+    check(pkt_log_count(&log) == 50 && pkt_log_available(&log) == 50, "count after append");
+    check(pop_expect(&log, 0, 20, NULL), "pop 20 in order");
+    check(pkt_log_available(&log) == 30 && pkt_log_count(&log) == 50, "popped records stay counted");
+    check(pkt_log_commit(&log) == PKT_LOG_OK && pkt_log_count(&log) == 30, "commit 20");
+
+    // rewind
+    check(pop_expect(&log, 20, 10, NULL), "pop 10 more");
+    pkt_log_rewind(&log);
+    check(pkt_log_available(&log) == 30, "rewind restores available");
+    check(pop_expect(&log, 20, 30, NULL), "rewound records come back");
+    SensorPacketV2 p;
+    check(pkt_log_pop(&log, &p, sizeof(p), NULL) == PKT_LOG_ERR_EMPTY, "empty after the last record");
+    check(pkt_log_commit(&log) == PKT_LOG_OK && pkt_log_count(&log) == 0, "commit all");
+
+    // popping from the unflushed staging page
+    SensorPacketV2 q = packet(50);
+    check(pkt_log_append(&log, &q, sizeof(q)) == PKT_LOG_OK, "append unflushed");
+    check(pop_expect(&log, 50, 1, NULL), "pop from the staging page");
+    pkt_log_rewind(&log);
+    check(pkt_log_pop(&log, &p, 4, NULL) == PKT_LOG_ERR_SIZE, "small buffer rejected");
+    pkt_log_rewind(&log);
+    check(pkt_log_append(&log, &q, 0) == PKT_LOG_ERR_ARG &&
+          pkt_log_append(&log, &q, PKT_LOG_MAX_PAYLOAD + 1) == PKT_LOG_ERR_ARG, "bad lengths rejected");
+
+    // v1 records (older firmware) share the log
+    SensorPacketV1 v1;
+    memset(&v1, 0, sizeof(v1));
+    v1.seq = 77;
+    size_t len = 0;
+    check(pkt_log_pop(&log, &p, sizeof(p), NULL) == PKT_LOG_OK && pkt_log_commit(&log) == PKT_LOG_OK, "drain");
+    check(pkt_log_append(&log, &v1, sizeof(v1)) == PKT_LOG_OK &&
+          pkt_log_pop(&log, &p, sizeof(p), &len) == PKT_LOG_OK && len == sizeof(v1) && p.seq == 77,
+          "record length preserved");
+    check(pkt_log_commit(&log) == PKT_LOG_OK && pkt_log_flush(&log) == PKT_LOG_OK, "commit v1");
+    check(f.overwrites == 0, "basic: no write over programmed bits");
+    printf("append/pop/commit/rewind: %s\n", failures ? "FAIL" : "ok");
+    ff_close(&f);
+}
+
+static void test_reboot(const char *path) {
+    int before = failures;
+    file_flash_t f;
+    pkt_log_t log;
+    check(ff_create(&f, path, 8), "create image");
+    check(reboot(&log, &f) == PKT_LOG_OK, "open");
+
+    check(append_range(&log, 0, 40), "append 40");
+    check(pop_expect(&log, 0, 15, NULL) && pkt_log_commit(&log) == PKT_LOG_OK, "deliver 15");
+    check(pop_expect(&log, 15, 5, NULL), "pop 5 uncommitted");
+    SensorPacketV2 lost = packet(999);
+    check(pkt_log_append(&log, &lost, sizeof(lost)) == PKT_LOG_OK, "append without flush");
+
+    check(reboot(&log, &f) == PKT_LOG_OK, "reboot");
+    check(pkt_log_count(&log) == 25, "reboot: committed cursor kept, uncommitted pops pending again");
+    check(peek_seq(&log) == 15, "reboot: resumes at the first undelivered record");
+    check(append_range(&log, 40, 10), "append after reboot");
+    check(pop_expect(&log, 15, 35, NULL), "reboot: unflushed record gone, order kept");
+    check(pkt_log_commit(&log) == PKT_LOG_OK, "commit");
+    check(reboot(&log, &f) == PKT_LOG_OK && pkt_log_count(&log) == 0, "reboot: empty after full delivery");
+
+    // Power loss in the middle of a flush: 8 records staged (one page), 100 bytes make it
+    check(append_range(&log, 50, 10), "append 10");
+    for (uint32_t i = 0; i < 8; i++) {
+        SensorPacketV2 p = packet(60 + i);
+        pkt_log_append(&log, &p, sizeof(p));
+    }
+    f.tear_after = 100;
+    check(pkt_log_flush(&log) != PKT_LOG_OK, "torn flush reports an error");
+    check(reboot(&log, &f) == PKT_LOG_OK, "reboot after power loss");
+    uint32_t n = pkt_log_count(&log);
+    uint32_t whole = 100 / 44;   // SensorPacketV2 record: 12 B header + 32 B
+    check(n == 10 + whole, "power loss: records before the tear kept, torn one dropped");
+    check(append_range(&log, 60 + whole, 5), "append after the torn record");
+    uint32_t got = 0;
+    check(pop_expect(&log, 50, n + 5, &got), "power loss: every intact record in order");
+    check(pkt_log_commit(&log) == PKT_LOG_OK, "commit");
+    check(reboot(&log, &f) == PKT_LOG_OK && pkt_log_count(&log) == 0, "power loss: log consistent after the next reboot");
+
+    // Blank or foreign content is formatted
+    memset(&log, 0, sizeof(log));
+    uint8_t junk[PKT_LOG_SECTOR_SIZE];
+    memset(junk, 0x5A, sizeof(junk));
+    for (uint32_t s = 0; s < 8; s++) {
+        pwrite(f.fd, junk, sizeof(junk), (off_t)s * PKT_LOG_SECTOR_SIZE);
+    }
+    check(reboot(&log, &f) == PKT_LOG_OK && pkt_log_count(&log) == 0, "foreign content formatted");
+    check(append_range(&log, 0, 3) && reboot(&log, &f) == PKT_LOG_OK && pkt_log_count(&log) == 3,
+          "usable after formatting");
+    f.overwrites = 0;   // the junk was written around the flash model on purpose
+    check(append_range(&log, 3, 3) && f.overwrites == 0, "reboot: no write over programmed bits");
+    printf("reboot recovery: %s\n", failures > before ? "FAIL" : "ok");
+    ff_close(&f);
+}
+
+static void test_wrap(const char *path) {
+    int before = failures;
+    const uint32_t sectors = 6;
+    file_flash_t f;
+    pkt_log_t log;
+    check(ff_create(&f, path, sectors), "create image");
+    check(reboot(&log, &f) == PKT_LOG_OK, "open");
+
+    uint32_t cap = pkt_log_capacity(&log, sizeof(SensorPacketV2));
+    uint32_t total = cap * 3 + 17;
+    for (uint32_t i = 0; i < total; i += HTTP_BATCH_MAX) {
+        uint32_t n = total - i < HTTP_BATCH_MAX ? total - i : HTTP_BATCH_MAX;
+        if (!append_range(&log, i, n)) {
+            check(false, "append while wrapping");
+            break;
+        }
+    }
+    uint32_t held = pkt_log_count(&log);
+    uint32_t dropped = log.stats.records_dropped;
+    check(log.stats.records_dropped == total - held, "wrap: every lost record counted as dropped");
+    uint32_t per_sector = (PKT_LOG_SECTOR_SIZE - 16) / 44;
+    check(held + per_sector >= cap && held < cap + per_sector, "wrap: holds its capacity, give or take the head sector");
+    check(peek_seq(&log) == total - held, "wrap: the oldest records are the ones dropped");
+
+    // Half delivered, then a reboot, then more wrapping
+    uint32_t first = total - held;
+    check(pop_expect(&log, first, held / 2, NULL) && pkt_log_commit(&log) == PKT_LOG_OK, "wrap: deliver half");
+    check(reboot(&log, &f) == PKT_LOG_OK, "wrap: reboot");
+    check(pkt_log_count(&log) == held - held / 2 && peek_seq(&log) == first + held / 2, "wrap: state after reboot");
+    check(append_range(&log, total, cap / 2), "wrap: append after reboot");
+    uint32_t pending = pkt_log_count(&log);
+    int64_t next = peek_seq(&log);
+    uint32_t got = 0;
+    check(next >= 0 && pop_expect(&log, (uint32_t)next, pending, &got), "wrap: contiguous until the newest");
+    check(next >= 0 && (uint32_t)next + got == total + cap / 2, "wrap: ends at the newest record");
+    check(f.overwrites == 0, "wrap: no write over programmed bits");
+    printf("wrap-around: %s (%u sectors, capacity %u, %u appended, %u dropped)\n", failures > before ? "FAIL" : "ok",
+           sectors, cap, total, dropped);
+    ff_close(&f);
+}
+
+static void capacity(const char *path, uint32_t sectors) {
+    file_flash_t f;
+    pkt_log_t log;
+    check(ff_create(&f, path, sectors), "create image");
+    check(reboot(&log, &f) == PKT_LOG_OK, "open");
+    uint32_t cap = pkt_log_capacity(&log, sizeof(SensorPacketV2));
+    uint32_t seq = 0;
+    while (log.stats.records_dropped == 0 && seq < cap * 2) {
+        append_range(&log, seq, HTTP_BATCH_MAX);
+        seq += HTTP_BATCH_MAX;
+    }
+    uint32_t before_drop = seq - HTTP_BATCH_MAX;
+    check(before_drop >= cap, "capacity: pkt_log_capacity() records fit before the first drop");
+    printf("capacity: %u KB, %u B records -> pkt_log_capacity %u, first drop after %u\n",
+           sectors * PKT_LOG_SECTOR_SIZE / 1024, (unsigned)(sizeof(SensorPacketV2)), cap, before_drop);
+    ff_close(&f);
+}
+
+static void gateway_pattern(const char *path, uint32_t sectors, uint32_t packets, uint32_t batch) {
+    file_flash_t f;
+    pkt_log_t log;
+    check(ff_create(&f, path, sectors), "create image");
+    check(reboot(&log, &f) == PKT_LOG_OK, "open");
+
+    // Backend down: everything goes to the log (wrapping if it must)
+    double t0 = now_s();
+    for (uint32_t i = 0; i < packets; i += batch) {
+        uint32_t n = packets - i < batch ? packets - i : batch;
+        if (!append_range(&log, i, n)) {
+            check(false, "append");
+            break;
+        }
+    }
+    double t_append = now_s() - t0;
+    pkt_log_stats_t w = log.stats;
+
+    // Backend back: replay HTTP_BATCH_MAX at a time, one commit per POST
+    uint32_t held = pkt_log_count(&log);
+    int64_t first = peek_seq(&log);
+    uint32_t replayed = 0;
+    bool in_order = first >= 0;
+    t0 = now_s();
+    while (pkt_log_available(&log) > 0) {
+        uint32_t got = 0;
+        in_order = in_order && pop_expect(&log, (uint32_t)first + replayed,
+                                          held - replayed < HTTP_BATCH_MAX ? held - replayed : HTTP_BATCH_MAX, &got);
+        if (got == 0 || pkt_log_commit(&log) != PKT_LOG_OK) {
+            break;
+        }
+        replayed += got;
+    }
+    double t_replay = now_s() - t0;
+    check(in_order && replayed == held && pkt_log_count(&log) == 0, "gateway pattern: full replay in order");
+    check(f.overwrites == 0, "gateway pattern: no write over programmed bits");
+
+    uint32_t max_erases = 0;
+    uint64_t sum_erases = 0;
+    for (uint32_t s = 0; s < sectors; s++) {
+        sum_erases += f.erases[s];
+        if (f.erases[s] > max_erases) max_erases = f.erases[s];
+    }
+    printf("\ngateway pattern: %u packets, appends in batches of %u, replay in batches of %d\n",
+           packets, batch, HTTP_BATCH_MAX);
+    printf("  append: %.0f pkt/s, %u flushes, write amplification %.2f (%llu flash B / %llu payload B)\n",
+           packets / t_append, w.flushes, (double)w.flash_bytes / w.payload_bytes,
+           (unsigned long long)w.flash_bytes, (unsigned long long)w.payload_bytes);
+    printf("  replay: %.0f pkt/s, %u held, %u dropped, %u cursors, write amplification %.2f overall\n",
+           replayed / t_replay, held, log.stats.records_dropped, log.stats.cursors_written,
+           (double)log.stats.flash_bytes / log.stats.payload_bytes);
+    printf("  erases: %llu total, %.1f mean / %u max per sector\n",
+           (unsigned long long)sum_erases, (double)sum_erases / sectors, max_erases);
+    ff_close(&f);
+}
+
+int main(int argc, char **argv) {
+    uint32_t packets = 20000;
+    uint32_t batch = 16;
+    uint32_t sectors = 240;
+    const char *path = "/tmp/pkt_log_bench.bin";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:s:f:")) != -1) {
+        switch (opt) {
+            case 'n': packets = (uint32_t)atol(optarg); break;
+            case 'b': batch = (uint32_t)atoi(optarg); break;
+            case 's': sectors = (uint32_t)atoi(optarg); break;
+            case 'f': path = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n pkts] [-b pkts] [-s sectors] [-f path]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (packets == 0 || batch == 0 || sectors < 2) {
+        fprintf(stderr, "bad options\n");
+        return 2;
+    }
+
+    test_basic(path);
+    test_reboot(path);
+    test_wrap(path);
+    capacity(path, sectors);
+    gateway_pattern(path, sectors, packets, batch);
+    unlink(path);
+
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}
@@ -0,0 +1,233 @@
+// report_replay.cpp
+// Host-side replay of the nodes' send-on-delta policy (components/report_policy).
+//
+// Feeds a level trace through report_policy::ReportPolicy the way a node
+// would (sample, filter the rate with KalmanCvQ16 as level_rate_x10() does,
+// decide, sleep interval_s()) and compares it with the fixed
+// schedule (one packet every SAMPLE_INTERVAL_S): packets sent, and the error
+// of the level the backend sees (last received value held until the next
+// one) against the trace, evaluated every second.
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -o report_replay tools/report_replay/report_replay.cpp
+//
+// Usage:
+//   ./report_replay [options] [trace.csv]
+//     trace.csv: "t_s,level_cm" per line (ascending t_s; '#' lines and a
+//                header are skipped). Without a file a synthetic 24 h trace
+//                is used (night at rest, morning pump fill, daytime
+//                consumption, a leak at 15 h).
+//     -d <cm>    delta threshold             (default 3)
+//     -H <s>     heartbeat                   (default 600)
+//     -s <s>     slow sampling interval      (default 30)
+//     -f <s>     fast sampling interval      (default 5)
+//     -r <cm/m>  rate for fast sampling      (default 2)
+//     -n <cm>    measurement noise, +/- cm   (default 1)
+//     -b <s>     fixed schedule interval     (default 30)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "components/report_policy/report_policy.h"
+#include "components/ultrasonic01/kalman.h"
+
+using ultrasonic01::Q16;
+
+// Node filter and the variance below which its rate is used (RATE_MAX_VAR)
+static const int RATE_MAX_VAR = 4;
+
+struct Point {
+    double t_s;
+    double level_cm;
+};
+
+struct Trace {
+    std::vector<Point> pts;
+
+    double duration() const { return pts.empty() ? 0 : pts.back().t_s - pts.front().t_s; }
+
+    // Linear interpolation at t (relative to the first point)
+    double at(double t) const {
+        t += pts.front().t_s;
+        if (t <= pts.front().t_s) return pts.front().level_cm;
+        if (t >= pts.back().t_s) return pts.back().level_cm;
+        size_t lo = 0, hi = pts.size() - 1;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (pts[mid].t_s <= t) lo = mid; else hi = mid;
+        }
+        const Point &a = pts[lo], &b = pts[hi];
+        return a.level_cm + (b.level_cm - a.level_cm) * (t - a.t_s) / (b.t_s - a.t_s);
+    }
+};
+
+static bool load_csv(const char *path, Trace &trace) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        Point p;
+        if (line[0] == '#' || sscanf(line, "%lf,%lf", &p.t_s, &p.level_cm) != 2) {
+            continue;
+        }
+        if (!trace.pts.empty() && p.t_s <= trace.pts.back().t_s) {
+            fprintf(stderr, "%s: t_s must be ascending (%.0f)\n", path, p.t_s);
+            fclose(f);
+            return false;
+        }
+        trace.pts.push_back(p);
+    }
+    fclose(f);
+    if (trace.pts.size() < 2) {
+        fprintf(stderr, "%s: need at least 2 points\n", path);
+        return false;
+    }
+    return true;
+}
+
+// 24 h: rest, pump fill 06:00-07:30 (~3 cm/min), consumption 08:00-22:00
+// (~0.2 cm/min), a leak 15:00-15:20 (~4 cm/min), rest
+static void synthetic_day(Trace &trace) {
+    const Point pts[] = {
+        {0, 180},       {6 * 3600, 180},   {7.5 * 3600, 450}, {8 * 3600, 450},
+        {15 * 3600, 366}, {15 * 3600 + 1200, 286}, {22 * 3600, 202}, {24 * 3600, 202},
+    };
+    trace.pts.assign(pts, pts + sizeof(pts) / sizeof(pts[0]));
+}
+
+// Deterministic noise in [-amp, amp]
+static uint32_t rng_state = 12345;
+static double noise(double amp) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return amp * (((rng_state >> 8) & 0xFFFF) / 32767.5 - 1.0);
+}
+
+struct Result {
+    uint32_t samples = 0;
+    uint32_t sent = 0;
+    double err_sum = 0, err_sq = 0, err_max = 0;
+    uint32_t err_n = 0;
+};
+
+// What the backend shows: each received level held until the next one
+static void score(const Trace &trace, const std::vector<Point> &received, Result &res) {
+    size_t k = 0;
+    for (double t = 0; t <= trace.duration(); t += 1) {
+        while (k + 1 < received.size() && received[k + 1].t_s <= t) k++;
+        if (received.empty() || received[0].t_s > t) continue;
+        double e = fabs(trace.at(t) - received[k].level_cm);
+        res.err_sum += e;
+        res.err_sq += e * e;
+        if (e > res.err_max) res.err_max = e;
+        res.err_n++;
+    }
+}
+
+static int16_t measure(const Trace &trace, double t, double noise_cm) {
+    return (int16_t)lround(trace.at(t) + noise(noise_cm));
+}
+
+// level_rate_x10() of the nodes; the filter runs on the level here, so no sign flip
+static int16_t level_rate_x10(const ultrasonic01::KalmanCvQ16 &kalman) {
+    if (kalman.rate_var() > Q16(RATE_MAX_VAR)) {
+        return report_policy::RATE_UNKNOWN;
+    }
+    return ultrasonic01::rate_x10(kalman.rate_cm_min());
+}
+
+int main(int argc, char **argv) {
+    report_policy::Config cfg = {3, 600, 30, 5, 20};
+    double noise_cm = 1.0;
+    uint32_t fixed_s = 30;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:H:s:f:r:n:b:")) != -1) {
+        switch (opt) {
+            case 'd': cfg.delta_cm = (int16_t)atoi(optarg); break;
+            case 'H': cfg.heartbeat_s = (uint32_t)atoi(optarg); break;
+            case 's': cfg.slow_interval_s = (uint32_t)atoi(optarg); break;
+            case 'f': cfg.fast_interval_s = (uint32_t)atoi(optarg); break;
+            case 'r': cfg.fast_rate_x10 = (int16_t)lround(atof(optarg) * 10); break;
+            case 'n': noise_cm = atof(optarg); break;
+            case 'b': fixed_s = (uint32_t)atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-d cm] [-H s] [-s s] [-f s] [-r cm/min] [-n cm] [-b s] [trace.csv]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (cfg.slow_interval_s == 0 || cfg.fast_interval_s == 0 || fixed_s == 0) {
+        fprintf(stderr, "intervals must be > 0\n");
+        return 2;
+    }
+
+    Trace trace;
+    if (optind < argc) {
+        if (!load_csv(argv[optind], trace)) return 1;
+    } else {
+        synthetic_day(trace);
+    }
+    double duration = trace.duration();
+
+    // Fixed schedule (current firmware)
+    Result fixed;
+    std::vector<Point> fixed_rx;
+    rng_state = 12345;
+    for (double t = 0; t <= duration; t += fixed_s) {
+        fixed.samples++;
+        fixed.sent++;
+        fixed_rx.push_back({t, (double)measure(trace, t, noise_cm)});
+    }
+    score(trace, fixed_rx, fixed);
+
+    // Send-on-delta
+    Result adaptive;
+    std::vector<Point> adaptive_rx;
+    report_policy::ReportPolicy policy(cfg);
+    ultrasonic01::KalmanCvQ16 kalman(Q16(1), Q16(2), Q16(25));
+    rng_state = 12345;
+    uint32_t dt = 0;
+    uint32_t fast_s = 0;
+    for (double t = 0; t <= duration; t += dt) {
+        int16_t level = measure(trace, t, noise_cm);
+        kalman.update(level, (uint32_t)lround(t * 1000));
+        report_policy::Reason r = policy.on_sample(dt, level, level_rate_x10(kalman), 0);
+        adaptive.samples++;
+        if (r != report_policy::Reason::Skip) {
+            policy.on_sent(level, 0);
+            adaptive.sent++;
+            adaptive_rx.push_back({t, (double)level});
+        }
+        dt = policy.interval_s();
+        if (policy.fast()) fast_s += dt;
+    }
+    score(trace, adaptive_rx, adaptive);
+
+    const report_policy::Stats &st = policy.stats();
+    printf("trace: %zu points, %.1f h, noise +/-%.1f cm\n", trace.pts.size(), duration / 3600.0, noise_cm);
+    printf("policy: delta=%d cm heartbeat=%u s interval=%u/%u s fast>=%s cm/min\n",
+           cfg.delta_cm, cfg.heartbeat_s, cfg.slow_interval_s, cfg.fast_interval_s,
+           report_policy::rate_text(cfg.fast_rate_x10).s);
+    printf("%-10s %8s %8s %10s %10s %10s\n", "", "samples", "sent", "mean_err", "rms_err", "max_err");
+    const struct { const char *name; const Result *r; } rows[] = {{"fixed", &fixed}, {"adaptive", &adaptive}};
+    for (const auto &row : rows) {
+        const Result &r = *row.r;
+        printf("%-10s %8u %8u %9.2fcm %9.2fcm %9.2fcm\n", row.name, r.samples, r.sent,
+               r.err_n ? r.err_sum / r.err_n : 0.0, r.err_n ? sqrt(r.err_sq / r.err_n) : 0.0, r.err_max);
+    }
+    printf("saved: %.1f%% of transmissions (%u -> %u); fast sampling %.1f%% of the time\n",
+           fixed.sent ? 100.0 * (1.0 - (double)adaptive.sent / fixed.sent) : 0.0, fixed.sent, adaptive.sent,
+           duration > 0 ? 100.0 * fast_s / duration : 0.0);
+    printf("reasons: first=%u delta=%u heartbeat=%u alert=%u skipped=%u\n",
+           st.by_reason[(int)report_policy::Reason::First], st.by_reason[(int)report_policy::Reason::Delta],
+           st.by_reason[(int)report_policy::Reason::Heartbeat], st.by_reason[(int)report_policy::Reason::Alert],
+           st.by_reason[(int)report_policy::Reason::Skip]);
+    return 0;
+}
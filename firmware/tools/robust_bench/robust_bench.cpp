@@ -0,0 +1,190 @@
+// robust_bench.cpp
+// Host-side accuracy test and benchmark of the nodes' N-sample distance
+// estimator (components/ultrasonic01/robust_estimator.h), for N = 3..15.
+//
+// Each trial draws N samples of a random true distance the way the sensor
+// misbehaves: +/-noise cm jitter, a share of timeouts (-1) and a share of
+// wrong echoes (anywhere in the tank). For every N it reports, for the plain
+// median of the valid samples and for robust_estimate() (median + MAD
+// rejection + trimmed mean):
+//   - rms and max error against the true distance,
+//   - bad: cycles more than -b cm off, or with no valid sample at all,
+//   - ns per estimate (host CPU),
+//   - the time the node spends taking the samples (N * -d ms, one sensor).
+// Pick the smallest N whose bad rate is acceptable; more samples cost
+// measurement time (radio and CPU stay on for it).
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -o robust_bench tools/robust_bench/robust_bench.cpp
+//
+// Usage:
+//   ./robust_bench [options]
+//     -k <trials>  trials per N                        (default 200000)
+//     -n <cm>      jitter amplitude                    (default 2)
+//     -o <pct>     wrong-echo share of samples         (default 5)
+//     -t <pct>     timeout share of samples            (default 3)
+//     -b <cm>      error counted as a bad cycle        (default 5)
+//     -d <ms>      time per sample (trigger spacing)   (default 60)
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <utility>
+#include <vector>
+
+#include "components/ultrasonic01/robust_estimator.h"
+
+using ultrasonic01::robust_estimate;
+using ultrasonic01::RobustResult;
+
+// The estimator is usable at compile time (and so checked here)
+static_assert(robust_estimate(std::array<int, 3>{100, 101, 250}).cm == 101, "outlier rejected");
+static_assert(robust_estimate(std::array<int, 3>{-1, 120, -1}).cm == 120, "single valid sample");
+static_assert(robust_estimate(std::array<int, 3>{-1, -1, -1}).cm == -1, "no valid sample");
+static_assert(robust_estimate(std::array<int, 5>{203, 200, 9, 201, 202}).median_cm == 201, "median");
+static_assert(robust_estimate(std::array<int, 4>{-1, 300, 20, 302}).valid == 3, "masking");
+
+struct Options {
+    long trials = 200000;
+    double noise_cm = 2;
+    double outlier_pct = 5;
+    double timeout_pct = 3;
+    int bad_cm = 5;
+    int sample_ms = 60;
+};
+
+// Deterministic generator
+static uint32_t rng_state = 12345;
+static uint32_t rng() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+static double uniform() { return (rng() & 0xFFFF) / 65535.0; }
+
+struct Trial {
+    int truth;
+    std::vector<int> samples;
+};
+
+// Same trials for every estimator; the first N samples are used for size N
+static std::vector<Trial> make_trials(const Options &o, size_t max_n) {
+    std::vector<Trial> trials((size_t)o.trials);
+    for (Trial &t : trials) {
+        t.truth = 20 + (int)(rng() % 430);
+        t.samples.resize(max_n);
+        for (int &s : t.samples) {
+            double u = uniform() * 100;
+            if (u < o.timeout_pct) {
+                s = -1;
+            } else if (u < o.timeout_pct + o.outlier_pct) {
+                s = 5 + (int)(rng() % 446);
+            } else {
+                s = (int)lround(t.truth + o.noise_cm * (2 * uniform() - 1));
+            }
+        }
+    }
+    return trials;
+}
+
+struct Score {
+    double sum_sq = 0;
+    int max_err = 0;
+    long bad = 0;
+    long scored = 0;
+    double ns = 0;
+
+    void add(int estimate, int truth, int bad_cm) {
+        if (estimate < 0) {
+            bad++;
+            return;
+        }
+        int err = abs(estimate - truth);
+        sum_sq += (double)err * err;
+        if (err > max_err) max_err = err;
+        if (err > bad_cm) bad++;
+        scored++;
+    }
+};
+
+template <size_t N>
+static int median_only(const std::array<int, N> &s) {
+    return robust_estimate(s).median_cm;
+}
+
+template <size_t N>
+static int robust(const std::array<int, N> &s) {
+    return robust_estimate(s).cm;
+}
+
+template <size_t N, class Fn>
+static Score score(const std::vector<Trial> &trials, const Options &o, Fn fn) {
+    std::vector<std::array<int, N>> inputs(trials.size());
+    for (size_t i = 0; i < trials.size(); i++) {
+        for (size_t j = 0; j < N; j++) inputs[i][j] = trials[i].samples[j];
+    }
+    std::vector<int> out(trials.size());
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (size_t i = 0; i < inputs.size(); i++) {
+        out[i] = fn(inputs[i]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    Score sc;
+    for (size_t i = 0; i < trials.size(); i++) {
+        sc.add(out[i], trials[i].truth, o.bad_cm);
+    }
+    sc.ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / (double)trials.size();
+    return sc;
+}
+
+static void print_row(size_t n, const char *name, const Score &s, const Options &o, long trials) {
+    printf("%3zu  %-7s %8.3fcm %6dcm %9.3f%% %8.1f %7dms\n", n, name,
+           s.scored ? sqrt(s.sum_sq / s.scored) : 0.0, s.max_err, 100.0 * s.bad / trials, s.ns,
+           (int)n * o.sample_ms);
+}
+
+template <size_t N>
+static void run_one(const std::vector<Trial> &trials, const Options &o) {
+    print_row(N, "median", score<N>(trials, o, median_only<N>), o, o.trials);
+    print_row(N, "robust", score<N>(trials, o, robust<N>), o, o.trials);
+}
+
+template <size_t... I>
+static void run_all(const std::vector<Trial> &trials, const Options &o, std::index_sequence<I...>) {
+    (run_one<I + 3>(trials, o), ...);
+}
+
+int main(int argc, char **argv) {
+    Options o;
+    int opt;
+    while ((opt = getopt(argc, argv, "k:n:o:t:b:d:")) != -1) {
+        switch (opt) {
+            case 'k': o.trials = atol(optarg); break;
+            case 'n': o.noise_cm = atof(optarg); break;
+            case 'o': o.outlier_pct = atof(optarg); break;
+            case 't': o.timeout_pct = atof(optarg); break;
+            case 'b': o.bad_cm = atoi(optarg); break;
+            case 'd': o.sample_ms = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-k trials] [-n cm] [-o pct] [-t pct] [-b cm] [-d ms]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (o.trials <= 0 || o.outlier_pct + o.timeout_pct > 100) {
+        fprintf(stderr, "bad options\n");
+        return 2;
+    }
+
+    std::vector<Trial> trials = make_trials(o, 15);
+    printf("%ld trials per N, jitter +/-%gcm, %g%% wrong echoes, %g%% timeouts, bad > %dcm\n",
+           o.trials, o.noise_cm, o.outlier_pct, o.timeout_pct, o.bad_cm);
+    printf("%3s  %-7s %10s %8s %10s %8s %9s\n", "N", "", "rms_err", "max_err", "bad", "ns/est", "sampling");
+    run_all(trials, o, std::make_index_sequence<13>());
+    return 0;
+}
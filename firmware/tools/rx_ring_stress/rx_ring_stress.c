@@ -0,0 +1,324 @@
+// rx_ring_stress.c
+// Host-side stress test of the gateway's ESP-NOW receive ring
+// (gateway_devkit_v1/main/rx_ring.h) with a real producer and consumer
+// thread, like espnow_recv_cb and packet_processing_task.
+//
+// 1. Single thread: the ring takes RX_RING_SLOTS frames, the next reserve
+//    fails and counts a drop, frames come out in order, and the free-running
+//    head/tail counters wrap past UINT32_MAX without losing a frame.
+// 2. Flood (-n frames, producer never waits): every frame the consumer sees
+//    is intact (payload derived from its seq, so a torn copy shows) and in
+//    order; delivered + drops == produced; the seq gaps the consumer sees add
+//    up to the drop counter; high_water <= RX_RING_SLOTS.
+//    Lossless (same frames, the producer yields on a full ring instead of
+//    dropping): every frame delivered; reports sustained frames/s.
+// 3. Paced (-r frames/s for -t s, consumer spends -w us per frame, like
+//    decode + ACK; the producer sleeps between frames and the consumer while
+//    the ring is empty): below the consumer's capacity nothing is dropped, and the
+//    high-water mark shows how much of the ring the bursts used.
+//
+// Build (from firmware/):
+//   gcc -std=gnu11 -O2 -pthread -Igateway_devkit_v1/main -o rx_ring_stress tools/rx_ring_stress/rx_ring_stress.c
+//
+// Usage:
+//   ./rx_ring_stress [options]   (exit 1 if a check fails)
+//     -n <frames>  frames in the flood run          (default 5000000)
+//     -r <fps>     paced producer rate              (default 5000)
+//     -t <s>       paced run length                 (default 2)
+//     -w <us>      consumer work per paced frame    (default 20)
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rx_ring.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void spin_us(int64_t us) {
+    int64_t end = now_us() + us;
+    while (now_us() < end) {
+    }
+}
+
+// Frame i: seq in the first 4 bytes, length and payload derived from it
+static void frame_fill(rx_frame_t *f, uint32_t seq) {
+    f->len = (uint8_t)(8 + seq % (RX_FRAME_MAX - 8));
+    f->rssi = (int8_t)(-40 - (int)(seq % 50));
+    f->rx_us = seq;
+    memcpy(f->data, &seq, 4);
+    for (uint32_t i = 4; i < f->len; i++) {
+        f->data[i] = (uint8_t)(seq * 31 + i);
+    }
+}
+
+static bool frame_ok(const rx_frame_t *f, uint32_t *seq_out) {
+    uint32_t seq;
+    memcpy(&seq, f->data, 4);
+    *seq_out = seq;
+    if (f->len != (uint8_t)(8 + seq % (RX_FRAME_MAX - 8)) || f->rx_us != seq ||
+        f->rssi != (int8_t)(-40 - (int)(seq % 50))) {
+        return false;
+    }
+    for (uint32_t i = 4; i < f->len; i++) {
+        if (f->data[i] != (uint8_t)(seq * 31 + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// SINGLE THREAD
+// ============================================================================
+
+static rx_ring_t ring;
+
+static void ring_reset(uint32_t start) {
+    memset(&ring, 0, sizeof(ring));
+    atomic_store(&ring.head, start);
+    atomic_store(&ring.tail, start);
+}
+
+static void test_single(void) {
+    ring_reset(0);
+    check(rx_ring_peek(&ring) == NULL, "empty ring: nothing to peek");
+    for (uint32_t i = 0; i < RX_RING_SLOTS; i++) {
+        rx_frame_t *f = rx_ring_reserve(&ring);
+        check(f != NULL, "reserve while not full");
+        if (f) {
+            frame_fill(f, i);
+            rx_ring_publish(&ring);
+        }
+    }
+    check(rx_ring_reserve(&ring) == NULL && rx_ring_drops(&ring) == 1, "full ring: reserve fails, one drop");
+    check(rx_ring_high_water(&ring) == RX_RING_SLOTS, "high_water = RX_RING_SLOTS when full");
+    bool order = true;
+    for (uint32_t i = 0; i < RX_RING_SLOTS; i++) {
+        const rx_frame_t *f = rx_ring_peek(&ring);
+        uint32_t seq = 0;
+        order = order && f && frame_ok(f, &seq) && seq == i;
+        rx_ring_release(&ring);
+    }
+    check(order, "frames out in order");
+    check(rx_ring_peek(&ring) == NULL, "empty after draining");
+
+    // Counters wrapping past UINT32_MAX
+    ring_reset(UINT32_MAX - 40);
+    uint32_t next_in = 0, next_out = 0;
+    order = true;
+    for (int round = 0; round < 10; round++) {
+        for (int k = 0; k < 7; k++) {
+            rx_frame_t *f = rx_ring_reserve(&ring);
+            if (!f) {
+                order = false;
+                break;
+            }
+            frame_fill(f, next_in++);
+            rx_ring_publish(&ring);
+        }
+        for (int k = 0; k < 7; k++) {
+            const rx_frame_t *f = rx_ring_peek(&ring);
+            uint32_t seq = 0;
+            order = order && f && frame_ok(f, &seq) && seq == next_out++;
+            rx_ring_release(&ring);
+        }
+    }
+    check(order && rx_ring_drops(&ring) == 0, "head/tail wrap past UINT32_MAX");
+    check(rx_ring_high_water(&ring) == 7, "high_water across the wrap");
+    printf("single thread: %s\n", failures ? "FAIL" : "ok");
+}
+
+// ============================================================================
+// PRODUCER / CONSUMER
+// ============================================================================
+
+typedef struct {
+    uint32_t frames;         // flood / lossless: frames to produce
+    bool retry;              // lossless: the producer waits for a free slot instead of dropping
+    int64_t period_ns;       // paced: time between frames (0 = as fast as possible)
+    int64_t duration_us;
+    int64_t work_us;         // consumer work per frame
+} run_cfg_t;
+
+typedef struct {
+    uint32_t produced;
+    uint32_t delivered;
+    uint32_t gaps;           // frames skipped in the seq sequence seen by the consumer
+    uint32_t next_seq;       // seq after the last frame delivered
+    uint32_t bad;            // torn or out-of-order frames
+    double seconds;
+} run_result_t;
+
+static run_cfg_t cfg;
+static run_result_t res;
+static atomic_bool producer_done;
+
+static void *producer(void *arg) {
+    (void)arg;
+    uint32_t seq = 0;
+    if (cfg.period_ns == 0) {
+        for (; seq < cfg.frames; seq++) {
+            rx_frame_t *f = rx_ring_reserve(&ring);
+            while (!f && cfg.retry) {
+                sched_yield();
+                f = rx_ring_reserve(&ring);
+            }
+            if (f) {
+                frame_fill(f, seq);
+                rx_ring_publish(&ring);
+            }
+        }
+    } else {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int64_t start_ns = (int64_t)start.tv_sec * 1000000000 + start.tv_nsec;
+        for (;;) {
+            int64_t due_ns = (int64_t)seq * cfg.period_ns;
+            if (due_ns >= cfg.duration_us * 1000) {
+                break;
+            }
+            due_ns += start_ns;
+            struct timespec due = { due_ns / 1000000000, due_ns % 1000000000 };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+            rx_frame_t *f = rx_ring_reserve(&ring);
+            if (f) {
+                frame_fill(f, seq);
+                rx_ring_publish(&ring);
+            }
+            seq++;
+        }
+    }
+    res.produced = seq;
+    atomic_store_explicit(&producer_done, true, memory_order_release);
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    (void)arg;
+    int64_t expected = 0;
+    for (;;) {
+        const rx_frame_t *f = rx_ring_peek(&ring);
+        if (!f) {
+            if (atomic_load_explicit(&producer_done, memory_order_acquire) && rx_ring_peek(&ring) == NULL) {
+                break;
+            }
+            if (cfg.period_ns) {
+                usleep(100);   // packet_processing_task blocks until notified
+            } else {
+                sched_yield();
+            }
+            continue;
+        }
+        uint32_t seq = 0;
+        if (!frame_ok(f, &seq) || (int64_t)seq < expected) {
+            res.bad++;
+        } else {
+            res.gaps += (uint32_t)(seq - expected);
+            expected = (int64_t)seq + 1;
+        }
+        rx_ring_release(&ring);
+        res.delivered++;
+        if (cfg.work_us) {
+            spin_us(cfg.work_us);
+        }
+    }
+    res.next_seq = (uint32_t)expected;
+    return NULL;
+}
+
+static void run(const run_cfg_t *c) {
+    cfg = *c;
+    memset(&res, 0, sizeof(res));
+    ring_reset(0);
+    atomic_store(&producer_done, false);
+
+    pthread_t p, q;
+    int64_t t0 = now_us();
+    pthread_create(&q, NULL, consumer, NULL);
+    pthread_create(&p, NULL, producer, NULL);
+    pthread_join(p, NULL);
+    pthread_join(q, NULL);
+    res.seconds = (now_us() - t0) / 1e6;
+}
+
+static void report(const char *name) {
+    // lossless: the counter holds the failed reserves the producer retried
+    uint32_t drops = cfg.retry ? 0 : rx_ring_drops(&ring);
+    printf("%-8s produced %9u  delivered %9u  drops %9u (%5.2f%%)  high_water %2u/%d  %8.0f frames/s\n",
+           name, res.produced, res.delivered, drops, res.produced ? 100.0 * drops / res.produced : 0.0,
+           rx_ring_high_water(&ring), RX_RING_SLOTS, res.delivered / res.seconds);
+    check(res.bad == 0, "frames intact and in order");
+    check(res.delivered + drops == res.produced, "delivered + drops == produced");
+    // frames dropped after the last delivered one leave no gap
+    check(res.gaps + (res.produced - res.next_seq) == drops, "seq gaps seen by the consumer == drop counter");
+    check(rx_ring_high_water(&ring) <= RX_RING_SLOTS, "high_water within the ring");
+}
+
+int main(int argc, char **argv) {
+    uint32_t frames = 5000000;
+    int rate = 5000;
+    int seconds = 2;
+    int work_us = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:t:w:")) != -1) {
+        switch (opt) {
+            case 'n': frames = (uint32_t)atol(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 't': seconds = atoi(optarg); break;
+            case 'w': work_us = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n frames] [-r fps] [-t s] [-w us]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (frames == 0 || rate <= 0 || seconds <= 0 || work_us < 0) {
+        fprintf(stderr, "bad options\n");
+        return 2;
+    }
+
+    test_single();
+
+    printf("\nring: %d slots of %zu B\n", RX_RING_SLOTS, sizeof(rx_frame_t));
+    run_cfg_t flood = { frames, false, 0, 0, 0 };
+    run(&flood);
+    report("flood");
+
+    run_cfg_t lossless = { frames, true, 0, 0, 0 };
+    run(&lossless);
+    report("lossless");
+    check(res.delivered == frames, "lossless: every frame delivered");
+    printf("lossless: producer waited on a full ring %u times\n", rx_ring_drops(&ring));
+
+    run_cfg_t paced = { 0, false, 1000000000LL / rate, (int64_t)seconds * 1000000, work_us };
+    run(&paced);
+    report("paced");
+    check(rx_ring_drops(&ring) == 0, "paced below consumer capacity: no drops");
+    printf("paced: %d frames/s, %d us of work per frame\n", rate, work_us);
+
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}
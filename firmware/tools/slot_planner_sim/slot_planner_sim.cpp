@@ -0,0 +1,235 @@
+// slot_planner_sim.cpp
+// Host-side slot timing simulation of the interleaved multi-sensor
+// measurement (components/ultrasonic01/slot_planner.h driven like
+// measure_interleaved() in ultrasonic01.h), for 2 and 3 sensors.
+//
+// The loop of measure_interleaved() runs on a virtual clock: it sleeps whole
+// FreeRTOS ticks until earliest_us(), triggers (plus a random scheduling
+// delay with -j), and measure_cm() blocks until the echo completes (the
+// pulse of the target distance, or the 2 x timeout deadline when a sensor
+// gets no echo). Checks for every trigger:
+//   1. order A0 B0 (C0) A1 B1 (C1) ..., `samples` readings per sensor,
+//   2. guard: at least guard_ms after the previous trigger of any sensor,
+//   3. re-arm: at least rearm_ms after the previous trigger of the same sensor,
+//   4. no overlap: not before the previous echo completed,
+//   5. no idling: without a delay it fires at the first tick at or after the
+//      later of the guard/re-arm deadline and the previous echo.
+// Runs with the node defaults (guard 30 ms, re-arm 60 ms: the guard alone
+// spaces the slots) and with guard 10 ms, where the re-arm rule binds.
+// Prints the cycle time per scenario next to a sensor-by-sensor loop (each
+// reading followed by rearm_ms).
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -o slot_planner_sim tools/slot_planner_sim/slot_planner_sim.cpp
+//
+// Usage:
+//   ./slot_planner_sim [-j max_delay_us] [-r runs]   (default 2000 us, 2000 runs; exit 1 if a check fails)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "components/ultrasonic01/slot_planner.h"
+
+using namespace ultrasonic01;
+
+// Same as ultrasonic01::Schedule (defaults: the node firmwares)
+struct Schedule {
+    int samples = 3;
+    int guard_ms = 30;   // ULTRA_GUARD_MS
+    int rearm_ms = 60;   // ULTRA_MEASURE_DELAY_MS
+};
+
+static const int64_t TICK_US = 10000;   // portTICK_PERIOD_MS, CONFIG_FREERTOS_HZ = 100
+static const int64_t TRIGGER_US = 10;   // trigger pulse
+static const int64_t RISE_US = 450;     // trigger end -> echo rise (HC-SR04 burst)
+static const int64_t TIMEOUT_US = 300000;
+static const int NO_ECHO = -1;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, int slot, long long got, long long want) {
+    if (!ok) {
+        if (failures < 20) {
+            printf("FAIL %s (slot %d): got %lld, want %lld\n", what, slot, got, want);
+        }
+        failures++;
+    }
+}
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng() {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// measure_cm() blocks this long: trigger, flight, echo pulse; or the deadline
+static int64_t echo_us(int cm) {
+    return cm == NO_ECHO ? TRIGGER_US + 2 * TIMEOUT_US : TRIGGER_US + RISE_US + (int64_t)cm * 58;
+}
+
+struct Slot {
+    size_t sensor;
+    int sample;
+    int64_t earliest_us;
+    int64_t trigger_us;
+    int64_t end_us;
+};
+
+template <size_t N>
+static std::vector<Slot> run(const Schedule &sc, const int (&cm)[N], int64_t max_delay_us) {
+    SlotPlanner<N> plan(sc.samples, sc.guard_ms * 1000, sc.rearm_ms * 1000);
+    std::vector<Slot> log;
+    int64_t now = 0;
+    while (!plan.done()) {
+        Slot s = {};
+        s.sensor = plan.sensor();
+        s.sample = plan.sample();
+        s.earliest_us = plan.earliest_us();
+        int64_t wait_us = s.earliest_us - now;
+        if (wait_us > 0) {
+            now += (wait_us + TICK_US - 1) / TICK_US * TICK_US;
+        }
+        if (max_delay_us > 0) {
+            now += rng() % (max_delay_us + 1);
+        }
+        s.trigger_us = now;
+        now += echo_us(cm[s.sensor]);
+        s.end_us = now;
+        plan.fired(s.trigger_us);
+        log.push_back(s);
+    }
+    return log;
+}
+
+template <size_t N>
+static void check_rules(const Schedule &sc, const std::vector<Slot> &log, bool exact) {
+    check(log.size() == N * sc.samples, "readings", -1, (long long)log.size(), (long long)(N * sc.samples));
+    for (size_t k = 0; k < log.size(); k++) {
+        const Slot &s = log[k];
+        int slot = (int)k;
+        check(s.sensor == k % N && s.sample == (int)(k / N), "order", slot, (long long)s.sensor, (long long)(k % N));
+        if (k == 0) {
+            continue;
+        }
+        const Slot &prev = log[k - 1];
+        check(s.trigger_us - prev.trigger_us >= sc.guard_ms * 1000, "guard", slot, s.trigger_us - prev.trigger_us,
+              sc.guard_ms * 1000);
+        if (k >= N) {
+            const Slot &same = log[k - N];
+            check(s.trigger_us - same.trigger_us >= sc.rearm_ms * 1000, "re-arm", slot, s.trigger_us - same.trigger_us,
+                  sc.rearm_ms * 1000);
+        }
+        check(s.trigger_us >= prev.end_us, "no overlap", slot, s.trigger_us, prev.end_us);
+        if (exact) {
+            // The sleep starts when the previous echo completed
+            int64_t deadline = s.earliest_us > prev.end_us ? s.earliest_us : prev.end_us;
+            int64_t want = deadline == prev.end_us
+                               ? prev.end_us
+                               : prev.end_us + (deadline - prev.end_us + TICK_US - 1) / TICK_US * TICK_US;
+            check(s.trigger_us == want, "no idling", slot, s.trigger_us, want);
+        }
+    }
+}
+
+// Sensor-by-sensor loop as before interleaving: each reading, then rearm_ms
+template <size_t N>
+static int64_t sequential_us(const Schedule &sc, const int (&cm)[N]) {
+    int64_t t = 0;
+    for (size_t i = 0; i < N; i++) {
+        t += sc.samples * (echo_us(cm[i]) + sc.rearm_ms * 1000);
+    }
+    return t;
+}
+
+template <size_t N>
+static void scenario(const Schedule &sc, const char *name, const int (&cm)[N], int64_t max_delay_us, int runs) {
+    std::vector<Slot> log = run(sc, cm, 0);
+    check_rules<N>(sc, log, true);
+    int64_t cycle = log.back().end_us;
+    int64_t worst = cycle;
+    for (int r = 0; r < runs; r++) {
+        std::vector<Slot> late = run(sc, cm, max_delay_us);
+        check_rules<N>(sc, late, false);
+        if (late.back().end_us > worst) worst = late.back().end_us;
+    }
+    printf("  %-28s interleaved %4lld ms (delayed: worst %4lld ms)   sensor by sensor %4lld ms\n", name,
+           (long long)(cycle / 1000), (long long)(worst / 1000), (long long)(sequential_us(sc, cm) / 1000));
+}
+
+// The planner alone, fired exactly on time: slot k at
+// max(slot k-1 + guard, slot k-N + re-arm)
+template <size_t N>
+static void check_planner(const Schedule &sc) {
+    SlotPlanner<N> plan(sc.samples, sc.guard_ms * 1000, sc.rearm_ms * 1000);
+    std::vector<int64_t> fired;
+    for (int k = 0; !plan.done(); k++) {
+        int64_t want = 0;
+        if (k > 0) {
+            want = fired[k - 1] + sc.guard_ms * 1000;
+        }
+        if (k >= (int)N && fired[k - N] + sc.rearm_ms * 1000 > want) {
+            want = fired[k - N] + sc.rearm_ms * 1000;
+        }
+        int64_t t = plan.earliest_us();
+        check(t == want, "planner earliest", k, t, want);
+        plan.fired(t);
+        fired.push_back(t);
+    }
+}
+
+template <size_t N>
+static void scenarios(const Schedule &sc, const int (*cm)[N], const char *const *names, size_t count,
+                      int64_t max_delay_us, int runs) {
+    check_planner<N>(sc);
+    printf("%zu sensors, guard %d ms, re-arm %d ms:\n", N, sc.guard_ms, sc.rearm_ms);
+    for (size_t i = 0; i < count; i++) {
+        scenario(sc, names[i], cm[i], max_delay_us, runs);
+    }
+}
+
+int main(int argc, char **argv) {
+    int64_t max_delay_us = 2000;
+    int runs = 2000;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:r:")) != -1) {
+        switch (opt) {
+            case 'j': max_delay_us = atoll(optarg); break;
+            case 'r': runs = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-j max_delay_us] [-r runs]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (max_delay_us < 0 || runs < 0) {
+        fprintf(stderr, "bad options\n");
+        return 2;
+    }
+
+    const Schedule node;
+    Schedule tight;
+    tight.guard_ms = 10;
+    printf("%d samples per sensor, %lld ms ticks, delay up to %lld us, %d runs\n", node.samples,
+           (long long)(TICK_US / 1000), (long long)max_delay_us, runs);
+
+    const int cm2[][2] = {{30, 30}, {450, 450}, {40, 450}, {200, NO_ECHO}};
+    const char *const names2[] = {"targets at 30 cm", "targets at 450 cm", "40 cm + 450 cm", "200 cm + no echo"};
+    const int cm3[][3] = {{30, 30, 30}, {450, 450, 450}, {40, 250, 450}, {100, NO_ECHO, 300}};
+    const char *const names3[] = {"targets at 30 cm", "targets at 450 cm", "40 cm + 250 cm + 450 cm",
+                                  "100 cm + no echo + 300 cm"};
+    for (const Schedule &sc : {node, tight}) {
+        scenarios<2>(sc, cm2, names2, 4, max_delay_us, runs);
+        scenarios<3>(sc, cm3, names3, 4, max_delay_us, runs);
+    }
+
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}
@@ -0,0 +1,142 @@
+// sound_speed_test.cpp
+// Host-side check of the air temperature correction of the ultrasonic
+// distance (components/ultrasonic01/sound_speed.h).
+//
+// Checks, against double-precision formulas:
+//   - the Q16 sound scale (table + interpolation) at every 0.1 degC of the
+//     table range,
+//   - pulse_to_cm() for every distance 2..500 cm and every whole degC
+//     (at most 1 cm off, i.e. rounding), and that SOUND_SCALE_ONE is
+//     bit-identical to the old (pulse_us + 29) / 58,
+//   - the NTC divider table (Beta equation) from 0 to 60 degC,
+//   - EchoDecoder with a scale.
+// Then prints the error of the uncompensated us/58 rule at 450 cm between
+// 15 and 45 degC, next to the compensated one.
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -o sound_speed_test tools/sound_speed_test/sound_speed_test.cpp
+//
+// Usage:
+//   ./sound_speed_test              exit 1 if any check fails
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "components/ultrasonic01/echo_decoder.h"
+#include "components/ultrasonic01/sound_speed.h"
+
+using namespace ultrasonic01;
+
+// Everything the node uses is built by the compiler (static_assert proves it)
+static_assert(sound_scale_q16(TEMP_INVALID) == SOUND_SCALE_ONE, "no reading: us/58");
+static_assert(sound_scale_q16(SOUND_TEMP_MIN_C * 10 - 100) == SOUND_SCALE_TABLE[0], "clamped low");
+static_assert(sound_scale_q16(300) > sound_scale_q16(200), "warmer air: longer distance per us");
+static_assert(pulse_to_cm(26100) == (26100 + 29) / 58, "SOUND_SCALE_ONE is us/58");
+static_assert(pulse_to_cm(-1, sound_scale_q16(250)) == -1, "timeout");
+static constexpr NtcTable NTC;
+static_assert(NTC.temp_c_x10(1650, 3300) == 250, "10k/10k divider at half supply is 25 degC");
+static_assert(NTC.temp_c_x10(0, 3300) == TEMP_INVALID, "shorted thermistor");
+static_assert(NTC.temp_c_x10(3300, 3300) == TEMP_INVALID, "open thermistor");
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, double got, double want) {
+    if (!ok) {
+        if (failures < 20) {
+            printf("FAIL %s: got %.4f, want %.4f\n", what, got, want);
+        }
+        failures++;
+    }
+}
+
+static double exact_speed(double t_c) { return 331.3 * sqrt(1 + t_c / 273.15); }
+
+static void test_scale_table() {
+    double worst = 0;
+    for (int t = SOUND_TEMP_MIN_C * 10; t <= SOUND_TEMP_MAX_C * 10; t++) {
+        double want = exact_speed(t / 10.0) * 58.0 / 20000.0;
+        double got = sound_scale_q16(t) / (double)SOUND_SCALE_ONE;
+        double err = fabs(got - want) / want;
+        if (err > worst) worst = err;
+        check(err < 2e-5, "scale", got, want);
+    }
+    printf("scale table: worst relative error %.2e (%d..%d degC, 0.1 degC steps)\n", worst,
+           SOUND_TEMP_MIN_C, SOUND_TEMP_MAX_C);
+}
+
+static void test_pulse_to_cm() {
+    for (int32_t us = 0; us < 60000; us++) {
+        check(pulse_to_cm(us) == (us + 29) / 58, "us/58 unchanged", pulse_to_cm(us), (us + 29) / 58);
+    }
+    int worst = 0;
+    for (int t = SOUND_TEMP_MIN_C; t <= SOUND_TEMP_MAX_C; t++) {
+        double c = exact_speed(t) * 100.0 / 1e6;   // cm/us
+        for (int cm = 2; cm <= 500; cm++) {
+            int32_t us = (int32_t)lround(2 * cm / c);
+            int got = pulse_to_cm(us, sound_scale_q16(t * 10));
+            int err = abs(got - cm);
+            if (err > worst) worst = err;
+            check(err <= 1, "pulse_to_cm", got, cm);
+        }
+    }
+    printf("pulse_to_cm: worst error %d cm (2..500 cm, every degC)\n", worst);
+}
+
+static void test_ntc() {
+    const NtcModel m;
+    const int supply_mv = 3300;
+    double worst = 0;
+    for (int t10 = 0; t10 <= 600; t10++) {
+        double t_k = t10 / 10.0 + 273.15;
+        double r = m.r25_ohm * exp(m.beta * (1 / t_k - 1 / 298.15));
+        int adc_mv = (int)lround(supply_mv * r / (r + m.r_fixed_ohm));
+        int got = NTC.temp_c_x10(adc_mv, supply_mv);
+        // 1 mV of ADC resolution is up to ~0.1 degC at the ends of this range
+        double err = fabs(got - t10) / 10.0;
+        if (err > worst) worst = err;
+        check(got != TEMP_INVALID && err <= 0.2, "ntc", got / 10.0, t10 / 10.0);
+    }
+    printf("ntc 10k B3950 / 10k: worst error %.2f degC (0..60 degC, ADC rounded to 1 mV)\n", worst);
+}
+
+static void test_decoder() {
+    EchoDecoder d;
+    uint32_t scale = sound_scale_q16(400);   // 40 degC
+    d.begin(1000, 300000, scale);
+    d.on_edge(1, 1100);
+    d.on_edge(0, 1100 + 26100);
+    int want = pulse_to_cm(26100, scale);
+    check(d.state() == EchoDecoder::State::Done && d.distance_cm() == want, "decoder scale", d.distance_cm(), want);
+    d.begin(1000, 300000);
+    d.on_edge(1, 1100);
+    d.on_edge(0, 1100 + 26100);
+    check(d.distance_cm() == (26100 + 29) / 58, "decoder default", d.distance_cm(), (26100 + 29) / 58);
+}
+
+static void report_drift() {
+    const int cm = 450;
+    printf("\nat %d cm (true):   temp   us/58   error   compensated\n", cm);
+    for (int t = 15; t <= 45; t += 5) {
+        double c = exact_speed(t) * 100.0 / 1e6;
+        int32_t us = (int32_t)lround(2 * cm / c);
+        int raw = pulse_to_cm(us);
+        int comp = pulse_to_cm(us, sound_scale_q16(t * 10));
+        printf("%24d C %6d %+6.1f%% %10d\n", t, raw, 100.0 * (raw - cm) / cm, comp);
+    }
+}
+
+int main() {
+    test_scale_table();
+    test_pulse_to_cm();
+    test_ntc();
+    test_decoder();
+    report_drift();
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}
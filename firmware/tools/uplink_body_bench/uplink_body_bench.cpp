@@ -0,0 +1,159 @@
+// uplink_body_bench.cpp
+// Gateway half of the binary-vs-JSON uplink benchmark (HTTP_UPLINK_BINARY in
+// gateway_devkit_v1/main/main.c). The backend half is
+// backend/bench_ingest.php, which times decode and INSERT of the bodies
+// written here.
+//
+// For batch sizes 1, 8, 16 (HTTP_BATCH_MAX) and 32 it builds the JSON and the
+// binary body with the gateway's encoders (gateway_devkit_v1/main/uplink_body.c) and reports bytes
+// and host ns per packet (snprintf vs memcpy). Checks: the binary body is
+// 4 + 33 B per packet and holds the packets unchanged, the JSON body has one
+// object per packet.
+// With -o the bodies are written to <dir>/json_<n>.json and <dir>/bin_<n>.bin.
+//
+// Build (from firmware/):
+//   g++ -std=gnu++17 -O2 -I. -Icommon -Igateway_devkit_v1/main -o uplink_body_bench tools/uplink_body_bench/uplink_body_bench.cpp gateway_devkit_v1/main/uplink_body.c
+//
+// Usage:
+//   ./uplink_body_bench [-k reps] [-o dir]   (default 200000 reps; exit 1 if a check fails)
+//   php ../backend/bench_ingest.php <dir> [reps] [--db]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "uplink_body.h"
+
+static const int BATCH_SIZES[] = {1, 8, 16, 32};
+static const int BATCH_MAX = 32;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static double now_s() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Readings as a gateway sees them: several nodes, rate known or not, alerts now and then
+static SensorPacketV2 make_packet(uint32_t i) {
+    SensorPacketV2 p = {};
+    p.version = (uint8_t)(i % 4 == 3 ? SENSOR_PACKET_VERSION : SENSOR_PACKET_V2_VERSION);
+    p.node_id = (uint8_t)(1 + i % 5);
+    const uint8_t mac[6] = {0x80, 0xf3, 0xda, 0x62, 0xa7, (uint8_t)(0x80 + p.node_id)};
+    memcpy(p.mac, mac, 6);
+    p.seq = 100000 + i;
+    p.distance_cm = (int16_t)(35 + (i * 37) % 380);
+    p.level_cm = (int16_t)(420 - p.distance_cm);
+    p.percentual = (uint8_t)(p.level_cm * 100 / 420);
+    p.volume_l = (uint32_t)p.level_cm * 190;
+    p.vin_mv = (int16_t)(4700 + i % 300);
+    p.rssi = (int8_t)(-45 - (int)(i % 40));
+    p.ts_ms = 1700000000u + i * 30000;
+    p.flags = (uint8_t)(i % 11 == 0 ? FLAG_IS_ALERT : 0);
+    p.alert_type = (uint8_t)(p.flags ? ALERT_RAPID_DROP : ALERT_NONE);
+    p.rate_cmpm_x10 = p.version == SENSOR_PACKET_VERSION ? SENSOR_RATE_UNKNOWN : (int16_t)((int)(i % 41) - 20);
+    return p;
+}
+
+static size_t count_objects(const char *body) {
+    size_t n = 0;
+    for (const char *p = body; (p = strstr(p, "\"node_id\":")) != nullptr; p++) {
+        n++;
+    }
+    return n;
+}
+
+static bool write_file(const std::string &path, const char *data, size_t len) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+int main(int argc, char **argv) {
+    long reps = 200000;
+    const char *dir = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "k:o:")) != -1) {
+        switch (opt) {
+            case 'k': reps = atol(optarg); break;
+            case 'o': dir = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-k reps] [-o dir]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (reps <= 0) {
+        fprintf(stderr, "bad options\n");
+        return 2;
+    }
+
+    std::vector<SensorPacketV2> pkts;
+    for (int i = 0; i < BATCH_MAX; i++) {
+        pkts.push_back(make_packet((uint32_t)i));
+    }
+    static char json[BATCH_MAX * UPLINK_JSON_RECORD_MAX + 2];
+    static char bin[4 + BATCH_MAX * (1 + sizeof(SensorPacketV2))];
+
+    printf("%5s  %9s %9s %7s  %10s %10s %7s\n", "batch", "json B/pk", "bin B/pk", "size", "json ns/pk", "bin ns/pk",
+           "speed");
+    for (int n : BATCH_SIZES) {
+        int jlen = uplink_encode_json(json, sizeof(json), pkts.data(), n, false);
+        int blen = uplink_encode_binary(bin, sizeof(bin), pkts.data(), n, false);
+        check(jlen > 0 && count_objects(json) == (size_t)n, "json: one object per packet");
+        check(blen == 4 + n * (int)(1 + sizeof(SensorPacketV2)), "binary: 4 + 33 B per packet");
+        bool same = blen > 0;
+        for (int i = 0; same && i < n; i++) {
+            same = (uint8_t)bin[4 + i * 33] == sizeof(SensorPacketV2) &&
+                   memcmp(&bin[5 + i * 33], &pkts[i], sizeof(SensorPacketV2)) == 0;
+        }
+        check(same, "binary: packets unchanged");
+
+        if (dir) {
+            std::string base = std::string(dir) + "/";
+            check(write_file(base + "json_" + std::to_string(n) + ".json", json, jlen) &&
+                  write_file(base + "bin_" + std::to_string(n) + ".bin", bin, blen), "write bodies");
+        }
+
+        long loops = reps / n;
+        volatile int sink = 0;
+        double t0 = now_s();
+        for (long k = 0; k < loops; k++) {
+            sink += uplink_encode_json(json, sizeof(json), pkts.data(), n, false);
+        }
+        double t_json = (now_s() - t0) * 1e9 / (loops * n);
+        t0 = now_s();
+        for (long k = 0; k < loops; k++) {
+            sink += uplink_encode_binary(bin, sizeof(bin), pkts.data(), n, false);
+        }
+        double t_bin = (now_s() - t0) * 1e9 / (loops * n);
+        printf("%5d  %9.1f %9.1f %6.1fx  %10.1f %10.1f %6.1fx\n", n, (double)jlen / n, (double)blen / n,
+               (double)jlen / blen, t_json, t_bin, t_json / t_bin);
+    }
+    if (dir) {
+        printf("bodies written to %s/\n", dir);
+    }
+
+    if (failures) {
+        printf("\nFAIL: %d checks\n", failures);
+        return 1;
+    }
+    printf("\nok\n");
+    return 0;
+}